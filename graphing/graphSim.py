@@ -1,6 +1,6 @@
 #This program will run and graph the simulation, comparing serial and parallel
 import sys
-import ConfigParser
+import json
 from subprocess import call
 #If not the independent variable, these values will be used
 MOLECULES = 2112
@@ -23,11 +23,10 @@ def changeConfigFile(timeSteps, molecules, size):
 	f.close()
 #function to get the run-time from the last run
 def getRunTime():
-	config = ConfigParser.RawConfigParser()
-	config.read('run.results')
-	line = config.get('Results','Run-Time')
-	line = line.split()
-	return line[0]
+	f = open('run.results.json')
+	results = json.load(f)
+	f.close()
+	return str(results['results']['run_time'])
 #function to print out the help information
 def printHelp():
 	print "***HELP***"
@@ -61,9 +60,9 @@ for i in input:
 	if xaxis == "Density":
 		changeConfigFile(STEPS, float(i)*SIZE*SIZE*SIZE, SIZE) 
 	f.write(i+'\t')
-	call(["./bin/metrosim", "resources/demo.config", "-s"])
+	call(["./bin/metrosim", "resources/demo.config", "-s", "--json"])
 	f.write(getRunTime()+'\t')
-	call(["./bin/metrosim", "resources/demo.config", "-p"])
+	call(["./bin/metrosim", "resources/demo.config", "-p", "--json"])
 	f.write(getRunTime()+'\n')
 f.close()
 #set up gnuplot
@@ -64,6 +64,10 @@ int metrosim::run(int argc, char** argv) {
 #endif
 
 	Simulation sim = Simulation(args);
+	if (args.dryRun) {
+		sim.dryRun();
+		exit(EXIT_SUCCESS);
+	}
 	sim.run();
 
 	fprintf(stdout, "Finishing simulation...\n\n");
@@ -19,6 +19,21 @@
 using std::string;
 
 #define LONG_NAME 400
+#define LONG_TRAJECTORY 401
+#define LONG_JOURNAL 402
+#define LONG_PACKING 403
+#define LONG_SPATIAL_INDEX 404
+#define LONG_AUTOTUNE 405
+#define LONG_TUNING_DB 406
+#define LONG_PERF_COUNTERS 407
+#define LONG_TRACE 408
+#define LONG_TRACE_SAMPLE 409
+#define LONG_JSON 410
+#define LONG_METRICS_ENDPOINT 411
+#define LONG_DRY_RUN 412
+#define LONG_DRIFT_CHECK 413
+#define LONG_DRIFT_THRESHOLD 414
+#define LONG_DRIFT_RESET 415
 
 bool getCommands(int argc, char** argv, SimulationArgs* args) {
   CommandParameters params = CommandParameters();
@@ -55,6 +70,21 @@ bool readCommandLine(int argc, char** argv, CommandParameters* params) {
     {"neighbor", required_argument, 0, 'l'},
     {"name", required_argument, 0, LONG_NAME},
     {"strategy", required_argument, 0, 'S'},
+    {"trajectory-interval", required_argument, 0, LONG_TRAJECTORY},
+    {"journal", required_argument, 0, LONG_JOURNAL},
+    {"packing", required_argument, 0, LONG_PACKING},
+    {"spatial-index", required_argument, 0, LONG_SPATIAL_INDEX},
+    {"autotune", no_argument, 0, LONG_AUTOTUNE},
+    {"tuning-db", required_argument, 0, LONG_TUNING_DB},
+    {"perf-counters", no_argument, 0, LONG_PERF_COUNTERS},
+    {"trace", required_argument, 0, LONG_TRACE},
+    {"trace-sample", required_argument, 0, LONG_TRACE_SAMPLE},
+    {"json", no_argument, 0, LONG_JSON},
+    {"metrics-endpoint", required_argument, 0, LONG_METRICS_ENDPOINT},
+    {"dry-run", no_argument, 0, LONG_DRY_RUN},
+    {"drift-check", required_argument, 0, LONG_DRIFT_CHECK},
+    {"drift-threshold", required_argument, 0, LONG_DRIFT_THRESHOLD},
+    {"drift-reset", no_argument, 0, LONG_DRIFT_RESET},
     {0, 0, 0, 0}
   };
 
@@ -77,6 +107,34 @@ bool readCommandLine(int argc, char** argv, CommandParameters* params) {
           return false;
         }
         break;
+      case LONG_TRAJECTORY:
+        if (!fromString<int>(optarg, params->trajectoryInterval)) {
+          std::cerr << APP_NAME << ": ";
+          std::cerr << " --trajectory-interval: Invalid trajectory interval"
+                    << std::endl;
+          return false;
+        }
+        if (params->trajectoryInterval < 0) {
+          std::cerr << APP_NAME << ": ";
+          std::cerr << " --trajectory-interval: Trajectory interval must be "
+                       "non-negative"
+                    << std::endl;
+          return false;
+        }
+        break;
+      case LONG_JOURNAL:
+        if (!fromString<int>(optarg, params->journalInterval)) {
+          std::cerr << APP_NAME << ": ";
+          std::cerr << " --journal: Invalid keyframe interval" << std::endl;
+          return false;
+        }
+        if (params->journalInterval < 0) {
+          std::cerr << APP_NAME << ": ";
+          std::cerr << " --journal: Keyframe interval must be non-negative"
+                    << std::endl;
+          return false;
+        }
+        break;
       case 'i': // status interval
         params->statusFlag = true;
         if (!fromString<int>(optarg, params->statusInterval)) {
@@ -158,6 +216,76 @@ bool readCommandLine(int argc, char** argv, CommandParameters* params) {
       case 'S':
         params->simStrategy = string(optarg);
         break;
+      case LONG_PACKING:
+        params->packing = string(optarg);
+        break;
+      case LONG_SPATIAL_INDEX:
+        params->spatialIndex = string(optarg);
+        break;
+      case LONG_AUTOTUNE:
+        params->autotuneFlag = true;
+        break;
+      case LONG_TUNING_DB:
+        params->autotuneFlag = true;
+        params->tuningDbPath = string(optarg);
+        break;
+      case LONG_PERF_COUNTERS:
+        params->perfCountersFlag = true;
+        break;
+      case LONG_JSON:
+        params->jsonFlag = true;
+        break;
+      case LONG_METRICS_ENDPOINT:
+        params->metricsEndpoint = string(optarg);
+        break;
+      case LONG_DRY_RUN:
+        params->dryRunFlag = true;
+        break;
+      case LONG_DRIFT_CHECK:
+        if (!fromString<int>(optarg, params->driftInterval)) {
+          std::cerr << APP_NAME << ": ";
+          std::cerr << " --drift-check: Invalid check interval" << std::endl;
+          return false;
+        }
+        if (params->driftInterval < 0) {
+          std::cerr << APP_NAME << ": ";
+          std::cerr << " --drift-check: Check interval must be non-negative"
+                    << std::endl;
+          return false;
+        }
+        break;
+      case LONG_DRIFT_THRESHOLD:
+        if (!fromString<double>(optarg, params->driftThreshold)) {
+          std::cerr << APP_NAME << ": ";
+          std::cerr << " --drift-threshold: Invalid threshold" << std::endl;
+          return false;
+        }
+        if (params->driftThreshold < 0) {
+          std::cerr << APP_NAME << ": ";
+          std::cerr << " --drift-threshold: Threshold must be non-negative"
+                    << std::endl;
+          return false;
+        }
+        break;
+      case LONG_DRIFT_RESET:
+        params->driftResetFlag = true;
+        break;
+      case LONG_TRACE:
+        params->tracePath = string(optarg);
+        break;
+      case LONG_TRACE_SAMPLE:
+        if (!fromString<int>(optarg, params->traceSampleInterval)) {
+          std::cerr << APP_NAME << ": ";
+          std::cerr << " --trace-sample: Invalid sample interval" << std::endl;
+          return false;
+        }
+        if (params->traceSampleInterval < 1) {
+          std::cerr << APP_NAME << ": ";
+          std::cerr << " --trace-sample: Sample interval must be positive"
+                    << std::endl;
+          return false;
+        }
+        break;
       case '?': // unknown option
         if (optopt) {
           std::cerr << APP_NAME << ": Unknown option -"
@@ -195,6 +323,15 @@ bool parseCommandLine(CommandParameters* params, SimulationArgs* args) {
   } else if (params->serialFlag && params->parallelFlag) { // conflicting flags
     std::cerr << APP_NAME << ": Cannot specify both GPU and CPU modes" << std::endl;
     return false;
+  } else if (params->parallelFlag && params->trajectoryInterval > 0) {
+    // The coordinates only live on the device during a parallel run
+    std::cerr << APP_NAME << ": Cannot write a trajectory in GPU mode"
+              << std::endl;
+    return false;
+  } else if (params->parallelFlag && params->journalInterval > 0) {
+    std::cerr << APP_NAME << ": Cannot write a move journal in GPU mode"
+              << std::endl;
+    return false;
   }
 
   // Assign the relevant information that will be used in the simulation
@@ -219,6 +356,30 @@ bool parseCommandLine(CommandParameters* params, SimulationArgs* args) {
     args->strategy = Strategy::Default;
   }
 
+  // Assign the initial packing
+  if (!params->packing.empty()) {
+    args->packing = Packing::fromString(params->packing);
+    if (args->packing == Packing::Unknown) {
+      std::cerr << APP_NAME << ": Unknown initial packing specified"
+                << std::endl;
+      return false;
+    }
+  } else {
+    args->packing = Packing::Default;
+  }
+
+  // Assign the neighbor cell index
+  if (!params->spatialIndex.empty()) {
+    args->spatialIndex = SpatialIndex::fromString(params->spatialIndex);
+    if (args->spatialIndex == SpatialIndex::Unknown) {
+      std::cerr << APP_NAME << ": Unknown spatial index specified"
+                << std::endl;
+      return false;
+    }
+  } else {
+    args->spatialIndex = SpatialIndex::Default;
+  }
+
   if (!parseInputFile(params->argList[0], args->filePath, args->fileType)) {
     std::cerr << APP_NAME << ": Must specify a config or state file"
               << std::endl;
@@ -232,6 +393,19 @@ bool parseCommandLine(CommandParameters* params, SimulationArgs* args) {
   args->verboseOutput = params->verboseOutputFlag;
   args->useNeighborList = params->neighborListFlag;
   args->neighborListInterval = params->neighborListInterval;
+  args->trajectoryInterval = params->trajectoryInterval;
+  args->journalInterval = params->journalInterval;
+  args->autotune = params->autotuneFlag;
+  args->tuningDbPath = params->tuningDbPath;
+  args->perfCounters = params->perfCountersFlag;
+  args->jsonOutput = params->jsonFlag;
+  args->metricsEndpoint = params->metricsEndpoint;
+  args->dryRun = params->dryRunFlag;
+  args->driftInterval = params->driftInterval;
+  args->driftThreshold = params->driftThreshold;
+  args->driftReset = params->driftResetFlag;
+  args->tracePath = params->tracePath;
+  args->traceSampleInterval = params->traceSampleInterval;
 
   return true;
 }
@@ -340,10 +514,97 @@ void printHelpScreen() {
           "\tname with the current step number appended at the end:\n\n"
           "\t\t<simulation-name>_<step-num>.state\n\n";
 
+  cout << "--trajectory-interval <interval>\n"
+          "\tSpecifies the number of accepted moves between frames of the\n"
+          "\tbinary trajectory. The trajectory is written next to the PDB\n"
+          "\toutput as <simulation-name>.traj, along with a frame offset\n"
+          "\tindex (<simulation-name>.trajidx) for random access to frames.\n"
+          "\tAn interval of 0 (the default) disables the trajectory. Not\n"
+          "\tavailable with the --parallel flag.\n\n";
+
+  cout << "--journal <keyframe-interval>\n"
+          "\tRecords every accepted move in a journal written next to the PDB\n"
+          "\toutput as <simulation-name>.journal. Each record holds the new\n"
+          "\tcoordinates of the moved molecule, and a full keyframe is written\n"
+          "\tevery <keyframe-interval> accepted moves. The configuration at\n"
+          "\tany step can be rebuilt from the journal with JournalReader.\n"
+          "\tAn interval of 0 (the default) disables the journal. Not\n"
+          "\tavailable with the --parallel flag.\n\n";
+
   cout << "--strategy <strategy-name>\t(-S)\n"
           "\tSpecifies the strategy to be used by the simulation for energy\n"
-          "\tcalulations. Options include 'brute-force' and\n"
-          "\t'proximity-matrix'\n\n";
+          "\tcalulations. Options include 'brute-force',\n"
+          "\t'proximity-matrix' and 'auto', which times a few hundred moves\n"
+          "\tof each strategy on the loaded box and uses the fastest.\n\n";
+
+  cout << "--packing <packing-name>\n"
+          "\tSpecifies how molecules are placed in the box when starting\n"
+          "\tfrom a configuration file. Options include 'fcc' (the default),\n"
+          "\t'simple-cubic' and 'random', an overlap-free random packing\n"
+          "\twith random orientations.\n\n";
+
+  cout << "--spatial-index <index-name>\n"
+          "\tSpecifies how the neighbor cells index molecules. 'dense'\n"
+          "\tstores every cell of the grid; 'sparse' hashes only the\n"
+          "\toccupied cells, for slabs, droplets and elongated boxes. By\n"
+          "\tdefault the sparse index is used when fewer than half of the\n"
+          "\tcells are occupied.\n\n";
+
+  cout << "--autotune\n"
+          "\tTimes several launch configurations of the energy kernels\n"
+          "\t(threads and tile size on the CPU, vector length on the GPU)\n"
+          "\tduring the first few thousand steps and keeps the fastest. The\n"
+          "\tresult is stored per machine and system size in\n"
+          "\t~/.mcgpu_tuning, and reused by later runs.\n\n";
+
+  cout << "--tuning-db <path>\n"
+          "\tUses <path> as the tuning database. Implies --autotune.\n\n";
+
+  cout << "--perf-counters\n"
+          "\tCounts cycles, instructions, L1 and last-level cache misses\n"
+          "\tand branch misses with the hardware performance counters\n"
+          "\tduring the system energy calculation and the main loop, and\n"
+          "\treports them in the results file. Linux only.\n\n";
+
+  cout << "--json\n"
+          "\tAlso writes the results as JSON (<name>.results.json) and a\n"
+          "\tstream of metrics with one JSON record per status interval\n"
+          "\t(<name>.metrics.jsonl).\n\n";
+
+  cout << "--dry-run\n"
+          "\tReads the input files and reports the molecule and atom\n"
+          "\tcounts, and for each strategy the memory the run would need\n"
+          "\tand the work each step would do, without running it.\n\n";
+
+  cout << "--drift-check <steps>\n"
+          "\tEvery <steps> steps, recomputes the full system energy from a\n"
+          "\tcopy of the coordinates on a background thread, and prints how\n"
+          "\tfar the running total has drifted from it. A check due while\n"
+          "\tthe last one is still running is skipped.\n\n";
+
+  cout << "--drift-threshold <fraction>\n"
+          "\tWith --drift-check, warns when the drift is more than\n"
+          "\t<fraction> of the energy. Defaults to 1e-6.\n\n";
+
+  cout << "--drift-reset\n"
+          "\tWith --drift-check, replaces the running total with the\n"
+          "\trecomputed energy after each check.\n\n";
+
+  cout << "--metrics-endpoint <port|path>\n"
+          "\tServes live metrics in the Prometheus text format over HTTP,\n"
+          "\ton 127.0.0.1:<port> or on the Unix-domain socket <path>. The\n"
+          "\tvalues are updated at each status interval.\n\n";
+
+  cout << "--trace <path>\n"
+          "\tRecords a timeline of the run (startup phases, status\n"
+          "\tupdates, state saves, output writes, rebuilds of the neighbor\n"
+          "\tstructures, and the phases and parallel tasks of sampled\n"
+          "\tmoves) and writes it to <path> as a Chrome trace, for\n"
+          "\tchrome://tracing or ui.perfetto.dev.\n\n";
+
+  cout << "--trace-sample <moves>\n"
+          "\tRecords the phases of every <moves>-th move in the trace.\n"
+          "\tDefaults to 100.\n\n";
 
   cout << "Generic Tool Options\n"
           "=====================\n\n";
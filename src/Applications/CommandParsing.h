@@ -20,6 +20,8 @@
 
 #define DEFAULT_STATUS_INTERVAL 1000
 #define DEFAULT_NEIGHBORLIST_INTERVAL 100
+#define DEFAULT_TRACE_SAMPLE_INTERVAL 100
+#define DEFAULT_DRIFT_THRESHOLD 1e-6
 
 /**
  * Contains the intermediate values and flags read in from the command
@@ -103,21 +105,85 @@ struct CommandParameters {
   /** The simulation strategy specified by the user */
   std::string simStrategy;
 
+  /** The initial packing specified by the user */
+  std::string packing;
+
+  /** The neighbor cell index specified by the user */
+  std::string spatialIndex;
+
+  /** Declares whether kernel autotuning was requested. */
+  bool autotuneFlag;
+
+  /** The tuning database specified by the user */
+  std::string tuningDbPath;
+
+  /** Declares whether hardware performance counters were requested. */
+  bool perfCountersFlag;
+
+  /** Declares whether JSON output was requested. */
+  bool jsonFlag;
+
+  /** The metrics endpoint specified by the user */
+  std::string metricsEndpoint;
+
+  /** Declares whether a dry run was requested. */
+  bool dryRunFlag;
+
+  /**
+   * The number of simulation steps between recomputations of the energy.
+   * @note A value of 0 means the energy is never recomputed.
+   */
+  int driftInterval;
+
+  /** The relative energy drift above which a warning is printed */
+  double driftThreshold;
+
+  /** Declares whether the energy is reset after each drift check. */
+  bool driftResetFlag;
+
+  /** The trace file specified by the user */
+  std::string tracePath;
+
+  /** The number of moves between those whose phases are traced */
+  int traceSampleInterval;
+
+  /**
+   * The number of accepted moves between binary trajectory frames.
+   * @note A value of 0 means no trajectory is written.
+   */
+  int trajectoryInterval;
+
+  /**
+   * The number of accepted moves between keyframes in the move journal.
+   * @note A value of 0 means no journal is written.
+   */
+  int journalInterval;
+
   /** Default constructor */
   CommandParameters() : statusInterval(DEFAULT_STATUS_INTERVAL),
               stateInterval(0),
               stepCount(0),
-              argCount(0),
-              argList(NULL),
               helpFlag(false),
               versionFlag(false),
+              argCount(0),
+              argList(NULL),
               statusFlag(false),
               stepFlag(false),
               serialFlag(false),
               parallelFlag(false),
               verboseOutputFlag(false),
               neighborListFlag(false),
-              neighborListInterval(DEFAULT_NEIGHBORLIST_INTERVAL)   {}
+              neighborListInterval(DEFAULT_NEIGHBORLIST_INTERVAL),
+              autotuneFlag(false),
+              perfCountersFlag(false),
+              jsonFlag(false),
+              dryRunFlag(false),
+              driftInterval(0),
+              driftThreshold(DEFAULT_DRIFT_THRESHOLD),
+              driftResetFlag(false),
+              traceSampleInterval(DEFAULT_TRACE_SAMPLE_INTERVAL),
+              trajectoryInterval(0),
+              journalInterval(0)   {}
 };
 
 /**
@@ -10,170 +10,78 @@
 #include "Metropolis/Utilities/MathLibrary.h"
 
 Box::Box() {
-	changedMol = Molecule();
-
 	environment = NULL;
+	templates = NULL;
 	atoms = NULL;
-	molecules = NULL;
-	neighborList = NULL;
-
 	bonds = NULL;
 	angles = NULL;
 	dihedrals = NULL;
 	hops = NULL;
+	moleculeTemplates = NULL;
+	moleculeIds = NULL;
+	atomCoordinates = NULL;
+	neighborList = NULL;
 
-	atomCount = 0;
+	parserBytes = 0;
+	templateCount = 0;
 	moleculeCount = 0;
+	atomCount = 0;
 }
 
 Box::~Box() {
 	FREE(environment);
-	FREE(atoms);
-	FREE(molecules);
-	FREE(neighborList);
+	FREE(templates);
+	if (neighborList != NULL) {
+		delete neighborList;
+		neighborList = NULL;
+	}
 
+	FREE(atoms);
 	FREE(bonds);
 	FREE(angles);
 	FREE(dihedrals);
 	FREE(hops);
+	FREE(moleculeTemplates);
+	FREE(moleculeIds);
+
+	if (atomCoordinates != NULL) {
+		for (int i = 0; i < 3; i++) {
+			delete[] atomCoordinates[i];
+		}
+		delete[] atomCoordinates;
+		atomCoordinates = NULL;
+	}
 }
 
-void Box::createNeighborList() {
-	neighborList = new NeighborList(molecules, environment);
-}
-
-int Box::chooseMolecule() {
-	return (int) randomReal(0, environment->numOfMolecules);
-}
-
-int Box::changeMolecule(int molIdx) {
-	Real maxTranslation = environment->maxTranslation;
-	Real maxRotation = environment->maxRotation;
-
-	saveChangedMol(molIdx);
-
-	//Pick an atom in the molecule about which to rotate
-	int atomIndex = randomReal(0, molecules[molIdx].numOfAtoms);
-	Atom vertex = molecules[molIdx].atoms[atomIndex];
-
-	const Real deltaX = randomReal(-maxTranslation, maxTranslation);
-	const Real deltaY = randomReal(-maxTranslation, maxTranslation);
-	const Real deltaZ = randomReal(-maxTranslation, maxTranslation);
-
-	const Real degreesX = randomReal(-maxRotation, maxRotation);
-	const Real degreesY = randomReal(-maxRotation, maxRotation);
-	const Real degreesZ = randomReal(-maxRotation, maxRotation);
-
-	moveMolecule(molecules[molIdx], vertex, deltaX, deltaY, deltaZ,
-		degreesX, degreesY, degreesZ);
-
-	keepMoleculeInBox(molIdx);
-
-	return molIdx;
-}
-
-int Box::changeMolecule(int molIdx, int vIdx, Real dX, Real dY, Real dZ, Real rX, Real rY, Real rZ) {
-	Atom vertex = molecules[molIdx].atoms[vIdx];
-
-	saveChangedMol(molIdx);
-	moveMolecule(molecules[molIdx], vertex, dX, dY, dZ, rX, rY, rZ);
-	keepMoleculeInBox(molIdx);
-	return molIdx;
-}
-
-void Box::keepMoleculeInBox(int molIdx) {
-    int primaryIndex = (*(*(environment->primaryAtomIndexArray))[molecules[molIdx].type])[0];
-    Atom primaryAtom = molecules[molIdx].atoms[primaryIndex];
-
-    int positionX = isOutOfBounds(primaryAtom.x, environment->x);
-    int positionY = isOutOfBounds(primaryAtom.y, environment->y);
-    int positionZ = isOutOfBounds(primaryAtom.z, environment->z);
-
-    for (int i = 0; i < molecules[molIdx].numOfAtoms; i++) {
-		//X axis
-		molecules[molIdx].atoms[i].x = wrapBox(molecules[molIdx].atoms[i].x, environment->x, positionX);
-		//Y axis
-		molecules[molIdx].atoms[i].y = wrapBox(molecules[molIdx].atoms[i].y, environment->y, positionY);
-		//Z axis
-		molecules[molIdx].atoms[i].z = wrapBox(molecules[molIdx].atoms[i].z, environment->z, positionZ);
-    }
-}
-
-int Box::isOutOfBounds(Real coor, Real boxDim) {
-    if (coor < 0)
-	return BELOW_ZERO;
-    else if (coor > boxDim)
-	return ABOVE_BOX_DIM;
-
-    return IN_BOX;
-}
-
-int Box::rollback(int molIdx) {
-	copyMolecule(&molecules[molIdx],&changedMol);
-
-	return molIdx;
+void Box::createNeighborList(Real** atomCoords, int** moleculeData,
+                             int* primaryIndexes) {
+	neighborList = new NeighborList(atomCoords, moleculeData, primaryIndexes,
+	                                environment);
 }
 
-void Box::saveChangedMol(int molIdx) {
-	Molecule *mol_src = &molecules[molIdx];
-
-	//free memory of changedMol before allocate memory
-	if (changedMol.numOfAtoms != 0) {
-		delete[] changedMol.atoms;
-		delete[] changedMol.bonds;
-		delete[] changedMol.angles;
-		delete[] changedMol.dihedrals;
-		delete[] changedMol.hops;
+void Box::localizeIds(Molecule& molecule, int firstId) {
+	for (int i = 0; i < molecule.numOfAtoms; i++) {
+		molecule.atoms[i].id -= firstId;
 	}
 
-	memcpy(&changedMol,mol_src,sizeof(changedMol));
-
-	changedMol.atoms = new Atom[mol_src->numOfAtoms];
-	changedMol.bonds = new Bond[mol_src->numOfBonds];
-	changedMol.angles = new Angle[mol_src->numOfAngles];
-	changedMol.dihedrals = new Dihedral[mol_src->numOfDihedrals];
-	changedMol.hops = new Hop[mol_src->numOfHops];
-
-	copyMolecule(&changedMol,mol_src);
-}
-
-void Box::copyMolecule(Molecule *mol_dst, Molecule *mol_src) {
-  mol_dst->numOfAtoms = mol_src->numOfAtoms;
-  mol_dst->numOfBonds = mol_src->numOfBonds;
-  mol_dst->numOfAngles = mol_src->numOfAngles;
-  mol_dst->numOfDihedrals = mol_src->numOfDihedrals;
-  mol_dst->numOfHops = mol_src->numOfHops;
-  mol_dst->id = mol_src->id;
-  mol_dst->type = mol_src->type;
-
-  for(int i = 0; i < mol_src->numOfAtoms; i++) {
-    mol_dst->atoms[i] = mol_src->atoms[i];
-  }
-
-  for(int i = 0; i < mol_src->numOfBonds; i++) {
-    mol_dst->bonds[i] = mol_src->bonds[i];
-  }
-
-  for(int i = 0; i < mol_src->numOfAngles; i++) {
-    mol_dst->angles[i] = mol_src->angles[i];
-  }
-
-  for(int i = 0; i < mol_src->numOfDihedrals; i++) {
-    mol_dst->dihedrals[i] = mol_src->dihedrals[i];
-  }
+	for (int i = 0; i < molecule.numOfBonds; i++) {
+		molecule.bonds[i].atom1 -= firstId;
+		molecule.bonds[i].atom2 -= firstId;
+	}
 
-  for(int i = 0; i < mol_src->numOfHops; i++) {
-    mol_dst->hops[i] = mol_src->hops[i];
-  }
-}
+	for (int i = 0; i < molecule.numOfAngles; i++) {
+		molecule.angles[i].atom1 -= firstId;
+		molecule.angles[i].atom2 -= firstId;
+		molecule.angles[i].commonAtom -= firstId;
+	}
 
-Real Box::wrapBox(Real x, Real boxDim, int position) {
-	if (position == IN_BOX)
-		return x;
-	else if(position == ABOVE_BOX_DIM)
-		x -= boxDim;
-	else if (position == BELOW_ZERO)
-		x += boxDim;
+	for (int i = 0; i < molecule.numOfDihedrals; i++) {
+		molecule.dihedrals[i].atom1 -= firstId;
+		molecule.dihedrals[i].atom2 -= firstId;
+	}
 
-  return x;
+	for (int i = 0; i < molecule.numOfHops; i++) {
+		molecule.hops[i].atom1 -= firstId;
+		molecule.hops[i].atom2 -= firstId;
+	}
 }
@@ -5,6 +5,11 @@
  * between constants files, z-matrices, config files, and state files, and the
  * SimBox class, which now performs energy calculations.
  *
+ * Every molecule in a simulation is a copy of one of a handful of molecule
+ * types, so the box only stores one template molecule per type. SimBoxBuilder
+ * stamps the templates out into the SimBox's arrays, and output files are
+ * written from the templates plus the SimBox's coordinates.
+ *
  *	Author: Nathan Coleman
  *	Created: February 21, 2014
  *
@@ -31,45 +36,6 @@ using namespace std;
 
 class Box
 {
-	private:
-
-		/**
-		 * IN_BOX indicates that a coordinate measurement is between 0 and the size
-		 *     of the box.
-		 */
-		static const int IN_BOX = 0;
-
-		/**
-		 * BELOW_ZERO indicates that a coordinate measurement is less than 0.
-		 */
-		static const int BELOW_ZERO = -1;
-
-		/**
-		 * ABOVE_BOX_DIM indicates that a coordinate measurement is greater than the
-		 *     length of the box in the corresponding dimension.
-		 */
-		static const int ABOVE_BOX_DIM = 1;
-
-	protected:
-
-		/**
-		 * Holds the old state of whatever molecule is being changed so that it can
-		 * be rolled back if the change is rejected.
-		 */
-		Molecule changedMol;
-
-    /**
-		 * Given a coordinate and the length of the box in the corresponding
-		 *     dimension, indicates whether the coordinate is cout of bounds.
-     *
-		 * @param coor The coordinate measurement to test for being in bounds.
-		 * @param boxDim The length of the box in the same dimension as the
-		 *     coordinate measurement.
-		 * @returns IN_BOX if 0 <= coor <= boxDim, BELOW_ZERO if coor < 0, and
-		 *     ABOVE_BOX_DIM if boxDim < coor.
-		 */
-		int isOutOfBounds(Real coor, Real boxDim);
-
 	public:
 
 		/**
@@ -80,71 +46,81 @@ class Box
 		Environment *environment;
 
 		/**
-		 * A dynamic array of the atoms within the box.
+		 * A dynamic array holding one template molecule for each molecule type.
+		 *     The atoms, bonds, etc. of each template are aliased to the arrays
+		 *     below. Atom IDs within a template (including the endpoints of its
+		 *     bonds, angles, dihedrals and hops) are local to the molecule, so
+		 *     atom 0 is the template's first atom.
 		 */
-		Atom *atoms;
+		Molecule *templates;
 
 		/**
-		 * A dynamic array of the molecules within the box. The atoms in each
-		 *     molecule and the atoms in atoms are aliased to one another, along
-		 *     with bonds, angles, etc.
+		 * A dynamic array of the atoms of every template.
 		 */
-		Molecule *molecules;
+		Atom *atoms;
 
 		/**
-		 * A dynamic array of the bonds within the box.
+		 * A dynamic array of the bonds of every template.
 		 */
 		Bond *bonds;
 
 		/**
-		 * A dynamic array of the angles within the box.
+		 * A dynamic array of the angles of every template.
 		 */
 		Angle *angles;
 
 		/**
-		 * A dynamic array of the dihedrals within the box.
+		 * A dynamic array of the dihedrals of every template.
 		 */
 		Dihedral *dihedrals;
 
 		/**
-		 * A dynamic array of the hops within the box.
+		 * A dynamic array of the hops of every template.
 		 */
 		Hop *hops;
 
 		/**
-		 * Points to the neighborList for the box.
+		 * int[moleculeCount]. The index into templates of each molecule.
 		 */
-		NeighborList *neighborList;
+		int *moleculeTemplates;
 
 		/**
-		 * The number of atoms in the box.
+		 * int[moleculeCount]. The ID of each molecule, as written to state files.
 		 */
-		int atomCount;
+		int *moleculeIds;
 
 		/**
-		 * The number of molecules in the box.
+		 * Real[3][atomCount]. The initial coordinates of every atom, when they
+		 *     are read in rather than generated (e.g. from a state file), or NULL.
+		 *     SimBoxBuilder takes ownership of the array and resets this to NULL.
 		 */
-		int moleculeCount;
+		Real **atomCoordinates;
+
+		/**
+		 * Points to the neighborList for the box.
+		 */
+		NeighborList *neighborList;
 
 		/**
-		 * The number of bonds in the box.
+		 * The approximate bytes the parameter tables held while the input files
+		 *     were read. The tables are freed once the box has been loaded.
 		 */
-		int bondCount;
+		size_t parserBytes;
 
 		/**
-		 * The number of angles in the box.
+		 * The number of templates (molecule types) in the box.
 		 */
-		int angleCount;
+		int templateCount;
 
 		/**
-		 * The number of dihedrals in the box.
+		 * The number of molecules in the box.
 		 */
-		int dihedralCount;
+		int moleculeCount;
 
 		/**
-		 * The number of hops in the box.
+		 * The number of atoms in the box.
 		 */
-		int hopCount;
+		int atomCount;
 
 		/**
 		 * Default (parameterless) constructor for box.
@@ -157,22 +133,23 @@ class Box
 		~Box();
 
 		/**
-		 * Getter method for atoms.
-		 * @return A pointer to the atoms dynamic array.
+		 * Getter method for templates.
+		 * @return A pointer to the templates dynamic array.
 		 */
-		Atom* getAtoms(){return atoms;};
+		Molecule* getTemplates(){return templates;};
 
 		/**
-		 * Getter method for atomCount
-		 * @return The number of atoms in the box.
+		 * Getter method for a molecule's template.
+		 * @param molIdx The index of the molecule.
+		 * @return The template molecule the molecule is a copy of.
 		 */
-		int getAtomCount(){return atomCount;};
+		Molecule& getTemplate(int molIdx){return templates[moleculeTemplates[molIdx]];};
 
 		/**
-		 * Getter method for molecules.
-		 * @return A pointer to the molecules dynamic array.
+		 * Getter method for atomCount
+		 * @return The number of atoms in the box.
 		 */
-		Molecule* getMolecules(){return molecules;};
+		int getAtomCount(){return atomCount;};
 
 		/**
 		 * Getter method for molecule count.
@@ -193,80 +170,23 @@ class Box
 		NeighborList* getNeighborList() {return neighborList;};
 
 		/**
-		 * Creates the box's neighbor list.
-		 */
-		void createNeighborList();
-
-    /**
-		 * Chooses a random molecule to be changed for a given simulation step.
-		 *
-		 * @return Returns the index of the chosen molecule.
-     */
-		int chooseMolecule();
-
-    /**
-		 * Changes a given molecule (specifically its Atoms) in a way determined
-		 * by given input tranlations and rotations.
+		 * Creates the box's neighbor list from the simulation box's coordinates.
 		 *
-		 * @param molIdx The index of the molecule to be changed.
-		 * @param vIdx The index of the atom in the molecule about which it will
-		 * 		 be rotated.
-		 * @param dX The amount to translate the molecule in the x direction.
-		 * @param dY The amount to translate the molecule in the y direction.
-		 * @param dZ The amount to translate the molecule in the z direction.
-		 * @param rX The amount to rotate the molecule about the x axis.
-		 * @param rY The amount to rotate the molecule about the y axis.
-		 * @param rZ The amount to rotate the molecule about the z axis.
-		 * @return The index of the changed molecule.
-		 * @deprecated This method was used solely for testing the new SimBox
-		 */
-		virtual int changeMolecule(int molIdx, int vIdx, Real dX, Real dY, Real dZ, Real rX, Real rY, Real rZ);
-
-    /**
-		 * Changes a given molecule (specifically its Atoms)
-		 *   in a random way, constrained by maxTranslation
-		 *   and maxRotation.
-		 * @param molIdx The index of the molecule to be changed.
-		 * @return Returns the index of the changed molecule.
-		 * @note This method is virtual to be overridden by an subclass.
-     */
-		virtual int changeMolecule(int molIdx);
-
-		/**
-		 * Makes each of the molecule's positional attributes
-		 *   periodic within the dimensions of the environment.
-		 * @param molecule The index of the molecule to be fixed.
-		 */
-		void keepMoleculeInBox(int molIdx);
-
-		/**
-		 * Rolls back the previous molecule change.
-		 * @param molIdx The index of the molecule to be reverted.
-		 * @return Returns the index of the reverted molecule.
-		 * @note This method is virtual to be overridden by an subclass.
+		 * @param atomCoords Real[3][numAtoms]. The coordinates of every atom.
+		 * @param moleculeData The simulation box's moleculeData.
+		 * @param primaryIndexes The simulation box's primaryIndexes.
 		 */
-		virtual int rollback(int molIdx);
+		void createNeighborList(Real** atomCoords, int** moleculeData,
+		                        int* primaryIndexes);
 
 		/**
-		 * Saves the unchanged version of a molecule to be changed.
-		 * @param molIdx The index of the molecule to be saved.
-		 */
-		void saveChangedMol(int molIdx);
-
-		/**
-		 * Copies the data of one molecule to another.
-		 * @param mol_dst A pointer to the destination molecule.
-		 * @param mol_src A pointer to the source molecule.
-		 */
-		void copyMolecule(Molecule *mol_dst, Molecule *mol_src);
-
-		/**
-		 * Makes a position periodic within a specified range.
-		 * @param x The position to be made periodic.
-		 * @param boxDim The magnitude of the periodic range.
-		 * @return Returns the periodic position.
+		 * Converts the atom IDs of a template from box-wide IDs into IDs local
+		 *     to the molecule, given the box-wide ID of its first atom.
+		 *
+		 * @param molecule The template to convert.
+		 * @param firstId The box-wide ID of the template's first atom.
 		 */
-		Real wrapBox(Real x, Real boxDim, int position);
+		static void localizeIds(Molecule& molecule, int firstId);
 
 };
 
@@ -1,6 +1,10 @@
 #include "BruteForceStep.h"
 #include "SimulationStep.h"
 #include "GPUCopy.h"
+#include "PairCounters.h"
+#include "Utilities/Tracer.h"
+
+#include <algorithm>
 
 
 Real BruteForceStep::calcMolecularEnergyContribution(int currMol,
@@ -14,6 +18,13 @@ Real BruteForceStep::calcMolecularEnergyContribution(int currMol,
 
 Real BruteForceCalcs::calcMolecularEnergyContribution(int currMol,
                                                       int startMol) {
+  if (SimCalcs::sb->useNLC && !SimCalcs::on_gpu) {
+    return calcNLCContribution(currMol, startMol);
+  }
+  if (SimCalcs::kernel.tiled && !SimCalcs::on_gpu) {
+    return calcTiledContribution(currMol, startMol);
+  }
+
   Real total = 0;
 
   int** molData = GPUCopy::moleculeDataPtr();
@@ -27,15 +38,20 @@ Real BruteForceCalcs::calcMolecularEnergyContribution(int currMol,
   const int p1Start = SimCalcs::sb->moleculeData[MOL_PIDX_START][currMol];
   const int p1End = (SimCalcs::sb->moleculeData[MOL_PIDX_COUNT][currMol]
                      + p1Start);
+  #ifdef _OPENACC
+  const int vectorLength = SimCalcs::kernel.vectorLength;
+  #endif
 
   #pragma acc parallel loop gang deviceptr(molData, atomCoords, bSize, \
-      pIdxes, aData) if (SimCalcs::on_gpu) vector_length(64)
+      pIdxes, aData) if (SimCalcs::on_gpu) vector_length(vectorLength)
   for (int otherMol = startMol; otherMol < numMolecules; otherMol++) {
     if (otherMol != currMol) {
       int p2Start = molData[MOL_PIDX_START][otherMol];
       int p2End = molData[MOL_PIDX_COUNT][otherMol] + p2Start;
+      PAIR_COUNT(moleculePairs, 1);
       if (SimCalcs::moleculesInRange(p1Start, p1End, p2Start, p2End,
                                      atomCoords, bSize, pIdxes, cutoff)) {
+        PAIR_COUNT(moleculePairsInRange, 1);
         total += calcMoleculeInteractionEnergy(currMol, otherMol, molData,
                                                aData, atomCoords, bSize);
       }
@@ -45,6 +61,89 @@ Real BruteForceCalcs::calcMolecularEnergyContribution(int currMol,
   return total;
 }
 
+Real BruteForceCalcs::calcNLCContribution(int currMol, int startMol) {
+  SimBox* sb = SimCalcs::sb;
+  int** molData = sb->moleculeData;
+  Real** atomCoords = sb->atomCoordinates;
+  Real* bSize = sb->size;
+  int* pIdxes = sb->primaryIndexes;
+  Real** aData = sb->atomData;
+  Real cutoff = sb->cutoff;
+
+  const int p1Start = molData[MOL_PIDX_START][currMol];
+  const int p1End = molData[MOL_PIDX_COUNT][currMol] + p1Start;
+
+  Real total = 0;
+  int numNeighbors = sb->findNeighbors(currMol);
+  for (int n = 0; n < numNeighbors; n++) {
+    const int cell = sb->neighbors[n];
+    const int* members = sb->cellMembers + sb->cellStart[cell];
+    const int count = sb->cellCount[cell];
+    for (int i = 0; i < count; i++) {
+      const int otherMol = members[i];
+      if (otherMol != currMol && otherMol >= startMol) {
+        int p2Start = molData[MOL_PIDX_START][otherMol];
+        int p2End = molData[MOL_PIDX_COUNT][otherMol] + p2Start;
+        PAIR_COUNT(moleculePairs, 1);
+        if (SimCalcs::moleculesInRange(p1Start, p1End, p2Start, p2End,
+                                       atomCoords, bSize, pIdxes, cutoff)) {
+          PAIR_COUNT(moleculePairsInRange, 1);
+          total += calcMoleculeInteractionEnergy(currMol, otherMol, molData,
+                                                 aData, atomCoords, bSize);
+        }
+      }
+    }
+  }
+  return total;
+}
+
+Real BruteForceCalcs::calcTiledContribution(int currMol, int startMol) {
+  int** molData = SimCalcs::sb->moleculeData;
+  Real** atomCoords = SimCalcs::sb->atomCoordinates;
+  Real* bSize = SimCalcs::sb->size;
+  int* pIdxes = SimCalcs::sb->primaryIndexes;
+  Real** aData = SimCalcs::sb->atomData;
+  Real cutoff = SimCalcs::sb->cutoff;
+  const int numMolecules = SimCalcs::sb->numMolecules;
+
+  const int p1Start = molData[MOL_PIDX_START][currMol];
+  const int p1End = molData[MOL_PIDX_COUNT][currMol] + p1Start;
+
+  const int numBlocks = (numMolecules - startMol + ENERGY_BLOCK - 1) /
+                        ENERGY_BLOCK;
+  Real* sums = SimCalcs::blockSums(numBlocks);
+  const KernelConfig config = SimCalcs::kernel;
+
+  #pragma omp parallel for num_threads(config.threads) \
+      schedule(dynamic, config.tileSize) if (config.threads > 1)
+  for (int b = 0; b < numBlocks; b++) {
+    const int blockStart = startMol + b * ENERGY_BLOCK;
+    const int blockEnd = std::min(blockStart + ENERGY_BLOCK, numMolecules);
+    TraceScope traced("Energy Tile", Tracer::isMoveSampled());
+    Real sum = 0;
+    for (int otherMol = blockStart; otherMol < blockEnd; otherMol++) {
+      if (otherMol != currMol) {
+        int p2Start = molData[MOL_PIDX_START][otherMol];
+        int p2End = molData[MOL_PIDX_COUNT][otherMol] + p2Start;
+        PAIR_COUNT(moleculePairs, 1);
+        if (SimCalcs::moleculesInRange(p1Start, p1End, p2Start, p2End,
+                                       atomCoords, bSize, pIdxes, cutoff)) {
+          PAIR_COUNT(moleculePairsInRange, 1);
+          sum += calcMoleculeInteractionEnergy(currMol, otherMol, molData,
+                                               aData, atomCoords, bSize);
+        }
+      }
+    }
+    sums[b] = sum;
+  }
+
+  Real total = 0;
+  for (int b = 0; b < numBlocks; b++) {
+    total += sums[b];
+  }
+  return total;
+}
+
 Real BruteForceCalcs::calcMoleculeInteractionEnergy (int m1, int m2,
                                                      int** molData,
                                                      Real** aData,
@@ -65,6 +164,9 @@ Real BruteForceCalcs::calcMoleculeInteractionEnergy (int m1, int m2,
           && aData[ATOM_EPSILON][i] >= 0 && aData[ATOM_EPSILON][j] >= 0) {
 
         const Real r2 = SimCalcs::calcAtomDistSquared(i, j, aCoords, bSize);
+        PAIR_COUNT(atomPairs, 1);
+        PAIR_COUNT(atomPairsInCutoff, r2 < SimCalcs::sb->cutoff *
+                                           SimCalcs::sb->cutoff);
         if (r2 == 0.0) {
           energySum += 0.0;
         } else {
@@ -47,6 +47,34 @@ namespace BruteForceCalcs {
    */
   Real calcMolecularEnergyContribution(int currMol, int startMol);
 
+  /**
+   * Determines the energy contribution of a particular molecule on the CPU,
+   * summing the other molecules in blocks of ENERGY_BLOCK, spread over
+   * SimCalcs::kernel.threads threads.
+   *
+   * @param currMol The index of the molecule to calculate the contribution of
+   * @param startMol The index of the molecule to begin searching from to
+   * determine interaction energies.
+   * @return The total energy of the box (discounts initial lj &
+   * charge energy)
+   */
+  Real calcTiledContribution(int currMol, int startMol);
+
+  /**
+   * Determines the energy contribution of a particular molecule on the CPU,
+   * checking only the molecules in the neighbor cells (see
+   * SimBox::findNeighbors) of its cell. Used when SimBox::useNLC is set.
+   * The cells are at least a cutoff wide, so every molecule whose first
+   * primary index atom is in range is found.
+   *
+   * @param currMol The index of the molecule to calculate the contribution of
+   * @param startMol The index of the molecule to begin searching from to
+   * determine interaction energies.
+   * @return The total energy of the box (discounts initial lj &
+   * charge energy)
+   */
+  Real calcNLCContribution(int currMol, int startMol);
+
   /**
    * Determines whether or not two molecule's primaryIndexes are within the
    * cutoff range of one another.
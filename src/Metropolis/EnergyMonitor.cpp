@@ -0,0 +1,157 @@
+/**
+ * EnergyMonitor.cpp
+ *
+ * Background recomputation of the system energy for --drift-check
+ */
+
+#include <algorithm>
+#include <cstring>
+#include <math.h>
+
+#include "EnergyMonitor.h"
+#include "BruteForceStep.h"
+#include "PairCounters.h"
+#include "SimulationStep.h"
+#include "Utilities/Tracer.h"
+
+EnergyMonitor::EnergyMonitor(const SimBox* sb, Real correction) {
+  this->sb = sb;
+  this->correction = correction;
+  busy = requested = stopping = false;
+  finished = false;
+  checks = skipped = 0;
+  maxDrift = maxRelativeDrift = 0;
+
+  snapshot = new Real*[NUM_DIMENSIONS];
+  for (int dim = 0; dim < NUM_DIMENSIONS; dim++) {
+    snapshot[dim] = new Real[sb->numAtoms];
+  }
+
+  worker = std::thread(&EnergyMonitor::workerLoop, this);
+}
+
+EnergyMonitor::~EnergyMonitor() {
+  {
+    std::unique_lock<std::mutex> guard(lock);
+    stopping = true;
+  }
+  started.notify_all();
+  worker.join();
+
+  for (int dim = 0; dim < NUM_DIMENSIONS; dim++) {
+    delete[] snapshot[dim];
+  }
+  delete[] snapshot;
+}
+
+bool EnergyMonitor::submit(long step, Real running) {
+  if (busy) {
+    skipped++;
+    return false;
+  }
+
+  // The monitor's thread is idle, so the snapshot can be written unlocked
+  for (int dim = 0; dim < NUM_DIMENSIONS; dim++) {
+    memcpy(snapshot[dim], sb->atomCoordinates[dim],
+           sb->numAtoms * sizeof(Real));
+  }
+  current.step = step;
+  current.running = running;
+  busy = true;
+
+  {
+    std::unique_lock<std::mutex> guard(lock);
+    requested = true;
+  }
+  started.notify_one();
+  return true;
+}
+
+bool EnergyMonitor::collect(DriftCheck& check) {
+  if (!finished.load(std::memory_order_acquire)) {
+    return false;
+  }
+  check = current;
+  finished.store(false, std::memory_order_relaxed);
+  busy = false;
+
+  checks++;
+  maxDrift = std::max(maxDrift, (Real) fabs(check.drift));
+  maxRelativeDrift = std::max(maxRelativeDrift,
+                              (Real) fabs(check.relativeDrift));
+  return true;
+}
+
+bool EnergyMonitor::wait(DriftCheck& check) {
+  if (!busy) {
+    return false;
+  }
+  {
+    TraceScope traced("Wait For Drift Check", Tracer::isEnabled());
+    std::unique_lock<std::mutex> guard(lock);
+    while (!finished.load(std::memory_order_acquire)) {
+      done.wait(guard);
+    }
+  }
+  return collect(check);
+}
+
+void EnergyMonitor::workerLoop() {
+  Tracer::nameThread("Energy Monitor");
+  while (true) {
+    {
+      std::unique_lock<std::mutex> guard(lock);
+      while (!requested && !stopping) {
+        started.wait(guard);
+      }
+      if (!requested) {
+        return;
+      }
+      requested = false;
+    }
+
+    Real recomputed;
+    {
+      TraceScope traced("Drift Check", Tracer::isEnabled());
+      recomputed = calcSystemEnergy(sb, snapshot) + correction;
+    }
+    current.recomputed = recomputed;
+    current.drift = current.running - recomputed;
+    current.relativeDrift = recomputed != 0 ? current.drift / fabs(recomputed)
+                                            : 0;
+
+    {
+      std::unique_lock<std::mutex> guard(lock);
+      finished.store(true, std::memory_order_release);
+    }
+    done.notify_all();
+  }
+}
+
+Real EnergyMonitor::calcSystemEnergy(const SimBox* sb, Real** atomCoords) {
+  // The pairs of a check are not part of the simulation's work
+  PairCountPause paused;
+
+  int** molData = sb->moleculeData;
+  Real** aData = sb->atomData;
+  Real* bSize = sb->size;
+  int* pIdxes = sb->primaryIndexes;
+  const Real cutoff = sb->cutoff;
+
+  Real total = 0;
+  for (int m1 = 0; m1 < sb->numMolecules; m1++) {
+    const int p1Start = molData[MOL_PIDX_START][m1];
+    const int p1End = molData[MOL_PIDX_COUNT][m1] + p1Start;
+
+    for (int m2 = m1 + 1; m2 < sb->numMolecules; m2++) {
+      const int p2Start = molData[MOL_PIDX_START][m2];
+      const int p2End = molData[MOL_PIDX_COUNT][m2] + p2Start;
+      if (SimCalcs::moleculesInRange(p1Start, p1End, p2Start, p2End,
+                                     atomCoords, bSize, pIdxes, cutoff)) {
+        total += BruteForceCalcs::calcMoleculeInteractionEnergy(
+            m1, m2, molData, aData, atomCoords, bSize);
+      }
+    }
+  }
+  return total;
+}
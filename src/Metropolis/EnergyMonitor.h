@@ -0,0 +1,142 @@
+/**
+ * EnergyMonitor.h
+ *
+ * Checks the running total energy of the simulation for --drift-check. The
+ * main loop only adds up the change in energy of each accepted move, so any
+ * error in those changes accumulates over the run. Every so many steps the
+ * monitor takes a copy of the atom coordinates and, on a background thread,
+ * recomputes the full system energy from it; the difference from the running
+ * total at the same step is the drift.
+ *
+ * The recomputation sums every pair of molecules in range with the
+ * brute-force pair kernel, without the strategy's structures, so it is a
+ * reference for any strategy. Its pairs are not added to the pair counters of
+ * COUNTERS=1 builds. It runs while the simulation goes on: if the previous
+ * check has not finished when the next is due, the new one is skipped rather
+ * than making the loop wait.
+ */
+
+#ifndef METROPOLIS_ENERGYMONITOR_H
+#define METROPOLIS_ENERGYMONITOR_H
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#include "SimBox.h"
+
+/** The result of one recomputation of the system energy */
+struct DriftCheck {
+  /** The step the coordinates were copied at, before its move */
+  long step;
+
+  /** The running total energy at that step */
+  Real running;
+
+  /** The energy recomputed from the copied coordinates */
+  Real recomputed;
+
+  /** running - recomputed */
+  Real drift;
+
+  /** The drift as a fraction of the recomputed energy */
+  Real relativeDrift;
+};
+
+class EnergyMonitor {
+  public:
+    /**
+     * Starts the monitor's thread.
+     *
+     * @param sb The simulation box. Only its coordinates may change while
+     *     the monitor runs, and it must outlive the monitor.
+     * @param correction The energy added to the pair energies, such as the
+     *     long-range correction, so the result matches the running total.
+     */
+    EnergyMonitor(const SimBox* sb, Real correction);
+
+    /** Finishes any check in progress, then stops the monitor's thread. */
+    ~EnergyMonitor();
+
+    /**
+     * Copies the current coordinates and starts recomputing the energy from
+     * them in the background, unless a check is still in progress.
+     *
+     * @param step The current step.
+     * @param running The running total energy at this step.
+     * @return false if the check was skipped.
+     */
+    bool submit(long step, Real running);
+
+    /**
+     * Picks up the result of the check in progress if it has finished.
+     *
+     * @param check Set to the result.
+     * @return true if a result was picked up.
+     */
+    bool collect(DriftCheck& check);
+
+    /**
+     * Waits for the check in progress, if any, and picks up its result.
+     *
+     * @param check Set to the result.
+     * @return true if a result was picked up.
+     */
+    bool wait(DriftCheck& check);
+
+    /** @return the number of checks whose results were picked up */
+    int getChecks() {return checks;}
+
+    /** @return the number of checks skipped because one was in progress */
+    int getSkipped() {return skipped;}
+
+    /** @return the largest absolute drift picked up */
+    Real getMaxDrift() {return maxDrift;}
+
+    /** @return the largest absolute relative drift picked up */
+    Real getMaxRelativeDrift() {return maxRelativeDrift;}
+
+    /**
+     * Computes the energy of a configuration by summing every pair of
+     * molecules in range.
+     *
+     * @param sb The simulation box, for everything but the coordinates.
+     * @param atomCoords The coordinates to use.
+     * @return The energy, without any correction.
+     */
+    static Real calcSystemEnergy(const SimBox* sb, Real** atomCoords);
+
+  private:
+    const SimBox* sb;
+    Real correction;
+
+    /** The copied coordinates of the check in progress */
+    Real** snapshot;
+
+    /** The check in progress, filled in by the monitor's thread */
+    DriftCheck current;
+
+    /** True from submit() until the result is picked up */
+    bool busy;
+
+    /** True from submit() until the monitor's thread starts the check */
+    bool requested;
+
+    /** True once the monitor's thread has a result to pick up */
+    std::atomic<bool> finished;
+
+    int checks, skipped;
+    Real maxDrift, maxRelativeDrift;
+    bool stopping;
+
+    std::mutex lock;
+    std::condition_variable started;
+    std::condition_variable done;
+    std::thread worker;
+
+    /** Entry point for the monitor's thread */
+    void workerLoop();
+};
+
+#endif
@@ -0,0 +1,231 @@
+#include "KernelTuner.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "Utilities/Timer.h"
+
+/** @return the most threads a parallel region may use */
+static int maxThreads() {
+#ifdef _OPENMP
+  return omp_get_max_threads();
+#else
+  return 1;
+#endif
+}
+
+KernelTuner::KernelTuner(SimBox* sb_in, SimulationStrategy strategy_in,
+                         bool parallel_in, const std::string& dbPath_in) {
+  sb = sb_in;
+  strategy = strategy_in;
+  parallel = parallel_in;
+  dbPath = dbPath_in;
+  if (dbPath.empty()) {
+    const char* home = getenv("HOME");
+    dbPath = home != NULL ? std::string(home) + "/" : "";
+    dbPath.append(TUNING_DB_DEFAULT);
+  }
+
+  current = currentMoves = 0;
+  moveStart = 0;
+  tuning = false;
+  source = "default";
+  perMove = 0;
+
+  if (parallel) {
+    int lengths[] = {32, 64, 128, 256};
+    for (int i = 0; i < 4; i++) {
+      Candidate c = {{false, 1, 1, lengths[i]}, 0, 0};
+      candidates.push_back(c);
+    }
+  } else {
+    int tiles[] = {1, 4, 16};
+    int threads = 1;
+    while (true) {
+      for (int i = 0; i < 3; i++) {
+        Candidate c = {{true, threads, tiles[i], 64}, 0, 0};
+        candidates.push_back(c);
+        if (threads == 1) {
+          break;  // The tile size only matters with several threads
+        }
+      }
+      if (threads == maxThreads()) {
+        break;
+      }
+      threads = std::min(2 * threads, maxThreads());
+    }
+  }
+}
+
+std::string KernelTuner::getKey() {
+  char host[256];
+  if (gethostname(host, sizeof(host)) != 0) {
+    snprintf(host, sizeof(host), "unknown");
+  }
+  host[sizeof(host) - 1] = '\0';
+
+  std::stringstream key;
+  key << host << " " << (parallel ? "gpu" : "cpu") << " "
+      << Strategy::toString(strategy) << " " << sb->numMolecules << " "
+      << sb->numAtoms << " " << maxThreads();
+  return key.str();
+}
+
+bool KernelTuner::loadTuning() {
+  std::ifstream db(dbPath.c_str());
+  if (!db.is_open()) {
+    return false;
+  }
+
+  // Entries are the six key fields followed by the configuration
+  std::string key = getKey(), line;
+  while (std::getline(db, line)) {
+    if (line.empty() || line[0] == '#') {
+      continue;
+    }
+    std::istringstream in(line);
+    std::string field, lineKey;
+    for (int i = 0; i < 6 && in >> field; i++) {
+      lineKey.append(i == 0 ? "" : " ").append(field);
+    }
+    KernelConfig config = {!parallel, 1, 1, 64};
+    double usPerMove;
+    if (lineKey == key && in >> config.threads >> config.tileSize
+        >> config.vectorLength >> usPerMove) {
+      SimCalcs::kernel = config;
+      source = "cached";
+      perMove = usPerMove * 1e-6;
+      return true;
+    }
+  }
+  return false;
+}
+
+void KernelTuner::start() {
+  tuning = true;
+  current = currentMoves = 0;
+  SimCalcs::kernel = candidates[current].config;
+}
+
+void KernelTuner::startMove() {
+  moveStart = wallClockSeconds();
+}
+
+void KernelTuner::endMove() {
+  if (!tuning) {
+    return;
+  }
+
+  Candidate& c = candidates[current];
+  if (++currentMoves > TUNING_WARMUP_MOVES) {
+    c.seconds += wallClockSeconds() - moveStart;
+    c.moves++;
+  }
+  if (c.moves < TUNING_MOVES) {
+    return;
+  }
+
+  currentMoves = 0;
+  if (++current < candidates.size()) {
+    SimCalcs::kernel = candidates[current].config;
+    return;
+  }
+
+  lockIn();
+  source = "tuned";
+  saveTuning();
+  fprintf(stdout, "Kernel tuning: %s\n", summary().c_str());
+}
+
+void KernelTuner::finish() {
+  if (tuning) {
+    lockIn();
+    source = "partially tuned";
+  }
+}
+
+void KernelTuner::lockIn() {
+  tuning = false;
+  int best = -1;
+  for (int i = 0; i < candidates.size(); i++) {
+    if (candidates[i].moves == 0) {
+      continue;
+    }
+    double time = candidates[i].seconds / candidates[i].moves;
+    if (best < 0 || time < perMove) {
+      best = i;
+      perMove = time;
+    }
+  }
+  SimCalcs::kernel = candidates[best < 0 ? 0 : best].config;
+}
+
+bool KernelTuner::saveTuning() {
+  std::string key = getKey();
+  std::vector<std::string> lines;
+
+  std::ifstream in(dbPath.c_str());
+  std::string line;
+  while (std::getline(in, line)) {
+    if (line.compare(0, key.size() + 1, key + " ") != 0) {
+      lines.push_back(line);
+    }
+  }
+  in.close();
+  if (lines.empty()) {
+    lines.push_back("# MCGPU kernel tuning: host mode strategy molecules "
+                    "atoms max-threads threads tile vector-length us/move");
+  }
+
+  std::stringstream entry;
+  entry << key << " " << SimCalcs::kernel.threads << " "
+        << SimCalcs::kernel.tileSize << " " << SimCalcs::kernel.vectorLength
+        << " " << perMove * 1e6;
+  lines.push_back(entry.str());
+
+  // Write a copy and move it into place, so readers never see half a file
+  std::string tmpPath = dbPath + ".tmp";
+  std::ofstream out(tmpPath.c_str());
+  for (int i = 0; i < lines.size(); i++) {
+    out << lines[i] << std::endl;
+  }
+  out.close();
+  if (!out || rename(tmpPath.c_str(), dbPath.c_str()) != 0) {
+    std::cerr << "Error: KernelTuner::saveTuning(): Unable to write "
+              << dbPath << std::endl;
+    remove(tmpPath.c_str());
+    return false;
+  }
+  return true;
+}
+
+std::string KernelTuner::describe(const KernelConfig& config) {
+  std::stringstream out;
+  if (parallel) {
+    out << "vector length " << config.vectorLength;
+  } else {
+    out << "threads " << config.threads << ", tile " << config.tileSize;
+  }
+  return out.str();
+}
+
+std::string KernelTuner::summary() {
+  std::stringstream out;
+  out << describe(SimCalcs::kernel) << " (" << source;
+  if (perMove > 0) {
+    char buffer[32];
+    snprintf(buffer, sizeof(buffer), ", %.2f us/move", perMove * 1e6);
+    out << buffer;
+  }
+  out << ")";
+  return out.str();
+}
@@ -0,0 +1,118 @@
+/**
+ * KernelTuner.h
+ *
+ * Picks the launch parameters of the energy kernels (SimCalcs::kernel) for
+ * --autotune. On the CPU these are the threads computing each molecule's
+ * energy and the tile of blocks handed to each thread; on the GPU, the vector
+ * length of the energy loops.
+ *
+ * During the first steps of a run, each candidate configuration is used for a
+ * stretch of moves and timed. The fastest is then locked in and stored in a
+ * small tuning database, keyed by machine and system size, so later runs of
+ * the same system on the same machine skip the tuning. The tiled kernels sum
+ * in a fixed order, so the candidates all give the same energies.
+ */
+
+#ifndef METROPOLIS_KERNELTUNER_H
+#define METROPOLIS_KERNELTUNER_H
+
+#include <string>
+#include <vector>
+
+#include "SimBox.h"
+#include "SimulationArgs.h"
+#include "SimulationStep.h"
+
+/** The number of moves timed for each candidate configuration */
+#define TUNING_MOVES 200
+
+/** The number of untimed moves made after switching candidates */
+#define TUNING_WARMUP_MOVES 20
+
+/** The name of the tuning database in the home directory */
+#define TUNING_DB_DEFAULT ".mcgpu_tuning"
+
+class KernelTuner {
+ public:
+  /**
+   * Constructs a tuner for a box. Nothing changes until loadTuning() or
+   * start() is called.
+   *
+   * @param sb The simulation box.
+   * @param strategy The energy calculation strategy of the run.
+   * @param parallel True if the energy kernels run on the GPU.
+   * @param dbPath The tuning database, or empty for ~/.mcgpu_tuning.
+   */
+  KernelTuner(SimBox* sb, SimulationStrategy strategy, bool parallel,
+              const std::string& dbPath);
+
+  /**
+   * Looks the machine and system up in the tuning database, and uses the
+   * stored configuration if there is one.
+   *
+   * @return true if a stored configuration was found.
+   */
+  bool loadTuning();
+
+  /** Starts timing the candidate configurations, beginning with the first. */
+  void start();
+
+  /** @return true while candidate configurations are still being timed */
+  bool isTuning() {return tuning;}
+
+  /** Marks the start of a move. Only needed while isTuning(). */
+  void startMove();
+
+  /**
+   * Marks the end of a move. Moves on to the next candidate once the current
+   * one has been timed, and locks in the fastest after the last.
+   */
+  void endMove();
+
+  /**
+   * Locks in the fastest candidate timed so far if tuning has not finished,
+   * as when the run is shorter than the tuning. Such partial results are not
+   * stored.
+   */
+  void finish();
+
+  /** @return the configuration in use and how it was picked */
+  std::string summary();
+
+ private:
+  /** A candidate configuration and its timings */
+  struct Candidate {
+    KernelConfig config;
+    double seconds;
+    int moves;
+  };
+
+  SimBox* sb;
+  SimulationStrategy strategy;
+  bool parallel;
+  std::string dbPath;
+
+  std::vector<Candidate> candidates;
+  int current;
+  int currentMoves;
+  double moveStart;
+  bool tuning;
+
+  /** How the configuration in use was picked: "default", "cached", ... */
+  std::string source;
+  double perMove;
+
+  /** @return the database key of this machine and system */
+  std::string getKey();
+
+  /** Switches to the fastest candidate timed so far */
+  void lockIn();
+
+  /** Stores the configuration in use in the tuning database */
+  bool saveTuning();
+
+  /** @return a configuration as text, such as "threads 4, tile 16" */
+  std::string describe(const KernelConfig& config);
+};
+
+#endif
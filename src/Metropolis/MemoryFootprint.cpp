@@ -0,0 +1,265 @@
+#include "MemoryFootprint.h"
+
+#include <limits.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <algorithm>
+#include <vector>
+
+#include "OutputWriter.h"
+#include "SimBoxConstants.h"
+
+/** The element counts of the SimBox a Box is stamped out into */
+struct BoxCounts {
+  double molecules, atoms, bonds, angles, primaryIndexes, largestMolecule;
+
+  /** Bytes of the per-type exclusion and fudge tables */
+  double exclusions;
+};
+
+static BoxCounts countBox(Box* box) {
+  BoxCounts c = {0, 0, 0, 0, 0, 0, 0};
+  std::vector< std::vector<int>* >* primary =
+      box->environment->primaryAtomIndexArray;
+  int numMolecules = std::min(box->environment->numOfMolecules,
+                              box->moleculeCount);
+  c.molecules = numMolecules;
+  for (int i = 0; i < numMolecules; i++) {
+    Molecule& m = box->getTemplate(i);
+    c.atoms += m.numOfAtoms;
+    c.bonds += m.numOfBonds;
+    c.angles += m.numOfAngles;
+    c.primaryIndexes += primary->at(m.type)->size();
+    c.largestMolecule = std::max(c.largestMolecule, (double) m.numOfAtoms);
+  }
+
+  // One pair of tables per molecule type, listing each atom's partners
+  std::vector<bool> counted(primary->size(), false);
+  for (int t = 0; t < box->templateCount; t++) {
+    Molecule& m = box->templates[t];
+    if (m.type < 0 || m.type >= counted.size() || counted[m.type]) {
+      continue;
+    }
+    counted[m.type] = true;
+    c.exclusions += 2.0 * m.numOfAtoms * (sizeof(int*) + sizeof(int)) +
+                    2.0 * (m.numOfBonds + m.numOfAngles + m.numOfHops) *
+                    sizeof(int);
+  }
+  return c;
+}
+
+/** @return the bytes of the Box's templates and per-molecule tables */
+static double boxBytes(Box* box) {
+  double bytes = sizeof(Environment) + box->templateCount * sizeof(Molecule);
+  for (int t = 0; t < box->templateCount; t++) {
+    Molecule& m = box->templates[t];
+    bytes += m.numOfAtoms * sizeof(Atom) + m.numOfBonds * sizeof(Bond) +
+             m.numOfAngles * sizeof(Angle) +
+             m.numOfDihedrals * sizeof(Dihedral) + m.numOfHops * sizeof(Hop);
+  }
+  return bytes + 2.0 * box->moleculeCount * sizeof(int);
+}
+
+/** @return the bytes of the SimBox's arrays, as SimBoxBuilder sizes them */
+static double simBoxBytes(const BoxCounts& c) {
+  return NUM_DIMENSIONS * sizeof(Real) +
+         MOL_DATA_SIZE * c.molecules * sizeof(int) +
+         (NUM_DIMENSIONS + ATOM_DATA_SIZE) * c.atoms * sizeof(Real) +
+         NUM_DIMENSIONS * c.largestMolecule * sizeof(Real) +
+         (BOND_DATA_SIZE + 1) * c.bonds * sizeof(Real) +
+         (ANGLE_DATA_SIZE + 1) * c.angles * sizeof(Real) +
+         c.largestMolecule * sizeof(int) + c.primaryIndexes * sizeof(int) +
+         c.exclusions;
+}
+
+/** @return the bytes of the neighbor cells, as SimBox::buildNLC sizes them */
+static double cellBytes(double molecules, double capacity, double members,
+                        double hashCapacity, bool sparse) {
+  double bytes = (2 * capacity + 1) * sizeof(int) + members * sizeof(int) +
+                 2 * molecules * sizeof(int) + 27 * sizeof(int);
+  if (sparse) {
+    bytes += capacity * sizeof(long long) +
+             hashCapacity * (sizeof(long long) + sizeof(int));
+  }
+  return bytes;
+}
+
+/** @return the cells along each side of the box, as the NLC builders count */
+static double countCells(Environment* environment) {
+  Real size[NUM_DIMENSIONS] = {environment->x, environment->y,
+                               environment->z};
+  double cells = 1;
+  for (int i = 0; i < NUM_DIMENSIONS; i++) {
+    int n = (int) (size[i] / environment->cutoff);
+    cells *= n < 1 ? 1 : n;
+  }
+  return cells;
+}
+
+MemoryFootprint::MemoryFootprint() {
+  parserTables = box = simBox = nlc = neighborList = proximityMatrix = 0;
+  outputBuffers = device = 0;
+  matrixOnDevice = false;
+}
+
+double MemoryFootprint::hostPeak() const {
+  double running = box + simBox + nlc + neighborList + outputBuffers +
+                   (matrixOnDevice ? 0 : proximityMatrix);
+  return std::max(parserTables + box, running);
+}
+
+double MemoryFootprint::deviceTotal() const {
+  return device + (matrixOnDevice ? proximityMatrix : 0);
+}
+
+std::string MemoryFootprint::summary() const {
+  const char* names[] = {"SimBox", "NLC", "neighbor list", "proximity matrix",
+                         "output buffers", "box", "parser tables"};
+  double bytes[] = {simBox, nlc, neighborList, proximityMatrix, outputBuffers,
+                    box, parserTables};
+  std::string parts;
+  for (int i = 0; i < 7; i++) {
+    if (bytes[i] > 0) {
+      parts.append(parts.empty() ? "" : ", ").append(names[i]).append(" ")
+           .append(formatBytes(bytes[i]));
+    }
+  }
+  std::string out = formatBytes(hostPeak()) + " host (" + parts + ")";
+  if (deviceTotal() > 0) {
+    out.append(", " + formatBytes(deviceTotal()) + " device");
+  }
+  return out;
+}
+
+void MemoryFootprint::write(std::ostream& out) const {
+  out << "Parser-Tables = " << (long long) parserTables << " bytes"
+      << std::endl;
+  out << "Box = " << (long long) box << " bytes" << std::endl;
+  out << "SimBox = " << (long long) simBox << " bytes" << std::endl;
+  out << "NLC = " << (long long) nlc << " bytes" << std::endl;
+  out << "Neighbor-List = " << (long long) neighborList << " bytes"
+      << std::endl;
+  out << "Proximity-Matrix = " << (long long) proximityMatrix << " bytes"
+      << std::endl;
+  out << "Output-Buffers = " << (long long) outputBuffers << " bytes"
+      << std::endl;
+  out << "Device = " << (long long) deviceTotal() << " bytes" << std::endl;
+  out << "Host-Peak = " << (long long) hostPeak() << " bytes" << std::endl;
+}
+
+JsonObject MemoryFootprint::toJson() const {
+  JsonObject out;
+  out.add("parser_tables", (long long) parserTables);
+  out.add("box", (long long) box);
+  out.add("sim_box", (long long) simBox);
+  out.add("nlc", (long long) nlc);
+  out.add("neighbor_list", (long long) neighborList);
+  out.add("proximity_matrix", (long long) proximityMatrix);
+  out.add("output_buffers", (long long) outputBuffers);
+  out.add("device", (long long) deviceTotal());
+  out.add("host_peak", (long long) hostPeak());
+  return out;
+}
+
+MemoryFootprint MemoryFootprint::estimate(Box* box, const SimulationArgs& args,
+                                          SimulationStrategy strategy) {
+  MemoryFootprint out;
+  BoxCounts c = countBox(box);
+  bool parallel = args.simulationMode == SimulationMode::Parallel;
+
+  out.parserTables = box->parserBytes;
+  out.box = boxBytes(box);
+  out.simBox = simBoxBytes(c);
+  out.outputBuffers = OUTPUT_QUEUE_DEPTH * NUM_DIMENSIONS * c.atoms *
+                      sizeof(Real);
+  if (args.driftInterval > 0 && !parallel) {
+    out.outputBuffers += NUM_DIMENSIONS * c.atoms * sizeof(Real);
+  }
+
+  if (args.useNeighborList) {
+    double cells = countCells(box->environment);
+    out.neighborList = (cells + 1 + 2 * c.molecules) * sizeof(int);
+
+    // Follow SimBoxBuilder::fillNLC's choice of index, assuming the worst
+    // case of every molecule in a cell of its own
+    double occupied = std::min(c.molecules, cells);
+    bool sparse = args.spatialIndex != SpatialIndex::Dense ||
+                  cells >= INT_MAX;
+    if (args.spatialIndex == SpatialIndex::Default && sparse &&
+        cells < INT_MAX && 2 * occupied >= cells) {
+      sparse = false;
+    }
+    double capacity = cells, hashCapacity = 0;
+    if (sparse) {
+      capacity = occupied + (long) occupied / 4 + NLC_SPARE_CELLS;
+      hashCapacity = 1;
+      while (hashCapacity < 2 * capacity) {
+        hashCapacity *= 2;
+      }
+    }
+    out.nlc = cellBytes(c.molecules, capacity,
+                        c.molecules + NLC_SPARE_SLOTS * capacity,
+                        hashCapacity, sparse);
+  }
+
+  if (strategy == Strategy::ProximityMatrix) {
+    out.proximityMatrix = c.molecules * c.molecules;
+    out.matrixOnDevice = parallel;
+  }
+
+  if (parallel) {
+    out.device = MOL_DATA_SIZE * c.molecules * sizeof(int) +
+                 (ATOM_DATA_SIZE + NUM_DIMENSIONS) * c.atoms * sizeof(Real) +
+                 NUM_DIMENSIONS * c.largestMolecule * sizeof(Real) +
+                 c.primaryIndexes * sizeof(int) + NUM_DIMENSIONS * sizeof(Real);
+  }
+  return out;
+}
+
+MemoryFootprint MemoryFootprint::measure(Box* box, SimBox* sb,
+                                         const SimulationArgs& args,
+                                         SimulationStrategy strategy) {
+  MemoryFootprint out = estimate(box, args, strategy);
+  out.nlc = 0;
+  if (sb->useNLC && sb->cellStart != NULL) {
+    out.nlc = cellBytes(sb->numMolecules, sb->cellCapacity,
+                        sb->cellStart[sb->cellCapacity],
+                        sb->sparseNLC ? sb->hashCapacity : 0, sb->sparseNLC);
+  }
+  out.neighborList = box->neighborList != NULL ?
+                     box->neighborList->getBytes() : 0;
+  return out;
+}
+
+double MemoryFootprint::availableMemory() {
+  FILE* meminfo = fopen("/proc/meminfo", "r");
+  if (meminfo != NULL) {
+    char line[128];
+    long long kb;
+    while (fgets(line, sizeof(line), meminfo) != NULL) {
+      if (sscanf(line, "MemAvailable: %lld kB", &kb) == 1) {
+        fclose(meminfo);
+        return kb * 1024.0;
+      }
+    }
+    fclose(meminfo);
+  }
+
+  // Older kernels only report the free memory
+  long pages = sysconf(_SC_AVPHYS_PAGES), pageSize = sysconf(_SC_PAGESIZE);
+  return pages > 0 && pageSize > 0 ? (double) pages * pageSize : 0;
+}
+
+std::string MemoryFootprint::formatBytes(double bytes) {
+  char buffer[32];
+  if (bytes < 1024 * 1024) {
+    snprintf(buffer, sizeof(buffer), "%.1f KB", bytes / 1024);
+  } else if (bytes < 1024.0 * 1024 * 1024) {
+    snprintf(buffer, sizeof(buffer), "%.1f MB", bytes / (1024 * 1024));
+  } else {
+    snprintf(buffer, sizeof(buffer), "%.2f GB",
+             bytes / (1024.0 * 1024 * 1024));
+  }
+  return buffer;
+}
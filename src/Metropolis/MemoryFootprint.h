@@ -0,0 +1,104 @@
+/**
+ * MemoryFootprint.h
+ *
+ * Accounts for the memory a run holds, subsystem by subsystem. The sizes are
+ * worked out from the element counts of each array rather than asked of the
+ * allocator, so the same arithmetic measures a built SimBox and, for
+ * --dry-run, estimates one that was never allocated from the counts in the
+ * loaded Box.
+ */
+
+#ifndef METROPOLIS_MEMORYFOOTPRINT_H
+#define METROPOLIS_MEMORYFOOTPRINT_H
+
+#include <ostream>
+#include <string>
+
+#include "Box.h"
+#include "SimBox.h"
+#include "SimulationArgs.h"
+#include "Utilities/Json.h"
+
+struct MemoryFootprint {
+  /** The parameter tables, held while the input files are read */
+  double parserTables;
+
+  /** The Box's templates and per-molecule tables */
+  double box;
+
+  /** The SimBox's arrays: coordinates, atom, bond and angle data */
+  double simBox;
+
+  /** The SimBox's neighbor cells */
+  double nlc;
+
+  /** The Box's neighbor list, built for --neighbor */
+  double neighborList;
+
+  /** The proximity matrix, on the GPU when running in parallel */
+  double proximityMatrix;
+
+  /** The output writer's and the energy monitor's coordinate snapshots */
+  double outputBuffers;
+
+  /** The copies of the SimBox's arrays on the GPU */
+  double device;
+
+  /** True if the proximity matrix is held on the GPU */
+  bool matrixOnDevice;
+
+  /** Constructs an empty footprint */
+  MemoryFootprint();
+
+  /**
+   * @return the most host memory held at once: the parser tables are freed
+   *     before the SimBox is built.
+   */
+  double hostPeak() const;
+
+  /** @return the GPU memory held, including the proximity matrix there */
+  double deviceTotal() const;
+
+  /**
+   * @return the footprint on one line, such as
+   *     "12.4 MB host (SimBox 10.2 MB, proximity matrix 2.0 MB, ...)"
+   */
+  std::string summary() const;
+
+  /** Writes one "Name = bytes" line per subsystem, for the results file */
+  void write(std::ostream& out) const;
+
+  /** @return the bytes of each subsystem, for the JSON results */
+  JsonObject toJson() const;
+
+  /**
+   * Estimates the footprint of a run from a loaded Box, before the SimBox is
+   * built. The neighbor cells are sized for every molecule in a cell of its
+   * own, which is the most they can need.
+   *
+   * @param box The loaded box.
+   * @param args The arguments of the run.
+   * @param strategy The energy calculation strategy to estimate for.
+   */
+  static MemoryFootprint estimate(Box* box, const SimulationArgs& args,
+                                  SimulationStrategy strategy);
+
+  /**
+   * Measures the footprint of a run once its SimBox has been built, using
+   * the neighbor cells and neighbor list actually allocated.
+   */
+  static MemoryFootprint measure(Box* box, SimBox* sb,
+                                 const SimulationArgs& args,
+                                 SimulationStrategy strategy);
+
+  /**
+   * @return the bytes of memory the system could hand out without swapping,
+   *     or 0 if unknown.
+   */
+  static double availableMemory();
+
+  /** @return a byte count as text, such as "12.4 MB" */
+  static std::string formatBytes(double bytes);
+};
+
+#endif
@@ -0,0 +1,316 @@
+#include "MetricsServer.h"
+
+#include <errno.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <iostream>
+#include <sstream>
+
+/** The most bytes of a request read before answering */
+#define METRICS_REQUEST_BYTES 4096
+
+/** The milliseconds a client gets to send its request */
+#define METRICS_REQUEST_MS 1000
+
+MetricsServer::MetricsServer(const std::string& name_in,
+                             const std::string& strategy_in,
+                             const std::vector<std::string>& phaseNames_in) {
+  name = name_in;
+  strategy = strategy_in;
+  phaseNames = phaseNames_in;
+  if (phaseNames.size() > METRICS_MAX_PHASES) {
+    phaseNames.resize(METRICS_MAX_PHASES);
+  }
+  sequence.store(0);
+  for (int i = 0; i < PHASES + PHASE_VALUES * METRICS_MAX_PHASES; i++) {
+    values[i].store(0);
+  }
+  listener = -1;
+  stopping.store(false);
+}
+
+MetricsServer::~MetricsServer() {
+  stopping.store(true);
+  if (server.joinable()) {
+    server.join();
+  }
+  if (listener >= 0) {
+    close(listener);
+  }
+  if (!socketPath.empty()) {
+    unlink(socketPath.c_str());
+  }
+}
+
+bool MetricsServer::start(const std::string& endpoint) {
+  bool isPort = !endpoint.empty() &&
+                endpoint.find_first_not_of("0123456789") == std::string::npos;
+  if (isPort) {
+    long port = strtol(endpoint.c_str(), NULL, 10);
+    if (endpoint.size() > 5 || port < 1 || port > 65535) {
+      std::cerr << "Error: MetricsServer::start(): Invalid port " << endpoint
+                << std::endl;
+      return false;
+    }
+    listener = socket(AF_INET, SOCK_STREAM, 0);
+    int reuse = 1;
+    if (listener >= 0) {
+      setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+    }
+    struct sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_port = htons((unsigned short) port);
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (listener < 0 ||
+        bind(listener, (struct sockaddr*) &address, sizeof(address)) != 0) {
+      std::cerr << "Error: MetricsServer::start(): Unable to listen on "
+                << "127.0.0.1:" << endpoint << ": " << strerror(errno)
+                << std::endl;
+      return false;
+    }
+  } else {
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (endpoint.empty() || endpoint.size() >= sizeof(address.sun_path)) {
+      std::cerr << "Error: MetricsServer::start(): Invalid socket path "
+                << endpoint << std::endl;
+      return false;
+    }
+    strcpy(address.sun_path, endpoint.c_str());
+
+    // Replace a socket left behind by an earlier run, but never a file
+    struct stat existing;
+    if (lstat(endpoint.c_str(), &existing) == 0) {
+      if (!S_ISSOCK(existing.st_mode)) {
+        std::cerr << "Error: MetricsServer::start(): " << endpoint
+                  << " exists and is not a socket" << std::endl;
+        return false;
+      }
+      unlink(endpoint.c_str());
+    }
+    listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listener < 0 ||
+        bind(listener, (struct sockaddr*) &address, sizeof(address)) != 0) {
+      std::cerr << "Error: MetricsServer::start(): Unable to listen on "
+                << endpoint << ": " << strerror(errno) << std::endl;
+      return false;
+    }
+    socketPath = endpoint;
+  }
+
+  if (listen(listener, 8) != 0) {
+    std::cerr << "Error: MetricsServer::start(): Unable to listen on "
+              << endpoint << ": " << strerror(errno) << std::endl;
+    return false;
+  }
+  server = std::thread(&MetricsServer::serve, this);
+  return true;
+}
+
+void MetricsServer::publish(const MetricsSnapshot& snapshot) {
+  // An odd sequence tells the reader a publish is under way
+  unsigned version = sequence.load(std::memory_order_relaxed);
+  sequence.store(version + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+
+  std::memory_order order = std::memory_order_relaxed;
+  values[STEP].store(snapshot.step, order);
+  values[LAST_STEP].store(snapshot.lastStep, order);
+  values[ENERGY].store(snapshot.energy, order);
+  values[ACCEPTED].store(snapshot.accepted, order);
+  values[REJECTED].store(snapshot.rejected, order);
+  values[STEPS_PER_SECOND].store(snapshot.stepsPerSecond, order);
+  values[ELAPSED].store(snapshot.elapsed, order);
+  values[PUBLISHED].store(wallClockSeconds(), order);
+  for (int i = 0; i < phaseNames.size(); i++) {
+    std::atomic<double>* phase = &values[PHASES + PHASE_VALUES * i];
+    phase[0].store(snapshot.phaseCount[i], order);
+    phase[1].store(snapshot.phaseTotal[i], order);
+    phase[2].store(snapshot.phaseP50[i], order);
+    phase[3].store(snapshot.phaseP90[i], order);
+    phase[4].store(snapshot.phaseP99[i], order);
+  }
+
+  sequence.store(version + 2, std::memory_order_release);
+}
+
+void MetricsServer::read(MetricsSnapshot& snapshot, double& published) {
+  std::memory_order order = std::memory_order_relaxed;
+  unsigned before, after;
+  do {
+    before = sequence.load(std::memory_order_acquire);
+    snapshot.step = (long) values[STEP].load(order);
+    snapshot.lastStep = (long) values[LAST_STEP].load(order);
+    snapshot.energy = values[ENERGY].load(order);
+    snapshot.accepted = (long) values[ACCEPTED].load(order);
+    snapshot.rejected = (long) values[REJECTED].load(order);
+    snapshot.stepsPerSecond = values[STEPS_PER_SECOND].load(order);
+    snapshot.elapsed = values[ELAPSED].load(order);
+    published = values[PUBLISHED].load(order);
+    for (int i = 0; i < phaseNames.size(); i++) {
+      std::atomic<double>* phase = &values[PHASES + PHASE_VALUES * i];
+      snapshot.phaseCount[i] = (long) phase[0].load(order);
+      snapshot.phaseTotal[i] = phase[1].load(order);
+      snapshot.phaseP50[i] = phase[2].load(order);
+      snapshot.phaseP90[i] = phase[3].load(order);
+      snapshot.phaseP99[i] = phase[4].load(order);
+    }
+    std::atomic_thread_fence(std::memory_order_acquire);
+    after = sequence.load(std::memory_order_relaxed);
+  } while ((before & 1) != 0 || before != after);
+}
+
+/** Writes the HELP and TYPE lines of a metric */
+static void describe(std::ostream& out, const char* metric, const char* type,
+                     const char* help) {
+  out << "# HELP " << metric << " " << help << "\n";
+  out << "# TYPE " << metric << " " << type << "\n";
+}
+
+/**
+ * Quotes a label value for the Prometheus text format, which only escapes
+ * backslashes, double quotes and line feeds.
+ */
+static std::string quoteLabel(const std::string& text) {
+  std::string quoted = "\"";
+  for (size_t i = 0; i < text.size(); i++) {
+    switch (text[i]) {
+      case '\\': quoted += "\\\\"; break;
+      case '"': quoted += "\\\""; break;
+      case '\n': quoted += "\\n"; break;
+      default: quoted += text[i];
+    }
+  }
+  return quoted + "\"";
+}
+
+/** Writes a metric value the way Prometheus parses it */
+static void value(std::ostream& out, const std::string& metric, double x) {
+  char buffer[32];
+  if (x != x) {
+    snprintf(buffer, sizeof(buffer), "NaN");
+  } else if (x > 1e308 || x < -1e308) {
+    snprintf(buffer, sizeof(buffer), x > 0 ? "+Inf" : "-Inf");
+  } else {
+    snprintf(buffer, sizeof(buffer), "%.15g", x);
+  }
+  out << metric << " " << buffer << "\n";
+}
+
+std::string MetricsServer::format() {
+  MetricsSnapshot s;
+  double published;
+  read(s, published);
+
+  std::ostringstream out;
+  describe(out, "mcgpu_info", "gauge", "The simulation being run.");
+  value(out, "mcgpu_info{name=" + quoteLabel(name) + ",strategy=" +
+        quoteLabel(strategy) + "}", 1);
+  if (published == 0) {
+    // Nothing has been published yet; the run is still starting up
+    return out.str();
+  }
+
+  describe(out, "mcgpu_step", "gauge", "The step the run has reached.");
+  value(out, "mcgpu_step", s.step);
+  describe(out, "mcgpu_last_step", "gauge", "The step the run ends at.");
+  value(out, "mcgpu_last_step", s.lastStep);
+  describe(out, "mcgpu_energy", "gauge", "The current energy of the system.");
+  value(out, "mcgpu_energy", s.energy);
+  describe(out, "mcgpu_accepted_moves_total", "counter",
+           "The moves accepted so far.");
+  value(out, "mcgpu_accepted_moves_total", s.accepted);
+  describe(out, "mcgpu_rejected_moves_total", "counter",
+           "The moves rejected so far.");
+  value(out, "mcgpu_rejected_moves_total", s.rejected);
+  long moves = s.accepted + s.rejected;
+  describe(out, "mcgpu_acceptance_ratio", "gauge",
+           "The fraction of the moves so far that were accepted.");
+  value(out, "mcgpu_acceptance_ratio",
+        moves > 0 ? (double) s.accepted / moves : 0);
+  describe(out, "mcgpu_steps_per_second", "gauge",
+           "The steps per second over the last status interval.");
+  value(out, "mcgpu_steps_per_second", s.stepsPerSecond);
+  describe(out, "mcgpu_elapsed_seconds", "gauge",
+           "The seconds since the main loop began.");
+  value(out, "mcgpu_elapsed_seconds", s.elapsed);
+  describe(out, "mcgpu_update_age_seconds", "gauge",
+           "The seconds since these values were published; grows if the run "
+           "stalls.");
+  value(out, "mcgpu_update_age_seconds", wallClockSeconds() - published);
+
+  describe(out, "mcgpu_phase_seconds", "summary",
+           "The wall-clock seconds spent in each phase of a step.");
+  const char* quantiles[] = {"0.5", "0.9", "0.99"};
+  for (int i = 0; i < phaseNames.size(); i++) {
+    std::string label = "phase=" + quoteLabel(phaseNames[i]);
+    double percentiles[] = {s.phaseP50[i], s.phaseP90[i], s.phaseP99[i]};
+    for (int q = 0; q < 3; q++) {
+      value(out, "mcgpu_phase_seconds{" + label + ",quantile=\"" +
+            quantiles[q] + "\"}", percentiles[q]);
+    }
+    value(out, "mcgpu_phase_seconds_sum{" + label + "}", s.phaseTotal[i]);
+    value(out, "mcgpu_phase_seconds_count{" + label + "}", s.phaseCount[i]);
+  }
+  return out.str();
+}
+
+void MetricsServer::serve() {
+  while (!stopping.load()) {
+    struct pollfd waiting = {listener, POLLIN, 0};
+    if (poll(&waiting, 1, METRICS_POLL_MS) <= 0) {
+      continue;
+    }
+    int connection = accept(listener, NULL, NULL);
+    if (connection >= 0) {
+      answer(connection);
+      close(connection);
+    }
+  }
+}
+
+void MetricsServer::answer(int connection) {
+  // Read the request line and headers; the path and method are not checked
+  std::string request;
+  char buffer[512];
+  while (request.find("\r\n\r\n") == std::string::npos &&
+         request.find("\n\n") == std::string::npos &&
+         request.size() < METRICS_REQUEST_BYTES) {
+    struct pollfd waiting = {connection, POLLIN, 0};
+    if (poll(&waiting, 1, METRICS_REQUEST_MS) <= 0) {
+      return;
+    }
+    ssize_t received = recv(connection, buffer, sizeof(buffer), 0);
+    if (received <= 0) {
+      return;
+    }
+    request.append(buffer, received);
+  }
+
+  std::string body = format();
+  std::ostringstream response;
+  response << "HTTP/1.0 200 OK\r\n"
+           << "Content-Type: text/plain; version=0.0.4\r\n"
+           << "Content-Length: " << body.size() << "\r\n"
+           << "Connection: close\r\n\r\n" << body;
+  std::string text = response.str();
+  size_t sent = 0;
+  while (sent < text.size()) {
+    ssize_t n = send(connection, text.data() + sent, text.size() - sent,
+                     MSG_NOSIGNAL);
+    if (n <= 0) {
+      return;
+    }
+    sent += n;
+  }
+}
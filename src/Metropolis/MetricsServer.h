@@ -0,0 +1,126 @@
+/**
+ * MetricsServer.h
+ *
+ * Serves live metrics of a running simulation for --metrics-endpoint, in the
+ * Prometheus text format, over HTTP on a localhost port or a Unix-domain
+ * socket. A scheduler or Prometheus itself can poll it to spot runs that have
+ * stalled (the age of the last update keeps growing) or diverged (the energy
+ * runs away) long before they finish.
+ *
+ * The simulation publishes a snapshot at each status interval. Publishing
+ * takes no locks: the snapshot is guarded by a sequence counter, and the
+ * server thread copies it again if the simulation published part way through
+ * the copy.
+ */
+
+#ifndef METROPOLIS_METRICSSERVER_H
+#define METROPOLIS_METRICSSERVER_H
+
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Utilities/Timer.h"
+
+/** The most step phases a snapshot can carry */
+#define METRICS_MAX_PHASES 16
+
+/** The milliseconds the server waits for a connection before rechecking */
+#define METRICS_POLL_MS 200
+
+/** The values published at each status interval */
+struct MetricsSnapshot {
+  /** The step about to be taken */
+  long step;
+
+  /** The step the run ends at */
+  long lastStep;
+
+  /** The current energy of the system */
+  double energy;
+
+  /** The moves accepted and rejected so far */
+  long accepted, rejected;
+
+  /** The steps per second since the previous snapshot */
+  double stepsPerSecond;
+
+  /** The seconds since the main loop began */
+  double elapsed;
+
+  /** For each step phase: occurrences, total seconds and percentiles */
+  long phaseCount[METRICS_MAX_PHASES];
+  double phaseTotal[METRICS_MAX_PHASES];
+  double phaseP50[METRICS_MAX_PHASES];
+  double phaseP90[METRICS_MAX_PHASES];
+  double phaseP99[METRICS_MAX_PHASES];
+};
+
+class MetricsServer {
+ public:
+  /**
+   * Constructs a server that is not yet listening.
+   *
+   * @param name The simulation name, reported as a label.
+   * @param strategy The energy calculation strategy, reported as a label.
+   * @param phaseNames The names of the step phases in the snapshots.
+   */
+  MetricsServer(const std::string& name, const std::string& strategy,
+                const std::vector<std::string>& phaseNames);
+
+  /** Stops the server thread and closes the socket */
+  ~MetricsServer();
+
+  /**
+   * Starts listening and serving on a background thread.
+   *
+   * @param endpoint A port number to listen on 127.0.0.1, or the path of a
+   *     Unix-domain socket to create.
+   * @return false if the endpoint could not be opened.
+   */
+  bool start(const std::string& endpoint);
+
+  /**
+   * Publishes a snapshot for the server to report. Called from the
+   * simulation loop; never blocks.
+   */
+  void publish(const MetricsSnapshot& snapshot);
+
+  /** @return the latest snapshot in the Prometheus text format */
+  std::string format();
+
+ private:
+  /** The snapshot fields, one atomic value each, in the order of snapshot */
+  enum Value {
+    STEP, LAST_STEP, ENERGY, ACCEPTED, REJECTED, STEPS_PER_SECOND, ELAPSED,
+    PUBLISHED, PHASES
+  };
+
+  /** The number of values stored for each phase */
+  static const int PHASE_VALUES = 5;
+
+  std::string name;
+  std::string strategy;
+  std::vector<std::string> phaseNames;
+
+  /** Odd while a snapshot is being published, bumped twice per publish */
+  std::atomic<unsigned> sequence;
+  std::atomic<double> values[PHASES + PHASE_VALUES * METRICS_MAX_PHASES];
+
+  int listener;
+  std::string socketPath;
+  std::atomic<bool> stopping;
+  std::thread server;
+
+  /** Copies out a consistent snapshot and the time it was published */
+  void read(MetricsSnapshot& snapshot, double& published);
+
+  /** Entry point for the server thread */
+  void serve();
+
+  /** Answers one connection with the current metrics */
+  void answer(int connection);
+};
+
+#endif
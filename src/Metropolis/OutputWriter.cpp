@@ -0,0 +1,332 @@
+/**
+ * OutputWriter.cpp
+ *
+ * Background writer for state, PDB, trajectory, journal and metrics output
+ */
+
+#include <cstring>
+#include <iostream>
+#include <fstream>
+
+#include "OutputWriter.h"
+#include "Utilities/FileUtilities.h"
+#include "Utilities/Tracer.h"
+
+OutputWriter::OutputWriter(Box* box, int numAtoms, int queueDepth) {
+  this->box = box;
+  this->numAtoms = numAtoms;
+  trajectory = NULL;
+  journal = NULL;
+  writing = false;
+  stopping = false;
+  queuedBatches = 0;
+  queuedMetrics = droppedMetrics = 0;
+
+  if (queueDepth < 1)
+    queueDepth = 1;
+
+  for (int slot = 0; slot < queueDepth; slot++) {
+    Real** coords = new Real*[NUM_DIMENSIONS];
+    for (int dim = 0; dim < NUM_DIMENSIONS; dim++) {
+      coords[dim] = new Real[numAtoms];
+    }
+    snapshots.push_back(coords);
+    freeSlots.push_back(slot);
+  }
+
+  worker = std::thread(&OutputWriter::workerLoop, this);
+}
+
+OutputWriter::~OutputWriter() {
+  if (journal != NULL && !journalMoves.empty())
+    submit(OutputType::JournalMoves, "", 0, NULL, takeJournalMoves());
+
+  {
+    std::unique_lock<std::mutex> guard(queueLock);
+    stopping = true;
+  }
+  jobAvailable.notify_all();
+  worker.join();
+
+  delete trajectory;
+  delete journal;
+
+  for (int slot = 0; slot < snapshots.size(); slot++) {
+    for (int dim = 0; dim < NUM_DIMENSIONS; dim++) {
+      delete[] snapshots[slot][dim];
+    }
+    delete[] snapshots[slot];
+  }
+}
+
+void OutputWriter::writeState(const std::string& path, int simStep,
+                              const SimBox* sb) {
+  submit(OutputType::State, path, simStep, sb);
+}
+
+void OutputWriter::writePDB(const std::string& path, const SimBox* sb) {
+  submit(OutputType::PDB, path, 0, sb);
+}
+
+bool OutputWriter::openTrajectory(const std::string& path, const SimBox* sb) {
+  flush();
+  delete trajectory;
+
+  trajectory = new TrajectoryWriter(path, numAtoms, sb->numMolecules,
+                                    sb->moleculeData[MOL_START],
+                                    sb->moleculeData[MOL_LEN],
+                                    sb->moleculeData[MOL_TYPE], sb->size);
+  if (!trajectory->isOpen()) {
+    delete trajectory;
+    trajectory = NULL;
+    return false;
+  }
+  return true;
+}
+
+void OutputWriter::writeFrame(int simStep, const SimBox* sb) {
+  if (trajectory != NULL)
+    submit(OutputType::TrajectoryFrame, "", simStep, sb);
+}
+
+bool OutputWriter::openJournal(const std::string& path, const SimBox* sb) {
+  flush();
+  delete journal;
+  journalMoves.clear();
+
+  journal = new JournalWriter(path, numAtoms, sb->numMolecules,
+                              sb->moleculeData[MOL_START],
+                              sb->moleculeData[MOL_LEN]);
+  if (!journal->isOpen()) {
+    delete journal;
+    journal = NULL;
+    return false;
+  }
+  return true;
+}
+
+void OutputWriter::recordMove(int simStep, int molIdx, const SimBox* sb) {
+  if (journal == NULL)
+    return;
+
+  journal->encodeMove(journalMoves, simStep, molIdx, sb->atomCoordinates);
+  if (journalMoves.size() >= JOURNAL_BATCH_SIZE)
+    submit(OutputType::JournalMoves, "", simStep, NULL, takeJournalMoves());
+}
+
+void OutputWriter::writeKeyframe(int simStep, const SimBox* sb) {
+  if (journal != NULL)
+    submit(OutputType::JournalKeyframe, "", simStep, sb, takeJournalMoves());
+}
+
+bool OutputWriter::openMetrics(const std::string& path) {
+  flush();
+  if (metrics.is_open())
+    metrics.close();
+
+  metrics.clear();
+  metrics.open(path.c_str(), std::ios::out | std::ios::trunc);
+  if (!metrics.is_open()) {
+    std::cerr << "Error: OutputWriter::openMetrics(): Unable to create "
+              << path << std::endl;
+    return false;
+  }
+  return true;
+}
+
+void OutputWriter::writeMetrics(const std::string& record) {
+  if (metrics.is_open())
+    submit(OutputType::MetricsRecord, "", 0, NULL, NULL, record);
+}
+
+std::vector<char>* OutputWriter::takeJournalMoves() {
+  if (journalMoves.empty())
+    return NULL;
+
+  std::vector<char>* moves = new std::vector<char>();
+  moves->swap(journalMoves);
+  journalMoves.reserve(moves->size());
+  return moves;
+}
+
+void OutputWriter::flush() {
+  std::unique_lock<std::mutex> guard(queueLock);
+  while (!pending.empty() || writing) {
+    drained.wait(guard);
+  }
+}
+
+int OutputWriter::getDroppedMetrics() {
+  std::unique_lock<std::mutex> guard(queueLock);
+  return droppedMetrics;
+}
+
+void OutputWriter::submit(OutputType::Type type, const std::string& path,
+                          int step, const SimBox* sb,
+                          std::vector<char>* moves, const std::string& text) {
+  int slot = -1;
+  if (sb != NULL) {
+    {
+      std::unique_lock<std::mutex> guard(queueLock);
+      TraceScope traced("Wait For Output Slot",
+                        Tracer::isEnabled() && freeSlots.empty());
+      while (freeSlots.empty()) {
+        slotAvailable.wait(guard);
+      }
+      slot = freeSlots.back();
+      freeSlots.pop_back();
+    }
+
+    // The slot is owned by this thread until the job is queued, so the copy
+    // can happen without holding the lock.
+    for (int dim = 0; dim < NUM_DIMENSIONS; dim++) {
+      memcpy(snapshots[slot][dim], sb->atomCoordinates[dim],
+             numAtoms * sizeof(Real));
+    }
+  }
+
+  if (moves != NULL) {
+    std::unique_lock<std::mutex> guard(queueLock);
+    TraceScope traced("Wait For Journal Batch", Tracer::isEnabled() &&
+                      queuedBatches >= JOURNAL_QUEUE_DEPTH);
+    while (queuedBatches >= JOURNAL_QUEUE_DEPTH) {
+      batchWritten.wait(guard);
+    }
+    queuedBatches++;
+  }
+
+  Job job;
+  job.type = type;
+  job.path = path;
+  job.step = step;
+  job.slot = slot;
+  job.moves = moves;
+  job.text = text;
+
+  {
+    std::unique_lock<std::mutex> guard(queueLock);
+    if (type == OutputType::MetricsRecord &&
+        queuedMetrics >= METRICS_QUEUE_DEPTH) {
+      for (std::deque<Job>::iterator it = pending.begin(); it != pending.end();
+           ++it) {
+        if (it->type == OutputType::MetricsRecord) {
+          pending.erase(it);
+          break;
+        }
+      }
+      droppedMetrics++;
+    } else if (type == OutputType::MetricsRecord) {
+      queuedMetrics++;
+    }
+    pending.push_back(job);
+  }
+  jobAvailable.notify_one();
+}
+
+void OutputWriter::workerLoop() {
+  Tracer::nameThread("Output Writer");
+  while (true) {
+    Job job;
+    {
+      std::unique_lock<std::mutex> guard(queueLock);
+      while (pending.empty() && !stopping) {
+        jobAvailable.wait(guard);
+      }
+      if (pending.empty())
+        return;
+      job = pending.front();
+      pending.pop_front();
+      if (job.type == OutputType::MetricsRecord)
+        queuedMetrics--;
+      writing = true;
+    }
+
+    writeJob(job);
+
+    {
+      std::unique_lock<std::mutex> guard(queueLock);
+      if (job.slot >= 0)
+        freeSlots.push_back(job.slot);
+      if (job.moves != NULL)
+        queuedBatches--;
+      writing = false;
+    }
+    delete job.moves;
+    slotAvailable.notify_one();
+    batchWritten.notify_one();
+    drained.notify_all();
+  }
+}
+
+void OutputWriter::writeJob(const Job& job) {
+  const char* names[] = {"Write State", "Write PDB", "Write Trajectory Frame",
+                         "Write Journal Moves", "Write Journal Keyframe",
+                         "Write Metrics"};
+  TraceScope traced(names[job.type], Tracer::isEnabled());
+  Real** atomCoords = job.slot >= 0 ? snapshots[job.slot] : NULL;
+
+  if (job.moves != NULL)
+    journal->writeRecords(*job.moves);
+
+  switch (job.type) {
+    case OutputType::State: {
+      StateScanner statescan = StateScanner("");
+      statescan.outputState(box, job.step, job.path, atomCoords);
+      break;
+    }
+    case OutputType::PDB:
+      formatPDB(job.path, atomCoords);
+      break;
+    case OutputType::TrajectoryFrame:
+      trajectory->appendFrame(job.step, atomCoords);
+      break;
+    case OutputType::JournalMoves:
+      break;
+    case OutputType::JournalKeyframe:
+      journal->writeKeyframe(job.step, atomCoords);
+      break;
+    case OutputType::MetricsRecord:
+      metrics << job.text << std::endl;
+      break;
+  }
+}
+
+void OutputWriter::formatPDB(const std::string& path, Real** atomCoords) {
+  std::ofstream pdbFile;
+  pdbFile.open(path.c_str());
+
+  int numOfMolecules = box->getEnvironment()->numOfMolecules;
+  pdbFile << "REMARK Created by MCGPU" << std::endl;
+  int atomIdx = 0;
+
+  for (int i = 0; i < numOfMolecules; i++) {
+    Molecule& currentMol = box->getTemplate(i);
+    for (int j = 0; j < currentMol.numOfAtoms; j++) {
+      Atom& currentAtom = currentMol.atoms[j];
+      pdbFile.setf(std::ios_base::left,std::ios_base::adjustfield);
+      pdbFile.width(6);
+      pdbFile << "ATOM";
+      pdbFile.setf(std::ios_base::right,std::ios_base::adjustfield);
+      pdbFile.width(5);
+      pdbFile << atomIdx + 1;
+      pdbFile.width(3); // change from 5
+      pdbFile << *currentAtom.name;
+      pdbFile.width(6); // change from 4
+      pdbFile << "UNK";
+      pdbFile.width(6);
+      pdbFile << i + 1;
+      pdbFile.setf(std::ios_base::fixed, std::ios_base::floatfield);
+      pdbFile.precision(3);
+      pdbFile.width(12);
+      pdbFile << atomCoords[0][atomIdx];
+      pdbFile.width(8);
+      pdbFile << atomCoords[1][atomIdx];
+      pdbFile.width(8);
+      pdbFile << atomCoords[2][atomIdx] << std::endl;
+      atomIdx++;
+    }
+    pdbFile << "TER" << std::endl;
+  }
+  pdbFile << "END" << std::endl;
+  pdbFile.close();
+}
@@ -0,0 +1,232 @@
+/**
+ * OutputWriter.h
+ *
+ * Moves file output (state files, PDB snapshots, trajectory frames, the
+ * move journal and the metrics stream) off of the main simulation loop. The
+ * loop hands the writer a copy of the atom coordinates and a description of
+ * the file to produce; a background thread does the formatting and disk I/O
+ * while the simulation keeps running.
+ */
+
+#ifndef OUTPUT_WRITER_H
+#define OUTPUT_WRITER_H
+
+#include <condition_variable>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Box.h"
+#include "SimBox.h"
+#include "Utilities/Journal.h"
+#include "Utilities/Trajectory.h"
+
+/**
+ * The default number of coordinate snapshots that can be waiting on the
+ * writer at once. Two gives double buffering: the loop can fill one snapshot
+ * while the previous one is being written.
+ */
+#define OUTPUT_QUEUE_DEPTH 2
+
+/**
+ * The number of bytes of journal move records to collect before handing
+ * them to the writer thread.
+ */
+#define JOURNAL_BATCH_SIZE (1 << 20)
+
+/**
+ * The number of batches of journal move records that can be waiting on the
+ * writer at once. Recording a move blocks while this many are waiting, so a
+ * slow disk holds the journal to a few batches of memory.
+ */
+#define JOURNAL_QUEUE_DEPTH 4
+
+/**
+ * The number of metrics records that can be waiting on the writer at once.
+ * Past this the oldest waiting record is dropped, so a stalled disk neither
+ * holds up the simulation loop nor grows the queue.
+ */
+#define METRICS_QUEUE_DEPTH 64
+
+/** Enumeration for the kinds of files the writer produces */
+namespace OutputType {
+  enum Type {
+    State,
+    PDB,
+    TrajectoryFrame,
+    JournalMoves,
+    JournalKeyframe,
+    MetricsRecord
+  };
+}
+
+class OutputWriter {
+  public:
+    /**
+     * Starts the writer thread.
+     *
+     * @param box The box holding the molecule topology (names, bonds, etc.)
+     *     used when formatting output. It must outlive the writer.
+     * @param numAtoms The number of atoms in each coordinate snapshot.
+     * @param queueDepth The number of snapshots that may be queued before
+     *     a submission blocks.
+     */
+    OutputWriter(Box* box, int numAtoms, int queueDepth = OUTPUT_QUEUE_DEPTH);
+
+    /** Writes any queued output, then stops the writer thread. */
+    ~OutputWriter();
+
+    /**
+     * Queues a state file for the given step, using a copy of the current
+     * atom coordinates in the simulation box.
+     */
+    void writeState(const std::string& path, int simStep, const SimBox* sb);
+
+    /**
+     * Queues a PDB file using a copy of the current atom coordinates in the
+     * simulation box.
+     */
+    void writePDB(const std::string& path, const SimBox* sb);
+
+    /**
+     * Creates a binary trajectory (and its frame index) that later calls to
+     * writeFrame append to. The header is written immediately.
+     *
+     * @return False if the trajectory could not be created.
+     */
+    bool openTrajectory(const std::string& path, const SimBox* sb);
+
+    /**
+     * Queues a trajectory frame for the given step, using a copy of the
+     * current atom coordinates in the simulation box.
+     */
+    void writeFrame(int simStep, const SimBox* sb);
+
+    /**
+     * Creates a move journal that later calls to recordMove and
+     * writeKeyframe append to. The header is written immediately.
+     *
+     * @return False if the journal could not be created.
+     */
+    bool openJournal(const std::string& path, const SimBox* sb);
+
+    /**
+     * Records the coordinates of a molecule after an accepted move. Records
+     * are batched in memory and written along with the next keyframe, or
+     * once JOURNAL_BATCH_SIZE bytes have been collected.
+     */
+    void recordMove(int simStep, int molIdx, const SimBox* sb);
+
+    /**
+     * Queues a journal keyframe for the given step, using a copy of the
+     * current atom coordinates in the simulation box. Any batched moves are
+     * written before it.
+     */
+    void writeKeyframe(int simStep, const SimBox* sb);
+
+    /**
+     * Creates a metrics stream (JSON lines) that later calls to
+     * writeMetrics append to, replacing any file at the path.
+     *
+     * @return False if the stream could not be created.
+     */
+    bool openMetrics(const std::string& path);
+
+    /**
+     * Queues one record for the metrics stream. The writer thread appends it
+     * as a line and flushes the stream, so it can be followed while the run
+     * goes on. If METRICS_QUEUE_DEPTH records are already waiting, the oldest
+     * of them is dropped.
+     *
+     * @param record The record, a JSON object on one line.
+     */
+    void writeMetrics(const std::string& record);
+
+    /** Blocks until every queued file has been written to disk. */
+    void flush();
+
+    /** @return the metrics records dropped because the queue was full */
+    int getDroppedMetrics();
+
+  private:
+    /** A single queued file, along with the snapshot it will be built from */
+    struct Job {
+      OutputType::Type type;
+      std::string path;
+      int step;
+
+      /** The snapshot slot, or -1 if the job doesn't use a snapshot */
+      int slot;
+
+      /** Batched journal move records to write, or NULL */
+      std::vector<char>* moves;
+
+      /** The text of a metrics record */
+      std::string text;
+    };
+
+    /**
+     * Waits for a free snapshot slot, copies the coordinates into it and
+     * queues the job. If sb is NULL no snapshot is taken. A job with journal
+     * moves also waits until fewer than JOURNAL_QUEUE_DEPTH batches are
+     * queued.
+     */
+    void submit(OutputType::Type type, const std::string& path, int step,
+                const SimBox* sb, std::vector<char>* moves = NULL,
+                const std::string& text = "");
+
+    /** Hands the batched journal moves over to the writer thread. */
+    std::vector<char>* takeJournalMoves();
+
+    /** Entry point for the writer thread */
+    void workerLoop();
+
+    /** Formats and writes one job. Called on the writer thread. */
+    void writeJob(const Job& job);
+
+    /** Writes the PDB representation of a coordinate snapshot */
+    void formatPDB(const std::string& path, Real** atomCoords);
+
+    Box* box;
+    int numAtoms;
+
+    /** The open trajectory, or NULL if none was requested */
+    TrajectoryWriter* trajectory;
+
+    /** The open move journal, or NULL if none was requested */
+    JournalWriter* journal;
+
+    /** The open metrics stream, or closed if none was requested */
+    std::ofstream metrics;
+
+    /** Move records collected on the simulation thread, not yet queued */
+    std::vector<char> journalMoves;
+
+    /** snapshots[slot][dim] holds the coordinates for one queued job */
+    std::vector<Real**> snapshots;
+    std::vector<int> freeSlots;
+    std::deque<Job> pending;
+
+    /** The number of jobs with journal moves queued or being written */
+    int queuedBatches;
+
+    /** The metrics records waiting in pending, and those dropped */
+    int queuedMetrics, droppedMetrics;
+
+    std::mutex queueLock;
+    std::condition_variable slotAvailable;
+    std::condition_variable batchWritten;
+    std::condition_variable jobAvailable;
+    std::condition_variable drained;
+
+    /** True while the writer thread is formatting a job */
+    bool writing;
+    bool stopping;
+
+    std::thread worker;
+};
+
+#endif
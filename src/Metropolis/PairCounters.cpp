@@ -0,0 +1,71 @@
+#include "PairCounters.h"
+
+#include <stdio.h>
+
+#ifdef PAIR_COUNTERS_ENABLED
+PairCounters pairCounters = {0, 0, 0, 0, 0, 0, 0, 0};
+thread_local bool pairCountingPaused = false;
+#endif
+
+/** @return part as a percentage of whole, or 0 if whole is 0 */
+static double percent(long long part, long long whole) {
+  return whole > 0 ? 100.0 * part / whole : 0;
+}
+
+PairCounters PairCounters::since(const PairCounters& earlier) const {
+  PairCounters out;
+  out.moleculePairs = moleculePairs - earlier.moleculePairs;
+  out.moleculePairsInRange = moleculePairsInRange -
+                             earlier.moleculePairsInRange;
+  out.atomPairs = atomPairs - earlier.atomPairs;
+  out.atomPairsInCutoff = atomPairsInCutoff - earlier.atomPairsInCutoff;
+  out.proximityUpdates = proximityUpdates - earlier.proximityUpdates;
+  out.nlcUpdates = nlcUpdates - earlier.nlcUpdates;
+  out.nlcCellChanges = nlcCellChanges - earlier.nlcCellChanges;
+  out.nlcRebuilds = nlcRebuilds - earlier.nlcRebuilds;
+  return out;
+}
+
+std::string PairCounters::summary() const {
+  char buffer[256];
+  snprintf(buffer, sizeof(buffer), "molecule pairs %lld (%.1f%% in range), "
+           "atom pairs %lld (%.1f%% inside the cutoff)", moleculePairs,
+           percent(moleculePairsInRange, moleculePairs), atomPairs,
+           percent(atomPairsInCutoff, atomPairs));
+  std::string out = buffer;
+  if (proximityUpdates > 0) {
+    snprintf(buffer, sizeof(buffer), ", proximity updates %lld",
+             proximityUpdates);
+    out.append(buffer);
+  }
+  if (nlcUpdates > 0) {
+    snprintf(buffer, sizeof(buffer), ", NLC updates %lld (%lld changed cell, "
+             "%lld rebuilds)", nlcUpdates, nlcCellChanges, nlcRebuilds);
+    out.append(buffer);
+  }
+  return out;
+}
+
+JsonObject PairCounters::toJson() const {
+  JsonObject out;
+  out.add("molecule_pairs", moleculePairs);
+  out.add("molecule_pairs_in_range", moleculePairsInRange);
+  out.add("atom_pairs", atomPairs);
+  out.add("atom_pairs_in_cutoff", atomPairsInCutoff);
+  out.add("proximity_updates", proximityUpdates);
+  out.add("nlc_updates", nlcUpdates);
+  out.add("nlc_cell_changes", nlcCellChanges);
+  out.add("nlc_rebuilds", nlcRebuilds);
+  return out;
+}
+
+void PairCounters::write(std::ostream& out) const {
+  out << "Molecule-Pairs = " << moleculePairs << std::endl;
+  out << "Molecule-Pairs-In-Range = " << moleculePairsInRange << std::endl;
+  out << "Atom-Pairs = " << atomPairs << std::endl;
+  out << "Atom-Pairs-In-Cutoff = " << atomPairsInCutoff << std::endl;
+  out << "Proximity-Updates = " << proximityUpdates << std::endl;
+  out << "NLC-Updates = " << nlcUpdates << std::endl;
+  out << "NLC-Cell-Changes = " << nlcCellChanges << std::endl;
+  out << "NLC-Rebuilds = " << nlcRebuilds << std::endl;
+}
@@ -0,0 +1,119 @@
+/**
+ * PairCounters.h
+ *
+ * Counts the work done by the energy kernels: how many molecule pairs each
+ * strategy visits, how many of them are in range, how many atom pairs are
+ * evaluated and how many of those actually lie inside the cutoff, plus the
+ * updates made to the proximity matrix and neighbor cells. Comparing the
+ * counts shows how much of the work a strategy wastes.
+ *
+ * The counting is only compiled in by building with COUNTERS=1, which defines
+ * PAIR_COUNTERS. Otherwise PAIR_COUNT expands to nothing. Counting slows the
+ * kernels down, so counter builds should not be used for timing. The OpenACC
+ * kernels are never counted.
+ */
+
+#ifndef METROPOLIS_PAIRCOUNTERS_H
+#define METROPOLIS_PAIRCOUNTERS_H
+
+#include <ostream>
+#include <string>
+
+#include "Utilities/Json.h"
+
+#if defined(PAIR_COUNTERS) && !defined(_OPENACC)
+#define PAIR_COUNTERS_ENABLED
+#endif
+
+struct PairCounters {
+  /** Molecule pairs looked at by the energy kernels */
+  long long moleculePairs;
+
+  /** Molecule pairs found in range, whose atom pairs were evaluated */
+  long long moleculePairsInRange;
+
+  /** Atom pairs whose energy was evaluated */
+  long long atomPairs;
+
+  /** Evaluated atom pairs less than the cutoff apart */
+  long long atomPairsInCutoff;
+
+  /** Rows of the proximity matrix recomputed after a move or rollback */
+  long long proximityUpdates;
+
+  /** Accepted moves passed to SimBox::updateNLC */
+  long long nlcUpdates;
+
+  /** NLC updates that moved the molecule to another cell */
+  long long nlcCellChanges;
+
+  /** Rebuilds of every neighbor cell, when an update ran out of room */
+  long long nlcRebuilds;
+
+  /** @return the counts since an earlier copy of the counters */
+  PairCounters since(const PairCounters& earlier) const;
+
+  /**
+   * @return the counts and the fractions that were needed on one line, such
+   *     as "molecule pairs 1000 (12.0% in range), atom pairs ..."
+   */
+  std::string summary() const;
+
+  /** Writes one "Name = count" line per counter, for the results file */
+  void write(std::ostream& out) const;
+
+  /** @return the counts, for the JSON results */
+  JsonObject toJson() const;
+};
+
+#ifdef PAIR_COUNTERS_ENABLED
+
+/** The counts since the start of the run, or since they were last reset */
+extern PairCounters pairCounters;
+
+/** True on a thread whose kernel calls are not being counted */
+extern thread_local bool pairCountingPaused;
+
+/**
+ * Adds n to a counter, unless counting is paused on the calling thread. Safe
+ * to use from several threads.
+ */
+#define PAIR_COUNT(field, n) \
+  do { \
+    if (!pairCountingPaused) { \
+      _Pragma("omp atomic") \
+      pairCounters.field += (n); \
+    } \
+  } while (0)
+
+#else
+
+#define PAIR_COUNT(field, n)
+
+#endif
+
+/**
+ * Pauses counting on the calling thread while in scope, for kernel calls that
+ * are not part of the simulation, such as the drift checks.
+ */
+class PairCountPause {
+ public:
+#ifdef PAIR_COUNTERS_ENABLED
+  PairCountPause() : wasPaused(pairCountingPaused) {
+    pairCountingPaused = true;
+  }
+
+  ~PairCountPause() {
+    pairCountingPaused = wasPaused;
+  }
+
+ private:
+  bool wasPaused;
+#else
+  // User-provided, so the compiler does not flag an unused guard
+  PairCountPause() {}
+  ~PairCountPause() {}
+#endif
+};
+
+#endif
@@ -2,6 +2,10 @@
 #include "ProximityMatrixStep.h"
 #include "SimulationStep.h"
 #include "GPUCopy.h"
+#include "PairCounters.h"
+#include "Utilities/Tracer.h"
+
+#include <algorithm>
 
 #ifdef _OPENACC
 #include <openacc.h>
@@ -23,17 +27,27 @@ Real ProximityMatrixStep::calcSystemEnergy(Real &subLJ, Real &subCharge,
                                            int numMolecules) {
   Real result = SimulationStep::calcSystemEnergy(subLJ, subCharge,
                                                  numMolecules);
-  this->proximityMatrix = ProximityMatrixCalcs::createProximityMatrix();
+  buildProximityMatrix();
   return result;
 }
 
+void ProximityMatrixStep::buildProximityMatrix() {
+  TraceScope traced("Proximity Matrix Build", Tracer::isEnabled());
+  if (this->proximityMatrix != NULL) {
+    ProximityMatrixCalcs::freeProximityMatrix(this->proximityMatrix);
+  }
+  this->proximityMatrix = ProximityMatrixCalcs::createProximityMatrix();
+}
+
 void ProximityMatrixStep::changeMolecule(int molIdx, SimBox *box) {
   SimulationStep::changeMolecule(molIdx, box);
+  ScopedPhase timed(updateTimer);
   ProximityMatrixCalcs::updateProximityMatrix(this->proximityMatrix, molIdx);
 }
 
 void ProximityMatrixStep::rollback(int molIdx, SimBox *box) {
   SimulationStep::rollback(molIdx, box);
+  ScopedPhase timed(updateTimer);
   ProximityMatrixCalcs::updateProximityMatrix(this->proximityMatrix, molIdx);
 }
 
@@ -41,6 +55,10 @@ void ProximityMatrixStep::rollback(int molIdx, SimBox *box) {
 
 Real ProximityMatrixCalcs::calcMolecularEnergyContribution(
     int currMol, int startMol, char *proximityMatrix) {
+  if (SimCalcs::kernel.tiled && !SimCalcs::on_gpu) {
+    return calcTiledContribution(currMol, startMol, proximityMatrix);
+  }
+
   Real total = 0;
 
   int **molData = GPUCopy::moleculeDataPtr();
@@ -54,16 +72,21 @@ Real ProximityMatrixCalcs::calcMolecularEnergyContribution(
   const int p1Start = SimCalcs::sb->moleculeData[MOL_PIDX_START][currMol];
   const int p1End = (SimCalcs::sb->moleculeData[MOL_PIDX_COUNT][currMol]
                      + p1Start);
+  #ifdef _OPENACC
+  const int vectorLength = SimCalcs::kernel.vectorLength;
+  #endif
 
   if (proximityMatrix == NULL) {
     #pragma acc parallel loop gang deviceptr(molData, atomCoords, bSize, \
-        pIdxes, aData) if (SimCalcs::on_gpu) vector_length(64)
+        pIdxes, aData) if (SimCalcs::on_gpu) vector_length(vectorLength)
     for (int otherMol = startMol; otherMol < numMolecules; otherMol++) {
       if (otherMol != currMol) {
         int p2Start = molData[MOL_PIDX_START][otherMol];
         int p2End = molData[MOL_PIDX_COUNT][otherMol] + p2Start;
+        PAIR_COUNT(moleculePairs, 1);
         if (SimCalcs::moleculesInRange(p1Start, p1End, p2Start, p2End,
                                        atomCoords, bSize, pIdxes, cutoff)) {
+          PAIR_COUNT(moleculePairsInRange, 1);
           total += calcMoleculeInteractionEnergy(currMol, otherMol, molData,
                                                  aData, atomCoords, bSize);
         }
@@ -71,12 +94,15 @@ Real ProximityMatrixCalcs::calcMolecularEnergyContribution(
     }
   } else {
     #pragma acc parallel loop gang deviceptr(molData, atomCoords, bSize, \
-        pIdxes, aData, proximityMatrix) if (SimCalcs::on_gpu) vector_length(64)
+        pIdxes, aData, proximityMatrix) if (SimCalcs::on_gpu) \
+        vector_length(vectorLength)
     for (int otherMol = startMol; otherMol < numMolecules; otherMol++) {
       if (otherMol != currMol) {
         //int p2Start = molData[MOL_PIDX_START][otherMol];
         //int p2End = molData[MOL_PIDX_COUNT][otherMol] + p2Start;
+        PAIR_COUNT(moleculePairs, 1);
         if (proximityMatrix[currMol*numMolecules + otherMol]) {
+          PAIR_COUNT(moleculePairsInRange, 1);
           total += calcMoleculeInteractionEnergy(currMol, otherMol, molData,
                                                  aData, atomCoords, bSize);
         }
@@ -87,6 +113,63 @@ Real ProximityMatrixCalcs::calcMolecularEnergyContribution(
   return total;
 }
 
+Real ProximityMatrixCalcs::calcTiledContribution(int currMol, int startMol,
+                                                 char *proximityMatrix) {
+  int** molData = SimCalcs::sb->moleculeData;
+  Real** atomCoords = SimCalcs::sb->atomCoordinates;
+  Real* bSize = SimCalcs::sb->size;
+  int* pIdxes = SimCalcs::sb->primaryIndexes;
+  Real** aData = SimCalcs::sb->atomData;
+  Real cutoff = SimCalcs::sb->cutoff;
+  const long numMolecules = SimCalcs::sb->numMolecules;
+
+  const int p1Start = molData[MOL_PIDX_START][currMol];
+  const int p1End = molData[MOL_PIDX_COUNT][currMol] + p1Start;
+
+  const int numBlocks = (numMolecules - startMol + ENERGY_BLOCK - 1) /
+                        ENERGY_BLOCK;
+  Real* sums = SimCalcs::blockSums(numBlocks);
+  const KernelConfig config = SimCalcs::kernel;
+
+  #pragma omp parallel for num_threads(config.threads) \
+      schedule(dynamic, config.tileSize) if (config.threads > 1)
+  for (int b = 0; b < numBlocks; b++) {
+    const int blockStart = startMol + b * ENERGY_BLOCK;
+    const int blockEnd = std::min((long) blockStart + ENERGY_BLOCK,
+                                  numMolecules);
+    TraceScope traced("Energy Tile", Tracer::isMoveSampled());
+    Real sum = 0;
+    for (int otherMol = blockStart; otherMol < blockEnd; otherMol++) {
+      if (otherMol == currMol) {
+        continue;
+      }
+      PAIR_COUNT(moleculePairs, 1);
+      bool inRange;
+      if (proximityMatrix != NULL) {
+        inRange = proximityMatrix[currMol*numMolecules + otherMol];
+      } else {
+        int p2Start = molData[MOL_PIDX_START][otherMol];
+        int p2End = molData[MOL_PIDX_COUNT][otherMol] + p2Start;
+        inRange = SimCalcs::moleculesInRange(p1Start, p1End, p2Start, p2End,
+                                             atomCoords, bSize, pIdxes,
+                                             cutoff);
+      }
+      if (inRange) {
+        PAIR_COUNT(moleculePairsInRange, 1);
+        sum += calcMoleculeInteractionEnergy(currMol, otherMol, molData,
+                                             aData, atomCoords, bSize);
+      }
+    }
+    sums[b] = sum;
+  }
+
+  Real total = 0;
+  for (int b = 0; b < numBlocks; b++) {
+    total += sums[b];
+  }
+  return total;
+}
+
 // TODO: Duplicate; abstract out when PGCC supports it
 Real ProximityMatrixCalcs::calcMoleculeInteractionEnergy (int m1, int m2,
                                                           int** molData,
@@ -108,6 +191,9 @@ Real ProximityMatrixCalcs::calcMoleculeInteractionEnergy (int m1, int m2,
           && aData[ATOM_EPSILON][i] >= 0 && aData[ATOM_EPSILON][j] >= 0) {
 
         const Real r2 = SimCalcs::calcAtomDistSquared(i, j, aCoords, bSize);
+        PAIR_COUNT(atomPairs, 1);
+        PAIR_COUNT(atomPairsInCutoff, r2 < SimCalcs::sb->cutoff *
+                                           SimCalcs::sb->cutoff);
         if (r2 == 0.0) {
           energySum += 0.0;
         } else {
@@ -168,6 +254,7 @@ void ProximityMatrixCalcs::updateProximityMatrix(char *matrix, int i) {
   Real* bSize = GPUCopy::sizePtr();
   int* pIdxes = GPUCopy::primaryIndexesPtr();
   Real** aData = GPUCopy::atomDataPtr();
+  PAIR_COUNT(proximityUpdates, 1);
 
   #pragma acc parallel loop deviceptr(molData, atomCoords, bSize, pIdxes, \
       aData, matrix) if (SimCalcs::on_gpu)
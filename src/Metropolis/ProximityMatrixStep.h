@@ -36,6 +36,12 @@ class ProximityMatrixStep: public SimulationStep {
   virtual Real calcMolecularEnergyContribution(int currMol, int startMol);
   virtual void changeMolecule(int molIdx, SimBox *box);
   virtual void rollback(int molIdx, SimBox *box);
+
+  /**
+   * Builds the proximity matrix from the current coordinates, replacing any
+   * matrix built before. calcSystemEnergy calls this.
+   */
+  void buildProximityMatrix();
  private:
   char *proximityMatrix;
 };
@@ -45,6 +51,15 @@ namespace ProximityMatrixCalcs {
   Real calcMolecularEnergyContribution(int currMol, int startMol,
                                        char *proximityMatrix);
 
+  /**
+   * Determines the energy contribution of a molecule on the CPU, summing the
+   * other molecules in blocks of ENERGY_BLOCK, spread over
+   * SimCalcs::kernel.threads threads. Checks the range of every pair if the
+   * proximity matrix has not been built yet.
+   */
+  Real calcTiledContribution(int currMol, int startMol,
+                             char *proximityMatrix);
+
   #pragma acc routine vector
   Real calcMoleculeInteractionEnergy (int m1, int m2, int** molData,
                                       Real** aData, Real** aCoords,
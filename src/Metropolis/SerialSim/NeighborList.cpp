@@ -1,81 +1,97 @@
 /*
-	Neighbor linded-list class for use in NLC energy calculations.
+	Neighbor cell list class for use in NLC energy calculations.
 
 	Author: Jared Brown
 	Created: April 17, 2014
 */
 
-#include <iostream>
-#include <stdio.h>
-#include <stdlib.h>
-#include <unistd.h>
-#include <cmath>
-
+#include <algorithm>
 #include <math.h>
-//#include <string>
-#include "Metropolis/DataTypes.h"
-#include "Metropolis/SimulationArgs.h"
-#include "Metropolis/Utilities/FileUtilities.h"
 #include "NeighborList.h"
 
 //Constructor & Destructor
-NeighborList::NeighborList(Molecule *molecules, Environment *enviro)
+NeighborList::NeighborList(Real **atomCoords, int **moleculeData,
+                           int *primaryIndexes, Environment *enviro)
 {
 	rrCut = enviro->cutoff * enviro->cutoff;
-	
-	// Compute the # of cells for linked cell lists
+	numMolecules = enviro->numOfMolecules;
+
+	region[0] = enviro->x;
+	region[1] = enviro->y;
+	region[2] = enviro->z;
+
+	// Compute the # of cells for the cell lists. Cells are at least as wide
+	// as the cutoff, and there is always at least one.
 	for (int k = 0; k < 3; k++)
 	{
-		if (k == 0)
-			region[k] = enviro->x;
-		else if (k == 1)
-			region[k] = enviro->y;
-		else if (k == 2)
-			region[k] = enviro->z;
-		
-		numCells[k] = region[k] / enviro->cutoff; 
+		numCells[k] = (int) (region[k] / enviro->cutoff);
+		if (numCells[k] < 1)
+			numCells[k] = 1;
 		lengthCell[k] = region[k] / numCells[k];
 	}
-		
-  	/* Make a linked-cell list --------------------------------------------*/
+
 	numCellsYZ = numCells[1] * numCells[2];
 	numCellsXYZ = numCells[0] * numCellsYZ;
-		
-	// Reset the headers, head
-	for (int c = 0; c < numCellsXYZ; c++) 
+
+	cellStart.resize(numCellsXYZ + 1);
+	cellMolecules.resize(numMolecules);
+	moleculeCell.resize(numMolecules);
+
+	update(atomCoords, moleculeData, primaryIndexes);
+}
+
+NeighborList::~NeighborList() {
+}
+
+void NeighborList::update(Real **atomCoords, int **moleculeData,
+                          int *primaryIndexes)
+{
+	// Find each molecule's cell from its first primary index. Molecules that
+	// have drifted out of the box are binned by their periodic image.
+	#pragma omp parallel for schedule(static)
+	for (int i = 0; i < numMolecules; i++)
 	{
-		head[c] = EMPTY;
+		int primaryIndex = primaryIndexes[moleculeData[MOL_PIDX_START][i]];
+		int vectorCells[3];
+		for (int k = 0; k < 3; k++)
+		{
+			Real pos = atomCoords[k][primaryIndex];
+			pos -= region[k] * floor(pos / region[k]);
+			vectorCells[k] = (int) (pos / lengthCell[k]);
+			if (vectorCells[k] >= numCells[k])
+				vectorCells[k] = numCells[k] - 1;
+		}
+		moleculeCell[i] = getCellIndex(vectorCells[0], vectorCells[1],
+		                               vectorCells[2]);
 	}
 
-	// Scan cutoff index atom in each molecule to construct headers, head, & linked lists, linkedCellList
-	for (int i = 0; i < enviro->numOfMolecules; i++)
+	// Counting sort: count the molecules in each cell, turn the counts into
+	// offsets, then scatter the molecules to their cells.
+	std::fill(cellStart.begin(), cellStart.end(), 0);
+	#pragma omp parallel for schedule(static)
+	for (int i = 0; i < numMolecules; i++)
 	{
-		std::vector<int> molPrimaryIndexArray = (*(*(enviro->primaryAtomIndexArray))[molecules[i].type]);
-		int primaryIndex = molPrimaryIndexArray[0]; // Use first primary index to determine cell placement
-		
-		int vectorCells[3];			
-		vectorCells[0] = molecules[i].atoms[primaryIndex].x / lengthCell[0]; 
-		vectorCells[1] = molecules[i].atoms[primaryIndex].y / lengthCell[1];
-		vectorCells[2] = molecules[i].atoms[primaryIndex].z / lengthCell[2];
-		
-		// Translate the vector cell index to a scalar cell index
-		int c = vectorCells[0] * numCellsYZ 
-			+ vectorCells[1] * numCells[2] 
-			+ vectorCells[2];
+		#pragma omp atomic
+		cellStart[moleculeCell[i] + 1]++;
+	}
 
-		// Link to the previous occupant (or EMPTY if you're the 1st)
-		linkedCellList[i] = head[c];
+	for (int c = 0; c < numCellsXYZ; c++)
+		cellStart[c + 1] += cellStart[c];
 
-		// The last one goes to the header
-		head[c] = i;
-	} /* Endfor molecule i */
-}
+	std::vector<int> next(cellStart.begin(), cellStart.end() - 1);
+	#pragma omp parallel for schedule(static)
+	for (int i = 0; i < numMolecules; i++)
+	{
+		int slot;
+		#pragma omp atomic capture
+		slot = next[moleculeCell[i]]++;
+		cellMolecules[slot] = i;
+	}
 
-NeighborList::~NeighborList() {
-	free(numCells);
-	free(lengthCell);
-	free(head);
-	free(linkedCellList);
-	free(region);
+	// The scatter fills each cell in whatever order the threads ran, so sort
+	// the (small) cells to keep the layout deterministic.
+	#pragma omp parallel for schedule(dynamic, 1024)
+	for (int c = 0; c < numCellsXYZ; c++)
+		std::sort(cellMolecules.begin() + cellStart[c],
+		          cellMolecules.begin() + cellStart[c + 1]);
 }
-	
@@ -1,5 +1,10 @@
 /*
-	Neighbor linded-list class for use in NLC energy calculations.
+	Neighbor cell list class for use in NLC energy calculations.
+
+	Molecules are binned into cells at least as wide as the cutoff, using the
+	first primary index of each molecule. The molecules are stored sorted by
+	cell, so the molecules in cell c are
+	cellMolecules[cellStart[c]] .. cellMolecules[cellStart[c + 1] - 1].
 
 	Author: Jared Brown
 	Created: April 17, 2014
@@ -9,30 +14,61 @@
 #define NEIGHBORLIST_H
 
 #include <string>
-#include "Metropolis/Box.h"
+#include <vector>
 #include "Metropolis/DataTypes.h"
+#include "Metropolis/SimBoxConstants.h"
 #include "Metropolis/SimulationArgs.h"
 #include "Metropolis/Utilities/StructLibrary.h"
 
-#define NMAX 100000  /* Maximum number of atoms which can be simulated */
-#define NCLMAX 10000 /* Maximum number of linked-list cells */
-#define EMPTY -1
-
 class NeighborList
 {
 	public:
-		NeighborList(Molecule *molecules, Environment *enviro);
+		NeighborList(Real **atomCoords, int **moleculeData, int *primaryIndexes,
+		             Environment *enviro);
 		~NeighborList();
-		
+
+		/**
+		 * Re-bins every molecule from its current coordinates.
+		 */
+		void update(Real **atomCoords, int **moleculeData, int *primaryIndexes);
+
+		/** @return the scalar index of the cell at (x, y, z) */
+		int getCellIndex(int x, int y, int z) {
+			return x * numCellsYZ + y * numCells[2] + z;
+		};
+
+		/** @return the cell holding a molecule */
+		int getCell(int molecule) {return moleculeCell[molecule];};
+
+		/** @return the number of molecules in a cell */
+		int getCellCount(int cell) {
+			return cellStart[cell + 1] - cellStart[cell];
+		};
+
+		/** @return the molecules in a cell, in increasing order */
+		const int* getCellMolecules(int cell) {
+			return &cellMolecules[cellStart[cell]];
+		};
+
+		/** @return the bytes held by the cell arrays */
+		size_t getBytes() {
+			return (cellStart.capacity() + cellMolecules.capacity() +
+			        moleculeCell.capacity()) * sizeof(int);
+		};
+
 		int numCells[3];            	/* Number of cells in the x|y|z direction */
 		int numCellsYZ;					/* Total number of cells in YZ plane */
 		int numCellsXYZ;				/* Total number of cells in XYZ area*/
 		Real lengthCell[3];         	/* Length of a cell in the x|y|z direction */
-		int head[NCLMAX];    			/* Headers for the linked cell lists */
-		int linkedCellList[NMAX];       /* Linked cell lists */
-		
+
 		Real region[3];
 		Real rrCut;
+
+	private:
+		int numMolecules;
+		std::vector<int> cellStart;     /* Offset of each cell's molecules, plus the total */
+		std::vector<int> cellMolecules; /* Molecule indexes sorted by cell */
+		std::vector<int> moleculeCell;  /* Cell of each molecule */
 };
 
 #endif
@@ -27,5 +27,5 @@ SerialBox::~SerialBox()
 	FREE(dihedrals);
 	FREE(environment);
 	FREE(hops);
-	FREE(molecules);
+	FREE(templates);
 }
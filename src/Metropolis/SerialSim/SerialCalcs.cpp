@@ -34,7 +34,6 @@ Box* SerialCalcs::createBox(SimulationArgs& simArgs, long* startStep, long* step
 }
 
 Real SerialCalcs::calcEnergy_LRC(Box* box) {
-	Molecule *molecules = box->getMolecules();
 	Environment *enviro = box->getEnvironment();
 
 	Real Ecut = 0.0;		// Holds LJ long-range cutoff energy correction
@@ -44,11 +43,13 @@ Real SerialCalcs::calcEnergy_LRC(Box* box) {
 	Real RC9 = pow(RC3, 3);							// 1 / cutoff^9
 
 	// Note: currently only supports at most TWO solvents (needs to be updated for more)
-	int a = 0, b = 1;
+	// The solvents are the templates of the first two molecules
+	Molecule& solvent1 = box->getTemplate(0);
+	Molecule& solvent2 = box->getTemplate(enviro->numOfMolecules > 1 ? 1 : 0);
 	Real NMOL1 = enviro->numOfMolecules / 2;	// Number of molecules of solvent1
 	Real NMOL2 = enviro->numOfMolecules / 2;	// Number of molecules of solvent2
-	int NATOM1 = molecules[a].numOfAtoms;			// Number of atoms in solvent1
-	int NATOM2 = molecules[b].numOfAtoms;			// Number of atoms in solvent2
+	int NATOM1 = solvent1.numOfAtoms;			// Number of atoms in solvent1
+	int NATOM2 = solvent2.numOfAtoms;			// Number of atoms in solvent2
 	int NATMX = NATOM1;
 	if (NATMX < NATOM2) {		// NATMX = MAX(NAT0M1, NAT0M2)
 		NATMX = NATOM2;
@@ -59,12 +60,12 @@ Real SerialCalcs::calcEnergy_LRC(Box* box) {
 	Real SigmaA[NATOM1], EpsilonA[NATOM1];
 	Real A6[NATOM1], A12[NATOM1];
 	for(int i = 0; i < NATOM1; i++) {
-		if (molecules[a].atoms[i].sigma < 0 || molecules[a].atoms[i].epsilon < 0) {
+		if (solvent1.atoms[i].sigma < 0 || solvent1.atoms[i].epsilon < 0) {
 			SigmaA[i] = 0.0;
 			EpsilonA[i] = 0.0;
 		} else {
-			SigmaA[i] = molecules[a].atoms[i].sigma;
-			EpsilonA[i] = molecules[a].atoms[i].epsilon;
+			SigmaA[i] = solvent1.atoms[i].sigma;
+			EpsilonA[i] = solvent1.atoms[i].epsilon;
 		}
 
 		sig2 = pow(SigmaA[i], 2);
@@ -78,12 +79,12 @@ Real SerialCalcs::calcEnergy_LRC(Box* box) {
 	Real SigmaB[NATOM2], EpsilonB[NATOM2];
 	Real B6[NATOM2], B12[NATOM2];
 	for(int i = 0; i < NATOM2; i++) {
-		if (molecules[b].atoms[i].sigma < 0 || molecules[b].atoms[i].epsilon < 0) {
+		if (solvent2.atoms[i].sigma < 0 || solvent2.atoms[i].epsilon < 0) {
 			SigmaB[i] = 0.0;
 			EpsilonB[i] = 0.0;
 		} else {
-			SigmaB[i] = molecules[b].atoms[i].sigma;
-			EpsilonB[i] = molecules[b].atoms[i].epsilon;
+			SigmaB[i] = solvent2.atoms[i].sigma;
+			EpsilonB[i] = solvent2.atoms[i].epsilon;
 		}
 
 		sig2 = pow(SigmaB[i], 2);
@@ -4,6 +4,19 @@
 
 #include "SimBox.h"
 #include "GPUCopy.h"
+#include "PairCounters.h"
+#include "Utilities/Tracer.h"
+
+#include <algorithm>
+
+/**
+ * Returns the first bucket to probe for a grid position in a hash table of
+ * the given size (a power of two).
+ */
+static inline int hashBucket(long long key, int capacity) {
+  unsigned long long h = (unsigned long long) key * 0x9E3779B97F4A7C15ULL;
+  return (int) (h >> 32) & (capacity - 1);
+}
 
 
 // ----- Experimental -----
@@ -77,7 +90,9 @@ int SimBox::findNeighbors(int molIdx) {
       for (int k = -1; k <= 1; k++) {
         if (k + 1 >= numCells[2]) break;
         int c2 = wrapCell(base[2] + k, 2);
-        neighbors[outIdx] = neighborCells[c0][c1][c2];
+        int cell = lookupCell(getCellKey(c0, c1, c2));
+        if (cell < 0) continue;
+        neighbors[outIdx] = cell;
         outIdx++;
       }
     }
@@ -96,28 +111,145 @@ int SimBox::getCell(Real loc, int dimension) {
   return (idx + numC) % numC;
 }
 
-void SimBox::updateNLC(int molIdx) {
-  bool update = false;
-  int newCell[3];
+long long SimBox::getCellKey(int x, int y, int z) {
+  return ((long long) x * numCells[1] + y) * numCells[2] + z;
+}
+
+long long SimBox::findCellKey(int molIdx) {
   int pIdx = primaryIndexes[moleculeData[MOL_PIDX_START][molIdx]];
-  for (int i = 0; i < NUM_DIMENSIONS; i++) {
-    newCell[i] = getCell(atomCoordinates[i][pIdx], i);
-    if (newCell[i] != prevCell[i])
-      update = true;
+  return getCellKey(getCell(atomCoordinates[X_COORD][pIdx], X_COORD),
+                    getCell(atomCoordinates[Y_COORD][pIdx], Y_COORD),
+                    getCell(atomCoordinates[Z_COORD][pIdx], Z_COORD));
+}
+
+int SimBox::lookupCell(long long key) {
+  if (!sparseNLC) {
+    return (int) key;
+  }
+  for (int b = hashBucket(key, hashCapacity); hashKeys[b] != -1;
+       b = (b + 1) & (hashCapacity - 1)) {
+    if (hashKeys[b] == key) {
+      return hashCells[b];
+    }
+  }
+  return -1;
+}
+
+int SimBox::findCell(int molIdx) {
+  return lookupCell(findCellKey(molIdx));
+}
+
+int SimBox::addCell(long long key) {
+  if (numStoredCells == cellCapacity) {
+    return -1;
   }
 
-  if (update) {
-    if (prevNode->index == molIdx) {
-      neighborCells[prevCell[0]][prevCell[1]][prevCell[2]] = (prevNode->next);
-      prevNode->next = neighborCells[newCell[0]][newCell[1]][newCell[2]];
-      neighborCells[newCell[0]][newCell[1]][newCell[2]] = prevNode;
-    } else {
-      NLC_Node* removeNode = prevNode->next;
-      prevNode->next = (prevNode->next->next);
-      removeNode->next = (neighborCells[newCell[0]][newCell[1]][newCell[2]]);
-      neighborCells[newCell[0]][newCell[1]][newCell[2]] = removeNode;
+  int cell = numStoredCells++;
+  cellKeys[cell] = key;
+  cellCount[cell] = 0;
+  int b = hashBucket(key, hashCapacity);
+  while (hashKeys[b] != -1) {
+    b = (b + 1) & (hashCapacity - 1);
+  }
+  hashKeys[b] = key;
+  hashCells[b] = cell;
+  return cell;
+}
+
+void SimBox::buildNLC() {
+  TraceScope traced("NLC Rebuild", Tracer::isEnabled());
+  delete[] cellStart;
+  delete[] cellCount;
+  delete[] cellMembers;
+  delete[] cellKeys;
+  delete[] hashKeys;
+  delete[] hashCells;
+  cellKeys = NULL;
+  hashKeys = NULL;
+  hashCells = NULL;
+
+  if (sparseNLC) {
+    // Store only the occupied grid positions, in increasing order
+    std::vector<long long> keys(numMolecules);
+    for (int i = 0; i < numMolecules; i++) {
+      keys[i] = findCellKey(i);
+    }
+    std::sort(keys.begin(), keys.end());
+    int numOccupied = std::unique(keys.begin(), keys.end()) - keys.begin();
+
+    cellCapacity = numOccupied + numOccupied / 4 + NLC_SPARE_CELLS;
+    hashCapacity = 1;
+    while (hashCapacity < 2 * cellCapacity) {
+      hashCapacity *= 2;
     }
+    cellKeys = new long long[cellCapacity];
+    hashKeys = new long long[hashCapacity];
+    hashCells = new int[hashCapacity];
+    std::fill(hashKeys, hashKeys + hashCapacity, -1LL);
+    cellCount = new int[cellCapacity];
+
+    numStoredCells = 0;
+    for (int c = 0; c < numOccupied; c++) {
+      addCell(keys[c]);
+    }
+  } else {
+    cellCapacity = numStoredCells = (int) numCellsXYZ;
+    cellCount = new int[cellCapacity];
+  }
+
+  for (int c = 0; c < cellCapacity; c++) {
+    cellCount[c] = 0;
+  }
+  for (int i = 0; i < numMolecules; i++) {
+    cellOf[i] = findCell(i);
+    cellCount[cellOf[i]]++;
+  }
+
+  cellStart = new int[cellCapacity + 1];
+  cellStart[0] = 0;
+  for (int c = 0; c < cellCapacity; c++) {
+    cellStart[c + 1] = cellStart[c] + cellCount[c] + NLC_SPARE_SLOTS;
+    cellCount[c] = 0;
+  }
+
+  cellMembers = new int[cellStart[cellCapacity]];
+  for (int i = 0; i < numMolecules; i++) {
+    int slot = cellStart[cellOf[i]] + cellCount[cellOf[i]]++;
+    cellMembers[slot] = i;
+    cellSlot[i] = slot;
+  }
+}
+
+void SimBox::updateNLC(int molIdx) {
+  int oldCell = cellOf[molIdx];
+  long long key = findCellKey(molIdx);
+  int newCell = lookupCell(key);
+  PAIR_COUNT(nlcUpdates, 1);
+  if (newCell == oldCell) {
+    return;
+  }
+  PAIR_COUNT(nlcCellChanges, 1);
+
+  if (newCell < 0) {
+    newCell = addCell(key);
+  }
+  if (newCell < 0 ||
+      cellCount[newCell] == cellStart[newCell + 1] - cellStart[newCell]) {
+    PAIR_COUNT(nlcRebuilds, 1);
+    buildNLC();
+    return;
   }
+
+  // Fill the molecule's old slot with the last member of its old cell
+  int last = cellStart[oldCell] + --cellCount[oldCell];
+  int moved = cellMembers[last];
+  cellMembers[cellSlot[molIdx]] = moved;
+  cellSlot[moved] = cellSlot[molIdx];
+
+  int slot = cellStart[newCell] + cellCount[newCell]++;
+  cellMembers[slot] = molIdx;
+  cellSlot[molIdx] = slot;
+  cellOf[molIdx] = newCell;
 }
 
 Real SimBox::calcIntraMolecularEnergy(int molIdx) {
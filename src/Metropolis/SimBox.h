@@ -11,6 +11,18 @@
 #include <vector>
 #include <set>
 
+/**
+ * The number of spare slots given to each neighbor cell, so molecules can
+ * move between cells without rebuilding the cells.
+ */
+#define NLC_SPARE_SLOTS 4
+
+/**
+ * The number of empty cells the sparse neighbor cells keep room for, on top of
+ * a quarter of the occupied cells, before they must be rebuilt.
+ */
+#define NLC_SPARE_CELLS 16
+
 typedef unsigned int ID;
 
 
@@ -213,34 +225,92 @@ public:
   Real* cellWidth;
 
   /**
-   * Points to NLC_Node[numMolecules]
-   * Used only for allocation / deallocation of memory for the NLC linked cells.
+   * The total number of cells in the grid,
+   *     numCells[0] * numCells[1] * numCells[2].
    */
-  NLC_Node* nlc_heap;
+  long long numCellsXYZ;
 
   /**
-   * NLC_Node*[3^3]
-   * Holds each linked list for cells adjacent to the target molecule.
+   * True if only the occupied cells of the grid are stored, false if every
+   *     cell is. In the sparse index a hash table maps grid positions to
+   *     cells, so empty regions of the box take no memory or traversal time.
    */
-  NLC_Node** neighbors;
+  bool sparseNLC;
 
   /**
-   * NLC_Node*[numCells[0]][numCells[1]][numCells[2]]
-   * NLC heads for every cell in the box.
+   * The number of cells stored. Equal to numCellsXYZ in the dense index, and
+   *     to the number of grid positions that have held a molecule since the
+   *     last rebuild in the sparse index.
    */
-  NLC_Node**** neighborCells;
+  int numStoredCells;
 
   /**
-   * Points to the node before the node just examined, or
-   *     to the node just examined if that node is the head of its linked list.
+   * The number of cells there is room for before the cells must be rebuilt.
    */
-  NLC_Node* prevNode;
+  int cellCapacity;
 
   /**
-   * int[3]
-   * Holds the location of the cell most recently examined.
+   * int[cellCapacity + 1]
+   * The first slot of each cell in cellMembers. The slots of cell c end at
+   *     cellStart[c + 1]; each cell has spare slots so molecules can move in
+   *     without shifting the other cells.
+   */
+  int* cellStart;
+
+  /**
+   * int[cellCapacity]
+   * The number of molecules in each cell.
+   */
+  int* cellCount;
+
+  /**
+   * int[cellStart[cellCapacity]]
+   * The molecules in each cell. Only the first cellCount[c] slots of cell c
+   *     are in use.
+   */
+  int* cellMembers;
+
+  /**
+   * long long[cellCapacity]
+   * The grid position (see getCellKey) of each cell. Sparse index only.
+   */
+  long long* cellKeys;
+
+  /**
+   * The size of the hash table, a power of two. Sparse index only.
+   */
+  int hashCapacity;
+
+  /**
+   * long long[hashCapacity]
+   * The grid positions in the hash table, or -1 for an empty bucket.
+   *     Sparse index only.
+   */
+  long long* hashKeys;
+
+  /**
+   * int[hashCapacity]
+   * The cell stored for each grid position in hashKeys. Sparse index only.
+   */
+  int* hashCells;
+
+  /**
+   * int[numMolecules]
+   * The cell holding each molecule.
+   */
+  int* cellOf;
+
+  /**
+   * int[numMolecules]
+   * The slot in cellMembers holding each molecule.
    */
-  int* prevCell;
+  int* cellSlot;
+
+  /**
+   * int[3^3]
+   * Holds the indexes of the cells adjacent to the target molecule.
+   */
+  int* neighbors;
 
   /**
    * int[atoms in largest molecule]
@@ -435,17 +505,66 @@ public:
   Real calcBlending (const Real &a, const Real &b);
 
   /**
-   * Given the index for a molecule, popuplate neighbors with the heads of
-   * linked-lists holding the molecules in neighboring cells.
+   * Given the index for a molecule, popuplate neighbors with the indexes of
+   * the neighboring cells. The molecules in cell c are
+   * cellMembers[cellStart[c]] .. cellMembers[cellStart[c] + cellCount[c] - 1].
    *
    * The neighbors field variable is filled by this method, but cells beyond the
-   * number of neighboring cells are unaffected.
+   * number of neighboring cells are unaffected. The sparse index leaves out
+   * neighboring grid positions that have no cell stored.
    *
    * @param molIdx The index of the molecule to find the neighboring cells of.
    * @return The number of neighboring cells found.
    */
   int findNeighbors(int molIdx);
 
+  /**
+   * Given the x, y and z indexes of a grid position, returns its scalar key.
+   */
+  long long getCellKey(int x, int y, int z);
+
+  /**
+   * Returns the key of the grid position holding a molecule's first primary
+   * index atom.
+   *
+   * @param molIdx The index of the molecule.
+   */
+  long long findCellKey(int molIdx);
+
+  /**
+   * Returns the cell stored for a grid position. In the dense index this is
+   * the key itself.
+   *
+   * @param key The key of the grid position.
+   * @return The cell, or -1 if the sparse index has no cell for the position.
+   */
+  int lookupCell(long long key);
+
+  /**
+   * Returns the cell holding a molecule's first primary index atom, or -1 if
+   * the sparse index has no cell for its position.
+   *
+   * @param molIdx The index of the molecule.
+   */
+  int findCell(int molIdx);
+
+  /**
+   * Sorts every molecule into the cells by counting, leaving NLC_SPARE_SLOTS
+   * spare slots in each cell. The sparse index stores only the occupied
+   * cells, and keeps room for NLC_SPARE_CELLS more. numCells, cellWidth,
+   * numCellsXYZ, sparseNLC, cellOf and cellSlot must already be set; the cell
+   * arrays are (re)allocated here.
+   */
+  void buildNLC();
+
+  /**
+   * Adds an empty cell for a grid position to the sparse index.
+   *
+   * @param key The key of the grid position.
+   * @return The new cell, or -1 if there is no room left for it.
+   */
+  int addCell(long long key);
+
   /**
    * Given an index and a dimension, returns the index, wrapped around the box.
    *
@@ -465,12 +584,11 @@ public:
   int getCell(Real loc, int dimension);
 
   /**
-   * Given a molecule, updates the molecule's position in the neighbor linked
-   * cells (if it needs to be updated).
-   *
-   * updateNLC uses the prevNode pointer to avoid redundant traversal of the NLC
-   * list. Therefore, it must be set to the node to remove's predecessor, or the
-   * remove node itself if that node is the head of the linked list.
+   * Given a molecule, moves it to the cell it now lies in (if it needs to be
+   * moved). The molecule is swapped out of its old cell with that cell's last
+   * member and appended to its new cell, so each move takes constant time.
+   * If the new cell has no spare slot, or the sparse index has no room for a
+   * new cell, every cell is rebuilt.
    *
    * @param molIdx The index of the molecule to update.
    */
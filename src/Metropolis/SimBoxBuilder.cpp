@@ -1,22 +1,63 @@
 #include "SimBoxBuilder.h"
+#include "Utilities/Timer.h"
 
+#include <algorithm>
+#include <climits>
 
-SimBoxBuilder::SimBoxBuilder(bool useNLC, SBScanner* sbData_in) {
+
+SimBoxBuilder::SimBoxBuilder(bool useNLC, SBScanner* sbData_in,
+                             PackingType packing_in,
+                             SpatialIndexType spatialIndex_in) {
   sb = new SimBox();
   sb->useNLC = useNLC;
   sbData = sbData_in;
+  packing = packing_in;
+  spatialIndex = spatialIndex_in;
+  times.stamp = times.place = times.wrap = times.nlc = 0;
 }
 
 SimBox* SimBoxBuilder::build(Box* box) {
+  double phaseStart = wallClockSeconds(), phaseEnd;
+
   initEnvironment(box->environment);
-  addMolecules(box->molecules, box->environment->primaryAtomIndexArray->size());
+  bool generateCoordinates = box->atomCoordinates == NULL;
+  addMolecules(box);
+  phaseEnd = wallClockSeconds();
+  times.stamp = phaseEnd - phaseStart;
+  phaseStart = phaseEnd;
+
+  if (generateCoordinates) {
+    if (packing == Packing::SimpleCubic) {
+      placeOnSimpleCubicLattice();
+    } else if (packing == Packing::Random) {
+      if (!placeRandomly()) {
+        return NULL;
+      }
+    } else {
+      placeOnLattice();
+    }
+  }
+  phaseEnd = wallClockSeconds();
+  times.place = phaseEnd - phaseStart;
+  phaseStart = phaseEnd;
+
   addPrimaryIndexes(box->environment->primaryAtomIndexArray);
+  keepMoleculesInBox();
+  phaseEnd = wallClockSeconds();
+  times.wrap = phaseEnd - phaseStart;
+  phaseStart = phaseEnd;
+
   if (sb->useNLC) {
     fillNLC();
   }
+  times.nlc = wallClockSeconds() - phaseStart;
   return sb;
 }
 
+const SimBoxBuilder::BuildTimes& SimBoxBuilder::getBuildTimes() {
+  return times;
+}
+
 void SimBoxBuilder::initEnvironment(Environment* environment) {
   sb->size = new Real[NUM_DIMENSIONS];
   sb->size[X_COORD] = environment->x;
@@ -30,7 +71,9 @@ void SimBoxBuilder::initEnvironment(Environment* environment) {
   sb->numMolecules = environment->numOfMolecules;
 }
 
-void SimBoxBuilder::addMolecules(Molecule* molecules, int numTypes) {
+void SimBoxBuilder::addMolecules(Box* box) {
+  int numTypes = box->environment->primaryAtomIndexArray->size();
+  int numMolecules = sb->numMolecules;
   int largestMolecule = 0, nAtoms = 0;
   int mostBonds = 0, nBonds = 0;
   int mostAngles = 0, nAngles = 0;
@@ -43,18 +86,36 @@ void SimBoxBuilder::addMolecules(Molecule* molecules, int numTypes) {
     sb->fudgeAtoms[i] = NULL;
   }
 
-  for (int i = 0; i < sb->numMolecules; i++) {
-    nAtoms += molecules[i].numOfAtoms;
-    nBonds += molecules[i].numOfBonds;
-    nAngles += molecules[i].numOfAngles;
-    if (molecules[i].numOfAtoms > largestMolecule) {
-      largestMolecule = molecules[i].numOfAtoms;
+  sb->moleculeData = new int*[MOL_DATA_SIZE];
+  for (int i = 0; i < MOL_DATA_SIZE; i++) {
+    sb->moleculeData[i] = new int[numMolecules];
+  }
+  int** molData = sb->moleculeData;
+
+  // Lay the molecules out one after another. Every instance's atoms, bonds
+  // and angles start where the previous molecule's ended, so once these
+  // offsets are known each molecule can be filled in independently.
+  for (int i = 0; i < numMolecules; i++) {
+    Molecule& pattern = box->getTemplate(i);
+    molData[MOL_START][i] = nAtoms;
+    molData[MOL_LEN][i] = pattern.numOfAtoms;
+    molData[MOL_TYPE][i] = pattern.type;
+    molData[MOL_BOND_START][i] = nBonds;
+    molData[MOL_BOND_COUNT][i] = pattern.numOfBonds;
+    molData[MOL_ANGLE_START][i] = nAngles;
+    molData[MOL_ANGLE_COUNT][i] = pattern.numOfAngles;
+
+    nAtoms += pattern.numOfAtoms;
+    nBonds += pattern.numOfBonds;
+    nAngles += pattern.numOfAngles;
+    if (pattern.numOfAtoms > largestMolecule) {
+      largestMolecule = pattern.numOfAtoms;
     }
-    if (molecules[i].numOfBonds > mostBonds) {
-      mostBonds = molecules[i].numOfBonds;
+    if (pattern.numOfBonds > mostBonds) {
+      mostBonds = pattern.numOfBonds;
     }
-    if (molecules[i].numOfAngles > mostAngles) {
-      mostAngles = molecules[i].numOfAngles;
+    if (pattern.numOfAngles > mostAngles) {
+      mostAngles = pattern.numOfAngles;
     }
   }
 
@@ -62,10 +123,20 @@ void SimBoxBuilder::addMolecules(Molecule* molecules, int numTypes) {
   sb->numBonds = nBonds;
   sb->numAngles = nAngles;
 
+  // Coordinates that were read in are taken over rather than copied
+  bool readCoordinates = box->atomCoordinates != NULL;
+  if (readCoordinates) {
+    sb->atomCoordinates = box->atomCoordinates;
+    box->atomCoordinates = NULL;
+  } else {
+    sb->atomCoordinates = new Real*[NUM_DIMENSIONS];
+    for (int i = 0; i < NUM_DIMENSIONS; i++) {
+      sb->atomCoordinates[i] = new Real[sb->numAtoms];
+    }
+  }
+
   sb->rollBackCoordinates = new Real*[NUM_DIMENSIONS];
-  sb->atomCoordinates = new Real*[NUM_DIMENSIONS];
   sb->atomData = new Real*[ATOM_DATA_SIZE];
-  sb->moleculeData = new int*[MOL_DATA_SIZE];
   sb->bondData = new Real*[BOND_DATA_SIZE];
   sb->angleData = new Real*[ANGLE_DATA_SIZE];
   sb->bondLengths = new Real[nBonds];
@@ -74,7 +145,6 @@ void SimBoxBuilder::addMolecules(Molecule* molecules, int numTypes) {
   sb->angleSizes = new Real[nAngles];
 
   for (int i = 0; i < NUM_DIMENSIONS; i++) {
-    sb->atomCoordinates[i] = new Real[sb->numAtoms];
     sb->rollBackCoordinates[i] = new Real[largestMolecule];
   }
 
@@ -82,10 +152,6 @@ void SimBoxBuilder::addMolecules(Molecule* molecules, int numTypes) {
     sb->atomData[i] = new Real[sb->numAtoms];
   }
 
-  for (int i = 0; i < MOL_DATA_SIZE; i++) {
-    sb->moleculeData[i] = new int[sb->numMolecules];
-  }
-
   for (int i = 0; i < BOND_DATA_SIZE; i++) {
     sb->bondData[i] = new Real[sb->numBonds];
   }
@@ -93,195 +159,652 @@ void SimBoxBuilder::addMolecules(Molecule* molecules, int numTypes) {
   for (int i = 0; i < ANGLE_DATA_SIZE; i++) {
     sb->angleData[i] = new Real[sb->numAngles];
   }
-  int atomIdx = 0, bondIdx = 0, angleIdx = 0;
 
-  std::map<int, int> idToIdx;
-  std::map<int, std::string*> idToName;
+  // Bond and angle parameters and the exclusion tables only depend on the
+  // molecule type, so they are resolved once per type and shared by every
+  // instance.
+  std::vector< std::vector<BondData> > typeBonds(numTypes);
+  std::vector< std::vector<AngleData> > typeAngles(numTypes);
+  Molecule* templates = box->getTemplates();
+  for (int t = 0; t < box->templateCount; t++) {
+    Molecule& pattern = templates[t];
+    if (sb->excludeAtoms[pattern.type] == NULL) {
+      resolveBondedParameters(pattern, typeBonds[pattern.type],
+                              typeAngles[pattern.type]);
+      addExclusions(pattern);
+    }
+  }
 
-  for (int i = 0; i < sb->numMolecules; i++) {
+  // Template atom IDs are local to the molecule, so the index of an atom in
+  // the simulation box is the molecule's start plus its ID.
+  #pragma omp parallel for schedule(static)
+  for (int i = 0; i < numMolecules; i++) {
+    Molecule& pattern = box->getTemplate(i);
+    int type = pattern.type;
+    int start = molData[MOL_START][i];
+    int bondIdx = molData[MOL_BOND_START][i];
+    int angleIdx = molData[MOL_ANGLE_START][i];
 
-    sb->moleculeData[MOL_START][i] = atomIdx;
-    sb->moleculeData[MOL_LEN][i] = molecules[i].numOfAtoms;
-    sb->moleculeData[MOL_TYPE][i] = molecules[i].type;
-    sb->moleculeData[MOL_BOND_START][i] = bondIdx;
-    sb->moleculeData[MOL_BOND_COUNT][i] = molecules[i].numOfBonds;
-    sb->moleculeData[MOL_ANGLE_START][i] = angleIdx;
-    sb->moleculeData[MOL_ANGLE_COUNT][i] = molecules[i].numOfAngles;
-
-    for (int j = 0; j < molecules[i].numOfAtoms; j++) {
-      Atom a = molecules[i].atoms[j];
-      idToIdx[a.id] = atomIdx;
-      idToName[a.id] = a.name;
-      sb->atomData[ATOM_SIGMA][atomIdx] = a.sigma;
-      sb->atomData[ATOM_EPSILON][atomIdx] = a.epsilon;
-      sb->atomData[ATOM_CHARGE][atomIdx] = a.charge;
-      sb->atomCoordinates[X_COORD][atomIdx] = a.x;
-      sb->atomCoordinates[Y_COORD][atomIdx] = a.y;
-      sb->atomCoordinates[Z_COORD][atomIdx] = a.z;
-      atomIdx++;
-    }
-
-    for (int j = 0; j < molecules[i].numOfBonds; j++) {
-      Bond b = molecules[i].bonds[j];
-      sb->bondData[BOND_A1_IDX][bondIdx] = idToIdx[b.atom1];
-      sb->bondData[BOND_A2_IDX][bondIdx] = idToIdx[b.atom2];
-      std::string name1 = *(idToName[b.atom1]);
-      std::string name2 = *(idToName[b.atom2]);
-      sb->bondData[BOND_KBOND][bondIdx] = sbData->getKBond(name1, name2);
-      sb->bondData[BOND_EQDIST][bondIdx] = sbData->getEqBondDist(name1, name2);
+    for (int j = 0; j < pattern.numOfAtoms; j++) {
+      Atom& a = pattern.atoms[j];
+      sb->atomData[ATOM_SIGMA][start + j] = a.sigma;
+      sb->atomData[ATOM_EPSILON][start + j] = a.epsilon;
+      sb->atomData[ATOM_CHARGE][start + j] = a.charge;
+      if (!readCoordinates) {
+        sb->atomCoordinates[X_COORD][start + j] = a.x;
+        sb->atomCoordinates[Y_COORD][start + j] = a.y;
+        sb->atomCoordinates[Z_COORD][start + j] = a.z;
+      }
+    }
+
+    for (int j = 0; j < pattern.numOfBonds; j++) {
+      Bond& b = pattern.bonds[j];
+      sb->bondData[BOND_A1_IDX][bondIdx] = start + b.atom1;
+      sb->bondData[BOND_A2_IDX][bondIdx] = start + b.atom2;
+      sb->bondData[BOND_KBOND][bondIdx] = typeBonds[type][j].kBond;
+      sb->bondData[BOND_EQDIST][bondIdx] = typeBonds[type][j].eqBondDist;
       sb->bondLengths[bondIdx] = b.distance;
       sb->bondData[BOND_VARIABLE][bondIdx] = b.variable;
       bondIdx++;
     }
 
-    for (int j = 0; j < molecules[i].numOfAngles; j++) {
-      Angle a = molecules[i].angles[j];
-      sb->angleData[ANGLE_A1_IDX][angleIdx] = idToIdx[a.atom1];
-      sb->angleData[ANGLE_A2_IDX][angleIdx] = idToIdx[a.atom2];
-      sb->angleData[ANGLE_MID_IDX][angleIdx] = idToIdx[a.commonAtom];
-      std::string a1Name = *(idToName[a.atom1]);
-      std::string a2Name = *(idToName[a.atom2]);
-      std::string midName = *(idToName[a.commonAtom]);
-      sb->angleData[ANGLE_KANGLE][angleIdx] = sbData->getKAngle(a1Name, midName, a2Name);
-      sb->angleData[ANGLE_EQANGLE][angleIdx] = sbData->getEqAngle(a1Name, midName, a2Name);
+    for (int j = 0; j < pattern.numOfAngles; j++) {
+      Angle& a = pattern.angles[j];
+      sb->angleData[ANGLE_A1_IDX][angleIdx] = start + a.atom1;
+      sb->angleData[ANGLE_A2_IDX][angleIdx] = start + a.atom2;
+      sb->angleData[ANGLE_MID_IDX][angleIdx] = start + a.commonAtom;
+      sb->angleData[ANGLE_KANGLE][angleIdx] = typeAngles[type][j].kAngle;
+      sb->angleData[ANGLE_EQANGLE][angleIdx] = typeAngles[type][j].eqAngle;
       sb->angleSizes[angleIdx] = a.value;
       sb->angleData[ANGLE_VARIABLE][angleIdx] = a.variable;
       angleIdx++;
     }
+  }
+}
 
-    int type = molecules[i].type;
-    if (sb->excludeAtoms[type] == NULL) {
-      int numOfAtoms = sb->moleculeData[MOL_LEN][i];
-      sb->excludeAtoms[type] = new int*[numOfAtoms];
-      sb->fudgeAtoms[type] = new int*[numOfAtoms];
-      int startIdx = sb->moleculeData[MOL_START][i];
-      int *excludeCount = new int[numOfAtoms];
-      int *fudgeCount = new int[numOfAtoms];
-      for (int j = 0; j < numOfAtoms; j++) {
-        excludeCount[j] = 0;
-        fudgeCount[j] = 0;
+void SimBoxBuilder::addExclusions(Molecule& pattern) {
+  int type = pattern.type;
+  int numOfAtoms = pattern.numOfAtoms;
+  sb->excludeAtoms[type] = new int*[numOfAtoms];
+  sb->fudgeAtoms[type] = new int*[numOfAtoms];
+  int *excludeCount = new int[numOfAtoms];
+  int *fudgeCount = new int[numOfAtoms];
+  for (int j = 0; j < numOfAtoms; j++) {
+    excludeCount[j] = 0;
+    fudgeCount[j] = 0;
+  }
+  for (int j = 0; j < pattern.numOfBonds; j++) {
+    int idx1 = pattern.bonds[j].atom1;
+    int idx2 = pattern.bonds[j].atom2;
+    if (idx1 >= 0 && idx1 < numOfAtoms && idx2 >= 0 && idx2 < numOfAtoms) {
+      excludeCount[idx1]++;
+      excludeCount[idx2]++;
+    }
+  }
+  for (int j = 0; j < pattern.numOfAngles; j++) {
+    int idx1 = pattern.angles[j].atom1;
+    int idx2 = pattern.angles[j].atom2;
+    if (idx1 >= 0 && idx1 < numOfAtoms && idx2 >= 0 && idx2 < numOfAtoms) {
+      excludeCount[idx1]++;
+      excludeCount[idx2]++;
+    }
+  }
+  for (int j = 0; j < pattern.numOfHops; j++) {
+    int idx1 = pattern.hops[j].atom1;
+    int idx2 = pattern.hops[j].atom2;
+    int hopDist = pattern.hops[j].hop;
+    if (idx1 >= 0 && idx1 < numOfAtoms && idx2 >= 0 && idx2 < numOfAtoms && hopDist == 3) {
+      fudgeCount[idx1]++;
+      fudgeCount[idx2]++;
+    }
+  }
+  for (int j = 0; j < numOfAtoms; j++) {
+    sb->excludeAtoms[type][j] = new int[excludeCount[j] + 1];
+    sb->fudgeAtoms[type][j] = new int[fudgeCount[j] + 1];
+    excludeCount[j] = 0;
+    fudgeCount[j] = 0;
+  }
+  for (int j = 0; j < pattern.numOfBonds; j++) {
+    int idx1 = pattern.bonds[j].atom1;
+    int idx2 = pattern.bonds[j].atom2;
+    if (idx1 >= 0 && idx1 < numOfAtoms && idx2 >= 0 && idx2 < numOfAtoms) {
+      sb->excludeAtoms[type][idx1][excludeCount[idx1]++] = idx2;
+      sb->excludeAtoms[type][idx2][excludeCount[idx2]++] = idx1;
+    }
+  }
+  for (int j = 0; j < pattern.numOfAngles; j++) {
+    int idx1 = pattern.angles[j].atom1;
+    int idx2 = pattern.angles[j].atom2;
+    if (idx1 >= 0 && idx1 < numOfAtoms && idx2 >= 0 && idx2 < numOfAtoms) {
+      sb->excludeAtoms[type][idx1][excludeCount[idx1]++] = idx2;
+      sb->excludeAtoms[type][idx2][excludeCount[idx2]++] = idx1;
+    }
+  }
+  for (int j = 0; j < pattern.numOfHops; j++) {
+    int idx1 = pattern.hops[j].atom1;
+    int idx2 = pattern.hops[j].atom2;
+    int hopDist = pattern.hops[j].hop;
+    if (idx1 >= 0 && idx1 < numOfAtoms && idx2 >= 0 && idx2 < numOfAtoms && hopDist == 3) {
+      sb->fudgeAtoms[type][idx1][fudgeCount[idx1]++] = idx2;
+      sb->fudgeAtoms[type][idx2][fudgeCount[idx2]++] = idx1;
+    }
+  }
+
+  for (int j = 0; j < numOfAtoms; j++) {
+    sb->excludeAtoms[type][j][excludeCount[j]] = -1;
+    sb->fudgeAtoms[type][j][fudgeCount[j]] = -1;
+  }
+
+  delete[] excludeCount;
+  delete[] fudgeCount;
+}
+
+void SimBoxBuilder::placeOnLattice() {
+  Real cells, dcells, cellL, halfcellL;
+  Real** coords = sb->atomCoordinates;
+  int** molData = sb->moleculeData;
+  int numMolecules = sb->numMolecules;
+
+  // Determine the number of unit cells in each coordinate direction
+  dcells = pow(0.25 * (Real) numMolecules, 1.0/3.0);
+  cells = (int)(dcells + 0.5);
+
+  // Check if numMolecules is a non-fcc number of molecules and increase
+  // the number of cells if necessary
+  while((4 * cells * cells * cells) < numMolecules) {
+    cells++;
+  }
+
+  //Determine length of unit cell
+  cellL = sb->size[X_COORD] / (Real) cells;
+  halfcellL = 0.5 * cellL;
+
+  // Construct the unit cell. Each molecule starts at its template's
+  // z-matrix coordinates.
+  Real offsets[4][NUM_DIMENSIONS] = {
+    {0.0, 0.0, 0.0},
+    {halfcellL, halfcellL, 0.0},
+    {0.0, halfcellL, halfcellL},
+    {halfcellL, 0.0, halfcellL}
+  };
+  for (int a = 0; a < 4 && a < numMolecules; a++) {
+    int start = molData[MOL_START][a];
+    for (int j = 0; j < molData[MOL_LEN][a]; j++) {
+      for (int k = 0; k < NUM_DIMENSIONS; k++) {
+        coords[k][start + j] += offsets[a][k];
       }
-      for (int j = 0; j < molecules[i].numOfBonds; j++) {
-        int idx1 = idToIdx[molecules[i].bonds[j].atom1] - startIdx;
-        int idx2 = idToIdx[molecules[i].bonds[j].atom2] - startIdx;
-        if (idx1 >= 0 && idx1 < numOfAtoms && idx2 >= 0 && idx2 < numOfAtoms) {
-          excludeCount[idx1]++;
-          excludeCount[idx2]++;
-        }
+    }
+  }
+
+  // Build the lattice from the unit cell by repeatedly translating
+  // the four vectors of the unit cell through a distance cellL in
+  // the x, y, and z directions. Molecule i sits at slot i % 4 of unit cell
+  // i / 4, and is copied from the unit cell molecule in the same slot atom by
+  // atom. Molecules are copied in parallel unless a copy would read atoms
+  // past the unit cell, which only happens when molecule types of different
+  // sizes don't line up with the four slots.
+  int unitCellMolecules = numMolecules < 4 ? numMolecules : 4;
+  int unitCellEnd = molData[MOL_START][unitCellMolecules - 1] +
+                    molData[MOL_LEN][unitCellMolecules - 1];
+  bool independent = true;
+  for (int i = 4; i < numMolecules && independent; i++) {
+    if (molData[MOL_START][i % 4] + molData[MOL_LEN][i] > unitCellEnd) {
+      independent = false;
+    }
+  }
+
+  int cellsPerSide = (int) cells;
+  #pragma omp parallel for schedule(static) if (independent)
+  for (int i = 4; i < numMolecules; i++) {
+    int cell = i / 4;
+    Real dx = cellL * (cell % cellsPerSide);
+    Real dy = cellL * ((cell / cellsPerSide) % cellsPerSide);
+    Real dz = cellL * (cell / (cellsPerSide * cellsPerSide));
+    int start = molData[MOL_START][i];
+    int base = molData[MOL_START][i % 4];
+    for (int j = 0; j < molData[MOL_LEN][i]; j++) {
+      coords[X_COORD][start + j] = coords[X_COORD][base + j] + dx;
+      coords[Y_COORD][start + j] = coords[Y_COORD][base + j] + dy;
+      coords[Z_COORD][start + j] = coords[Z_COORD][base + j] + dz;
+    }
+  }
+
+  //Shift center of box to the origin
+  for (int k = 0; k < NUM_DIMENSIONS; k++) {
+    Real* dim = coords[k];
+    #pragma omp parallel for schedule(static)
+    for (int j = 0; j < sb->numAtoms; j++) {
+      dim[j] -= halfcellL;
+    }
+  }
+}
+
+void SimBoxBuilder::centerMolecules() {
+  Real** coords = sb->atomCoordinates;
+  int** molData = sb->moleculeData;
+
+  #pragma omp parallel for schedule(static)
+  for (int i = 0; i < sb->numMolecules; i++) {
+    int start = molData[MOL_START][i];
+    int len = molData[MOL_LEN][i];
+    for (int k = 0; k < NUM_DIMENSIONS; k++) {
+      Real center = 0;
+      for (int j = start; j < start + len; j++) {
+        center += coords[k][j];
       }
-      for (int j = 0; j < molecules[i].numOfAngles; j++) {
-        int idx1 = idToIdx[molecules[i].angles[j].atom1] - startIdx;
-        int idx2 = idToIdx[molecules[i].angles[j].atom2] - startIdx;
-        if (idx1 >= 0 && idx1 < numOfAtoms && idx2 >= 0 && idx2 < numOfAtoms) {
-          excludeCount[idx1]++;
-          excludeCount[idx2]++;
-        }
+      center /= len;
+      for (int j = start; j < start + len; j++) {
+        coords[k][j] -= center;
       }
-      for (int j = 0; j < molecules[i].numOfHops; j++) {
-        int idx1 = idToIdx[molecules[i].hops[j].atom1] - startIdx;
-        int idx2 = idToIdx[molecules[i].hops[j].atom2] - startIdx;
-        int hopDist = molecules[i].hops[j].hop;
-        if (idx1 >= 0 && idx1 < numOfAtoms && idx2 >= 0 && idx2 < numOfAtoms && hopDist == 3) {
-          fudgeCount[idx1]++;
-          fudgeCount[idx2]++;
-        }
+    }
+  }
+}
+
+/**
+ * Chooses the number of lattice sites along each side of a box, so that the
+ *     spacing is about the same in every direction and there are at least
+ *     numSites sites.
+ */
+static void latticeShape(const Real* size, int numSites, int* shape) {
+  Real spacing = pow(size[X_COORD] * size[Y_COORD] * size[Z_COORD] / numSites,
+                     1.0 / 3.0);
+  for (int k = 0; k < NUM_DIMENSIONS; k++) {
+    shape[k] = (int) (size[k] / spacing);
+    if (shape[k] < 1) {
+      shape[k] = 1;
+    }
+  }
+  while ((long) shape[X_COORD] * shape[Y_COORD] * shape[Z_COORD] < numSites) {
+    int widest = X_COORD;
+    for (int k = Y_COORD; k < NUM_DIMENSIONS; k++) {
+      if (size[k] / shape[k] > size[widest] / shape[widest]) {
+        widest = k;
+      }
+    }
+    shape[widest]++;
+  }
+}
+
+void SimBoxBuilder::placeOnSimpleCubicLattice() {
+  Real** coords = sb->atomCoordinates;
+  int** molData = sb->moleculeData;
+  int shape[NUM_DIMENSIONS];
+
+  centerMolecules();
+  latticeShape(sb->size, sb->numMolecules, shape);
+
+  #pragma omp parallel for schedule(static)
+  for (int i = 0; i < sb->numMolecules; i++) {
+    int site[NUM_DIMENSIONS];
+    site[X_COORD] = i % shape[X_COORD];
+    site[Y_COORD] = (i / shape[X_COORD]) % shape[Y_COORD];
+    site[Z_COORD] = i / (shape[X_COORD] * shape[Y_COORD]);
+
+    int start = molData[MOL_START][i];
+    int end = start + molData[MOL_LEN][i];
+    for (int k = 0; k < NUM_DIMENSIONS; k++) {
+      Real center = (site[k] + 0.5) * sb->size[k] / shape[k];
+      for (int j = start; j < end; j++) {
+        coords[k][j] += center;
       }
-      for (int j = 0; j < numOfAtoms; j++) {
-        sb->excludeAtoms[type][j] = new int[excludeCount[j] + 1];
-        sb->fudgeAtoms[type][j] = new int[fudgeCount[j] + 1];
-        excludeCount[j] = 0;
-        fudgeCount[j] = 0;
+    }
+  }
+}
+
+/**
+ * A grid of cells over the box holding the atoms placed so far by a random
+ *     packing. Each cell is at least as wide as the largest separation two
+ *     atoms need, so overlaps only need to be checked against the 27
+ *     surrounding cells.
+ */
+struct PackingGrid {
+  int numCells[NUM_DIMENSIONS];
+  Real cellWidth[NUM_DIMENSIONS];
+  Real size[NUM_DIMENSIONS];
+  /** The LJ sigma of every atom in the box */
+  const Real* sigma;
+  /** The first atom in each cell, or -1 */
+  std::vector<int> head;
+  /** The next atom in the same cell as each atom, or -1 */
+  std::vector<int> next;
+  /** The wrapped position of each placed atom */
+  std::vector<Real> position[NUM_DIMENSIONS];
+
+  PackingGrid(const Real* boxSize, const Real* atomSigma, int numAtoms) {
+    sigma = atomSigma;
+    Real largestSigma = 0;
+    for (int j = 0; j < numAtoms; j++) {
+      if (sigma[j] > largestSigma) {
+        largestSigma = sigma[j];
       }
-      for (int j = 0; j < molecules[i].numOfBonds; j++) {
-        int idx1 = idToIdx[molecules[i].bonds[j].atom1] - startIdx;
-        int idx2 = idToIdx[molecules[i].bonds[j].atom2] - startIdx;
-        if (idx1 >= 0 && idx1 < numOfAtoms && idx2 >= 0 && idx2 < numOfAtoms) {
-          sb->excludeAtoms[type][idx1][++excludeCount[idx1]] = idx2;
-          sb->excludeAtoms[type][idx2][++excludeCount[idx2]] = idx1;
-        }
+    }
+    Real largestSeparation = separation(largestSigma, largestSigma);
+
+    int total = 1;
+    for (int k = 0; k < NUM_DIMENSIONS; k++) {
+      size[k] = boxSize[k];
+      numCells[k] = (int) (size[k] / largestSeparation);
+      if (numCells[k] < 1) {
+        numCells[k] = 1;
       }
-      for (int j = 0; j < molecules[i].numOfAngles; j++) {
-        int idx1 = idToIdx[molecules[i].angles[j].atom1] - startIdx;
-        int idx2 = idToIdx[molecules[i].angles[j].atom2] - startIdx;
-        if (idx1 >= 0 && idx1 < numOfAtoms && idx2 >= 0 && idx2 < numOfAtoms) {
-          sb->excludeAtoms[type][idx1][++excludeCount[idx1]] = idx2;
-          sb->excludeAtoms[type][idx2][++excludeCount[idx2]] = idx1;
+      cellWidth[k] = size[k] / numCells[k];
+      total *= numCells[k];
+      position[k].resize(numAtoms);
+    }
+    head.assign(total, -1);
+    next.assign(numAtoms, -1);
+  }
+
+  /** The closest two atoms of different molecules may start */
+  static Real separation(Real sigma1, Real sigma2) {
+    Real fromSigma = PACKING_SIGMA_FRACTION * 0.5 * (sigma1 + sigma2);
+    return fromSigma > PACKING_MIN_DISTANCE ? fromSigma : PACKING_MIN_DISTANCE;
+  }
+
+  Real wrap(Real value, int k) {
+    return value - size[k] * floor(value / size[k]);
+  }
+
+  int cellOf(Real value, int k) {
+    int cell = (int) (value / cellWidth[k]);
+    return cell < numCells[k] ? cell : numCells[k] - 1;
+  }
+
+  int cellIndex(int x, int y, int z) {
+    return (x * numCells[Y_COORD] + y) * numCells[Z_COORD] + z;
+  }
+
+  /**
+   * Returns true if an atom placed at a point would be far enough from every
+   *     placed atom, using the nearest periodic image. Separations are scaled
+   *     by relax, which is at most 1.
+   */
+  bool isClear(int atom, const Real* point, Real relax) {
+    int cell[NUM_DIMENSIONS];
+    for (int k = 0; k < NUM_DIMENSIONS; k++) {
+      cell[k] = cellOf(point[k], k);
+    }
+    for (int dx = -1; dx <= 1; dx++) {
+      for (int dy = -1; dy <= 1; dy++) {
+        for (int dz = -1; dz <= 1; dz++) {
+          int x = (cell[X_COORD] + dx + numCells[X_COORD]) % numCells[X_COORD];
+          int y = (cell[Y_COORD] + dy + numCells[Y_COORD]) % numCells[Y_COORD];
+          int z = (cell[Z_COORD] + dz + numCells[Z_COORD]) % numCells[Z_COORD];
+          for (int a = head[cellIndex(x, y, z)]; a != -1; a = next[a]) {
+            Real distSq = 0;
+            for (int k = 0; k < NUM_DIMENSIONS; k++) {
+              Real d = point[k] - position[k][a];
+              d -= size[k] * round(d / size[k]);
+              distSq += d * d;
+            }
+            Real minDist = relax * separation(sigma[atom], sigma[a]);
+            if (distSq < minDist * minDist) {
+              return false;
+            }
+          }
         }
       }
-      for (int j = 0; j < molecules[i].numOfHops; j++) {
-        int idx1 = idToIdx[molecules[i].hops[j].atom1] - startIdx;
-        int idx2 = idToIdx[molecules[i].hops[j].atom2] - startIdx;
-        int hopDist = molecules[i].hops[j].hop;
-        if (idx1 >= 0 && idx1 < numOfAtoms && idx2 >= 0 && idx2 < numOfAtoms && hopDist == 3) {
-          sb->fudgeAtoms[type][idx1][++fudgeCount[idx1]] = idx2;
-          sb->fudgeAtoms[type][idx2][++fudgeCount[idx2]] = idx1;
+    }
+    return true;
+  }
+
+  void insert(int atom, const Real* point) {
+    for (int k = 0; k < NUM_DIMENSIONS; k++) {
+      position[k][atom] = point[k];
+    }
+    int idx = cellIndex(cellOf(point[X_COORD], X_COORD),
+                        cellOf(point[Y_COORD], Y_COORD),
+                        cellOf(point[Z_COORD], Z_COORD));
+    next[atom] = head[idx];
+    head[idx] = atom;
+  }
+};
+
+/**
+ * Draws a uniformly random rotation as a 3x3 matrix, from a random unit
+ *     quaternion.
+ */
+static void randomRotation(Real m[3][3]) {
+  Real u1 = randomReal(0, 1), u2 = randomReal(0, 2 * PI);
+  Real u3 = randomReal(0, 2 * PI);
+  Real w = sqrt(u1) * cos(u3), x = sqrt(1 - u1) * sin(u2);
+  Real y = sqrt(1 - u1) * cos(u2), z = sqrt(u1) * sin(u3);
+
+  m[0][0] = 1 - 2 * (y * y + z * z);
+  m[0][1] = 2 * (x * y - w * z);
+  m[0][2] = 2 * (x * z + w * y);
+  m[1][0] = 2 * (x * y + w * z);
+  m[1][1] = 1 - 2 * (x * x + z * z);
+  m[1][2] = 2 * (y * z - w * x);
+  m[2][0] = 2 * (x * z - w * y);
+  m[2][1] = 2 * (y * z + w * x);
+  m[2][2] = 1 - 2 * (x * x + y * y);
+}
+
+/**
+ * Rotates the atoms in [start, end) about the origin.
+ */
+static void rotateAtoms(Real** coords, int start, int end, Real m[3][3]) {
+  for (int j = start; j < end; j++) {
+    Real p[NUM_DIMENSIONS] = {coords[X_COORD][j], coords[Y_COORD][j],
+                              coords[Z_COORD][j]};
+    for (int k = 0; k < NUM_DIMENSIONS; k++) {
+      coords[k][j] = m[k][0] * p[0] + m[k][1] * p[1] + m[k][2] * p[2];
+    }
+  }
+}
+
+bool SimBoxBuilder::placeRandomly() {
+  Real** coords = sb->atomCoordinates;
+  int** molData = sb->moleculeData;
+  int numMolecules = sb->numMolecules;
+
+  centerMolecules();
+
+  // Orientations are drawn serially, so the packing only depends on the
+  // random seed, and then applied in parallel.
+  Real (*rotations)[3][3] = new Real[numMolecules][3][3];
+  for (int i = 0; i < numMolecules; i++) {
+    randomRotation(rotations[i]);
+  }
+
+  #pragma omp parallel for schedule(static)
+  for (int i = 0; i < numMolecules; i++) {
+    int start = molData[MOL_START][i];
+    rotateAtoms(coords, start, start + molData[MOL_LEN][i], rotations[i]);
+  }
+  delete[] rotations;
+
+  // Each molecule is given a random site of a simple cubic lattice, so the
+  // types of a mixture are spread evenly through the box, and is then
+  // displaced from it at random. The lattice keeps the box from jamming at
+  // liquid densities, where inserting molecules at arbitrary points fails.
+  int shape[NUM_DIMENSIONS];
+  latticeShape(sb->size, numMolecules, shape);
+  int numSites = shape[X_COORD] * shape[Y_COORD] * shape[Z_COORD];
+  std::vector<int> sites(numSites);
+  for (int s = 0; s < numSites; s++) {
+    sites[s] = s;
+  }
+  for (int s = numSites - 1; s > 0; s--) {
+    int other = (int) randomReal(0, s + 1);
+    if (other > s) {
+      other = s;
+    }
+    std::swap(sites[s], sites[other]);
+  }
+
+  Real spacing[NUM_DIMENSIONS];
+  for (int k = 0; k < NUM_DIMENSIONS; k++) {
+    spacing[k] = sb->size[k] / shape[k];
+  }
+
+  // Only molecules that cannot find room are placed with relaxed
+  // separations, so a crowded box still starts mostly overlap-free.
+  Real tightest = 1.0;
+  PackingGrid grid(sb->size, sb->atomData[ATOM_SIGMA], sb->numAtoms);
+
+  for (int i = 0; i < numMolecules; i++) {
+    int start = molData[MOL_START][i];
+    int end = start + molData[MOL_LEN][i];
+    int site[NUM_DIMENSIONS];
+    site[X_COORD] = sites[i] % shape[X_COORD];
+    site[Y_COORD] = (sites[i] / shape[X_COORD]) % shape[Y_COORD];
+    site[Z_COORD] = sites[i] / (shape[X_COORD] * shape[Y_COORD]);
+
+    Real center[NUM_DIMENSIONS];
+    Real relax = 1.0;
+    int attempts = 0;
+    bool clear = false;
+
+    while (!clear) {
+      if (attempts > 0) {
+        Real m[3][3];
+        randomRotation(m);
+        rotateAtoms(coords, start, end, m);
+      }
+      for (int k = 0; k < NUM_DIMENSIONS; k++) {
+        Real jitter = PACKING_JITTER * spacing[k];
+        center[k] = (site[k] + 0.5) * spacing[k] + randomReal(-jitter, jitter);
+      }
+      clear = true;
+      for (int j = start; j < end && clear; j++) {
+        Real point[NUM_DIMENSIONS];
+        for (int k = 0; k < NUM_DIMENSIONS; k++) {
+          point[k] = grid.wrap(coords[k][j] + center[k], k);
         }
+        clear = grid.isClear(j, point, relax);
+      }
+      if (!clear && ++attempts % PACKING_MAX_ATTEMPTS == 0) {
+        relax *= PACKING_RELAXATION;
       }
+      if (!clear && attempts == PACKING_GIVE_UP_ATTEMPTS) {
+        std::cerr << "Error: SimBoxBuilder::placeRandomly(): Could not place "
+                  << "molecule " << i << " of " << numMolecules << " after "
+                  << attempts << " attempts. The box is too dense to pack at "
+                  << "random; use a larger box or the 'simple-cubic' packing."
+                  << std::endl;
+        return false;
+      }
+    }
 
-      for (int j = 0; j < numOfAtoms; j++) {
-        sb->excludeAtoms[type][j][++excludeCount[j]] = -1;
-        sb->fudgeAtoms[type][j][++fudgeCount[j]] = -1;
+    for (int j = start; j < end; j++) {
+      Real point[NUM_DIMENSIONS];
+      for (int k = 0; k < NUM_DIMENSIONS; k++) {
+        coords[k][j] += center[k];
+        point[k] = grid.wrap(coords[k][j], k);
       }
+      grid.insert(j, point);
+    }
+    if (relax < tightest) {
+      tightest = relax;
+    }
+  }
 
-      delete[] excludeCount;
-      delete[] fudgeCount;
+  if (tightest < 1.0) {
+    std::cout << "Random packing relaxed the separation between some "
+              << "molecules to " << 100 * tightest << "%" << std::endl;
+  }
+  return true;
+}
+
+void SimBoxBuilder::keepMoleculesInBox() {
+  #pragma omp parallel for schedule(static)
+  for (int i = 0; i < sb->numMolecules; i++) {
+    int start = sb->moleculeData[MOL_START][i];
+    int end = start + sb->moleculeData[MOL_LEN][i];
+    int pIdx = sb->primaryIndexes[sb->moleculeData[MOL_PIDX_START][i]];
+
+    for (int k = 0; k < NUM_DIMENSIONS; k++) {
+      Real primary = sb->atomCoordinates[k][pIdx];
+      if (primary < 0) {
+        for (int j = start; j < end; j++) {
+          sb->atomCoordinates[k][j] += sb->size[k];
+        }
+      } else if (primary > sb->size[k]) {
+        for (int j = start; j < end; j++) {
+          sb->atomCoordinates[k][j] -= sb->size[k];
+        }
+      }
     }
   }
 }
 
+void SimBoxBuilder::resolveBondedParameters(Molecule& molecule,
+    std::vector<BondData>& bonds, std::vector<AngleData>& angles) {
+  // Intern each atom's type name once, then look parameters up by ID. Atom
+  // IDs are local to the template, so they index the type table directly.
+  std::vector<int> idToType(molecule.numOfAtoms);
+  for (int j = 0; j < molecule.numOfAtoms; j++) {
+    Atom& a = molecule.atoms[j];
+    idToType[a.id] = sbData->getTypeId(*a.name);
+  }
+
+  bonds.resize(molecule.numOfBonds);
+  for (int j = 0; j < molecule.numOfBonds; j++) {
+    Bond b = molecule.bonds[j];
+    bonds[j] = sbData->getBondData(idToType[b.atom1], idToType[b.atom2]);
+  }
+
+  angles.resize(molecule.numOfAngles);
+  for (int j = 0; j < molecule.numOfAngles; j++) {
+    Angle a = molecule.angles[j];
+    angles[j] = sbData->getAngleData(idToType[a.atom1], idToType[a.commonAtom],
+                                     idToType[a.atom2]);
+  }
+}
+
 void SimBoxBuilder::addPrimaryIndexes(std::vector< std::vector<int>* >* in) {
   int numPIdxes = 0;
   for (int i = 0; i < sb->numMolecules; i++) {
+    sb->moleculeData[MOL_PIDX_START][i] = numPIdxes;
     numPIdxes += in->at(sb->moleculeData[MOL_TYPE][i])->size();
   }
   sb->primaryIndexes = new int[numPIdxes];
   sb->numPIdxes = numPIdxes;
 
-  int idx = 0;
+  #pragma omp parallel for schedule(static)
   for (int i = 0; i < sb->numMolecules; i++) {
     vector<int>* v = in->at(sb->moleculeData[MOL_TYPE][i]);
-    sb->moleculeData[MOL_PIDX_START][i] = idx;
+    int pIdx = sb->moleculeData[MOL_PIDX_START][i];
     sb->moleculeData[MOL_PIDX_COUNT][i] = v->size();
     for (int j = 0; j < v->size(); j++) {
-      sb->primaryIndexes[idx++] = v->at(j) + sb->moleculeData[MOL_START][i];
+      sb->primaryIndexes[pIdx + j] = v->at(j) + sb->moleculeData[MOL_START][i];
     }
   }
 }
 
 void SimBoxBuilder::fillNLC() {
-  sb->neighbors = new NLC_Node*[27];
+  sb->neighbors = new int[27];
   sb->numCells = new int[NUM_DIMENSIONS];
   sb->cellWidth = new Real[NUM_DIMENSIONS];
-  sb->prevCell = new int[NUM_DIMENSIONS];
+  sb->numCellsXYZ = 1;
   for (int i = 0; i < NUM_DIMENSIONS; i++) {
     sb->numCells[i] = (int) (sb->size[i] / sb->cutoff);
     if (sb->numCells[i] == 0) {
       sb->numCells[i] = 1;
     }
     sb->cellWidth[i] = sb->size[i] / sb->numCells[i];
+    sb->numCellsXYZ *= sb->numCells[i];
   }
 
-  sb->neighborCells = new NLC_Node***[sb->numCells[0]];
-  for (int i = 0; i < sb->numCells[0]; i++) {
-    sb->neighborCells[i] = new NLC_Node**[sb->numCells[1]];
-    for (int j = 0; j < sb->numCells[1]; j++) {
-      sb->neighborCells[i][j] = new NLC_Node*[sb->numCells[2]];
-      for (int k = 0; k < sb->numCells[2]; k++) {
-        sb->neighborCells[i][j][k] = new NLC_Node();
-        sb->neighborCells[i][j][k]->index = -1;
-        sb->neighborCells[i][j][k]->next = NULL;
-      }
-    }
-  }
-  sb->nlc_heap = new NLC_Node[sb->numMolecules];
-  for (int i = 0; i < sb->numMolecules; i++) {
-    int pIdx = sb->primaryIndexes[sb->moleculeData[MOL_PIDX_START][i]];
-    int cloc[3];
-    for (int j = 0; j < NUM_DIMENSIONS; j++) {
-      cloc[j] = sb->getCell(sb->atomCoordinates[j][pIdx], j);
+  sb->cellStart = sb->cellCount = sb->cellMembers = sb->hashCells = NULL;
+  sb->cellKeys = sb->hashKeys = NULL;
+  sb->cellOf = new int[sb->numMolecules];
+  sb->cellSlot = new int[sb->numMolecules];
+
+  // A grid too large to index with an int can only be stored sparsely
+  sb->sparseNLC = spatialIndex != SpatialIndex::Dense ||
+                  sb->numCellsXYZ >= INT_MAX;
+  if (spatialIndex == SpatialIndex::Default && sb->numCellsXYZ < INT_MAX) {
+    // Count the occupied cells so only the chosen index is built
+    std::vector<long long> keys(sb->numMolecules);
+    for (int i = 0; i < sb->numMolecules; i++) {
+      keys[i] = sb->findCellKey(i);
     }
-    sb->nlc_heap[i].next = sb->neighborCells[cloc[0]][cloc[1]][cloc[2]];
-    sb->nlc_heap[i].index = i;
-    sb->neighborCells[cloc[0]][cloc[1]][cloc[2]] = &(sb->nlc_heap[i]);
+    std::sort(keys.begin(), keys.end());
+    long long occupied = std::unique(keys.begin(), keys.end()) - keys.begin();
+    sb->sparseNLC = 2 * occupied < sb->numCellsXYZ;
   }
+  sb->buildNLC();
 }
@@ -2,12 +2,62 @@
 #define SIMBOX_BUILDER_H
 
 #include "SimBox.h"
+#include "SimulationArgs.h"
 #include "Utilities/FileUtilities.h"
 
+/**
+ * In a random packing, atoms of two different molecules start at least
+ *     PACKING_SIGMA_FRACTION of their mean LJ sigma apart, and never closer
+ *     than PACKING_MIN_DISTANCE angstroms.
+ */
+#define PACKING_SIGMA_FRACTION 0.8
+#define PACKING_MIN_DISTANCE 2.0
+
+/**
+ * The number of random positions tried for a molecule before the separations
+ *     of a random packing are relaxed by PACKING_RELAXATION.
+ */
+#define PACKING_MAX_ATTEMPTS 100
+#define PACKING_RELAXATION 0.9
+
+/**
+ * The number of random positions tried for a molecule before a random
+ *     packing gives up on the box as too dense to pack. By then the
+ *     separations have been relaxed to about 12% of their starting values.
+ */
+#define PACKING_GIVE_UP_ATTEMPTS 2000
+
+/**
+ * How far a molecule in a random packing may be displaced from its lattice
+ *     site, as a fraction of the lattice spacing.
+ */
+#define PACKING_JITTER 0.25
+
 class SimBoxBuilder {
 
+public:
+
+  /**
+   * Wall-clock seconds spent in each phase of build().
+   */
+  struct BuildTimes {
+    /** Laying out and stamping the molecules' atoms, bonds and angles. */
+    double stamp;
+    /** Placing the molecules, when no coordinates were read in. */
+    double place;
+    /** Adding primary indexes and wrapping molecules into the box. */
+    double wrap;
+    /** Filling the neighbor linked cells. */
+    double nlc;
+  };
+
 private:
 
+  /**
+   * The time spent in each phase of the last build.
+   */
+  BuildTimes times;
+
   /**
    * sb holds the simulation box object that is being created by the builder
    *     instance.
@@ -20,6 +70,16 @@ private:
    */
   SBScanner* sbData;
 
+  /**
+   * How the molecules are placed when no coordinates were read in.
+   */
+  PackingType packing;
+
+  /**
+   * Whether the NLC stores every cell or only the occupied ones.
+   */
+  SpatialIndexType spatialIndex;
+
   /**
    * Initializes basic environment variables, such as the box's temperature,
    *     cutoff distance, and dimensions.
@@ -29,13 +89,73 @@ private:
   void initEnvironment(Environment* environment);
 
   /**
-   * Adds molecules from the box to the simulation box. Currently only handles
-   *     atoms, not bonds or angles.
+   * Fills the simulation box's atom, molecule, bond and angle arrays by
+   *     stamping out each molecule's template. The molecules are laid out
+   *     serially and then stamped in parallel. Coordinates read in by the box
+   *     are taken over; otherwise each molecule starts at its template's
+   *     z-matrix coordinates.
    *
-   * @param molecules A dynamic array containing all of the molecules in the box.
-   * @param numTypes The number of different types of molecules in the box.
+   * @param box The box holding the templates and the molecule layout.
    */
-  void addMolecules(Molecule* molecules, int numTypes);
+  void addMolecules(Box* box);
+
+  /**
+   * Builds the exclusion and fudge tables of a molecule type from its
+   *     template's bonds, angles and hops.
+   *
+   * @param pattern The template of the molecule type.
+   */
+  void addExclusions(Molecule& pattern);
+
+  /**
+   * Places the molecules on an FCC lattice that fills the box, starting from
+   *     the template coordinates written by addMolecules.
+   */
+  void placeOnLattice();
+
+  /**
+   * Places the molecules' centers on a simple cubic lattice that fills the
+   *     box. The box need not be cubic: each side gets a number of sites
+   *     proportional to its length.
+   */
+  void placeOnSimpleCubicLattice();
+
+  /**
+   * Places the molecules at random positions with random orientations so
+   *     that no two atoms of different molecules overlap (see
+   *     PACKING_SIGMA_FRACTION). Each molecule is displaced at random from a
+   *     randomly chosen lattice site, and checked for overlaps against a
+   *     grid of cells holding the atoms placed so far. If a molecule cannot
+   *     be placed, the separations it needs are relaxed.
+   *
+   * @return false if a molecule could not be placed within
+   *     PACKING_GIVE_UP_ATTEMPTS tries.
+   */
+  bool placeRandomly();
+
+  /**
+   * Moves each molecule so that the center of its atoms is at the origin.
+   */
+  void centerMolecules();
+
+  /**
+   * Wraps each molecule whose first primary index lies outside the box back
+   *     into the box.
+   */
+  void keepMoleculesInBox();
+
+  /**
+   * Looks up the force constants and equilibrium values of every bond and
+   *     angle in a molecule. Every molecule of a type shares these values, so
+   *     this only needs to be called for one molecule of each type.
+   *
+   * @param molecule The molecule whose bonds and angles are resolved.
+   * @param bonds Filled with the data for each of the molecule's bonds.
+   * @param angles Filled with the data for each of the molecule's angles.
+   */
+  void resolveBondedParameters(Molecule& molecule,
+                               std::vector<BondData>& bonds,
+                               std::vector<AngleData>& angles);
 
   /**
    * Adds primary indexes, read in from the config file, to every molecule in
@@ -47,7 +167,8 @@ private:
   void addPrimaryIndexes(std::vector< std::vector<int>* >* primaryAtomIndexArray);
 
   /**
-   * Initializes the NLC of the Simulation Box.
+   * Initializes the NLC of the Simulation Box, choosing the sparse index if
+   *     requested or if fewer than half of the cells are occupied.
    */
   void fillNLC();
 
@@ -59,18 +180,31 @@ public:
    * @param useNLC True if this Simulation run will use the NLC, false otherwise.
    * @param sbData Points to SBScanner, which retrieves information about bonds
    *     and angles from oplsaa.sb.
+   * @param packing How to place the molecules when the box does not hold
+   *     coordinates that were read in.
+   * @param spatialIndex Whether the NLC stores every cell or only the
+   *     occupied ones.
    */
-  SimBoxBuilder(bool useNLC, SBScanner* sbData);
+  SimBoxBuilder(bool useNLC, SBScanner* sbData,
+                PackingType packing = Packing::Default,
+                SpatialIndexType spatialIndex = SpatialIndex::Default);
 
   /**
    * Driver function for SimBoxBuilder. Constructs and returns a simulation box
    *     based on a box passed in.
    *
-   * @param box Points to a box containing every aspect of the Simulation, as
-   *     read in, to be converted into the simulation box.
+   * @param box Points to a box holding the environment, the molecule templates
+   *     and, optionally, coordinates that were read in. The box gives up its
+   *     coordinates to the simulation box.
+   * @return The simulation box, or NULL if its molecules could not be placed.
    */
   SimBox* build(Box* box);
 
+  /**
+   * Returns the time spent in each phase of the last call to build.
+   */
+  const BuildTimes& getBuildTimes();
+
 };
 
 #endif
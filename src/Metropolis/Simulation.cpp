@@ -6,6 +6,8 @@
 
 #include <string>
 #include <iostream>
+#include <algorithm>
+#include <math.h>
 #include <fstream>
 #include <time.h>
 #include <stdio.h>
@@ -20,9 +22,16 @@
 #include "SimulationStep.h"
 #include "BruteForceStep.h"
 #include "ProximityMatrixStep.h"
+#include "StrategyCalibrator.h"
+#include "KernelTuner.h"
+#include "MemoryFootprint.h"
 #include "Box.h"
+#include "Metropolis/Utilities/Json.h"
 #include "Metropolis/Utilities/MathLibrary.h"
 #include "Metropolis/Utilities/Parsing.h"
+#include "Metropolis/Utilities/PerfCounters.h"
+#include "Metropolis/Utilities/Timer.h"
+#include "Metropolis/Utilities/Tracer.h"
 #include "SerialSim/SerialBox.h"
 #include "SerialSim/SerialCalcs.h"
 #include "SerialSim/NeighborList.h"
@@ -33,12 +42,16 @@
 
 #define RESULTS_FILE_DEFAULT "run"
 #define RESULTS_FILE_EXT ".results"
+#define JSON_RESULTS_FILE_EXT ".results.json"
+#define METRICS_FILE_EXT ".metrics.jsonl"
 
 Simulation::Simulation(SimulationArgs simArgs) {
-  args = simArgs;
-  stepStart = 0;
+  init(simArgs);
 
+  double loadStart = wallClockSeconds();
   box = SerialCalcs::createBox(args, &stepStart, &simSteps);
+  loadTime = wallClockSeconds() - loadStart;
+  Tracer::record("Load Box", loadStart, loadStart + loadTime);
   if (box == NULL) {
     std::cerr << "Error: Unable to initialize simulation Box" << std::endl;
     exit(EXIT_FAILURE);
@@ -51,7 +64,47 @@ Simulation::Simulation(SimulationArgs simArgs) {
     simSteps = args.stepCount;
 }
 
+Simulation::Simulation(SimulationArgs simArgs, Box* simBox) {
+  init(simArgs);
+
+  box = simBox;
+  loadTime = 0;
+  simSteps = args.stepCount;
+  std::cout << "Using seed: " << box->environment->randomseed << std::endl;
+  seed(box->environment->randomseed);
+}
+
+void Simulation::init(SimulationArgs simArgs) {
+  args = simArgs;
+  stepStart = 0;
+  startupTime = loopTime = 0;
+  finalEnergy = 0;
+  acceptedMoves = 0;
+  writer = NULL;
+  metricsServer = NULL;
+  driftWarnings = driftResets = 0;
+
+  const char* phaseNames[NUM_STEP_PHASES] = {"Choose", "Old-Energy", "Move",
+      "New-Energy", "Accept-Rollback", "Update", "Output"};
+  for (int i = 0; i < NUM_STEP_PHASES; i++) {
+    stepPhases.push_back(PhaseTimer(phaseNames[i]));
+  }
+
+  if (!args.tracePath.empty()) {
+    Tracer::start(args.traceSampleInterval);
+    Tracer::nameThread("Simulation");
+  }
+}
+
 Simulation::~Simulation() {
+  if (metricsServer != NULL) {
+    delete metricsServer;
+    metricsServer = NULL;
+  }
+  if (writer != NULL) {
+    delete writer;
+    writer = NULL;
+  }
   if (box != NULL) {
     delete box;
     box = NULL;
@@ -62,14 +115,6 @@ void Simulation::run() {
   if (!args.simulationName.empty())
     std::cout << "Simulation Name: " << args.simulationName << std::endl;
 
-  for (int molIdx = 0; molIdx < box->environment->numOfMolecules; molIdx++) {
-    box->keepMoleculeInBox(molIdx);
-  }
-
-  if (args.useNeighborList) {
-    box->createNeighborList();
-  }
-
   Real oldEnergy_sb = 0;
   Real oldEnergy = 0, currentEnergy = 0;
   Real newEnergyCont = 0, oldEnergyCont = 0;
@@ -103,11 +148,10 @@ void Simulation::run() {
     std::cout << " starting from step " << stepStart;
   std::cout << std::endl;
 
-  clock_t startTime, endTime;
-  startTime = clock();
-
-  clock_t function_time_start, function_time_end;
-  function_time_start = clock();
+  // clock() adds up the CPU time of every thread, so it is only reported
+  // alongside the wall-clock run time
+  double runStart = wallClockSeconds();
+  clock_t cpuStart = clock();
 
   if(args.verboseOutput) {
     log = Logger(VERBOSE);
@@ -115,11 +159,106 @@ void Simulation::run() {
     log = Logger(NON_VERBOSE);
   }
 
+  // The hardware counters cover the system energy and the main loop. Building
+  // the SimBox starts the OpenMP threads, which only inherit the counters if
+  // they are opened first.
+  PerfCounters energyCounters, loopCounters;
+  bool usePerfCounters = false;
+  if (args.perfCounters) {
+    usePerfCounters = energyCounters.open() && loopCounters.open();
+    if (!usePerfCounters) {
+      perfCountersError = energyCounters.getError().empty() ?
+          loopCounters.getError() : energyCounters.getError();
+      fprintf(stdout, "Performance counters unavailable: %s\n",
+              perfCountersError.c_str());
+    }
+  }
+
   // Build SimBox below
-  SimBoxBuilder builder = SimBoxBuilder(args.useNeighborList, new SBScanner());
+  SimBoxBuilder builder = SimBoxBuilder(args.useNeighborList, new SBScanner(),
+                                        args.packing, args.spatialIndex);
   bool parallel = args.simulationMode == SimulationMode::Parallel;
+
+  // Warn about a run that may not fit. The estimate and MemAvailable are
+  // both approximate, and swap or freed caches may still make room.
+  MemoryFootprint needed = MemoryFootprint::estimate(box, args,
+      args.strategy == Strategy::ProximityMatrix ? Strategy::ProximityMatrix :
+                                                   Strategy::BruteForce);
+  double available = MemoryFootprint::availableMemory();
+  if (available > 0 && needed.hostPeak() > available) {
+    std::cerr << "Warning: Simulation::run(): The run needs about "
+              << MemoryFootprint::formatBytes(needed.hostPeak())
+              << " of memory but only "
+              << MemoryFootprint::formatBytes(available)
+              << " is available (" << needed.summary()
+              << "). Use --dry-run to compare the strategies." << std::endl;
+  }
+
+  double phaseStart = wallClockSeconds();
   SimBox* sb = builder.build(box);
+  double buildTime = wallClockSeconds() - phaseStart;
+  if (sb == NULL) {
+    std::cerr << "Error: Unable to build the simulation box" << std::endl;
+    exit(EXIT_FAILURE);
+  }
+  Tracer::record("Build SimBox", phaseStart, phaseStart + buildTime);
+  phaseStart = wallClockSeconds();
+  if (args.useNeighborList) {
+    box->createNeighborList(sb->atomCoordinates, sb->moleculeData,
+                            sb->primaryIndexes);
+  }
+  double neighborListTime = wallClockSeconds() - phaseStart;
+  if (args.useNeighborList)
+    Tracer::record("Neighbor List", phaseStart,
+                   phaseStart + neighborListTime);
+  writer = new OutputWriter(box, sb->numAtoms);
+  if (args.trajectoryInterval > 0) {
+    std::string trajName = getPdbOutputName(TRAJECTORY_EXT);
+    if (writer->openTrajectory(trajName, sb)) {
+      log.verbose("Writing trajectory to " + trajName);
+    } else {
+      args.trajectoryInterval = 0;
+    }
+  }
+  if (args.journalInterval > 0) {
+    std::string journalName = getPdbOutputName(JOURNAL_EXT);
+    if (writer->openJournal(journalName, sb)) {
+      log.verbose("Writing move journal to " + journalName);
+      writer->writeKeyframe(stepStart, sb);
+    } else {
+      args.journalInterval = 0;
+    }
+  }
+  if (args.jsonOutput) {
+    std::string metricsName = getResultsName(METRICS_FILE_EXT);
+    if (writer->openMetrics(metricsName))
+      log.verbose("Writing metrics stream to " + metricsName);
+  }
   GPUCopy::setParallel(parallel);
+  phaseStart = wallClockSeconds();
+  GPUCopy::copyIn(sb);
+  double copyTime = wallClockSeconds() - phaseStart;
+  Tracer::record("Copy In", phaseStart, phaseStart + copyTime);
+
+  // The tiled kernels give the same energies for every tuned configuration
+  if (args.autotune && !parallel) {
+    SimCalcs::kernel.tiled = true;
+  }
+
+  double calibrationTime = 0;
+  if (args.strategy == Strategy::Auto) {
+    phaseStart = wallClockSeconds();
+    StrategyCalibrator calibrator(sb, simSteps);
+    args.strategy = calibrator.calibrate();
+    calibrationTime = wallClockSeconds() - phaseStart;
+    Tracer::record("Strategy Calibration", phaseStart,
+                   phaseStart + calibrationTime);
+    strategyCalibration = calibrator.summary();
+    fprintf(stdout, "Auto-selected strategy: %s (%s)\n",
+            Strategy::toString(args.strategy).c_str(),
+            strategyCalibration.c_str());
+  }
+
   SimulationStep *simStep;
   if (args.strategy == Strategy::BruteForce) {
     log.verbose("Using brute force strategy for energy calculations");
@@ -132,7 +271,54 @@ void Simulation::run() {
                 "brute force");
     simStep = new BruteForceStep(sb);
   }
-  GPUCopy::copyIn(sb);
+  simStep->setUpdateTimer(&stepPhases[PHASE_UPDATE]);
+
+  memory = MemoryFootprint::measure(box, sb, args,
+      args.strategy == Strategy::ProximityMatrix ? Strategy::ProximityMatrix :
+                                                   Strategy::BruteForce);
+  fprintf(stdout, "Memory: %s\n", memory.summary().c_str());
+
+  if (!args.metricsEndpoint.empty()) {
+    std::vector<std::string> phaseNames;
+    for (int i = 0; i < stepPhases.size(); i++) {
+      phaseNames.push_back(stepPhases[i].getName());
+    }
+    metricsServer = new MetricsServer(args.simulationName,
+        Strategy::toString(args.strategy == Strategy::ProximityMatrix ?
+                           Strategy::ProximityMatrix : Strategy::BruteForce),
+        phaseNames);
+    if (metricsServer->start(args.metricsEndpoint)) {
+      log.verbose("Serving metrics on " + args.metricsEndpoint);
+    } else {
+      delete metricsServer;
+      metricsServer = NULL;
+    }
+  }
+
+  // On the CPU, brute force sums the neighbor cells' energies with its own
+  // loop, so there is nothing for the tuner to time
+  KernelTuner* tuner = NULL;
+  if (args.autotune && !parallel && args.useNeighborList &&
+      args.strategy != Strategy::ProximityMatrix) {
+    fprintf(stdout, "Kernel tuning: skipped, the neighbor cells do not use "
+            "the tuned kernels\n");
+  } else if (args.autotune) {
+    tuner = new KernelTuner(sb, args.strategy == Strategy::ProximityMatrix ?
+                            Strategy::ProximityMatrix : Strategy::BruteForce,
+                            parallel, args.tuningDbPath);
+    if (tuner->loadTuning()) {
+      fprintf(stdout, "Kernel tuning: %s\n", tuner->summary().c_str());
+    } else {
+      log.verbose("Tuning the energy kernels during the first steps");
+      tuner->start();
+    }
+  }
+  long long energyAtomPairs = 0, loopAtomPairs = 0;
+#ifdef PAIR_COUNTERS_ENABLED
+  long long atomPairsBefore = pairCounters.atomPairs;
+#endif
+
+  phaseStart = wallClockSeconds();
   // SimCalcs::setSB(sb);
   //Calculate original starting energy for the entire system
   if (oldEnergy == 0) {
@@ -150,18 +336,33 @@ void Simulation::run() {
         log.verbose("Using original system energy calculation");
       }
     }
+    energyCounters.start();
     oldEnergy_sb = simStep->calcSystemEnergy(lj_energy, charge_energy,
                                              sb->numMolecules);
+    energyCounters.stop();
     oldEnergy_sb += energy_LRC;
   }
-  function_time_end = clock();
+#ifdef PAIR_COUNTERS_ENABLED
+  energyAtomPairs = pairCounters.atomPairs - atomPairsBefore;
+#endif
+  Tracer::record("Initial Energy", phaseStart, wallClockSeconds());
+  double energyTime = copyTime + wallClockSeconds() - phaseStart;
+  printStartupTimes(builder.getBuildTimes(), buildTime, neighborListTime,
+                    calibrationTime, energyTime);
   GPUCopy::copyOut(sb);
-  double duration = difftime(function_time_end, function_time_start) / CLOCKS_PER_SEC;
 
-  //for testing/debug purposes
-  std::stringstream durationConv;
-  durationConv << "Duration of system energy calculation function: " << duration << " seconds.";
-  log.verbose(durationConv.str());
+  // The checks copy the coordinates on the host, which the GPU kernels don't
+  // keep up to date
+  EnergyMonitor* monitor = NULL;
+  if (args.driftInterval > 0 && parallel) {
+    fprintf(stdout, "Energy drift checks are only available on the CPU\n");
+  } else if (args.driftInterval > 0) {
+    monitor = new EnergyMonitor(sb, energy_LRC);
+    std::stringstream driftConv;
+    driftConv << "Checking the energy for drift every " << args.driftInterval
+              << " steps";
+    log.verbose(driftConv.str());
+  }
 
   std::stringstream simStepsConv;
   simStepsConv << "\nRunning " << (simSteps) << " steps\n";
@@ -174,40 +375,75 @@ void Simulation::run() {
     baseStateFile.append("untitled");
   }
 
+#ifdef PAIR_COUNTERS_ENABLED
+  // Only count the pairs of the run itself, not of the startup
+  pairCounters = statusCounters = PairCounters();
+#endif
+
   // ----- Main simulation loop -----
+  loopStartTime = lastStatusTime = wallClockSeconds();
+  loopCounters.start();
   for (int move = stepStart; move < (stepStart + simSteps); move++) {
     new_lj = 0, old_lj = 0, new_charge = 0, old_charge = 0;
+    Tracer::sampleMove(move);
+    TraceScope tracedStep("Step", Tracer::isMoveSampled());
 
     // Provide printouts at each predetermined interval
     if (args.statusInterval > 0 &&
         (move - stepStart) % args.statusInterval == 0) {
-      stringstream moveConv;
-      moveConv << "Step " << (move) << ":\n--Current Energy: "
-               << oldEnergy_sb << "\n";
-      log.verbose(moveConv.str());
+      ScopedPhase timed(&stepPhases[PHASE_OUTPUT]);
+      TraceScope traced("Status", Tracer::isEnabled());
+      reportStatus(move, oldEnergy_sb, accepted, rejected);
     }
 
     // Save the simulation state at predetermined intervals
     if (args.stateInterval > 0 && move > stepStart &&
         (move - stepStart) % args.stateInterval == 0) {
+      ScopedPhase timed(&stepPhases[PHASE_OUTPUT]);
+      TraceScope traced("Save State", Tracer::isEnabled());
       log.verbose("");
       saveState(baseStateFile, move, sb);
       log.verbose("");
     }
 
+    // Recompute the energy in the background at each drift check
+    if (monitor != NULL) {
+      DriftCheck check;
+      if (monitor->collect(check)) {
+        ScopedPhase timed(&stepPhases[PHASE_OUTPUT]);
+        reportDrift(check, oldEnergy_sb);
+      }
+      if (move > stepStart && (move - stepStart) % args.driftInterval == 0) {
+        ScopedPhase timed(&stepPhases[PHASE_OUTPUT]);
+        monitor->submit(move, oldEnergy_sb);
+      }
+    }
+
+    if (tuner != NULL && tuner->isTuning())
+      tuner->startMove();
+
     // Randomly select index of a molecule for changing
+    stepPhases[PHASE_CHOOSE].start();
     int changeIdx = simStep->chooseMolecule(sb);
+    stepPhases[PHASE_CHOOSE].stop();
 
     // Calculate the energy before translation
+    stepPhases[PHASE_OLD_ENERGY].start();
     oldEnergyCont = simStep->calcMolecularEnergyContribution(changeIdx, 0);
+    stepPhases[PHASE_OLD_ENERGY].stop();
 
     // Perturb the molecule
+    stepPhases[PHASE_MOVE].start();
     simStep->changeMolecule(changeIdx, sb);
+    stepPhases[PHASE_MOVE].stop();
 
     // Calculate the new energy after translation
+    stepPhases[PHASE_NEW_ENERGY].start();
     newEnergyCont = simStep->calcMolecularEnergyContribution(changeIdx, 0);
+    stepPhases[PHASE_NEW_ENERGY].stop();
 
     // Compare new energy and old energy to decide if we should accept or not
+    stepPhases[PHASE_DECIDE].start();
     bool accept = false;
 
     if (newEnergyCont < oldEnergyCont) {
@@ -229,14 +465,58 @@ void Simulation::run() {
       rejected++;
       simStep->rollback(changeIdx, sb);
     }
+    stepPhases[PHASE_DECIDE].stop();
+
+    if (accept && sb->useNLC) {
+      ScopedPhase timed(&stepPhases[PHASE_UPDATE]);
+      sb->updateNLC(changeIdx);
+    }
+
+    if (accept && (args.trajectoryInterval > 0 || args.journalInterval > 0)) {
+      ScopedPhase timed(&stepPhases[PHASE_OUTPUT]);
+      if (args.trajectoryInterval > 0 &&
+          accepted % args.trajectoryInterval == 0) {
+        writer->writeFrame(move + 1, sb);
+      }
+      if (args.journalInterval > 0) {
+        writer->recordMove(move + 1, changeIdx, sb);
+        if (accepted % args.journalInterval == 0)
+          writer->writeKeyframe(move + 1, sb);
+      }
+    }
+
+    if (tuner != NULL && tuner->isTuning())
+      tuner->endMove();
+  }
+  loopCounters.stop();
+  loopTime = wallClockSeconds() - loopStartTime;
+#ifdef PAIR_COUNTERS_ENABLED
+  loopAtomPairs = pairCounters.atomPairs;
+#endif
+
+  // Finish the check in progress, then check the final energy too
+  if (monitor != NULL) {
+    DriftCheck check;
+    if (monitor->wait(check))
+      reportDrift(check, oldEnergy_sb);
+    monitor->submit(stepStart + simSteps, oldEnergy_sb);
+    if (monitor->wait(check))
+      reportDrift(check, oldEnergy_sb);
   }
   delete(simStep);
-  endTime = clock();
-  writePDB(box->getEnvironment(), box->getMolecules(), sb);
+  if (tuner != NULL) {
+    tuner->finish();
+    kernelConfig = tuner->summary();
+    delete tuner;
+  }
+  writePDB(sb);
 
-  double diffTime = difftime(endTime, startTime) / CLOCKS_PER_SEC;
+  double diffTime = wallClockSeconds() - runStart;
+  double cpuTime = (double) (clock() - cpuStart) / CLOCKS_PER_SEC;
 
   currentEnergy = oldEnergy_sb;
+  finalEnergy = currentEnergy;
+  acceptedMoves = accepted;
   stringstream startConv;
   startConv << "Step " << (stepStart + simSteps) << ":\r\n--Current Energy: "
             << currentEnergy;
@@ -245,6 +525,32 @@ void Simulation::run() {
   if (args.stateInterval >= 0)
     saveState(baseStateFile, (stepStart + simSteps), sb);
 
+  // Close the journal with a keyframe so replay covers the whole run
+  if (args.journalInterval > 0)
+    writer->writeKeyframe(stepStart + simSteps, sb);
+
+  // The metrics stream always ends with the final step
+  if (args.jsonOutput) {
+    writer->writeMetrics(metricsRecord(stepStart + simSteps, currentEnergy,
+                                       accepted, rejected,
+                                       loopTime > 0 ? simSteps / loopTime : 0));
+  }
+
+  publishMetrics(stepStart + simSteps, currentEnergy, accepted, rejected,
+                 loopTime > 0 ? simSteps / loopTime : 0);
+
+  // Make sure all of the output is on disk before reporting the results
+  writer->flush();
+  if (writer->getDroppedMetrics() > 0) {
+    std::cerr << "Warning: Simulation::run(): The disk fell behind, so "
+              << writer->getDroppedMetrics() << " metrics records were dropped"
+              << std::endl;
+  }
+
+  // The writer thread is idle now, so every thread's events can be read
+  if (Tracer::isEnabled() && Tracer::write(args.tracePath))
+    log.verbose("Wrote trace to " + args.tracePath);
+
   fprintf(stdout, "\nFinished running %ld steps\n", simSteps);
 
   fprintf(stdout, "LJ-Energy Subtotal: %.3f\n", lj_energy);
@@ -254,19 +560,22 @@ void Simulation::run() {
   //fprintf(stdout, "Intramolecular Energy: %.3f\n", intraMolEnergy);
 
   fprintf(stdout, "Final Energy: %.3f\n", currentEnergy);
-  fprintf(stdout, "Run Time: %.3f seconds\n", diffTime);
+  fprintf(stdout, "Run Time: %.3f seconds (CPU time %.3f seconds)\n",
+          diffTime, cpuTime);
+  fprintf(stdout, "Throughput: %.1f steps/second\n",
+          loopTime > 0 ? simSteps / loopTime : 0);
   fprintf(stdout, "Accepted Moves: %d\n", accepted);
   fprintf(stdout, "Rejected Moves: %d\n", rejected);
   fprintf(stdout, "Acceptance Ratio: %.2f%%\n", 100.0 * accepted / (accepted + rejected));
+#ifdef PAIR_COUNTERS_ENABLED
+  fprintf(stdout, "Pair Counters: %s\n", pairCounters.summary().c_str());
+#endif
+  if (usePerfCounters) {
+    fprintf(stdout, "Performance Counters (main loop): %s\n",
+            loopCounters.summary().c_str());
+  }
 
-  std::string resultsName;
-
-  if (args.simulationName.empty())
-    resultsName = RESULTS_FILE_DEFAULT;
-  else
-    resultsName = args.simulationName;
-
-  resultsName.append(RESULTS_FILE_EXT);
+  std::string resultsName = getResultsName(RESULTS_FILE_EXT);
 
   // Save the simulation results.
   std::ofstream resultsFile;
@@ -287,6 +596,19 @@ void Simulation::run() {
   }
   resultsFile << std::endl;
 
+  resultsFile << "Strategy = ";
+  if (args.strategy == Strategy::ProximityMatrix) {
+    resultsFile << Strategy::toString(Strategy::ProximityMatrix);
+  } else {
+    resultsFile << Strategy::toString(Strategy::BruteForce);
+  }
+  resultsFile << std::endl;
+  if (!strategyCalibration.empty())
+    resultsFile << "Strategy-Calibration = " << strategyCalibration
+                << std::endl;
+  if (!kernelConfig.empty())
+    resultsFile << "Kernel-Config = " << kernelConfig << std::endl;
+
   resultsFile << "Starting-Step = " << stepStart << std::endl;
   resultsFile << "Steps = " << simSteps << std::endl;
   resultsFile << "Molecule-Count = " << box->environment->numOfMolecules << std::endl << std::endl;
@@ -296,16 +618,135 @@ void Simulation::run() {
   resultsFile << "Charge Energy Subtotal: " << charge_energy << std::endl;
 
   resultsFile << "Final-Energy = " << currentEnergy << std::endl;
+  resultsFile << "Startup-Time = " << startupTime << " seconds" << std::endl;
   resultsFile << "Run-Time = " << diffTime << " seconds" << std::endl;
+  resultsFile << "CPU-Time = " << cpuTime << " seconds" << std::endl;
+  resultsFile << "Steps-Per-Second = "
+              << (loopTime > 0 ? simSteps / loopTime : 0) << std::endl;
   resultsFile << "Accepted-Moves = " << accepted << std::endl;
   resultsFile << "Rejected-Moves = " << rejected << std::endl;
   resultsFile << "Acceptance-Rate = " << 100.0f * accepted / (float) (accepted + rejected) << "%" << std::endl;
 
+  resultsFile << std::endl << "[Memory]" << std::endl;
+  memory.write(resultsFile);
+
+  JsonObject drift;
+  if (monitor != NULL) {
+    resultsFile << std::endl << "[Energy Drift]" << std::endl;
+    resultsFile << "Check-Interval = " << args.driftInterval << std::endl;
+    resultsFile << "Checks = " << monitor->getChecks() << std::endl;
+    resultsFile << "Skipped-Checks = " << monitor->getSkipped() << std::endl;
+    resultsFile << "Max-Drift = " << monitor->getMaxDrift() << std::endl;
+    resultsFile << "Max-Relative-Drift = " << monitor->getMaxRelativeDrift()
+                << std::endl;
+    resultsFile << "Final-Drift = " << finalDrift.drift << std::endl;
+    resultsFile << "Final-Relative-Drift = " << finalDrift.relativeDrift
+                << std::endl;
+    resultsFile << "Threshold = " << args.driftThreshold << std::endl;
+    resultsFile << "Warnings = " << driftWarnings << std::endl;
+    resultsFile << "Resets = " << driftResets << std::endl;
+
+    drift.add("check_interval", args.driftInterval);
+    drift.add("checks", monitor->getChecks());
+    drift.add("skipped_checks", monitor->getSkipped());
+    drift.add("max_drift", monitor->getMaxDrift());
+    drift.add("max_relative_drift", monitor->getMaxRelativeDrift());
+    drift.add("final_drift", finalDrift.drift);
+    drift.add("final_relative_drift", finalDrift.relativeDrift);
+    drift.add("threshold", args.driftThreshold);
+    drift.add("warnings", driftWarnings);
+    drift.add("resets", driftResets);
+    delete monitor;
+  }
+
+  writePhaseTimes(resultsFile);
+  if (usePerfCounters) {
+    resultsFile << std::endl << "[Performance Counters]" << std::endl;
+    energyCounters.write(resultsFile, "System-Energy", 0, energyAtomPairs);
+    loopCounters.write(resultsFile, "Loop", simSteps, loopAtomPairs);
+  } else if (!perfCountersError.empty()) {
+    resultsFile << std::endl << "[Performance Counters]" << std::endl;
+    resultsFile << "Unavailable = " << perfCountersError << std::endl;
+  }
+#ifdef PAIR_COUNTERS_ENABLED
+  resultsFile << std::endl << "[Counters]" << std::endl;
+  pairCounters.write(resultsFile);
+#endif
+
   resultsFile.close();
+
+  // The run is over, so stop serving metrics and remove the socket
+  delete metricsServer;
+  metricsServer = NULL;
+
+  if (!args.jsonOutput)
+    return;
+
+  JsonObject information;
+  information.add("timestamp", currentDateTime());
+  information.add("simulation_name", args.simulationName);
+  information.add("simulation_mode", parallel ? "GPU" : "CPU");
+  information.add("strategy", Strategy::toString(
+      args.strategy == Strategy::ProximityMatrix ? Strategy::ProximityMatrix :
+                                                   Strategy::BruteForce));
+  if (!strategyCalibration.empty())
+    information.add("strategy_calibration", strategyCalibration);
+  if (!kernelConfig.empty())
+    information.add("kernel_config", kernelConfig);
+  information.add("starting_step", stepStart);
+  information.add("steps", simSteps);
+  information.add("molecule_count", box->environment->numOfMolecules);
+
+  JsonObject results;
+  results.add("energy_lrc", energy_LRC);
+  results.add("final_energy", currentEnergy);
+  results.add("startup_time", startupTime);
+  results.add("run_time", diffTime);
+  results.add("cpu_time", cpuTime);
+  results.add("steps_per_second", loopTime > 0 ? simSteps / loopTime : 0);
+  results.add("accepted_moves", accepted);
+  results.add("rejected_moves", rejected);
+  results.add("acceptance_rate", (double) accepted / (accepted + rejected));
+
+  JsonObject startup, steps, timing;
+  for (int i = 0; i < startupPhases.size(); i++)
+    startup.add(startupPhases[i].first, startupPhases[i].second);
+  for (int i = 0; i < stepPhases.size(); i++) {
+    if (stepPhases[i].getCount() > 0)
+      steps.add(stepPhases[i].getName(), stepPhases[i].toJson());
+  }
+  timing.add("startup", startup).add("steps", steps);
+
+  JsonObject document;
+  document.add("information", information);
+  document.add("results", results);
+  document.add("timing", timing);
+  document.add("memory", memory.toJson());
+  if (args.driftInterval > 0 && !parallel)
+    document.add("energy_drift", drift);
+  if (usePerfCounters) {
+    JsonObject perf;
+    perf.add("system_energy", energyCounters.toJson(0, energyAtomPairs));
+    perf.add("loop", loopCounters.toJson(simSteps, loopAtomPairs));
+    document.add("performance_counters", perf);
+  } else if (!perfCountersError.empty()) {
+    document.add("performance_counters",
+                 JsonObject().add("unavailable", perfCountersError));
+  }
+#ifdef PAIR_COUNTERS_ENABLED
+  document.add("counters", pairCounters.toJson());
+#endif
+
+  std::string jsonName = getResultsName(JSON_RESULTS_FILE_EXT);
+  std::ofstream jsonFile(jsonName.c_str());
+  jsonFile << document.str() << std::endl;
+  jsonFile.close();
+  if (!jsonFile)
+    std::cerr << "Error: Simulation::run(): Unable to write " << jsonName
+              << std::endl;
 }
 
 void Simulation::saveState(const std::string& baseFileName, int simStep, const SimBox* sb) {
-  StateScanner statescan = StateScanner("");
   std::string stateOutputPath;
   if (!args.stateOutputPath.empty()) {
     stateOutputPath = args.stateOutputPath + "/";
@@ -322,64 +763,217 @@ void Simulation::saveState(const std::string& baseFileName, int simStep, const S
 
   log.verbose("Saving state file " + stateOutputPath );
 
-  statescan.outputState(box->getEnvironment(), box->getMolecules(), box->getMoleculeCount(), simStep, stateOutputPath, sb->atomCoordinates);
+  writer->writeState(stateOutputPath, simStep, sb);
+}
+
+void Simulation::writePDB(const SimBox* sb) {
+  writer->writePDB(getPdbOutputName(".pdb"), sb);
 }
 
-int Simulation::writePDB(Environment sourceEnvironment, Molecule* sourceMoleculeCollection, SimBox* sb) {
-  std::string pdbName;
+std::string Simulation::getPdbOutputName(const std::string& extension) {
+  std::string name;
 
   if (!args.pdbOutputPath.empty()) {
-    pdbName = args.pdbOutputPath;
-    pdbName.append("/");
+    name = args.pdbOutputPath;
+    name.append("/");
   }
   if (!args.simulationName.empty()) {
-    pdbName.append(args.simulationName);
+    name.append(args.simulationName);
   } else {
-    pdbName.append(RESULTS_FILE_DEFAULT);
-  }
-
-  pdbName.append(".pdb");
-  std::ofstream pdbFile;
-  pdbFile.open(pdbName.c_str());
-
-  int numOfMolecules = sourceEnvironment.numOfMolecules;
-  pdbFile << "REMARK Created by MCGPU" << std::endl;
-  int atomIdx = 0;
-
-  Real** atomCoords = sb->atomCoordinates;
-
-  for (int i = 0; i < numOfMolecules; i++) {
-    Molecule currentMol = sourceMoleculeCollection[i];
-    for (int j = 0; j < currentMol.numOfAtoms; j++) {
-      Atom currentAtom = currentMol.atoms[j];
-      pdbFile.setf(std::ios_base::left,std::ios_base::adjustfield);
-      pdbFile.width(6);
-      pdbFile << "ATOM";
-      pdbFile.setf(std::ios_base::right,std::ios_base::adjustfield);
-      pdbFile.width(5);
-      pdbFile << currentAtom.id + 1;
-      pdbFile.width(3); // change from 5
-      pdbFile << *currentAtom.name;
-      pdbFile.width(6); // change from 4
-      pdbFile << "UNK";
-      pdbFile.width(6);
-      pdbFile << i + 1;
-      pdbFile.setf(std::ios_base::fixed, std::ios_base::floatfield);
-      pdbFile.precision(3);
-      pdbFile.width(12);
-      pdbFile << atomCoords[0][atomIdx];
-      pdbFile.width(8);
-      pdbFile << atomCoords[1][atomIdx];
-      pdbFile.width(8);
-      pdbFile << atomCoords[2][atomIdx] << std::endl;
-      atomIdx++;
+    name.append(RESULTS_FILE_DEFAULT);
+  }
+
+  name.append(extension);
+  return name;
+}
+
+void Simulation::dryRun() {
+  Environment* enviro = box->environment;
+  double numMolecules = enviro->numOfMolecules;
+  double numAtoms = 0, numBonds = 0, numAngles = 0;
+  for (int i = 0; i < enviro->numOfMolecules; i++) {
+    Molecule& m = box->getTemplate(i);
+    numAtoms += m.numOfAtoms;
+    numBonds += m.numOfBonds;
+    numAngles += m.numOfAngles;
+  }
+
+  // Molecules are in range if their primary indexes are within the cutoff
+  double volume = enviro->x * enviro->y * enviro->z;
+  double sphere = 4.0 / 3.0 * M_PI * pow(enviro->cutoff, 3);
+  double inRange = (numMolecules - 1) * std::min(1.0, sphere / volume);
+  double atomPairs = inRange * pow(numAtoms / numMolecules, 2);
+
+  fprintf(stdout, "\nDry run of %s\n", args.filePath.c_str());
+  fprintf(stdout, "Molecules: %.0f of %d type(s), rounded up to whole sets of "
+          "types\n", numMolecules, box->templateCount);
+  fprintf(stdout, "Atoms: %.0f, bonds: %.0f, angles: %.0f\n", numAtoms,
+          numBonds, numAngles);
+  fprintf(stdout, "Box: %.3f x %.3f x %.3f A, cutoff %.3f A, about %.1f "
+          "molecules in range of each\n", enviro->x, enviro->y, enviro->z,
+          enviro->cutoff, inRange);
+  fprintf(stdout, "Steps: %ld\n", simSteps);
+
+  // Each step finds the moved molecule's energy before and after the move
+  double available = MemoryFootprint::availableMemory();
+  SimulationStrategy strategies[] = {Strategy::BruteForce,
+                                     Strategy::ProximityMatrix};
+  for (int i = 0; i < 2; i++) {
+    MemoryFootprint memory = MemoryFootprint::estimate(box, args,
+                                                       strategies[i]);
+    fprintf(stdout, "\n%s:\n", Strategy::toString(strategies[i]).c_str());
+    fprintf(stdout, "  Memory: %s\n", memory.summary().c_str());
+    if (available > 0 && memory.hostPeak() > available)
+      fprintf(stdout, "  Does not fit in the %s of available memory\n",
+              MemoryFootprint::formatBytes(available).c_str());
+    if (strategies[i] == Strategy::ProximityMatrix) {
+      fprintf(stdout, "  Setup: %.0f range checks to build the matrix\n",
+              numMolecules * numMolecules);
+      fprintf(stdout, "  Per step: %.0f matrix reads, %.0f-%.0f range checks "
+              "to update it, about %.0f atom pairs\n", 2 * (numMolecules - 1),
+              numMolecules, 2 * numMolecules, 2 * atomPairs);
+    } else {
+      fprintf(stdout, "  Per step: %.0f range checks, about %.0f atom "
+              "pairs\n", 2 * (numMolecules - 1), 2 * atomPairs);
     }
-    pdbFile << "TER" << std::endl;
   }
-  pdbFile << "END" << std::endl;
-  pdbFile.close();
+  if (available > 0)
+    fprintf(stdout, "\nAvailable memory: %s\n",
+            MemoryFootprint::formatBytes(available).c_str());
+}
+
+void Simulation::printStartupTimes(const SimBoxBuilder::BuildTimes& build,
+                                   double buildTime, double neighborListTime,
+                                   double calibrationTime, double energyTime) {
+  startupTime = loadTime + buildTime + neighborListTime + calibrationTime +
+                energyTime;
+  startupPhases.clear();
+  startupPhases.push_back(std::make_pair("Load", loadTime));
+  startupPhases.push_back(std::make_pair("Build", buildTime));
+  if (args.useNeighborList)
+    startupPhases.push_back(std::make_pair("Neighbor-List", neighborListTime));
+  if (calibrationTime > 0)
+    startupPhases.push_back(std::make_pair("Calibration", calibrationTime));
+  startupPhases.push_back(std::make_pair("Initial-Energy", energyTime));
+
+  fprintf(stdout, "Startup Time: %.3f seconds\n", startupTime);
+  fprintf(stdout, "  Load Box: %.3f seconds\n", loadTime);
+  fprintf(stdout, "  Build SimBox: %.3f seconds (stamp %.3f, place %.3f, "
+          "wrap %.3f, NLC %.3f)\n", buildTime, build.stamp, build.place,
+          build.wrap, build.nlc);
+  if (args.useNeighborList)
+    fprintf(stdout, "  Neighbor List: %.3f seconds\n", neighborListTime);
+  if (calibrationTime > 0)
+    fprintf(stdout, "  Strategy Calibration: %.3f seconds\n", calibrationTime);
+  fprintf(stdout, "  Initial Energy: %.3f seconds\n", energyTime);
+}
+
+void Simulation::reportStatus(long move, Real energy, int accepted,
+                              int rejected) {
+  stringstream moveConv;
+  moveConv << "Step " << (move) << ":\n--Current Energy: " << energy << "\n";
+
+  double now = wallClockSeconds();
+  double rate = 0;
+  if (move > stepStart && now > lastStatusTime) {
+    rate = args.statusInterval / (now - lastStatusTime);
+    double remaining = (stepStart + simSteps - move) / rate;
+    char buffer[96];
+    snprintf(buffer, sizeof(buffer), "--Rate: %.1f steps/s, ETA %.1f s\n",
+             rate, remaining);
+    moveConv << buffer;
+#ifdef PAIR_COUNTERS_ENABLED
+    moveConv << "--Pairs: " << pairCounters.since(statusCounters).summary()
+             << "\n";
+#endif
+  }
+#ifdef PAIR_COUNTERS_ENABLED
+  statusCounters = pairCounters;
+#endif
+  lastStatusTime = now;
+  log.verbose(moveConv.str());
+
+  if (args.jsonOutput) {
+    writer->writeMetrics(metricsRecord(move, energy, accepted, rejected,
+                                       rate));
+  }
+  publishMetrics(move, energy, accepted, rejected, rate);
+}
+
+void Simulation::reportDrift(const DriftCheck& check, Real& energy) {
+  finalDrift = check;
+  fprintf(stdout, "Energy drift at step %ld: %.6e (%.3e relative, "
+          "recomputed %.6f)\n", check.step, check.drift, check.relativeDrift,
+          check.recomputed);
+  if (fabs(check.relativeDrift) > args.driftThreshold) {
+    driftWarnings++;
+    std::cerr << "Warning: The energy has drifted by " << check.relativeDrift
+              << " of its value at step " << check.step << ", over the "
+              << "threshold of " << args.driftThreshold << std::endl;
+  }
+
+  // The moves since the check only added changes, so the error carries over
+  if (args.driftReset) {
+    energy -= check.drift;
+    driftResets++;
+  }
+}
+
+void Simulation::publishMetrics(long move, Real energy, int accepted,
+                                int rejected, double stepsPerSecond) {
+  if (metricsServer == NULL)
+    return;
+
+  MetricsSnapshot snapshot;
+  snapshot.step = move;
+  snapshot.lastStep = stepStart + simSteps;
+  snapshot.energy = energy;
+  snapshot.accepted = accepted;
+  snapshot.rejected = rejected;
+  snapshot.stepsPerSecond = stepsPerSecond;
+  snapshot.elapsed = wallClockSeconds() - loopStartTime;
+  for (int i = 0; i < stepPhases.size() && i < METRICS_MAX_PHASES; i++) {
+    PhaseTimer& phase = stepPhases[i];
+    snapshot.phaseCount[i] = phase.getCount();
+    snapshot.phaseTotal[i] = phase.getTotal();
+    snapshot.phaseP50[i] = phase.getPercentile(0.5);
+    snapshot.phaseP90[i] = phase.getPercentile(0.9);
+    snapshot.phaseP99[i] = phase.getPercentile(0.99);
+  }
+  metricsServer->publish(snapshot);
+}
+
+std::string Simulation::metricsRecord(long step, Real energy, int accepted,
+                                      int rejected, double stepsPerSecond) {
+  JsonObject record;
+  record.add("step", step);
+  record.add("elapsed", wallClockSeconds() - loopStartTime);
+  record.add("energy", energy);
+  record.add("accepted", accepted);
+  record.add("rejected", rejected);
+  if (stepsPerSecond > 0)
+    record.add("steps_per_second", stepsPerSecond);
+  return record.str();
+}
+
+std::string Simulation::getResultsName(const std::string& extension) {
+  std::string name = args.simulationName.empty() ? RESULTS_FILE_DEFAULT :
+                                                   args.simulationName;
+  return name + extension;
+}
 
-  return 0;
+void Simulation::writePhaseTimes(std::ofstream& resultsFile) {
+  resultsFile << std::endl << "[Timing]" << std::endl;
+  for (int i = 0; i < startupPhases.size(); i++) {
+    resultsFile << "Startup-" << startupPhases[i].first << " = "
+                << startupPhases[i].second << " seconds" << std::endl;
+  }
+  for (int i = 0; i < stepPhases.size(); i++) {
+    if (stepPhases[i].getCount() > 0) {
+      resultsFile << "Step-" << stepPhases[i].getName() << " = "
+                  << stepPhases[i].summary() << std::endl;
+    }
+  }
 }
 
 const std::string Simulation::currentDateTime() {
@@ -8,27 +8,81 @@
 #ifndef SIMULATION_H
 #define SIMULATION_H
 
+#include <fstream>
+#include <string>
+#include <utility>
+#include <vector>
+
 #include "SimulationArgs.h"
 #include "Box.h"
 #include "Utilities/Logger.h"
 #include "SimBox.h"
+#include "SimBoxBuilder.h"
+#include "EnergyMonitor.h"
+#include "MemoryFootprint.h"
+#include "MetricsServer.h"
+#include "OutputWriter.h"
+#include "PairCounters.h"
+#include "Utilities/Timer.h"
 
 #define OUT_INTERVAL 100
 
 const double kBoltz = 0.00198717;
 
+/**
+ * The phases of each step, timed separately. Output is only timed on the steps
+ * that write something, and the proximity matrix update is also counted in the
+ * move and the rollback it belongs to.
+ */
+enum StepPhase {
+  PHASE_CHOOSE,
+  PHASE_OLD_ENERGY,
+  PHASE_MOVE,
+  PHASE_NEW_ENERGY,
+  PHASE_DECIDE,
+  PHASE_UPDATE,
+  PHASE_OUTPUT,
+  NUM_STEP_PHASES
+};
+
 class Simulation
 {
   public:
     /** Construct the Simulation with configuration arguments */
     Simulation(SimulationArgs simArgs);
 
+    /**
+     * Construct the Simulation around a box already in memory, such as a
+     * benchmark builds, instead of loading one from the input files. The
+     * Simulation takes ownership of the box and runs args.stepCount steps.
+     */
+    Simulation(SimulationArgs simArgs, Box* simBox);
+
     /** Destruct the simulation */
     ~Simulation();
 
     /** Execute the simulation */
     void run();
 
+    /**
+     * Reports the molecule and atom counts of the loaded box and, for each
+     * strategy, the memory the run would need and the work each step would
+     * do, without building the SimBox. For --dry-run.
+     */
+    void dryRun();
+
+    /** @return the energy at the end of the last run */
+    Real getFinalEnergy() {return finalEnergy;}
+
+    /** @return the moves accepted during the last run */
+    int getAcceptedMoves() {return acceptedMoves;}
+
+    /** @return the wall-clock seconds from the load to the first energy */
+    double getStartupTime() {return startupTime;}
+
+    /** @return the wall-clock seconds spent in the main loop of the last run */
+    double getLoopTime() {return loopTime;}
+
   private:
     /** The periodic box the simulation run in */
     Box *box;
@@ -45,11 +99,130 @@ class Simulation
     /** The object that logs simulation events */
     Logger log;
 
-    /** Writes the final state of the application to a PDB file */
-    int writePDB(Environment sourceEnvironment,
-                 Molecule *sourceMoleculeCollection, SimBox* sb);
+    /** Writes state and PDB files in the background during the run */
+    OutputWriter *writer;
+
+    /** Serves live metrics for --metrics-endpoint, or NULL */
+    MetricsServer *metricsServer;
+
+    /** Wall-clock seconds spent reading the input files into the box */
+    double loadTime;
+
+    /** Wall-clock seconds from reading the input to the first energy */
+    double startupTime;
+
+    /** Wall-clock seconds spent in the main loop */
+    double loopTime;
+
+    /** The energy and the accepted moves at the end of the run */
+    Real finalEnergy;
+    int acceptedMoves;
+
+    /** The strategy timings, if the strategy was picked automatically */
+    std::string strategyCalibration;
+
+    /** The energy kernels' launch parameters, if they were autotuned */
+    std::string kernelConfig;
+
+    /** The wall-clock times the main loop began and of the last status */
+    double loopStartTime, lastStatusTime;
+
+    /** The memory held by each subsystem of the run */
+    MemoryFootprint memory;
+
+    /** Why the hardware performance counters could not be opened */
+    std::string perfCountersError;
+
+    /** The name and wall-clock seconds of each phase of startup */
+    std::vector<std::pair<std::string, double> > startupPhases;
+
+    /** The timings of each phase of the steps, indexed by StepPhase */
+    std::vector<PhaseTimer> stepPhases;
+
+    /** The drift checks over the threshold, and the resets of the energy */
+    int driftWarnings, driftResets;
+
+    /** The last drift check of the run */
+    DriftCheck finalDrift;
+
+#ifdef PAIR_COUNTERS_ENABLED
+    /** The pair counters at the last status, to print the counts since */
+    PairCounters statusCounters;
+#endif
 
-    /** Saves the state of the simulation to a file */
+    /**
+     * Sets up the state shared by both constructors, before the box is
+     * loaded.
+     */
+    void init(SimulationArgs simArgs);
+
+    /**
+     * Prints how long each phase of startup took and totals it in
+     * startupTime.
+     */
+    void printStartupTimes(const SimBoxBuilder::BuildTimes& build,
+                           double buildTime, double neighborListTime,
+                           double calibrationTime, double energyTime);
+
+    /**
+     * Writes the startup and per-step phase timings to the results file, one
+     * line per phase.
+     */
+    void writePhaseTimes(std::ofstream& resultsFile);
+
+    /**
+     * Reports the progress of the run at a status interval. Prints the
+     * current energy, the steps per second since the last status and the
+     * estimated time left, with --json queues a record for the metrics
+     * stream, and updates the metrics served for --metrics-endpoint.
+     *
+     * @param move The step about to be taken.
+     * @param energy The current energy of the system.
+     * @param accepted The moves accepted so far.
+     * @param rejected The moves rejected so far.
+     */
+    void reportStatus(long move, Real energy, int accepted, int rejected);
+
+    /**
+     * Prints the result of a drift check, warns if the drift is over the
+     * threshold and, with --drift-reset, corrects the running total.
+     *
+     * @param check The result of the check.
+     * @param energy The running total energy, which has moved on since the
+     *     check's coordinates were copied.
+     */
+    void reportDrift(const DriftCheck& check, Real& energy);
+
+    /**
+     * Publishes the progress of the run and the step phase timings to the
+     * metrics server, if there is one.
+     */
+    void publishMetrics(long move, Real energy, int accepted, int rejected,
+                        double stepsPerSecond);
+
+    /**
+     * @return one record of the metrics stream, a JSON object on one line.
+     *     stepsPerSecond is left out if it is 0.
+     */
+    std::string metricsRecord(long step, Real energy, int accepted,
+                              int rejected, double stepsPerSecond);
+
+    /**
+     * Builds the path of an output file that sits alongside the results
+     * file, named after the simulation, with the given extension.
+     */
+    std::string getResultsName(const std::string& extension);
+
+    /** Queues the current coordinates to be written to a PDB file */
+    void writePDB(const SimBox* sb);
+
+    /**
+     * Builds the path of an output file that sits alongside the PDB output,
+     * named after the simulation, with the given extension.
+     */
+    std::string getPdbOutputName(const std::string& extension);
+
+    /** Queues the state of the simulation to be saved to a file */
     void saveState(const std::string& simName, int simStep, const SimBox* sb);
 
     /** The current date */
@@ -6,7 +6,44 @@ SimulationStrategy Strategy::fromString(std::string type) {
     return Strategy::BruteForce;
   } else if (type == "prox" || type == "proximity-matrix") {
     return Strategy::ProximityMatrix;
+  } else if (type == "auto") {
+    return Strategy::Auto;
   } else {
     return Strategy::Unknown;
   }
 }
+
+std::string Strategy::toString(SimulationStrategy type) {
+  switch (type) {
+    case Strategy::BruteForce:
+      return "brute-force";
+    case Strategy::ProximityMatrix:
+      return "proximity-matrix";
+    case Strategy::Auto:
+      return "auto";
+    default:
+      return "default";
+  }
+}
+
+PackingType Packing::fromString(std::string type) {
+  if (type == "fcc") {
+    return Packing::FCC;
+  } else if (type == "sc" || type == "simple-cubic") {
+    return Packing::SimpleCubic;
+  } else if (type == "random") {
+    return Packing::Random;
+  } else {
+    return Packing::Unknown;
+  }
+}
+
+SpatialIndexType SpatialIndex::fromString(std::string type) {
+  if (type == "dense") {
+    return SpatialIndex::Dense;
+  } else if (type == "sparse") {
+    return SpatialIndex::Sparse;
+  } else {
+    return SpatialIndex::Unknown;
+  }
+}
@@ -45,13 +45,57 @@ namespace Strategy {
     Default,
     BruteForce,
     ProximityMatrix,
+    Auto,
     Unknown
   };
 
   Type fromString(std::string type);
+
+  /** @return the name of a strategy, as accepted by fromString */
+  std::string toString(Type type);
 }
 typedef Strategy::Type SimulationStrategy;
 
+/** Enumeration for how the starting configuration is generated */
+namespace Packing {
+  /**
+   * Specifies how molecules are placed in the box when no coordinates are
+   * read in from a state file.
+   *
+   * @note Default places the molecules on an FCC lattice.
+   */
+  enum Type {
+    Default,
+    FCC,
+    SimpleCubic,
+    Random,
+    Unknown
+  };
+
+  Type fromString(std::string type);
+}
+typedef Packing::Type PackingType;
+
+/** Enumeration for how the neighbor cells index molecules */
+namespace SpatialIndex {
+  /**
+   * Specifies whether the neighbor cells store every cell of the grid (dense)
+   * or only the occupied cells (sparse).
+   *
+   * @note Default picks the sparse index when fewer than half of the cells
+   *     hold a molecule, as in slabs, droplets and elongated boxes.
+   */
+  enum Type {
+    Default,
+    Dense,
+    Sparse,
+    Unknown
+  };
+
+  Type fromString(std::string type);
+}
+typedef SpatialIndex::Type SpatialIndexType;
+
 /**
  * A list of commands and arguments that define the settings for the
  * simulation set by the user.
@@ -79,6 +123,58 @@ struct SimulationArgs {
   /** Determines the particular strategy used for energy calculations */
   SimulationStrategy strategy;
 
+  /** Determines how the starting configuration is generated */
+  PackingType packing;
+
+  /** Determines how the neighbor cells index molecules */
+  SpatialIndexType spatialIndex;
+
+  /** If true, tunes the energy kernels' launch parameters during the run */
+  bool autotune;
+
+  /** The tuning database, or empty for the default in the home directory */
+  std::string tuningDbPath;
+
+  /** If true, reads the hardware performance counters during the run */
+  bool perfCounters;
+
+  /**
+   * If true, writes the results as JSON too, along with a JSON-lines stream
+   * of metrics at each status interval
+   */
+  bool jsonOutput;
+
+  /**
+   * The localhost port or Unix-domain socket path to serve live metrics on,
+   * or empty for none
+   */
+  std::string metricsEndpoint;
+
+  /**
+   * If true, reports the counts, memory and per-step cost of the run for
+   * each strategy instead of running it
+   */
+  bool dryRun;
+
+  /**
+   * The number of simulation steps between recomputations of the full
+   * system energy to check the running total for drift. A value of 0 means
+   * no checks are made.
+   */
+  int driftInterval;
+
+  /** The relative drift above which a drift check prints a warning */
+  double driftThreshold;
+
+  /** If true, the running total is replaced after each drift check */
+  bool driftReset;
+
+  /** The Chrome trace file to write, or empty for no trace */
+  std::string tracePath;
+
+  /** The trace records the phases of every traceSampleInterval-th move */
+  int traceSampleInterval;
+
   /**
    * If executing in parallel, the index of the graphics card being
    * used to run the simulation. Set to DEVICE_ANY if running 
@@ -114,6 +210,18 @@ struct SimulationArgs {
    */
   int stateInterval;
 
+  /**
+   * The number of accepted moves between frames written to the binary
+   * trajectory. A value of 0 means no trajectory is written.
+   */
+  int trajectoryInterval;
+
+  /**
+   * The number of accepted moves between full keyframes in the move
+   * journal. A value of 0 means no journal is written.
+   */
+  int journalInterval;
+
   /** Path to directory for PDB output data */
   std::string pdbOutputPath;
 
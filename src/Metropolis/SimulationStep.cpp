@@ -8,6 +8,7 @@
 
 /** Construct a new SimulationStep from a SimBox pointer */
 SimulationStep::SimulationStep(SimBox *box) {
+  updateTimer = NULL;
   SimCalcs::setSB(box);
 }
 
@@ -46,6 +47,15 @@ Real SimulationStep::calcSystemEnergy(Real &subLJ, Real &subCharge,
 
 SimBox* SimCalcs::sb;
 int SimCalcs::on_gpu;
+KernelConfig SimCalcs::kernel = {false, 1, 1, 64};
+
+Real* SimCalcs::blockSums(int numBlocks) {
+  static std::vector<Real> sums;
+  if (sums.size() < numBlocks) {
+    sums.resize(numBlocks);
+  }
+  return &sums[0];
+}
 
 bool SimCalcs::moleculesInRange(int p1Start, int p1End, int p2Start,
                                        int p2End, Real** atomCoords,
@@ -10,12 +10,43 @@
 
 #include "SimBox.h"
 #include "Metropolis/Utilities/MathLibrary.h"
+#include "Metropolis/Utilities/Timer.h"
+
+/**
+ * The number of molecules summed into each partial energy by the tiled CPU
+ * kernels. It is fixed so the order of summation, and with it the energy,
+ * does not depend on the thread count or tile size.
+ */
+#define ENERGY_BLOCK 32
+
+/**
+ * Launch parameters for the energy kernels, picked by KernelTuner.
+ */
+struct KernelConfig {
+  /**
+   * True to use the tiled CPU kernels, which sum ENERGY_BLOCK molecules at a
+   * time and can run on several threads. False keeps the original serial
+   * loops.
+   */
+  bool tiled;
+
+  /** The number of OpenMP threads computing one molecule's energy */
+  int threads;
+
+  /** The number of blocks of ENERGY_BLOCK molecules handed to a thread */
+  int tileSize;
+
+  /** The OpenACC vector length of the energy loops on the GPU */
+  int vectorLength;
+};
 
 class SimulationStep {
  public:
   /** Construct a new SimulationStep object from a SimBox pointer */
   SimulationStep(SimBox *box);
 
+  virtual ~SimulationStep() {}
+
   /**
    * Returns the index of a random molecule within the simulation box.
    * @return A random integer from 0 to (numMolecules - 1)
@@ -60,6 +91,18 @@ class SimulationStep {
    * @return The total energy of the box.
    */
   virtual Real calcSystemEnergy(Real &subLJ, Real &subCharge, int numMolecules);
+
+  /**
+   * Sets the timer that records how long the strategy spends keeping its own
+   * structures, such as the proximity matrix, up to date with the moves.
+   *
+   * @param timer The timer, or NULL to stop timing.
+   */
+  void setUpdateTimer(PhaseTimer* timer) {updateTimer = timer;}
+
+ protected:
+  /** Times the strategy's updates to its structures, if not NULL */
+  PhaseTimer* updateTimer;
 };
 
 /**
@@ -72,6 +115,13 @@ class SimulationStep {
 namespace SimCalcs {
   extern SimBox* sb;
   extern int on_gpu;
+  extern KernelConfig kernel;
+
+  /**
+   * Returns a scratch array of at least the given number of partial sums,
+   * for the tiled CPU kernels.
+   */
+  Real* blockSums(int numBlocks);
 
   /**
    * Determines whether or not two molecule's primaryIndexes are within the
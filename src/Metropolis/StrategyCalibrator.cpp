@@ -0,0 +1,160 @@
+#ifdef _OPENACC
+#include <openacc.h>
+#endif
+
+#include "StrategyCalibrator.h"
+
+#include <stdio.h>
+#include <unistd.h>
+#include <algorithm>
+
+#include "BruteForceStep.h"
+#include "GPUCopy.h"
+#include "ProximityMatrixStep.h"
+#include "Utilities/MathLibrary.h"
+#include "Utilities/Timer.h"
+
+StrategyCalibrator::StrategyCalibrator(SimBox* sb_in, long numSteps_in) {
+  sb = sb_in;
+  numSteps = numSteps_in;
+}
+
+SimulationStrategy StrategyCalibrator::calibrate() {
+  long draws = randomDrawCount();
+  timings.clear();
+
+  Timing bruteForce;
+  bruteForce.strategy = Strategy::BruteForce;
+  bruteForce.feasible = true;
+  bruteForce.memory = bruteForce.setup = 0;
+  {
+    BruteForceStep step(sb);
+    timeMoves(&step, bruteForce);
+  }
+  timings.push_back(bruteForce);
+
+  Timing proximity;
+  proximity.strategy = Strategy::ProximityMatrix;
+  proximity.feasible = true;
+  proximity.memory = (double) sb->numMolecules * sb->numMolecules;
+  proximity.setup = proximity.perMove = proximity.projected = 0;
+  if (proximity.memory > PROXIMITY_MATRIX_MEMORY_FRACTION * freeMemory()) {
+    proximity.feasible = false;
+    char buffer[80];
+    snprintf(buffer, sizeof(buffer), "needs %.1f MB",
+             proximity.memory / (1024 * 1024));
+    proximity.skipReason = buffer;
+  } else if (!GPUCopy::onGpu() &&
+             estimateMatrixSetup() > bruteForce.projected) {
+    // The build alone would take longer than the whole brute force run
+    proximity.feasible = false;
+    proximity.skipReason = "building the matrix outlasts brute-force";
+  }
+  if (proximity.feasible) {
+    ProximityMatrixStep step(sb);
+    double start = wallClockSeconds();
+    step.buildProximityMatrix();
+    proximity.setup = wallClockSeconds() - start;
+    timeMoves(&step, proximity);
+  }
+  timings.push_back(proximity);
+
+  rewindRandom(draws);
+
+  SimulationStrategy best = Strategy::BruteForce;
+  double bestTime = bruteForce.projected;
+  for (int i = 0; i < timings.size(); i++) {
+    if (timings[i].feasible && timings[i].projected < bestTime) {
+      best = timings[i].strategy;
+      bestTime = timings[i].projected;
+    }
+  }
+  return best;
+}
+
+double StrategyCalibrator::estimateMatrixSetup() {
+  int numMolecules = sb->numMolecules;
+  int rows = std::min(numMolecules, PROXIMITY_MATRIX_SAMPLE_ROWS);
+  int inRange = 0;
+
+  double start = wallClockSeconds();
+  for (int r = 0; r < rows; r++) {
+    int i = (int) ((long) r * numMolecules / rows);
+    int p1Start = sb->moleculeData[MOL_PIDX_START][i];
+    int p1End = sb->moleculeData[MOL_PIDX_COUNT][i] + p1Start;
+    for (int j = 0; j < numMolecules; j++) {
+      int p2Start = sb->moleculeData[MOL_PIDX_START][j];
+      int p2End = sb->moleculeData[MOL_PIDX_COUNT][j] + p2Start;
+      inRange += SimCalcs::moleculesInRange(p1Start, p1End, p2Start, p2End,
+                                            sb->atomCoordinates, sb->size,
+                                            sb->primaryIndexes, sb->cutoff);
+    }
+  }
+  double elapsed = wallClockSeconds() - start;
+
+  // Keep the range checks from being optimized away
+  volatile int sink = inRange;
+  (void) sink;
+  return elapsed * numMolecules / rows;
+}
+
+void StrategyCalibrator::timeMoves(SimulationStep* step, Timing& timing) {
+  for (int i = 0; i < CALIBRATION_WARMUP_MOVES; i++) {
+    makeMove(step);
+  }
+  double start = wallClockSeconds();
+  for (int i = 0; i < CALIBRATION_MOVES; i++) {
+    makeMove(step);
+  }
+  timing.perMove = (wallClockSeconds() - start) / CALIBRATION_MOVES;
+  timing.projected = timing.setup + timing.perMove * numSteps;
+}
+
+void StrategyCalibrator::makeMove(SimulationStep* step) {
+  int molIdx = step->chooseMolecule(sb);
+  step->calcMolecularEnergyContribution(molIdx, 0);
+  step->changeMolecule(molIdx, sb);
+  step->calcMolecularEnergyContribution(molIdx, 0);
+  step->rollback(molIdx, sb);
+}
+
+std::string StrategyCalibrator::summary() {
+  std::string out;
+  char buffer[160];
+  for (int i = 0; i < timings.size(); i++) {
+    const Timing& t = timings[i];
+    std::string name = Strategy::toString(t.strategy);
+    if (!t.feasible) {
+      snprintf(buffer, sizeof(buffer), "%s skipped (%s)", name.c_str(),
+               t.skipReason.c_str());
+    } else if (t.setup > 0) {
+      snprintf(buffer, sizeof(buffer), "%s %.2f us/move + %.3f s setup "
+               "(projected %.3f s)", name.c_str(), t.perMove * 1e6, t.setup,
+               t.projected);
+    } else {
+      snprintf(buffer, sizeof(buffer), "%s %.2f us/move (projected %.3f s)",
+               name.c_str(), t.perMove * 1e6, t.projected);
+    }
+    if (!out.empty()) {
+      out.append("; ");
+    }
+    out.append(buffer);
+  }
+  return out;
+}
+
+double StrategyCalibrator::freeMemory() {
+#ifdef _OPENACC
+  // A parallel run keeps the matrix on the device
+  if (GPUCopy::onGpu()) {
+    int device = acc_get_device_num(acc_device_nvidia);
+    size_t bytes = acc_get_property(device, acc_device_nvidia,
+                                    acc_property_free_memory);
+    // Runtimes that can't report it return 0; fall back on the host's
+    if (bytes > 0) {
+      return (double) bytes;
+    }
+  }
+#endif
+  return (double) sysconf(_SC_AVPHYS_PAGES) * sysconf(_SC_PAGESIZE);
+}
@@ -0,0 +1,115 @@
+/**
+ * StrategyCalibrator.h
+ *
+ * Picks the energy calculation strategy for --strategy auto. Each strategy is
+ * timed on a few hundred moves of the loaded SimBox, and the strategy with the
+ * shortest projected run time is chosen. Which strategy is fastest depends on
+ * the number of molecules, the density and the cutoff, so it is measured
+ * rather than predicted.
+ */
+
+#ifndef METROPOLIS_STRATEGYCALIBRATOR_H
+#define METROPOLIS_STRATEGYCALIBRATOR_H
+
+#include <string>
+#include <vector>
+
+#include "SimBox.h"
+#include "SimulationArgs.h"
+#include "SimulationStep.h"
+
+/** The number of moves timed for each strategy */
+#define CALIBRATION_MOVES 300
+
+/** The number of untimed moves made first, to warm up the caches */
+#define CALIBRATION_WARMUP_MOVES 30
+
+/**
+ * The largest fraction of the free memory the proximity matrix may take up.
+ */
+#define PROXIMITY_MATRIX_MEMORY_FRACTION 0.5
+
+/**
+ * The number of rows of the proximity matrix timed to estimate how long the
+ * whole matrix takes to build.
+ */
+#define PROXIMITY_MATRIX_SAMPLE_ROWS 64
+
+class StrategyCalibrator {
+ public:
+  /** The measurements for one strategy */
+  struct Timing {
+    /** The strategy measured */
+    SimulationStrategy strategy;
+
+    /** False if the strategy was not timed */
+    bool feasible;
+
+    /** Why the strategy was not timed */
+    std::string skipReason;
+
+    /** Bytes the strategy needs beyond the SimBox */
+    double memory;
+
+    /** Wall-clock seconds spent setting up before the first move */
+    double setup;
+
+    /** Wall-clock seconds per move */
+    double perMove;
+
+    /** setup + perMove * the number of steps in the run */
+    double projected;
+  };
+
+  /**
+   * Constructs a calibrator for a box.
+   *
+   * @param sb The simulation box, already copied to the device if running in
+   *     parallel.
+   * @param numSteps The number of steps the run will take.
+   */
+  StrategyCalibrator(SimBox* sb, long numSteps);
+
+  /**
+   * Times every strategy on the box and returns the one with the shortest
+   * projected run time. Every move is rolled back and the random number
+   * sequence is rewound, so the run goes on exactly as if the chosen strategy
+   * had been named.
+   */
+  SimulationStrategy calibrate();
+
+  /** @return the measurements from the last call to calibrate() */
+  const std::vector<Timing>& getTimings() {return timings;}
+
+  /** @return the measurements on one line, for the log and results file */
+  std::string summary();
+
+ private:
+  SimBox* sb;
+  long numSteps;
+  std::vector<Timing> timings;
+
+  /**
+   * Times CALIBRATION_MOVES moves of a strategy, rolling each one back, and
+   * fills in the per-move and projected times.
+   */
+  void timeMoves(SimulationStep* step, Timing& timing);
+
+  /** Makes a move with a strategy and rolls it back */
+  void makeMove(SimulationStep* step);
+
+  /**
+   * Estimates how long building the proximity matrix takes on the CPU by
+   * timing the range checks for a sample of its rows.
+   */
+  double estimateMatrixSetup();
+
+  /**
+   * @return the bytes of memory currently free where the proximity matrix
+   *     would be kept: on the device in a parallel run, otherwise in the
+   *     host's physical memory.
+   */
+  static double freeMemory();
+};
+
+#endif
@@ -194,6 +194,18 @@ bool ConfigScanner::readInConfig(string configpath) {
       if (value.length() > 0) {
         strategy = value;
       }
+    } else if (key == "packing") {
+      if (value.length() > 0) {
+        packing = value;
+      }
+    } else if (key == "spatial-index") {
+      if (value.length() > 0) {
+        spatialIndex = value;
+      }
+    } else if (key == "coordinate-input") {
+      if (value.length() > 0) {
+        coordinatePath = value;
+      }
     } else {
       throwScanError("Unexpected key encountered: " + key);
       return false;
@@ -284,3 +296,15 @@ string ConfigScanner::getSimulationName() {
 string ConfigScanner::getStrategy() {
   return strategy;
 }
+
+string ConfigScanner::getPacking() {
+  return packing;
+}
+
+string ConfigScanner::getSpatialIndex() {
+  return spatialIndex;
+}
+
+string ConfigScanner::getCoordinatePath() {
+  return coordinatePath;
+}
@@ -0,0 +1,215 @@
+#include "FileUtilities.h"
+
+#include <stdio.h>
+#include <string.h>
+#include "Parsing.h"
+
+#define COORDINATE_BLOCK_SIZE (1 << 20)
+
+/** The columns of the x coordinate in a PDB ATOM or HETATM record. */
+#define PDB_X_COLUMN 30
+#define PDB_COORD_WIDTH 8
+
+/**
+ * Parses a number from a fixed-width field of a line.
+ *
+ * @return false if the field holds no number or anything after it.
+ */
+static bool parseField(const std::string& line, size_t start, size_t width,
+                       Real& value) {
+  if (line.length() < start + 1) {
+    return false;
+  }
+  char field[PDB_COORD_WIDTH + 1];
+  size_t length = line.copy(field, width, start);
+  field[length] = '\0';
+
+  char* end;
+  value = strtod(field, &end);
+  if (end == field) {
+    return false;
+  }
+  while (*end == ' ') {
+    end++;
+  }
+  return *end == '\0';
+}
+
+/**
+ * Reads the coordinates of a PDB record whose fields have shifted out of
+ * their standard columns, as happens once atom serial numbers pass 99999.
+ * The coordinates are the first three fields with a decimal point; the serial
+ * and residue numbers before them are integers.
+ *
+ * @return false if the record does not hold three such fields in a row.
+ */
+static bool parseShiftedPDB(const std::string& line, Real* point) {
+  const char* pos = line.c_str();
+  int found = 0;
+  while (found < NUM_DIMENSIONS) {
+    pos += strspn(pos, " \t");
+    if (*pos == '\0') {
+      return false;
+    }
+    size_t length = strcspn(pos, " \t");
+    char* end;
+    Real value = strtod(pos, &end);
+    bool isDecimal = end == pos + length && memchr(pos, '.', length) != NULL;
+    if (isDecimal) {
+      point[found++] = value;
+    } else if (found > 0) {
+      return false;
+    }
+    pos += length;
+  }
+  return true;
+}
+
+bool CoordinateScanner::readInCoordinates(string path, int numAtoms,
+                                          Real** atomCoords) {
+  std::string extension = getExtension(path);
+  if (extension != "pdb" && extension != "xyz") {
+    std::cerr << "Error: readInCoordinates(): " << path << " is not a .pdb "
+              << "or .xyz file" << std::endl;
+    return false;
+  }
+
+  file = fopen(path.c_str(), "rb");
+  if (file == NULL) {
+    std::cerr << "Error: readInCoordinates(): could not open file (" << path
+              << ")" << std::endl;
+    return false;
+  }
+  buffer.resize(COORDINATE_BLOCK_SIZE);
+  bufferLength = 0;
+  bufferPos = 0;
+  lineNumber = 0;
+
+  bool ok;
+  if (extension == "pdb") {
+    ok = readPDB(path, numAtoms, atomCoords);
+  } else {
+    ok = readXYZ(path, numAtoms, atomCoords);
+  }
+
+  fclose(file);
+  file = NULL;
+  std::vector<char>().swap(buffer);
+  return ok;
+}
+
+bool CoordinateScanner::nextLine() {
+  line.clear();
+  while (true) {
+    if (bufferPos == bufferLength) {
+      bufferLength = fread(&buffer[0], 1, buffer.size(), file);
+      bufferPos = 0;
+      if (bufferLength == 0) {
+        if (line.empty()) {
+          return false;
+        }
+        break;
+      }
+    }
+    char* start = &buffer[bufferPos];
+    char* newline = (char*) memchr(start, '\n', bufferLength - bufferPos);
+    if (newline == NULL) {
+      line.append(start, bufferLength - bufferPos);
+      bufferPos = bufferLength;
+    } else {
+      line.append(start, newline - start);
+      bufferPos += newline - start + 1;
+      break;
+    }
+  }
+
+  if (!line.empty() && line[line.length() - 1] == '\r') {
+    line.erase(line.length() - 1);
+  }
+  lineNumber++;
+  return true;
+}
+
+bool CoordinateScanner::readPDB(string path, int numAtoms, Real** atomCoords) {
+  int atomIdx = 0;
+  while (nextLine()) {
+    if (line.compare(0, 4, "ATOM") != 0 && line.compare(0, 6, "HETATM") != 0) {
+      if (line.compare(0, 6, "ENDMDL") == 0) {
+        break;
+      }
+      continue;
+    }
+    if (atomIdx == numAtoms) {
+      std::cerr << "Error: readInCoordinates(): " << path << " has more "
+                << "atoms than the box (" << numAtoms << ")" << std::endl;
+      return false;
+    }
+    Real point[NUM_DIMENSIONS];
+    bool ok = true;
+    for (int k = 0; k < NUM_DIMENSIONS && ok; k++) {
+      ok = parseField(line, PDB_X_COLUMN + k * PDB_COORD_WIDTH,
+                      PDB_COORD_WIDTH, point[k]);
+    }
+    if (!ok && !parseShiftedPDB(line, point)) {
+      std::cerr << "Error: readInCoordinates(): " << path << ":"
+                << lineNumber << ": could not read coordinates" << std::endl;
+      return false;
+    }
+    for (int k = 0; k < NUM_DIMENSIONS; k++) {
+      atomCoords[k][atomIdx] = point[k];
+    }
+    atomIdx++;
+  }
+
+  if (atomIdx != numAtoms) {
+    std::cerr << "Error: readInCoordinates(): " << path << " has " << atomIdx
+              << " atoms, but the box has " << numAtoms << std::endl;
+    return false;
+  }
+  return true;
+}
+
+bool CoordinateScanner::readXYZ(string path, int numAtoms, Real** atomCoords) {
+  long count = -1;
+  if (nextLine()) {
+    char* end;
+    count = strtol(line.c_str(), &end, 10);
+    if (end == line.c_str()) {
+      count = -1;
+    }
+  }
+  if (count < 0) {
+    std::cerr << "Error: readInCoordinates(): " << path << " does not "
+              << "start with an atom count" << std::endl;
+    return false;
+  } else if (count != numAtoms) {
+    std::cerr << "Error: readInCoordinates(): " << path << " has " << count
+              << " atoms, but the box has " << numAtoms << std::endl;
+    return false;
+  }
+
+  // The second line is a free-form comment
+  nextLine();
+
+  for (int atomIdx = 0; atomIdx < numAtoms; atomIdx++) {
+    bool ok = nextLine();
+    const char* pos = line.c_str();
+
+    // Skip the atom's name
+    pos += strspn(pos, " \t");
+    pos += strcspn(pos, " \t");
+
+    for (int k = 0; k < NUM_DIMENSIONS && ok; k++) {
+      char* end;
+      atomCoords[k][atomIdx] = strtod(pos, &end);
+      ok = end != pos;
+      pos = end;
+    }
+    if (!ok) {
+      std::cerr << "Error: readInCoordinates(): " << path << ":"
+                << lineNumber << ": could not read coordinates" << std::endl;
+      return false;
+    }
+  }
+  return true;
+}
@@ -53,6 +53,27 @@ bool loadBoxData(SimulationArgs& simArgs, Box* box, long* startStep,
       }
     }
 
+    if (!config_scanner.getPacking().empty() &&
+        simArgs.packing == Packing::Default) {
+      simArgs.packing = Packing::fromString(config_scanner.getPacking());
+      if (simArgs.packing == Packing::Unknown) {
+        std::cerr << "Error: Unknown initial packing specified in config file"
+                  << std::endl;
+        return false;
+      }
+    }
+
+    if (!config_scanner.getSpatialIndex().empty() &&
+        simArgs.spatialIndex == SpatialIndex::Default) {
+      simArgs.spatialIndex =
+          SpatialIndex::fromString(config_scanner.getSpatialIndex());
+      if (simArgs.spatialIndex == SpatialIndex::Unknown) {
+        std::cerr << "Error: Unknown spatial index specified in config file"
+                  << std::endl;
+        return false;
+      }
+    }
+
     // Getting bond and angle data from oplsaa.sb file.
     sb_scanner = SBScanner();
     std::string sb_path = config_scanner.getOplsusaparPath();
@@ -82,6 +103,9 @@ bool loadBoxData(SimulationArgs& simArgs, Box* box, long* startStep,
       return false;
     }
 
+    box->parserBytes = sb_scanner.getTableBytes() +
+                       opls_scanner.getTableBytes();
+
     // Initialize moleculeVector, environment and steps.
     moleculeVector = zmatrix_scanner.buildMolecule(0);
     enviro = config_scanner.getEnviro();
@@ -108,6 +132,26 @@ bool loadBoxData(SimulationArgs& simArgs, Box* box, long* startStep,
       return false;
     }
 
+    // The run uses the counts after rounding up to whole sets of templates
+    box->environment->numOfMolecules = box->moleculeCount;
+    box->environment->numOfAtoms = box->atomCount;
+
+    // Start from coordinates that were saved earlier, rather than a lattice.
+    if (!config_scanner.getCoordinatePath().empty()) {
+      box->atomCoordinates = new Real*[NUM_DIMENSIONS];
+      for (int i = 0; i < NUM_DIMENSIONS; i++) {
+        box->atomCoordinates[i] = new Real[box->atomCount];
+      }
+      CoordinateScanner coordinate_scanner = CoordinateScanner();
+      if (!coordinate_scanner.readInCoordinates(
+              config_scanner.getCoordinatePath(), box->atomCount,
+              box->atomCoordinates)) {
+        std::cerr << "Error: loadBoxData(): Could not read starting "
+                  << "coordinates" << std::endl;
+        return false;
+      }
+    }
+
     return true;
   }
 
@@ -164,115 +208,141 @@ bool loadBoxData(SimulationArgs& simArgs, Box* box, long* startStep,
 }
 
 
-bool fillBoxData(Environment* enviro, vector<Molecule>& molecVec, Box* box,
-                 SBScanner& sb_scanner) {
-  // If the vector of molecules has no contents, print an error and return
-  if (!enviro || !box || molecVec.size() < 1) {
-    std::cerr << "Error: fillBoxData(): Could not fill molecule data."
-              << std::endl;
-    return false;
-  }
-
+/**
+ * Copies template molecules into the box's template arrays and converts their
+ * atom IDs to IDs local to each molecule.
+ */
+static void storeTemplates(vector<Molecule>& templates, Box* box) {
   // Holds the running number of atoms, bonds, angles, dihedrals, and hops.
   int count[5];
-  memset(count,0,sizeof(count));  // Instantiate count.
-
-  // Instantiate the box's relevant variables.
-  box->moleculeCount = 0;
-  box->atomCount = 0;
-  box->bondCount = 0;
-  box->angleCount = 0;
-  box->dihedralCount = 0;
-  box->hopCount = 0;
+  memset(count, 0, sizeof(count));
 
-  // For every molecule in the vector, increment the box's count for each
-  // sub-value accordingly.
-  for (int i = 0; i < molecVec.size(); ++i) {
-    Molecule mol = molecVec[i];
-    box->moleculeCount += 1;
-    box->atomCount += mol.numOfAtoms;
-    box->bondCount += mol.numOfBonds;
-    box->angleCount += mol.numOfAngles;
-    box->dihedralCount += mol.numOfDihedrals;
-    box->hopCount += mol.numOfHops;
+  for (int j = 0; j < templates.size(); j++) {
+    count[0] += templates[j].numOfAtoms;
+    count[1] += templates[j].numOfBonds;
+    count[2] += templates[j].numOfAngles;
+    count[3] += templates[j].numOfDihedrals;
+    count[4] += templates[j].numOfHops;
   }
 
-  // Allocate space for the box's various structures.
-  box->molecules = (Molecule *) malloc(sizeof(Molecule) * box->moleculeCount);
-  box->atoms     = (Atom *) malloc(sizeof(Atom) * box->atomCount);
-  box->bonds     = (Bond *) malloc(sizeof(Bond) *  box->bondCount);
-  box->angles    = (Angle *) malloc(sizeof(Angle) * box->angleCount);
-  box->dihedrals = (Dihedral *) malloc(sizeof(Dihedral) * box->dihedralCount);
-  box->hops      = (Hop *) malloc(sizeof(Hop) * box->hopCount);
-
-  // Clear the space allocated for the box's structures.
-  // Why do we not clear box->molecules?
-  memset(box->atoms, 0, sizeof(Atom) * box->atomCount);
-  memset(box->bonds, 0, sizeof(Bond) * box->bondCount);
-  memset(box->angles, 0, sizeof(Angle) * box->angleCount);
-  memset(box->dihedrals, 0, sizeof(Dihedral) * box->dihedralCount);
-  memset(box->hops, 0, sizeof(Hop) * box->hopCount);
-
-  std::vector<Bond> bondVector; // bondVector will hold a list of bonds.
-  // These will be used to get the common atom in every angle.
-
-  //Copy data from vector to molecule
-  for (int j = 0; j < molecVec.size(); j++) {
-    Molecule molec1 = molecVec[j];
+  // Allocate space for the box's template structures.
+  box->templateCount = templates.size();
+  box->templates = (Molecule *) malloc(sizeof(Molecule) * box->templateCount);
+  box->atoms     = (Atom *) malloc(sizeof(Atom) * count[0]);
+  box->bonds     = (Bond *) malloc(sizeof(Bond) * count[1]);
+  box->angles    = (Angle *) malloc(sizeof(Angle) * count[2]);
+  box->dihedrals = (Dihedral *) malloc(sizeof(Dihedral) * count[3]);
+  box->hops      = (Hop *) malloc(sizeof(Hop) * count[4]);
+
+  memset(count, 0, sizeof(count));
+
+  for (int j = 0; j < templates.size(); j++) {
+    Molecule molec1 = templates[j];
+    Molecule& dest = box->templates[j];
 
     // Point to memory allocated to atoms, bonds, etc in the box with the
-    // atoms, bonds, etc. arrays in each molecule.
-    box->molecules[j].atoms = (Atom *) (box->atoms + count[0]);
-    box->molecules[j].bonds = (Bond *) (box->bonds + count[1]);
-    box->molecules[j].angles = (Angle *) (box->angles + count[2]);
-    box->molecules[j].dihedrals = (Dihedral *) (box->dihedrals + count[3]);
-    box->molecules[j].hops = (Hop *) (box->hops + count[4]);
-
-    // Copy over constants from each element in the molecule vector.
-    box->molecules[j].id = molec1.id;
-    box->molecules[j].type = molec1.type;
-    box->molecules[j].numOfAtoms = molec1.numOfAtoms;
-    box->molecules[j].numOfBonds = molec1.numOfBonds;
-    box->molecules[j].numOfDihedrals = molec1.numOfDihedrals;
-    box->molecules[j].numOfAngles = molec1.numOfAngles;
-    box->molecules[j].numOfHops = molec1.numOfHops;
-
-    // Increment the offset to point data to.
+    // atoms, bonds, etc. arrays in each template.
+    dest = molec1;
+    dest.atoms = box->atoms + count[0];
+    dest.bonds = box->bonds + count[1];
+    dest.angles = box->angles + count[2];
+    dest.dihedrals = box->dihedrals + count[3];
+    dest.hops = box->hops + count[4];
+
     count[0] += molec1.numOfAtoms;
     count[1] += molec1.numOfBonds;
     count[2] += molec1.numOfAngles;
     count[3] += molec1.numOfDihedrals;
     count[4] += molec1.numOfHops;
 
-    // Copy over atoms from the molecule vector.
     for (int k = 0; k < molec1.numOfAtoms; k++) {
-      box->molecules[j].atoms[k] = molec1.atoms[k];
+      dest.atoms[k] = molec1.atoms[k];
     }
-
-    // Copy over bonds from the molecule vector.
     for (int k = 0; k < molec1.numOfBonds; k++) {
-      box->molecules[j].bonds[k] = molec1.bonds[k];
-
-      // Add the bond to bondVector
-      bondVector.push_back(molec1.bonds[k]);
+      dest.bonds[k] = molec1.bonds[k];
     }
-
-    // Copy over angles from the molecule vector.
     for (int k = 0; k < molec1.numOfAngles; k++) {
-      box->molecules[j].angles[k] = molec1.angles[k];
+      dest.angles[k] = molec1.angles[k];
+    }
+    for (int k = 0; k < molec1.numOfDihedrals; k++) {
+      dest.dihedrals[k] = molec1.dihedrals[k];
+    }
+    for (int k = 0; k < molec1.numOfHops; k++) {
+      dest.hops[k] = molec1.hops[k];
     }
 
-    // Copy over dihedrals from the molecule vector.
-    for(int k = 0; k < molec1.numOfDihedrals; k++) {
-      box->molecules[j].dihedrals[k] = molec1.dihedrals[k];
+    if (molec1.numOfAtoms > 0) {
+      Box::localizeIds(dest, molec1.atoms[0].id);
     }
+  }
+}
+
+bool fillBoxData(Environment* enviro, vector<Molecule>& molecVec, Box* box,
+                 SBScanner& sb_scanner) {
+  // If the vector of molecules has no contents, print an error and return
+  if (!enviro || !box || molecVec.size() < 1) {
+    std::cerr << "Error: fillBoxData(): Could not fill molecule data."
+              << std::endl;
+    return false;
+  }
+
+  // The first molecule of each type becomes the template for that type.
+  vector<Molecule> templates;
+  std::map<int, int> typeToTemplate;
 
-    // Copy over hops from the molecule vector.
-    for(int k = 0; k < molec1.numOfHops; k++) {
-      box->molecules[j].hops[k] = molec1.hops[k];
+  box->moleculeCount = molecVec.size();
+  box->atomCount = 0;
+  box->moleculeTemplates = (int *) malloc(sizeof(int) * box->moleculeCount);
+  box->moleculeIds = (int *) malloc(sizeof(int) * box->moleculeCount);
+
+  for (int i = 0; i < molecVec.size(); ++i) {
+    Molecule& mol = molecVec[i];
+    std::map<int, int>::iterator it = typeToTemplate.find(mol.type);
+    if (it == typeToTemplate.end()) {
+      it = typeToTemplate.insert(std::make_pair(mol.type,
+                                                (int) templates.size())).first;
+      templates.push_back(mol);
+    }
+
+    Molecule& pattern = templates[it->second];
+    if (mol.numOfAtoms != pattern.numOfAtoms) {
+      std::cerr << "Error: fillBoxData(): Molecule " << mol.id << " has "
+                << mol.numOfAtoms << " atoms, but other molecules of type "
+                << mol.type << " have " << pattern.numOfAtoms << std::endl;
+      return false;
     }
 
-  } // Repeat for every molecule in the vector.
+    box->moleculeTemplates[i] = it->second;
+    box->moleculeIds[i] = mol.id;
+    box->atomCount += mol.numOfAtoms;
+  }
+
+  storeTemplates(templates, box);
+
+  // Only the coordinates of each molecule are kept; everything else is shared
+  // with its template.
+  box->atomCoordinates = new Real*[3];
+  for (int i = 0; i < 3; i++) {
+    box->atomCoordinates[i] = new Real[box->atomCount];
+  }
+
+  int atomIdx = 0;
+  for (int i = 0; i < molecVec.size(); ++i) {
+    Molecule& mol = molecVec[i];
+    for (int k = 0; k < mol.numOfAtoms; k++) {
+      box->atomCoordinates[0][atomIdx] = mol.atoms[k].x;
+      box->atomCoordinates[1][atomIdx] = mol.atoms[k].y;
+      box->atomCoordinates[2][atomIdx] = mol.atoms[k].z;
+      atomIdx++;
+    }
+
+    free(mol.atoms);
+    free(mol.bonds);
+    free(mol.angles);
+    free(mol.dihedrals);
+    free(mol.hops);
+  }
+  molecVec.clear();
 
   enviro->numOfAtoms = box->atomCount;
   return true;
@@ -280,11 +350,6 @@ bool fillBoxData(Environment* enviro, vector<Molecule>& molecVec, Box* box,
 
 bool buildBoxData(Environment* enviro, vector<Molecule>& molecVec, Box* box,
                   SBScanner& sb_scanner) {
-
-  // Convert molecule vectors into an array
-  //int moleculeIndex = 0;
-  //int atomCount = 0;
-
   // If the vector of molecules has no contents, print an error and return.
   if (!enviro || !box || molecVec.size() < 1) {
     std::cerr << "Error: buildBoxData(): Could not load molecule data."
@@ -298,9 +363,7 @@ bool buildBoxData(Environment* enviro, vector<Molecule>& molecVec, Box* box,
     enviro->numOfMolecules += molecVec.size() - molecMod;
   }
 
-  // Allocate memory for the molecues in the box.
   box->moleculeCount = enviro->numOfMolecules;
-  box->molecules = (Molecule *) malloc(sizeof(Molecule) * box->moleculeCount);
 
   // If there aren't any molecules, return an error.
   if(box->moleculeCount < 1 || molecVec.size() < 1) {
@@ -310,315 +373,41 @@ bool buildBoxData(Environment* enviro, vector<Molecule>& molecVec, Box* box,
     return false;
   }
 
-
   int molecDiv = enviro->numOfMolecules / molecVec.size();
   int molecTypeNum = molecVec.size();
 
-  // Holds the running number of atoms, bonds, angles, dihedrals, and hops.
-  int count[5];
-  memset(count,0,sizeof(count)); // Instantiate count.
-
-  // Allocate memory for tables.
-  Table* tables = new Table[molecVec.size()];
-  int currentAtomCount = 0;
-
-  //Copy data from vector to molecule
-  for (int j = 0; j < molecVec.size(); j++) {
-    Molecule molec1 = molecVec[j];
-
-    // Count the number of atoms, bonds, etc.
-    count[0] += molec1.numOfAtoms;
-    count[1] += molec1.numOfBonds;
-    count[2] += molec1.numOfAngles;
-    count[3] += molec1.numOfDihedrals;
-    count[4] += molec1.numOfHops;
-
-    // Begin copying hops.
-    Hop *myHop = molec1.hops;
-    int **table;
-
-    // Allocate memory to tables.
-    table = new int*[molec1.numOfAtoms];
-    for(int k = 0; k < molec1.numOfAtoms;k++) {
-      table[k] = new int[molec1.numOfAtoms];
-    }
-
-    // Instantiate table to 0.
-    for(int test = 0; test< molec1.numOfAtoms;test++) {
-      for(int test1 = 0; test1 < molec1.numOfAtoms; test1++) {
-          table[test][test1] = 0;
-      }
-    }
-
-    // Fill table with hops.
-    for(int k2 = 0; k2<molec1.numOfHops;k2++) {
-      int atom1 = myHop->atom1;
-      int atom2 = myHop->atom2;
-      table[atom1-currentAtomCount][atom2-currentAtomCount] = myHop->hop;
-      table[atom2-currentAtomCount][atom1-currentAtomCount] = myHop->hop;
-      myHop++;
-    }
-
-    // Put the table in tables.
-    tables[j] = Table(table);
-    // Increase the number atoms in the molecule.
-    currentAtomCount += molec1.numOfAtoms;
-  }
-
-  // Fill box variables.
-  box->atomCount = molecDiv * count[0];
-  box->bondCount = molecDiv * count[1];
-  box->angleCount = molecDiv * count[2];
-  box->dihedralCount = molecDiv * count[3];
-  box->hopCount = molecDiv * count[4];
-
-  // Allocate memory to box.
-  box->atoms     = (Atom *) malloc(sizeof(Atom) * box->atomCount);
-  box->bonds     = (Bond *) malloc(sizeof(Bond) * box->bondCount);
-  box->angles    = (Angle *) malloc(sizeof(Angle) * box->angleCount);
-  box->dihedrals = (Dihedral *) malloc(sizeof(Dihedral) * box->dihedralCount);
-  box->hops      = (Hop *) malloc(sizeof(Hop) * box->hopCount);
-
-  // Clear memory in the box.
-  memset(box->atoms, 0, sizeof(Atom) * box->atomCount);
-  memset(box->bonds, 0, sizeof(Bond) * box->bondCount);
-  memset(box->angles, 0, sizeof(Angle) * box->angleCount);
-  memset(box->dihedrals, 0, sizeof(Dihedral) * box->dihedralCount);
-  memset(box->hops, 0, sizeof(Hop) * box->hopCount);
-
-  //Clear count.
-  memset(count, 0, sizeof(count));
-
-  std::vector<Bond> bondVector; // bondVector will hold a list of bonds.
-  // These will be used to get the common atom in every angle.
-
-  //Copy data from vector to molecule.
-  for(int j = 0; j < molecVec.size(); j++) {
-
-    Molecule molec1 = molecVec[j]; // Get the molecule from the molecule vector.
-
-    // Point to memory allocated to atoms, bonds, etc in the box with the
-    // atoms, bonds, etc. arrays in each molecule.
-    box->molecules[j].atoms = (Atom *) (box->atoms + count[0]);
-    box->molecules[j].bonds = (Bond *) (box->bonds + count[1]);
-    box->molecules[j].angles = (Angle *) (box->angles + count[2]);
-    box->molecules[j].dihedrals = (Dihedral *) (box->dihedrals + count[3]);
-    box->molecules[j].hops = (Hop *) (box->hops + count[4]);
-
-    // Copy over molecule values from the molecule in the vector.
-    box->molecules[j].id = molec1.id;
-    box->molecules[j].type = molec1.type;
-    box->molecules[j].numOfAtoms = molec1.numOfAtoms;
-    box->molecules[j].numOfBonds = molec1.numOfBonds;
-    box->molecules[j].numOfDihedrals = molec1.numOfDihedrals;
-    box->molecules[j].numOfAngles = molec1.numOfAngles;
-    box->molecules[j].numOfHops = molec1.numOfHops;
-
-    // Increment the count of atoms, bonds, etc.
-    // This will set the offset for the next pointer assignment.
-    count[0] += molec1.numOfAtoms;
-    count[1] += molec1.numOfBonds;
-    count[2] += molec1.numOfAngles;
-    count[3] += molec1.numOfDihedrals;
-    count[4] += molec1.numOfHops;
-
-    // Copy atoms from the molecule vector.
-    for (int k = 0; k < molec1.numOfAtoms; k++) {
-      box->molecules[j].atoms[k] = molec1.atoms[k];
-    }
-
-    // Copy bonds from the molecule vector.
+  // Find the common atom of every angle before the IDs are made local.
+  std::vector<Bond> bondVector;
+  int atomsPerSet = 0;
+  for (int j = 0; j < molecTypeNum; j++) {
+    Molecule& molec1 = molecVec[j];
+    atomsPerSet += molec1.numOfAtoms;
     for (int k = 0; k < molec1.numOfBonds; k++) {
-      box->molecules[j].bonds[k] = molec1.bonds[k];
-
-      // Add the bond to bondVector
       bondVector.push_back(molec1.bonds[k]);
     }
-
-    // Copy angles from the molecule vector.
     for (int k = 0; k < molec1.numOfAngles; k++) {
-      box->molecules[j].angles[k] = molec1.angles[k];
-      int a1Idx = molec1.angles[k].atom1;
-      int a2Idx = molec1.angles[k].atom2;
-      box->molecules[j].angles[k].commonAtom = getCommonAtom(bondVector,
-                                                             a1Idx, a2Idx);
-    }
-
-
-    // Copy dihedrals from the molecule vector.
-    for (int k = 0; k < molec1.numOfDihedrals; k++) {
-      box->molecules[j].dihedrals[k] = molec1.dihedrals[k];
-    }
-
-    // Copy hops from the molecule vector.
-    for (int k = 0; k < molec1.numOfHops; k++) {
-      box->molecules[j].hops[k] = molec1.hops[k];
-    }
-
-  } // Repeat for every molecule in the molecule vector.
-
-  // Repeat for each copy of every molecule in the vector.
-  for (int m = 1; m < molecDiv; m++) {
-    // Copy the molecule into the corresponding spot in the box.
-    int offset = m * molecTypeNum;
-    memcpy(&(box->molecules[offset]), box->molecules,
-           sizeof(Molecule) * molecTypeNum);
-
-    // Copy atoms, bonds, etc. for each molecule.
-    for (int n = 0; n < molecTypeNum; n++) {
-      box->molecules[offset+n].id=offset+n;
-      box->molecules[offset+n].atoms = box->molecules[n].atoms + count[0] * m;
-      box->molecules[offset+n].bonds = box->molecules[n].bonds + count[1] * m;
-      box->molecules[offset+n].angles = box->molecules[n].angles 
-        + count[2] * m;
-      box->molecules[offset+n].dihedrals = box->molecules[n].dihedrals
-        + count[3] * m;
-      box->molecules[offset+n].hops =  box->molecules[n].hops + count[4] * m;
-    }
-
-    memcpy(&(box->atoms[m * count[0]]), box->atoms, sizeof(Atom) * count[0]);
-    memcpy(&(box->bonds[m * count[1]]), box->bonds, sizeof(Bond) * count[1]);
-    memcpy(&(box->angles[m * count[2]]),
-           box->angles, sizeof(Angle) * count[2]);
-    memcpy(&(box->dihedrals[m * count[3]]), box->dihedrals,
-           sizeof(Dihedral) * count[3]);
-    memcpy(&(box->hops[m * count[4]]), box->hops, sizeof(Hop) * count[4]);
-
-    // Copy atoms for each molecule.
-    for (int k = 0; k < count[0]; k++)  {
-      box->atoms[m * count[0] + k].id = m * count[0] + k;
+      molec1.angles[k].commonAtom = getCommonAtom(bondVector,
+                                                  molec1.angles[k].atom1,
+                                                  molec1.angles[k].atom2);
     }
-
-    // Copy bonds for each molecule.
-    for (int k = 0; k < count[1]; k++) {
-      box->bonds[m * count[1] + k].atom1 += m * count[0];
-      box->bonds[m * count[1] + k].atom2 += m * count[0];
-    }
-
-    // Copy angles for each molecule.
-    for(int k = 0; k < count[2]; k++) {
-      box->angles[m * count[2] + k].atom1 += m * count[0];
-      box->angles[m * count[2] + k].atom2 += m * count[0];
-      box->angles[m * count[2] + k].commonAtom += m * count[0];
-    }
-
-    // Copy dihedrals for each molecule.
-    for(int k = 0; k < count[3]; k++) {
-      box->dihedrals[m * count[3] + k].atom1 += m * count[0];
-      box->dihedrals[m * count[3] + k].atom2 += m * count[0];
-    }
-
-    // Copy hops for each molecule.
-    for(int k = 0; k < count[4]; k++) {
-      box->hops[m * count[4] + k].atom1 += m * count[0];
-      box->hops[m * count[4] + k].atom2 += m * count[0];
-    }
-
-  } // Repeat for every molecule.
-
-  enviro->numOfAtoms = count[0] * molecDiv;
-
-  //generate fcc lattice box
-  if (!generatefccBox(box)) {
-    std::cerr << "Error: buildBoxData(): Could not generate FCC box"
-              << std::endl;
-    return false;
-  }
-
-  return true;
-}
-
-bool generatefccBox(Box* box) {
-  // Return an error if the box is missing an environment or molecules.
-  if (box->environment == NULL || box->molecules == NULL) {
-    std::cerr << "Error: generatefccBox(): Box environment or molecules "
-                 "array NULL" << std::endl;
-    return false;
   }
 
-  Real cells, dcells, cellL, halfcellL;
-  Environment* enviro = box->environment;
-  Molecule* molecules = box->molecules;
-
-  // Determine the number of unit cells in each coordinate direction
-  dcells = pow(0.25 * (Real) enviro->numOfMolecules, 1.0/3.0);
-  cells = (int)(dcells + 0.5);
+  storeTemplates(molecVec, box);
 
-  // Check if numOfMolecules is a non-fcc number of molecules and increase
-  // the number of cells if necessary
-  while((4 * cells * cells * cells) < enviro->numOfMolecules) {
-    cells++;
+  // The box repeats the set of templates, in order, molecDiv times. The first
+  // set keeps the IDs from the z-matrix.
+  box->moleculeTemplates = (int *) malloc(sizeof(int) * box->moleculeCount);
+  box->moleculeIds = (int *) malloc(sizeof(int) * box->moleculeCount);
+  for (int i = 0; i < box->moleculeCount; i++) {
+    box->moleculeTemplates[i] = i % molecTypeNum;
+    box->moleculeIds[i] = i < molecTypeNum ? molecVec[i].id : i;
   }
 
-  //Determine length of unit cell
-  cellL = enviro->x / (Real) cells;
-  halfcellL = 0.5 * cellL;
-
-  //Construct the unit cell
-  for (int j = 0; j < molecules[0].numOfAtoms; j++) {
-    molecules[0].atoms[j].x += 0.0;
-    molecules[0].atoms[j].y += 0.0;
-    molecules[0].atoms[j].z += 0.0;
-  }
-
-  for (int j = 0; j < molecules[1].numOfAtoms; j++) {
-    molecules[1].atoms[j].x += halfcellL;
-    molecules[1].atoms[j].y += halfcellL;
-    molecules[1].atoms[j].z += 0.0;
-  }
-
-  for (int j = 0; j < molecules[2].numOfAtoms; j++) {
-    molecules[2].atoms[j].x += 0.0;
-    molecules[2].atoms[j].y += halfcellL;
-    molecules[2].atoms[j].z += halfcellL;
-  }
-
-  for (int j = 0; j < molecules[3].numOfAtoms; j++) {
-    molecules[3].atoms[j].x += halfcellL;
-    molecules[3].atoms[j].y += 0.0;
-    molecules[3].atoms[j].z += halfcellL;
-  }
-
-  // Init all other molecules to initial coordinates
-  // Build the lattice from the unit cell by repeatedly translating
-  // the four vectors of the unit cell through a distance cellL in
-  // the x, y, and z directions
-  for(int i = 4; i < enviro->numOfMolecules; i++) {
-    for (int j = 0; j < molecules[i].numOfAtoms; j++) {
-      molecules[i].atoms[j].x += 0.0;
-      molecules[i].atoms[j].y += 0.0;
-      molecules[i].atoms[j].z += 0.0;
-    }
-  }
-
-  int offset = 0;
-  for (int z = 1; z <= cells; z++) {
-    for (int y = 1; y <= cells; y++) {
-      for (int x = 1; x <= cells; x++) {
-        for (int a = 0; a < 4; a++) {
-          int i = a + offset;
-          if (i < enviro->numOfMolecules) {
-            for (int j = 0; j < molecules[i].numOfAtoms; j++) {
-              molecules[i].atoms[j].x = molecules[a].atoms[j].x + cellL * (x-1);
-              molecules[i].atoms[j].y = molecules[a].atoms[j].y + cellL * (y-1);
-              molecules[i].atoms[j].z = molecules[a].atoms[j].z + cellL * (z-1);
-            }
-          }
-        }
-        offset += 4;
-      }
-    }
-  }
-
-  //Shift center of box to the origin
-  for (int i = 0; i < enviro->numOfMolecules; i++) {
-    for (int j = 0; j < molecules[i].numOfAtoms; j++) {
-      molecules[i].atoms[j].x -= halfcellL;
-      molecules[i].atoms[j].y -= halfcellL;
-      molecules[i].atoms[j].z -= halfcellL;
-    }
-  }
+  box->atomCount = atomsPerSet * molecDiv;
+  enviro->numOfAtoms = box->atomCount;
 
+  // Coordinates are generated on a lattice by SimBoxBuilder.
+  box->atomCoordinates = NULL;
   return true;
 }
 
@@ -7,6 +7,8 @@
 #include <string>
 #include <map>
 #include <sstream>
+#include <unordered_map>
+#include <stdint.h>
 #include "Metropolis/SimulationArgs.h"
 #include "StructLibrary.h"
 #include "MathLibrary.h"
@@ -22,33 +24,64 @@
 #define TRIMMED_CHARS " \n\r\t"
 #define COMMENT_DELIM ';'
 
+/**
+ * @return the approximate bytes held by an unordered_map: its buckets, plus
+ *     a heap node for each entry holding the entry, a next pointer and the
+ *     cached hash. Heap data of long string keys is not counted.
+ */
+template <typename Map>
+size_t mapBytes(const Map& map) {
+  return map.bucket_count() * sizeof(void*) +
+         map.size() * (sizeof(typename Map::value_type) + 2 * sizeof(void*));
+}
+
 class SBScanner {
  private:
   /**
-   * Double map from one atom to another atom to data about the bond between
-   * the two atoms.
+   * Maps each atom type name in the OPLSAA.sb file to a dense integer ID,
+   * assigned in the order the names are first seen.
    */
-  map<string, map<string, BondData> > bondDataMap;
+  unordered_map<string, int> typeIds;
 
   /**
-   * Triple map from one atom to another atom to a third atom about the angle
-   * formed by those three atoms.
+   * Flat table of bond data indexed by id1 * numTypes + id2. Entries with no
+   * bond between the two types hold -1 for both values. Built once the whole
+   * file has been read.
    */
-  map<string, map<string, map<string, AngleData> > > angleDataMap;
+  vector<BondData> bondTable;
+
+  /** Bonds read from the file, keyed by bondKey, until bondTable is built */
+  unordered_map<unsigned long long, BondData> bondEntries;
+
+  /** Angle data keyed by angleKey. */
+  unordered_map<unsigned long long, AngleData> angleTable;
+
+  /** Returns the ID of an atom type name, assigning a new one if needed. */
+  int internType(const string& name);
+
+  /** Combines two type IDs into a key for bondEntries. */
+  static unsigned long long bondKey(int atom1, int atom2);
+
+  /** Combines three type IDs into a key for angleTable. */
+  static unsigned long long angleKey(int endpoint1, int middleAtom,
+                                     int endpoint2);
+
+  /** Fills bondTable from bondEntries once every type is known. */
+  void buildBondTable();
 
   /** Contains the path to the oplsaa.sb file. */
   string fileName;
 
   /**
    * Given a line of input that specifies the data pertaining to a bond,
-   * stores the data in the bondDataMap.
+   * stores the data in bondEntries.
    * @param line A line of data from the OPLSAA.sb file.
    */
   void processBond(string line);
 
   /**
    * Given a line of input that specifies the data pertaining to an angle,
-   * stores the data in the angleDataMap.
+   * stores the data in angleTable.
    * @param line A line of data from the OPLSAA.sb file.
    */
   void processAngle(string line);
@@ -59,6 +92,17 @@ class SBScanner {
    */
   void processLine(string line);
 
+  /**
+   * Loads the tables from a parameter cache written by saveCache.
+   * @param cachePath The path of the cache file.
+   * @param sourceHash The content hash of the oplsaa.sb file.
+   * @return False if the cache is missing, stale, or unreadable.
+   */
+  bool loadCache(const string& cachePath, uint64_t sourceHash);
+
+  /** Writes the tables to a parameter cache, ignoring any failure. */
+  void saveCache(const string& cachePath, uint64_t sourceHash);
+
  public:
   /** Constructor for SBScanner */
   SBScanner();
@@ -67,7 +111,9 @@ class SBScanner {
   ~SBScanner();
 
   /**
-   * Reads in OPLS.sb and stores the bond and angle data.
+   * Reads in OPLS.sb and stores the bond and angle data. The parsed data
+   * is cached next to the file, and the cache is used instead of parsing
+   * while the file is unchanged.
    * @param fileName The path and name of the file to read from.
    * @return - success code
    *       0: successful
@@ -75,6 +121,28 @@ class SBScanner {
    */
   bool readInSB(string filename);
 
+  /**
+   * Returns the interned ID of an atom type name.
+   * @param name The atom type name, as it appears in the OPLSAA.sb file.
+   * @return The ID of the type, or -1 if the file doesn't mention it.
+   */
+  int getTypeId(const string& name);
+
+  /**
+   * Given the type IDs of a pair of atoms, returns the bond data between
+   * them. Both values are -1 if there is no such bond.
+   */
+  BondData getBondData(int atom1, int atom2);
+
+  /**
+   * Given the type IDs of three atoms, returns the data for the angle that
+   * they form. Both values are -1 if there is no such angle.
+   */
+  AngleData getAngleData(int endpoint1, int middleAtom, int endpoint2);
+
+  /** @return the approximate bytes held by the bond and angle tables */
+  size_t getTableBytes();
+
   /**
    * Given a pair of atoms, returns the kBond between them.
    * @param atom1 One of the atoms in the bond.
@@ -155,6 +223,15 @@ class ConfigScanner {
   /** The name of the strategy to use */
   string strategy;
 
+  /** The name of the initial packing to use */
+  string packing;
+
+  /** The name of the neighbor cell index to use */
+  string spatialIndex;
+
+  /** The path to a PDB or XYZ file holding starting coordinates. */
+  string coordinatePath;
+
   void throwScanError(string message);
   void parsePrimaryIndexDefinitions(string definitions);
 
@@ -201,6 +278,15 @@ class ConfigScanner {
   /** @return the simulation strategy string */
   string getStrategy();
 
+  /** @return the initial packing string */
+  string getPacking();
+
+  /** @return the neighbor cell index string */
+  string getSpatialIndex();
+
+  /** @return the path to the starting coordinates, or an empty string */
+  string getCoordinatePath();
+
   /** @returns the nonbonded cutoff in the simulation. */
   long getcutoff();
 
@@ -222,11 +308,17 @@ class ConfigScanner {
 
 class OplsScanner {
  private:
-  /** Map of opls references */
-  map<string,Atom> oplsTable;
+  /**
+   * Maps each OPLS hash number to a dense ID, assigned in file order, that
+   * indexes oplsAtoms.
+   */
+  unordered_map<string,int> oplsIds;
+
+  /** The atom parameters of each OPLS type, indexed by ID */
+  vector<Atom> oplsAtoms;
 
   /** Map of  the Fourier Coefficents stored */
-  map<string,Fourier> fourierTable;
+  unordered_map<string,Fourier> fourierTable;
 
   /** The path to the OPLS file. */
   string fileName;
@@ -249,6 +341,18 @@ class OplsScanner {
    */
   vector<string> errHashesFourier;
 
+  /**
+   * Loads the tables and recorded errors from a parameter cache written by
+   * saveCache.
+   * @param cachePath The path of the cache file.
+   * @param sourceHash The content hash of the OPLS file.
+   * @return False if the cache is missing, stale, or unreadable.
+   */
+  bool loadCache(const string& cachePath, uint64_t sourceHash);
+
+  /** Writes the tables to a parameter cache, ignoring any failure. */
+  void saveCache(const string& cachePath, uint64_t sourceHash);
+
  public:
   /**
    * Constrctor for the OplsScanner object.
@@ -258,7 +362,9 @@ class OplsScanner {
    ~OplsScanner();
 
   /**
-   * Scans in the opls File calls sub-function addLineToTable
+   * Scans in the opls File calls sub-function addLineToTable. The parsed
+   * data is cached next to the file, and the cache is used instead of
+   * parsing while the file is unchanged.
    * @param filename - the name/path of the opls file
    * @return - success code
    *   0: successful
@@ -290,6 +396,9 @@ class OplsScanner {
   /** Logs all the Errors found in the OPLS file to the output log. */
   void logErrors();
 
+  /** @return the approximate bytes held by the atom and Fourier tables */
+  size_t getTableBytes();
+
   /**
    * Returns an Atom struct based on the hashNum (1st col) in Z matrix file.
    * The Atom struct has -1 for x,y,z and has the hashNum for an id.
@@ -299,6 +408,20 @@ class OplsScanner {
    */
   Atom getAtom(string hashNum);
 
+  /**
+   * Returns the interned ID of an OPLS hash number.
+   * @param hashNum -  the hash number (1st col) in Z matrix file
+   * @return - the ID of the type, or -1 if it isn't in the OPLS file.
+   */
+  int getTypeId(string hashNum);
+
+  /**
+   * Returns an Atom struct based on the ID of its OPLS type.
+   * @param typeId - an ID returned by getTypeId
+   * @return - the atom parameters for that type.
+   */
+  Atom getAtom(int typeId);
+
   /**
    * Returns the sigma value based on the hashNum (1st col) in Z matrix file
    * @param hashNum -  the hash number (1st col) in Z matrix file
@@ -440,31 +563,24 @@ class ZmatrixScanner {
   vector<Hop> calculateHops(Molecule molec);
 
   /**
-   * Checks if the int item is contained in the vector
-   * @param vect - the vector to search through
-   * @param item - the item to search for
-   * @return - true if the int is in the vector and false otherwise.
+   * Finds the distance of the shortest path amongst bonds from one atom to
+   * every other atom in the molecule, using a single breadth first search.
+   * @param source - the index of the starting atom within the molecule
+   * @param adjacency - the bonded neighbors of each atom in the molecule
+   * @param distance - filled with the number of bonds seperating source and
+   * each atom, or -1 if the atoms are not connected.
    */
-  bool contains(vector<int> &vect, int item);
+  void findHopDistances(int source, vector< vector<int> > &adjacency,
+                        vector<int> &distance);
 
   /**
-   * Returns the distance of the shortest path amongst bonds between two atoms
-   * @param atom1 - the id of the starting atom
-   * @param atom2 - the if of the ending atom
-   * @param size - number of atoms in molecule
-   * @param graph - a 2d array representing all the bonds in the molecule
-   * @return - returns the number of bonds seperating atom1 and atom2.
-   */
-  int findHopDistance(int atom1,int atom2,int size, int **graph);
-
-  /**
-   * Creates a 2d array representing all the bonds in the molecule
-   * the array is filled with 1 or 0 for a bond or no bond between atoms
-   * array is n*n where n is the number of atoms.
-   * @param graph - a 2d array representing all the bonds in the molecule
+   * Creates an adjacency list representing all the bonds in the molecule.
+   * Entry i lists the indexes (within the molecule) of the atoms bonded to
+   * atom i.
+   * @param adjacency - filled with the bonded neighbors of each atom
    * @param molec - the molecule to check its bonds for valid hops
    */
-  void buildAdjacencyMatrix(int **&graph, Molecule molec);
+  void buildAdjacencyList(vector< vector<int> > &adjacency, Molecule molec);
 
 
   /**
@@ -579,15 +695,61 @@ class StateScanner {
    */
 
   /**
-   * @param environment - the environment state
-   * @param molecules - array of molecules to be printed out
-   * @param numOfMolecules - the number of molecules to be written out
+   * Writes a state file for the molecules in a box. Each molecule's atoms,
+   * bonds, etc. are written from its template.
+   *
+   * @param box - the box holding the environment and the templates
+   * @param step - the step number to record in the file
    * @param fileName - the name of the file to be written
    * @param atomCoords - the coordinates of the atoms in the box.
    */
-  void outputState(Environment *environment, Molecule *molecules,
-                   int numOfMolecules, int step, string filename,
-                   Real** atomCoords);
+  void outputState(Box* box, int step, string filename, Real** atomCoords);
+};
+
+/**
+ * Reads starting coordinates for a box from a PDB or XYZ file, such as an
+ * equilibrated box written by an earlier run. The atoms must be listed in the
+ * order the box lays them out: molecule by molecule, each molecule's atoms in
+ * z-matrix order. This is the order of the PDB files MCGPU writes.
+ *
+ * Files are read in large blocks and parsed in place, so boxes with millions
+ * of atoms load quickly.
+ */
+class CoordinateScanner {
+ public:
+  /**
+   * Reads the coordinates of every atom in a box. The format is chosen by
+   * the file's extension: ".pdb" or ".xyz".
+   *
+   * PDB coordinates are read from the standard columns of ATOM and HETATM
+   * records. An XYZ file holds the atom count, a comment line, and then one
+   * "name x y z" line per atom.
+   *
+   * @param path - the file to read
+   * @param numAtoms - the number of atoms the file must hold
+   * @param atomCoords - Real[3][numAtoms] that receives the coordinates
+   * @return - false if the file could not be read or does not match the box
+   */
+  bool readInCoordinates(string path, int numAtoms, Real** atomCoords);
+
+ private:
+  /** The file being read */
+  FILE* file;
+
+  /** The current block of the file, its length, and the read position */
+  std::vector<char> buffer;
+  size_t bufferLength;
+  size_t bufferPos;
+
+  /** The current line, NUL-terminated, and its number in the file */
+  std::string line;
+  long lineNumber;
+
+  /** Reads the next line into line; returns false at end of file */
+  bool nextLine();
+
+  bool readPDB(string path, int numAtoms, Real** atomCoords);
+  bool readXYZ(string path, int numAtoms, Real** atomCoords);
 };
 
 /**
@@ -614,10 +776,10 @@ bool loadBoxData(SimulationArgs& simArgs, Box* box, long* startStep,
 
 /**
  * Builds data for the simulation box/environment from the Zmatrix and config
- * files, if so desired. Note: this doesn't fully enable the box to be used
- * for the simulation; the geometry information must be set up. There's a call
- * to generatefcc box at the end of the method, at which point the box will
- * actually be "generated"/ready.
+ * files. The box stores one template per molecule in the z-matrix and
+ * repeats the templates, in order, to fill the requested number of
+ * molecules. No coordinates are stored; SimBoxBuilder places the molecules
+ * on a lattice while building the simulation box.
  *
  * @param enviro: the environment stored in the configuration file
  * @param molecVec: the array of molecules, partly created from the Zmatrix
@@ -634,10 +796,10 @@ bool buildBoxData(Environment* enviro, vector<Molecule>& molecVec, Box* box,
 
 /**
  * Uses data from a given state file to reconstruct a box/environment, as the
- * box looked * at the time of the statefile's capture during a prior
- * simulation run. Includes geometry information, etc, so the box will be
- * ready for use in the current * simulation immediately after the data has
- * been copied over to the box.
+ * box looked at the time of the statefile's capture during a prior
+ * simulation run. The first molecule of each type becomes the template for
+ * that type, and only the coordinates of the other molecules are kept. The
+ * per-molecule arrays in molecVec are freed and the vector is emptied.
  *
  * @param enviro: the Environment data from the statefile
  * @param molecVec: the vector array of molecules, copied from the statefile
@@ -650,19 +812,6 @@ bool buildBoxData(Environment* enviro, vector<Molecule>& molecVec, Box* box,
 bool fillBoxData(Environment* enviro, vector<Molecule>& moleVec, Box* box,
                  SBScanner& sb_scanner);
 
-/**
- * Once the box has been filled with environment data, takes the data and sets
- * up the geometry and other aspects necessary to successfully run a
- * simulation.
- * Data must be loaded by either buildBoxData or fillBoxData, depending on if
- * you are loading a clean simulation, or loading from the state file.
- *
- * @param: box: the box to be used for simulation, with all data pre-loaded
- * @return true if completed successfully, or false if there was a
- * show-stopping error for which you should halt the simulation
- */
-bool generatefccBox(Box* box);
-
 /**
  * This method allows for writing to a given log file, with some measure of
  * automation.
@@ -0,0 +1,260 @@
+/**
+ * Journal.cpp
+ *
+ * Accepted-move journal writer and replay
+ */
+
+#include <string.h>
+#include <iostream>
+
+#include "Journal.h"
+
+JournalWriter::JournalWriter(const std::string& path, int numAtoms,
+                             int numMolecules, const int* molStart,
+                             const int* molLen) {
+  this->numAtoms = numAtoms;
+  this->molStart.assign(molStart, molStart + numMolecules);
+  this->molLen.assign(molLen, molLen + numMolecules);
+
+  journalFile = fopen(path.c_str(), "wb");
+  if (journalFile == NULL) {
+    std::cerr << "Error: JournalWriter(): could not open journal (" << path
+              << ")" << std::endl;
+    return;
+  }
+
+  int32_t header[4] = {JOURNAL_VERSION, sizeof(Real), numAtoms, numMolecules};
+  fwrite(JOURNAL_MAGIC, 1, JOURNAL_MAGIC_LEN, journalFile);
+  fwrite(header, sizeof(int32_t), 4, journalFile);
+
+  for (int i = 0; i < numMolecules; i++) {
+    int32_t mol[2] = {molStart[i], molLen[i]};
+    fwrite(mol, sizeof(int32_t), 2, journalFile);
+  }
+}
+
+JournalWriter::~JournalWriter() {
+  if (journalFile != NULL)
+    fclose(journalFile);
+}
+
+bool JournalWriter::isOpen() {
+  return journalFile != NULL;
+}
+
+void JournalWriter::encodeMove(std::vector<char>& buffer, long step,
+                               int molIdx, Real** atomCoords) {
+  int start = molStart[molIdx], len = molLen[molIdx];
+  size_t pos = buffer.size();
+  buffer.resize(pos + 2 * sizeof(int32_t) + sizeof(int64_t) +
+                3 * len * sizeof(Real));
+
+  char* out = &buffer[pos];
+  int32_t kind = JOURNAL_MOVE, mol = molIdx;
+  int64_t recordStep = step;
+  memcpy(out, &kind, sizeof(int32_t));
+  out += sizeof(int32_t);
+  memcpy(out, &recordStep, sizeof(int64_t));
+  out += sizeof(int64_t);
+  memcpy(out, &mol, sizeof(int32_t));
+  out += sizeof(int32_t);
+
+  for (int dim = 0; dim < 3; dim++) {
+    memcpy(out, atomCoords[dim] + start, len * sizeof(Real));
+    out += len * sizeof(Real);
+  }
+}
+
+void JournalWriter::writeRecords(const std::vector<char>& buffer) {
+  if (isOpen() && !buffer.empty())
+    fwrite(&buffer[0], 1, buffer.size(), journalFile);
+}
+
+void JournalWriter::writeKeyframe(long step, Real** atomCoords) {
+  if (!isOpen())
+    return;
+
+  int32_t kind = JOURNAL_KEYFRAME;
+  int64_t recordStep = step;
+  fwrite(&kind, sizeof(int32_t), 1, journalFile);
+  fwrite(&recordStep, sizeof(int64_t), 1, journalFile);
+  for (int dim = 0; dim < 3; dim++) {
+    fwrite(atomCoords[dim], sizeof(Real), numAtoms, journalFile);
+  }
+}
+
+JournalReader::JournalReader(const std::string& path) {
+  numAtoms = 0;
+  numMolecules = 0;
+  lastStep = 0;
+  dataEnd = 0;
+
+  journalFile = fopen(path.c_str(), "rb");
+  if (journalFile == NULL) {
+    std::cerr << "Error: JournalReader(): could not open journal (" << path
+              << ")" << std::endl;
+    return;
+  }
+
+  char magic[JOURNAL_MAGIC_LEN];
+  int32_t header[4];
+  if (fread(magic, 1, JOURNAL_MAGIC_LEN, journalFile) != JOURNAL_MAGIC_LEN ||
+      memcmp(magic, JOURNAL_MAGIC, JOURNAL_MAGIC_LEN) != 0 ||
+      fread(header, sizeof(int32_t), 4, journalFile) != 4 ||
+      header[0] != JOURNAL_VERSION || header[1] != sizeof(Real)) {
+    std::cerr << "Error: JournalReader(): not a valid journal for this build ("
+              << path << ")" << std::endl;
+    fclose(journalFile);
+    journalFile = NULL;
+    return;
+  }
+  if (header[2] <= 0 || header[3] < 0) {
+    std::cerr << "Error: JournalReader(): corrupt header, " << header[2]
+              << " atoms and " << header[3] << " molecules (" << path << ")"
+              << std::endl;
+    fclose(journalFile);
+    journalFile = NULL;
+    return;
+  }
+  numAtoms = header[2];
+  numMolecules = header[3];
+
+  for (int i = 0; i < numMolecules; i++) {
+    int32_t mol[2];
+    if (fread(mol, sizeof(int32_t), 2, journalFile) != 2) {
+      fclose(journalFile);
+      journalFile = NULL;
+      return;
+    }
+    if (mol[0] < 0 || mol[1] < 0 || (int64_t) mol[0] + mol[1] > numAtoms) {
+      std::cerr << "Error: JournalReader(): molecule " << i << " has atoms "
+                << mol[0] << " to " << (int64_t) mol[0] + mol[1] << " of only "
+                << numAtoms << " (" << path << ")" << std::endl;
+      fclose(journalFile);
+      journalFile = NULL;
+      return;
+    }
+    molStart.push_back(mol[0]);
+    molLen.push_back(mol[1]);
+  }
+
+  // fseek succeeds past the end of the file, so a record cut short is only
+  // found by comparing its length with the file's
+  long recordsStart = ftell(journalFile);
+  fseek(journalFile, 0, SEEK_END);
+  long fileSize = ftell(journalFile);
+  fseek(journalFile, recordsStart, SEEK_SET);
+  dataEnd = recordsStart;
+
+  // Index the keyframes, skipping over the coordinates of every complete
+  // record.
+  while (true) {
+    long offset = ftell(journalFile);
+    int32_t kind;
+    int64_t step;
+    if (fread(&kind, sizeof(int32_t), 1, journalFile) != 1 ||
+        fread(&step, sizeof(int64_t), 1, journalFile) != 1) {
+      break;
+    }
+
+    long skip;
+    if (kind == JOURNAL_KEYFRAME) {
+      skip = 3L * numAtoms * sizeof(Real);
+    } else {
+      int32_t mol;
+      if (fread(&mol, sizeof(int32_t), 1, journalFile) != 1 || mol < 0 ||
+          mol >= numMolecules) {
+        break;
+      }
+      skip = 3L * molLen[mol] * sizeof(Real);
+    }
+
+    long end = ftell(journalFile) + skip;
+    if (end > fileSize || fseek(journalFile, end, SEEK_SET) != 0)
+      break;
+    if (kind == JOURNAL_KEYFRAME) {
+      keyframeSteps.push_back(step);
+      keyframeOffsets.push_back(offset);
+    }
+    lastStep = step;
+    dataEnd = end;
+  }
+}
+
+JournalReader::~JournalReader() {
+  if (journalFile != NULL)
+    fclose(journalFile);
+}
+
+bool JournalReader::isOpen() {
+  return journalFile != NULL && !keyframeSteps.empty();
+}
+
+int JournalReader::getAtomCount() {
+  return numAtoms;
+}
+
+int JournalReader::getMoleculeCount() {
+  return numMolecules;
+}
+
+long JournalReader::getFirstStep() {
+  return keyframeSteps.empty() ? 0 : keyframeSteps[0];
+}
+
+long JournalReader::getLastStep() {
+  return lastStep;
+}
+
+bool JournalReader::reconstruct(long step, Real** atomCoords) {
+  if (!isOpen() || step < keyframeSteps[0] || step > lastStep)
+    return false;
+
+  // Find the last keyframe at or before the requested step.
+  int key = keyframeSteps.size() - 1;
+  while (keyframeSteps[key] > step) {
+    key--;
+  }
+
+  clearerr(journalFile);
+  fseek(journalFile, keyframeOffsets[key], SEEK_SET);
+
+  while (readRecord(step, atomCoords)) {
+  }
+  return true;
+}
+
+bool JournalReader::readRecord(long maxStep, Real** atomCoords) {
+  if (ftell(journalFile) >= dataEnd)
+    return false;
+
+  int32_t kind;
+  int64_t step;
+  if (fread(&kind, sizeof(int32_t), 1, journalFile) != 1 ||
+      fread(&step, sizeof(int64_t), 1, journalFile) != 1 || step > maxStep) {
+    return false;
+  }
+
+  if (kind == JOURNAL_KEYFRAME) {
+    for (int dim = 0; dim < 3; dim++) {
+      if (fread(atomCoords[dim], sizeof(Real), numAtoms, journalFile) !=
+          numAtoms) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  int32_t mol;
+  if (fread(&mol, sizeof(int32_t), 1, journalFile) != 1 || mol < 0 ||
+      mol >= numMolecules) {
+    return false;
+  }
+  for (int dim = 0; dim < 3; dim++) {
+    if (fread(atomCoords[dim] + molStart[mol], sizeof(Real), molLen[mol],
+              journalFile) != molLen[mol]) {
+      return false;
+    }
+  }
+  return true;
+}
@@ -0,0 +1,147 @@
+/**
+ * Journal.h
+ *
+ * Reading and writing of accepted-move journals.
+ *
+ * Each Metropolis step changes at most one molecule, so instead of storing a
+ * full frame per step the journal (*.journal) stores the new coordinates of
+ * the moved molecule for every accepted move, plus periodic full keyframes.
+ * Any step of the run can be reconstructed exactly by loading the nearest
+ * keyframe at or before it and replaying the moves that follow.
+ *
+ *   header:   char[8]   magic ("MCGPUJNL")
+ *             int32     format version
+ *             int32     size of a coordinate in bytes (sizeof(Real))
+ *             int32     number of atoms
+ *             int32     number of molecules
+ *             int32     per molecule: first atom, atom count
+ *   keyframe: int32     JOURNAL_KEYFRAME
+ *             int64     step
+ *             Real      x, y and z coordinates [numAtoms] each
+ *   move:     int32     JOURNAL_MOVE
+ *             int64     step
+ *             int32     index of the moved molecule
+ *             Real      x, y and z coordinates [molecule atom count] each
+ *
+ * The step stored with a record is the number of steps completed once the
+ * record is applied, so a keyframe written before the first move of a fresh
+ * run has step 0 and the first move has step 1.
+ */
+
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+#include "Metropolis/DataTypes.h"
+
+#define JOURNAL_MAGIC "MCGPUJNL"
+#define JOURNAL_MAGIC_LEN 8
+#define JOURNAL_VERSION 1
+#define JOURNAL_EXT ".journal"
+
+#define JOURNAL_KEYFRAME 1
+#define JOURNAL_MOVE 2
+
+class JournalWriter {
+  public:
+    /**
+     * Creates the journal and writes its header.
+     *
+     * @param path The path of the journal file.
+     * @param numAtoms The number of atoms in the system.
+     * @param numMolecules The number of molecules in the system.
+     * @param molStart The index of the first atom of each molecule.
+     * @param molLen The number of atoms in each molecule.
+     */
+    JournalWriter(const std::string& path, int numAtoms, int numMolecules,
+                  const int* molStart, const int* molLen);
+
+    /** Closes the journal. */
+    ~JournalWriter();
+
+    /** True if the journal was created successfully. */
+    bool isOpen();
+
+    /**
+     * Appends a move record for a molecule to an in-memory buffer. The
+     * buffer is later passed to writeRecords, which lets the caller collect
+     * moves cheaply and write them in batches.
+     */
+    void encodeMove(std::vector<char>& buffer, long step, int molIdx,
+                    Real** atomCoords);
+
+    /** Writes a batch of records produced by encodeMove. */
+    void writeRecords(const std::vector<char>& buffer);
+
+    /** Writes a keyframe holding every atom's coordinates. */
+    void writeKeyframe(long step, Real** atomCoords);
+
+  private:
+    FILE* journalFile;
+    int numAtoms;
+    std::vector<int> molStart;
+    std::vector<int> molLen;
+};
+
+class JournalReader {
+  public:
+    /**
+     * Opens a journal and indexes its keyframes.
+     *
+     * @param path The path of the journal file.
+     */
+    JournalReader(const std::string& path);
+
+    /** Closes the journal. */
+    ~JournalReader();
+
+    /** True if the journal was opened and has at least one keyframe. */
+    bool isOpen();
+
+    int getAtomCount();
+    int getMoleculeCount();
+
+    /** The step of the first keyframe; the earliest reconstructable step. */
+    long getFirstStep();
+
+    /** The step of the last complete record in the journal. */
+    long getLastStep();
+
+    /**
+     * Reconstructs the coordinates of every atom at the given step.
+     *
+     * @param step The step to reconstruct.
+     * @param atomCoords Real[3][numAtoms]. Receives the coordinates.
+     * @return False if the step is outside of the journal.
+     */
+    bool reconstruct(long step, Real** atomCoords);
+
+  private:
+    /**
+     * Applies the record at the current file position to atomCoords.
+     *
+     * @return False at the end of the complete records, or if the record is
+     *     past maxStep (in which case it is left unapplied).
+     */
+    bool readRecord(long maxStep, Real** atomCoords);
+
+    FILE* journalFile;
+    int numAtoms;
+    int numMolecules;
+    std::vector<int> molStart;
+    std::vector<int> molLen;
+
+    /** The step and file offset of each keyframe, in file order */
+    std::vector<long> keyframeSteps;
+    std::vector<long> keyframeOffsets;
+    long lastStep;
+
+    /** The file offset just past the last complete record */
+    long dataEnd;
+};
+
+#endif
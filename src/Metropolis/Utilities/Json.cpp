@@ -0,0 +1,93 @@
+/**
+ * Json.cpp
+ *
+ * Builds the JSON documents of the machine-readable output
+ */
+
+#include "Json.h"
+
+#include <math.h>
+#include <stdio.h>
+
+JsonObject& JsonObject::add(const std::string& key, const std::string& value) {
+  return addRaw(key, quote(value));
+}
+
+JsonObject& JsonObject::add(const std::string& key, const char* value) {
+  return addRaw(key, quote(value));
+}
+
+JsonObject& JsonObject::add(const std::string& key, double value) {
+  if (isnan(value) || isinf(value)) {
+    return addRaw(key, "null");
+  }
+  char buffer[32];
+  snprintf(buffer, sizeof(buffer), "%.15g", value);
+  return addRaw(key, buffer);
+}
+
+JsonObject& JsonObject::add(const std::string& key, long long value) {
+  char buffer[32];
+  snprintf(buffer, sizeof(buffer), "%lld", value);
+  return addRaw(key, buffer);
+}
+
+JsonObject& JsonObject::add(const std::string& key, long value) {
+  return add(key, (long long) value);
+}
+
+JsonObject& JsonObject::add(const std::string& key, int value) {
+  return add(key, (long long) value);
+}
+
+JsonObject& JsonObject::add(const std::string& key, bool value) {
+  return addRaw(key, value ? "true" : "false");
+}
+
+JsonObject& JsonObject::add(const std::string& key, const JsonObject& value) {
+  return addRaw(key, value.str());
+}
+
+JsonObject& JsonObject::add(const std::string& key,
+                            const std::vector<JsonObject>& values) {
+  std::string json = "[";
+  for (int i = 0; i < values.size(); i++) {
+    json += (i == 0 ? "" : ", ") + values[i].str();
+  }
+  return addRaw(key, json + "]");
+}
+
+std::string JsonObject::str() const {
+  return "{" + members + "}";
+}
+
+std::string JsonObject::quote(const std::string& text) {
+  std::string out = "\"";
+  for (int i = 0; i < text.size(); i++) {
+    unsigned char c = text[i];
+    if (c == '"' || c == '\\') {
+      out += '\\';
+      out += c;
+    } else if (c == '\n') {
+      out += "\\n";
+    } else if (c == '\t') {
+      out += "\\t";
+    } else if (c < 0x20) {
+      char buffer[8];
+      snprintf(buffer, sizeof(buffer), "\\u%04x", c);
+      out += buffer;
+    } else {
+      out += c;
+    }
+  }
+  return out + "\"";
+}
+
+JsonObject& JsonObject::addRaw(const std::string& key,
+                               const std::string& json) {
+  if (!members.empty()) {
+    members += ", ";
+  }
+  members += quote(key) + ": " + json;
+  return *this;
+}
@@ -0,0 +1,67 @@
+/**
+ * Json.h
+ *
+ * Builds the JSON documents of the machine-readable output: the results
+ * document and the records of the metrics stream.
+ */
+
+#ifndef JSON_H
+#define JSON_H
+
+#include <string>
+#include <vector>
+
+/**
+ * A JSON object built up one member at a time. Members are written in the
+ * order they are added.
+ */
+class JsonObject {
+ public:
+  JsonObject() {}
+
+  /** Adds a string member */
+  JsonObject& add(const std::string& key, const std::string& value);
+
+  /** Adds a string member */
+  JsonObject& add(const std::string& key, const char* value);
+
+  /** Adds a number member. NaN and infinities are written as null. */
+  JsonObject& add(const std::string& key, double value);
+
+  /** Adds an integer member */
+  JsonObject& add(const std::string& key, long long value);
+
+  /** Adds an integer member */
+  JsonObject& add(const std::string& key, long value);
+
+  /** Adds an integer member */
+  JsonObject& add(const std::string& key, int value);
+
+  /** Adds a true or false member */
+  JsonObject& add(const std::string& key, bool value);
+
+  /** Adds a nested object */
+  JsonObject& add(const std::string& key, const JsonObject& value);
+
+  /** Adds an array of nested objects */
+  JsonObject& add(const std::string& key,
+                  const std::vector<JsonObject>& values);
+
+  /** @return true if no members have been added */
+  bool empty() const {return members.empty();}
+
+  /** @return the object on a single line, such as {"step": 1000} */
+  std::string str() const;
+
+  /** @return a string as a quoted and escaped JSON string */
+  static std::string quote(const std::string& text);
+
+ private:
+  /** The members written so far, without the enclosing braces */
+  std::string members;
+
+  /** Adds a member whose value is already formatted as JSON */
+  JsonObject& addRaw(const std::string& key, const std::string& json);
+};
+
+#endif
@@ -24,14 +24,35 @@ using std::cout;
 */
 stringstream output;
 
+/**
+  The seed last passed to seed(), and the random numbers drawn since.
+*/
+static int lastSeed = 1;
+static long numDraws = 0;
+
 void seed(int seed) {
 	srand(seed);
+	lastSeed = seed;
+	numDraws = 0;
 }
 
 Real randomReal(const Real start, const Real end) {
+	numDraws++;
 	return (end-start) * ((Real) rand() / RAND_MAX) + start;
 }
 
+long randomDrawCount() {
+	return numDraws;
+}
+
+void rewindRandom(long draws) {
+	srand(lastSeed);
+	for (long i = 0; i < draws; i++) {
+		rand();
+	}
+	numDraws = draws;
+}
+
 Point createPoint(double X, double Y, double Z) {
   Point p;
   p.x = X;
@@ -468,6 +489,7 @@ Molecule moveMolecule(Molecule molec, Atom pivot, double xTrans, double yTrans,
 }
 
 double randomNUM(const double start, const double end) {
+  numDraws++;
   return (end-start) * (double(rand()) / RAND_MAX) + start;
 }
 
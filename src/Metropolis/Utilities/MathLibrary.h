@@ -52,6 +52,17 @@ using std::map;
 
 void seed(int seed);
 Real randomReal(const Real start, const Real end);
+
+/**
+  Returns the number of random numbers drawn since the last call to seed().
+*/
+long randomDrawCount();
+
+/**
+  Reseeds the generator and skips the given number of draws, returning the
+  random number sequence to the point randomDrawCount() reported.
+*/
+void rewindRandom(long draws);
 void adjustAtomIDs(Molecule* molec, int m);
 void revertAtomIDs(Molecule* molec, int m);
 
@@ -4,6 +4,7 @@
 #include <stdexcept>
 //#include <sstream>
 #include "Parsing.h"
+#include "ParameterCache.h"
 #include "StructLibrary.h"
 #include "Metropolis/Box.h"
 #include "Metropolis/SimulationArgs.h"
@@ -12,7 +13,8 @@ OplsScanner::OplsScanner() {
 }
 
 OplsScanner::~OplsScanner() {
-  oplsTable.clear();
+  oplsIds.clear();
+  oplsAtoms.clear();
   fourierTable.clear();
 }
 
@@ -23,6 +25,14 @@ bool OplsScanner::readInOpls(string filename) {
 		return false;
 	}
 
+  uint64_t sourceHash;
+  bool hashed = ParameterCache::hashFile(filename, sourceHash);
+  string cachePath = filename + PARAMETER_CACHE_EXT;
+  if (hashed && loadCache(cachePath, sourceHash)) {
+    logErrors();
+    return true;
+  }
+
   int numOfLines=0;
   ifstream oplsScanner(filename.c_str());
   if (!oplsScanner.is_open()) {
@@ -46,9 +56,108 @@ bool OplsScanner::readInOpls(string filename) {
     logErrors();
   }
 
+  if (hashed) {
+    saveCache(cachePath, sourceHash);
+  }
   return true;
 }
 
+bool OplsScanner::loadCache(const string& cachePath, uint64_t sourceHash) {
+  ParameterCache::Reader cache(cachePath, PARAMETER_CACHE_OPLS, sourceHash);
+  if (!cache.isValid()) {
+    return false;
+  }
+
+  int numAtoms = cache.getInt();
+  for (int i = 0; i < numAtoms && cache.isValid(); i++) {
+    string hashNum = cache.getString();
+    string name = cache.getString();
+    Real sigma = cache.getReal(), epsilon = cache.getReal();
+    Real charge = cache.getReal();
+    oplsIds[hashNum] = oplsAtoms.size();
+    oplsAtoms.push_back(createAtom(0, -1, -1, -1, sigma, epsilon, charge, name));
+  }
+
+  int numFourier = cache.getInt();
+  for (int i = 0; i < numFourier && cache.isValid(); i++) {
+    string hashNum = cache.getString();
+    Fourier vValues;
+    for (int v = 0; v < 4; v++) {
+      vValues.vValues[v] = cache.getReal();
+    }
+    fourierTable[hashNum] = vValues;
+  }
+
+  int numErrLines = cache.getInt();
+  for (int i = 0; i < numErrLines && cache.isValid(); i++) {
+    errLines.push_back(cache.getInt());
+  }
+  int numErrHashes = cache.getInt();
+  for (int i = 0; i < numErrHashes && cache.isValid(); i++) {
+    errHashes.push_back(cache.getString());
+  }
+  int numErrHashesFourier = cache.getInt();
+  for (int i = 0; i < numErrHashesFourier && cache.isValid(); i++) {
+    errHashesFourier.push_back(cache.getString());
+  }
+
+  if (!cache.isValid()) {
+    oplsIds.clear();
+    oplsAtoms.clear();
+    fourierTable.clear();
+    errLines.clear();
+    errHashes.clear();
+    errHashesFourier.clear();
+    return false;
+  }
+  return true;
+}
+
+void OplsScanner::saveCache(const string& cachePath, uint64_t sourceHash) {
+  ParameterCache::Writer cache;
+
+  // Write the types in ID order so loading reassigns the same IDs
+  vector<const string*> hashNums(oplsAtoms.size());
+  for (unordered_map<string,int>::iterator it = oplsIds.begin();
+       it != oplsIds.end(); it++) {
+    hashNums[it->second] = &it->first;
+  }
+
+  cache.putInt(oplsAtoms.size());
+  for (int i = 0; i < oplsAtoms.size(); i++) {
+    cache.putString(*hashNums[i]);
+    cache.putString(*oplsAtoms[i].name);
+    cache.putReal(oplsAtoms[i].sigma);
+    cache.putReal(oplsAtoms[i].epsilon);
+    cache.putReal(oplsAtoms[i].charge);
+  }
+
+  cache.putInt(fourierTable.size());
+  for (unordered_map<string,Fourier>::iterator it = fourierTable.begin();
+       it != fourierTable.end(); it++) {
+    cache.putString(it->first);
+    for (int v = 0; v < 4; v++) {
+      cache.putReal(it->second.vValues[v]);
+    }
+  }
+
+  cache.putInt(errLines.size());
+  for (int i = 0; i < errLines.size(); i++) {
+    cache.putInt(errLines[i]);
+  }
+  cache.putInt(errHashes.size());
+  for (int i = 0; i < errHashes.size(); i++) {
+    cache.putString(errHashes[i]);
+  }
+  cache.putInt(errHashesFourier.size());
+  for (int i = 0; i < errHashesFourier.size(); i++) {
+    cache.putString(errHashesFourier[i]);
+  }
+
+  // A read-only parameter directory just means the next run parses again
+  cache.save(cachePath, PARAMETER_CACHE_OPLS, sourceHash);
+}
+
 void OplsScanner::addLineToTable(string line, int numOfLines) {
   string hashNum;
   int secCol;
@@ -65,18 +174,20 @@ void OplsScanner::addLineToTable(string line, int numOfLines) {
 
     Atom temp = createAtom(0, -1, -1, -1, sigma, epsilon, charge, name);
 
-    pair<map<string,Atom>::iterator,bool> ret;
-    ret = oplsTable.insert( pair<string,Atom>(hashNum,temp) );
+    pair<unordered_map<string,int>::iterator,bool> ret;
+    ret = oplsIds.insert( pair<string,int>(hashNum,oplsAtoms.size()) );
 
     if (ret.second==false) {
       errHashes.push_back(hashNum);
+    } else {
+      oplsAtoms.push_back(temp);
     }
 
   } else if (format == 2) {
     Real v0,v1,v2,v3;
     ss >> hashNum >> v0 >> v1 >> v2 >> v3 ;
     Fourier vValues = {v0,v1,v2,v3};
-    pair<map<string,Fourier>::iterator,bool> ret2;
+    pair<unordered_map<string,Fourier>::iterator,bool> ret2;
     ret2 = fourierTable.insert( pair<string,Fourier>(hashNum,vValues) );
 
     if (ret2.second==false) {
@@ -153,19 +264,36 @@ void OplsScanner::logErrors() {
 	}
 }
 
+int OplsScanner::getTypeId(string hashNum) {
+  unordered_map<string,int>::iterator it = oplsIds.find(hashNum);
+  return it == oplsIds.end() ? -1 : it->second;
+}
+
+size_t OplsScanner::getTableBytes() {
+  return mapBytes(oplsIds) + oplsAtoms.capacity() * sizeof(Atom) +
+         mapBytes(fourierTable);
+}
+
+Atom OplsScanner::getAtom(int typeId) {
+  if (typeId >= 0 && typeId < oplsAtoms.size()) {
+    return oplsAtoms[typeId];
+  } else {
+    return createAtom(0, -1, -1, -1, -1, -1, -1, NULL);
+  }
+}
+
 Atom OplsScanner::getAtom(string hashNum) {
-  if (oplsTable.count(hashNum) > 0) {
-    return oplsTable[hashNum];
-	} else {
+  int typeId = getTypeId(hashNum);
+  if (typeId < 0) {
 	  cerr << "Index does not exist: " << hashNum << endl;
-		return createAtom(0, -1, -1, -1, -1, -1, -1, NULL);
-	}
+  }
+  return getAtom(typeId);
 }
 
 Real OplsScanner::getSigma(string hashNum) {
-  if (oplsTable.count(hashNum) > 0) {
-    Atom temp = oplsTable[hashNum];
-    return temp.sigma;
+  int typeId = getTypeId(hashNum);
+  if (typeId >= 0) {
+    return oplsAtoms[typeId].sigma;
   } else {
     cerr << "Index does not exist: "<< hashNum <<endl;
     return -1;
@@ -173,9 +301,9 @@ Real OplsScanner::getSigma(string hashNum) {
 }
 
 Real OplsScanner::getEpsilon(string hashNum) {
-  if (oplsTable.count(hashNum) > 0) {
-    Atom temp = oplsTable[hashNum];
-    return temp.epsilon;
+  int typeId = getTypeId(hashNum);
+  if (typeId >= 0) {
+    return oplsAtoms[typeId].epsilon;
   } else {
     cerr << "Index does not exist: "<< hashNum <<endl;
     return -1;
@@ -183,9 +311,9 @@ Real OplsScanner::getEpsilon(string hashNum) {
 }
 
 Real OplsScanner::getCharge(string hashNum) {
-  if (oplsTable.count(hashNum) > 0) {
-    Atom temp = oplsTable[hashNum];
-    return temp.charge;
+  int typeId = getTypeId(hashNum);
+  if (typeId >= 0) {
+    return oplsAtoms[typeId].charge;
   } else {
     cerr << "Index does not exist: "<< hashNum <<endl;
     return -1;
@@ -193,9 +321,9 @@ Real OplsScanner::getCharge(string hashNum) {
 }
 
 Fourier OplsScanner::getFourier(string hashNum) {
-  if (fourierTable.count(hashNum) > 0) {
-    Fourier temp = fourierTable[hashNum];
-    return temp;
+  unordered_map<string,Fourier>::iterator it = fourierTable.find(hashNum);
+  if (it != fourierTable.end()) {
+    return it->second;
   } else {
     cerr << "Index does not exist: "<< hashNum <<endl;
     Fourier temp ={-1,-1,-1,-1};
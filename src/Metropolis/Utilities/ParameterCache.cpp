@@ -0,0 +1,163 @@
+/**
+ * ParameterCache.cpp
+ *
+ * Binary snapshots of parsed force-field files
+ */
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <sstream>
+
+#include "ParameterCache.h"
+
+#define FNV_OFFSET_BASIS 14695981039346656037ULL
+#define FNV_PRIME 1099511628211ULL
+
+bool ParameterCache::hashFile(const std::string& path, uint64_t& hash) {
+  FILE* file = fopen(path.c_str(), "rb");
+  if (file == NULL)
+    return false;
+
+  hash = FNV_OFFSET_BASIS;
+  unsigned char buffer[65536];
+  size_t count;
+  while ((count = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+    for (size_t i = 0; i < count; i++) {
+      hash ^= buffer[i];
+      hash *= FNV_PRIME;
+    }
+  }
+
+  bool ok = !ferror(file);
+  fclose(file);
+  return ok;
+}
+
+void ParameterCache::Writer::putInt(int32_t value) {
+  putBytes(&value, sizeof(int32_t));
+}
+
+void ParameterCache::Writer::putReal(Real value) {
+  putBytes(&value, sizeof(Real));
+}
+
+void ParameterCache::Writer::putString(const std::string& value) {
+  putInt(value.size());
+  putBytes(value.data(), value.size());
+}
+
+void ParameterCache::Writer::putBytes(const void* data, size_t size) {
+  const char* bytes = (const char*) data;
+  body.insert(body.end(), bytes, bytes + size);
+}
+
+bool ParameterCache::Writer::save(const std::string& path, int kind,
+                                  uint64_t sourceHash) {
+  std::stringstream tempPath;
+  tempPath << path << "." << getpid() << ".tmp";
+
+  FILE* file = fopen(tempPath.str().c_str(), "wb");
+  if (file == NULL)
+    return false;
+
+  int32_t header[3] = {PARAMETER_CACHE_VERSION, kind, sizeof(Real)};
+  bool ok = fwrite(PARAMETER_CACHE_MAGIC, 1, PARAMETER_CACHE_MAGIC_LEN, file) ==
+                PARAMETER_CACHE_MAGIC_LEN &&
+            fwrite(header, sizeof(int32_t), 3, file) == 3 &&
+            fwrite(&sourceHash, sizeof(uint64_t), 1, file) == 1 &&
+            (body.empty() ||
+             fwrite(&body[0], 1, body.size(), file) == body.size());
+  ok = (fclose(file) == 0) && ok;
+
+  if (!ok || rename(tempPath.str().c_str(), path.c_str()) != 0) {
+    remove(tempPath.str().c_str());
+    return false;
+  }
+  return true;
+}
+
+ParameterCache::Reader::Reader(const std::string& path, int kind,
+                               uint64_t sourceHash) {
+  data = NULL;
+  size = 0;
+  pos = 0;
+  valid = false;
+
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0)
+    return;
+
+  struct stat info;
+  if (fstat(fd, &info) == 0 && info.st_size > 0) {
+    void* mapping = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (mapping != MAP_FAILED) {
+      data = (const char*) mapping;
+      size = info.st_size;
+    }
+  }
+  close(fd);
+  if (data == NULL)
+    return;
+
+  valid = true;
+  const char* magic = getBytes(PARAMETER_CACHE_MAGIC_LEN);
+  int32_t version = getInt(), cacheKind = getInt(), realSize = getInt();
+  const char* hash = getBytes(sizeof(uint64_t));
+  if (!valid)
+    return;
+
+  uint64_t cacheHash;
+  memcpy(&cacheHash, hash, sizeof(uint64_t));
+  valid = memcmp(magic, PARAMETER_CACHE_MAGIC, PARAMETER_CACHE_MAGIC_LEN) == 0 &&
+          version == PARAMETER_CACHE_VERSION && cacheKind == kind &&
+          realSize == sizeof(Real) && cacheHash == sourceHash;
+}
+
+ParameterCache::Reader::~Reader() {
+  if (data != NULL)
+    munmap((void*) data, size);
+}
+
+bool ParameterCache::Reader::isValid() {
+  return valid;
+}
+
+int32_t ParameterCache::Reader::getInt() {
+  int32_t value = 0;
+  const char* bytes = getBytes(sizeof(int32_t));
+  if (bytes != NULL)
+    memcpy(&value, bytes, sizeof(int32_t));
+  return value;
+}
+
+Real ParameterCache::Reader::getReal() {
+  Real value = 0;
+  const char* bytes = getBytes(sizeof(Real));
+  if (bytes != NULL)
+    memcpy(&value, bytes, sizeof(Real));
+  return value;
+}
+
+std::string ParameterCache::Reader::getString() {
+  int32_t length = getInt();
+  if (length < 0) {
+    valid = false;
+    return "";
+  }
+  const char* bytes = getBytes(length);
+  return bytes == NULL ? "" : std::string(bytes, length);
+}
+
+const char* ParameterCache::Reader::getBytes(size_t count) {
+  if (!valid || count > size - pos) {
+    valid = false;
+    return NULL;
+  }
+  const char* bytes = data + pos;
+  pos += count;
+  return bytes;
+}
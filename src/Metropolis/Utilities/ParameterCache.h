@@ -0,0 +1,106 @@
+/**
+ * ParameterCache.h
+ *
+ * Binary snapshots of parsed force-field files (oplsaa.par, oplsaa.sb).
+ *
+ * The first time a parameter file is read, the scanner writes what it parsed
+ * to <file>.cache. The cache records a 64-bit FNV-1a hash of the source
+ * file's contents, so later runs can map the cache and skip parsing as long
+ * as the source is unchanged. Any problem reading or writing a cache (a
+ * read-only directory, a stale or truncated file, a different build
+ * precision) silently falls back to parsing the source.
+ *
+ *   header: char[8]   magic ("MCGPUFFC")
+ *           int32     format version
+ *           int32     kind of parameter file (PARAMETER_CACHE_OPLS / _SB)
+ *           int32     sizeof(Real)
+ *           uint64    FNV-1a hash of the source file
+ *   body:   written and read in order by the owning scanner
+ */
+
+#ifndef PARAMETER_CACHE_H
+#define PARAMETER_CACHE_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "Metropolis/DataTypes.h"
+
+#define PARAMETER_CACHE_MAGIC "MCGPUFFC"
+#define PARAMETER_CACHE_MAGIC_LEN 8
+#define PARAMETER_CACHE_VERSION 2
+#define PARAMETER_CACHE_EXT ".cache"
+
+#define PARAMETER_CACHE_OPLS 1
+#define PARAMETER_CACHE_SB 2
+
+namespace ParameterCache {
+  /**
+   * Computes the FNV-1a hash of a file's contents.
+   *
+   * @param path The file to hash.
+   * @param hash Receives the hash.
+   * @return False if the file could not be read.
+   */
+  bool hashFile(const std::string& path, uint64_t& hash);
+
+  /** Builds the body of a cache in memory and saves it. */
+  class Writer {
+    public:
+      void putInt(int32_t value);
+      void putReal(Real value);
+      void putString(const std::string& value);
+      void putBytes(const void* data, size_t size);
+
+      /**
+       * Writes the header and body to the cache. The cache is written to a
+       * temporary file and renamed into place, so concurrent runs never see
+       * a partial cache.
+       *
+       * @return False if the cache could not be written.
+       */
+      bool save(const std::string& path, int kind, uint64_t sourceHash);
+
+    private:
+      std::vector<char> body;
+  };
+
+  /** Maps a cache and reads its body back in the order it was written. */
+  class Reader {
+    public:
+      /**
+       * Maps a cache and validates its header.
+       *
+       * @param path The cache file.
+       * @param kind The kind of parameter file the cache must hold.
+       * @param sourceHash The hash the source file must have.
+       */
+      Reader(const std::string& path, int kind, uint64_t sourceHash);
+      ~Reader();
+
+      /**
+       * True if the cache was mapped, matched, and every read so far stayed
+       * within the file.
+       */
+      bool isValid();
+
+      int32_t getInt();
+      Real getReal();
+      std::string getString();
+
+      /**
+       * Returns a pointer to the next size bytes of the mapping, or NULL if
+       * the cache is too short.
+       */
+      const char* getBytes(size_t size);
+
+    private:
+      const char* data;
+      size_t size;
+      size_t pos;
+      bool valid;
+  };
+}
+
+#endif
@@ -0,0 +1,216 @@
+/**
+ * PerfCounters.cpp
+ *
+ * Hardware performance counters through perf_event_open
+ */
+
+#include "PerfCounters.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#endif
+
+PerfCounters::PerfCounters() {
+  for (int i = 0; i < NUM_EVENTS; i++) {
+    fds[i] = -1;
+  }
+}
+
+PerfCounters::~PerfCounters() {
+  for (int i = 0; i < NUM_EVENTS; i++) {
+    if (fds[i] >= 0) {
+      close(fds[i]);
+    }
+  }
+}
+
+#ifdef __linux__
+
+/** @return the perf_event_open config of a cache read miss */
+static unsigned long long cacheMiss(int cache) {
+  return cache | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+         (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+}
+
+bool PerfCounters::open() {
+  const unsigned int types[NUM_EVENTS] = {
+    PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HW_CACHE,
+    PERF_TYPE_HW_CACHE, PERF_TYPE_HARDWARE
+  };
+  const unsigned long long configs[NUM_EVENTS] = {
+    PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+    cacheMiss(PERF_COUNT_HW_CACHE_L1D), cacheMiss(PERF_COUNT_HW_CACHE_LL),
+    PERF_COUNT_HW_BRANCH_MISSES
+  };
+
+  bool opened = false;
+  for (int i = 0; i < NUM_EVENTS; i++) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = types[i];
+    attr.config = configs[i];
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.inherit = 1;
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED |
+                       PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+    fds[i] = syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+    if (fds[i] >= 0) {
+      opened = true;
+    } else if (error.empty()) {
+      error = strerror(errno);
+    }
+  }
+  return opened;
+}
+
+void PerfCounters::start() {
+  for (int i = 0; i < NUM_EVENTS; i++) {
+    if (fds[i] >= 0) {
+      ioctl(fds[i], PERF_EVENT_IOC_ENABLE, 0);
+    }
+  }
+}
+
+void PerfCounters::stop() {
+  for (int i = 0; i < NUM_EVENTS; i++) {
+    if (fds[i] >= 0) {
+      ioctl(fds[i], PERF_EVENT_IOC_DISABLE, 0);
+    }
+  }
+}
+
+double PerfCounters::read(Event event) const {
+  if (fds[event] < 0) {
+    return -1;
+  }
+  // The value, then the time enabled and the time on the hardware
+  unsigned long long values[3];
+  if (::read(fds[event], values, sizeof(values)) != sizeof(values)) {
+    return -1;
+  }
+  if (values[2] == 0) {
+    return 0;
+  }
+  return (double) values[0] * values[1] / values[2];
+}
+
+#else
+
+bool PerfCounters::open() {
+  error = "perf_event_open is only available on Linux";
+  return false;
+}
+
+void PerfCounters::start() {}
+
+void PerfCounters::stop() {}
+
+double PerfCounters::read(Event event) const {
+  return -1;
+}
+
+#endif
+
+const char* PerfCounters::eventName(Event event) {
+  const char* names[NUM_EVENTS] = {
+    "Cycles", "Instructions", "L1D-Misses", "LLC-Misses", "Branch-Misses"
+  };
+  return names[event];
+}
+
+void PerfCounters::write(std::ostream& out, const std::string& prefix,
+                         long steps, long long atomPairs) const {
+  for (int i = 0; i < NUM_EVENTS; i++) {
+    double count = read((Event) i);
+    if (count >= 0) {
+      out << prefix << "-" << eventName((Event) i) << " = "
+          << (long long) count << std::endl;
+    }
+  }
+
+  double cycles = read(CYCLES), instructions = read(INSTRUCTIONS);
+  if (cycles > 0 && instructions >= 0) {
+    out << prefix << "-IPC = " << instructions / cycles << std::endl;
+  }
+
+  const Event misses[] = {L1D_MISSES, LLC_MISSES, BRANCH_MISSES};
+  for (int i = 0; i < 3; i++) {
+    double count = read(misses[i]);
+    if (count < 0) {
+      continue;
+    }
+    if (steps > 0) {
+      out << prefix << "-" << eventName(misses[i]) << "-Per-Step = "
+          << count / steps << std::endl;
+    }
+    if (atomPairs > 0) {
+      out << prefix << "-" << eventName(misses[i]) << "-Per-Atom-Pair = "
+          << count / atomPairs << std::endl;
+    }
+  }
+}
+
+JsonObject PerfCounters::toJson(long steps, long long atomPairs) const {
+  const char* keys[NUM_EVENTS] = {
+    "cycles", "instructions", "l1d_misses", "llc_misses", "branch_misses"
+  };
+  JsonObject out;
+  for (int i = 0; i < NUM_EVENTS; i++) {
+    double count = read((Event) i);
+    if (count >= 0) {
+      out.add(keys[i], (long long) count);
+    }
+  }
+
+  double cycles = read(CYCLES), instructions = read(INSTRUCTIONS);
+  if (cycles > 0 && instructions >= 0) {
+    out.add("ipc", instructions / cycles);
+  }
+
+  const Event misses[] = {L1D_MISSES, LLC_MISSES, BRANCH_MISSES};
+  for (int i = 0; i < 3; i++) {
+    double count = read(misses[i]);
+    if (count < 0) {
+      continue;
+    }
+    if (steps > 0) {
+      out.add(std::string(keys[misses[i]]) + "_per_step", count / steps);
+    }
+    if (atomPairs > 0) {
+      out.add(std::string(keys[misses[i]]) + "_per_atom_pair",
+              count / atomPairs);
+    }
+  }
+  return out;
+}
+
+std::string PerfCounters::summary() const {
+  std::string out;
+  char buffer[64];
+  double cycles = read(CYCLES), instructions = read(INSTRUCTIONS);
+  if (cycles > 0 && instructions >= 0) {
+    snprintf(buffer, sizeof(buffer), "IPC %.2f", instructions / cycles);
+    out.append(buffer);
+  }
+  const Event misses[] = {L1D_MISSES, LLC_MISSES, BRANCH_MISSES};
+  for (int i = 0; i < 3; i++) {
+    double count = read(misses[i]);
+    if (count >= 0) {
+      snprintf(buffer, sizeof(buffer), "%s%s %.0f", out.empty() ? "" : ", ",
+               eventName(misses[i]), count);
+      out.append(buffer);
+    }
+  }
+  return out;
+}
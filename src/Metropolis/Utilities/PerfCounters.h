@@ -0,0 +1,100 @@
+/**
+ * PerfCounters.h
+ *
+ * Hardware performance counters for --perf-counters, read through
+ * perf_event_open on Linux. Each event is opened on its own, so a machine or
+ * container lacking some of them still reports the rest; where none can be
+ * opened (another OS, no PMU in a virtual machine, or perf_event_paranoid set
+ * too high) the counters simply report themselves unavailable.
+ *
+ * The counters are inherited by the threads started after open(), and read
+ * back as the total over all of them, so opening them before the first OpenMP
+ * parallel region also counts the threads of the tiled kernels.
+ */
+
+#ifndef PERFCOUNTERS_H
+#define PERFCOUNTERS_H
+
+#include <ostream>
+#include <string>
+
+#include "Json.h"
+
+class PerfCounters {
+ public:
+  /** The events counted */
+  enum Event {
+    CYCLES,
+    INSTRUCTIONS,
+    L1D_MISSES,
+    LLC_MISSES,
+    BRANCH_MISSES,
+    NUM_EVENTS
+  };
+
+  /** Constructs the counters without opening them */
+  PerfCounters();
+
+  /** Closes any counters that were opened */
+  ~PerfCounters();
+
+  /**
+   * Opens a counter for each event, stopped and at zero.
+   *
+   * @return true if at least one counter could be opened.
+   */
+  bool open();
+
+  /** @return why no counter could be opened, after open() failed */
+  const std::string& getError() const {return error;}
+
+  /** Starts counting. Counts accumulate over every start() and stop(). */
+  void start();
+
+  /** Stops counting */
+  void stop();
+
+  /** @return true if the event's counter was opened */
+  bool isAvailable(Event event) const {return fds[event] >= 0;}
+
+  /**
+   * @return the count of an event, scaled up if the kernel only had it on the
+   *     hardware for part of the time, or -1 if it is unavailable.
+   */
+  double read(Event event) const;
+
+  /**
+   * Writes a "<prefix>-<name> = <value>" line for each available event,
+   * followed by the instructions per cycle and the misses per step and, if
+   * atomPairs is not 0, per atom pair interaction.
+   *
+   * @param out The results file.
+   * @param prefix The phase counted, such as "Loop".
+   * @param steps The number of steps counted, or 0 to skip the per-step lines.
+   * @param atomPairs The atom pairs evaluated while counting, or 0 if unknown.
+   */
+  void write(std::ostream& out, const std::string& prefix, long steps,
+             long long atomPairs) const;
+
+  /**
+   * @return the same values as write(), for the JSON results, keyed by the
+   *     lower-case event names
+   */
+  JsonObject toJson(long steps, long long atomPairs) const;
+
+  /** @return the instructions per cycle and misses on one line */
+  std::string summary() const;
+
+  /** @return the name of an event, such as "L1D-Misses" */
+  static const char* eventName(Event event);
+
+ private:
+  int fds[NUM_EVENTS];
+  std::string error;
+
+  /** Not copyable, so that only one object closes the counters */
+  PerfCounters(const PerfCounters&);
+  PerfCounters& operator=(const PerfCounters&);
+};
+
+#endif
@@ -2,12 +2,34 @@
 
 #include <exception>
 #include <stdexcept>
+#include <string.h>
 //#include <sstream>
 #include "Parsing.h"
+#include "ParameterCache.h"
 #include "StructLibrary.h"
 #include "Metropolis/Box.h"
 #include "Metropolis/SimulationArgs.h"
 
+int SBScanner::internType(const string& name) {
+	unordered_map<string, int>::iterator it = typeIds.find(name);
+	if (it != typeIds.end())
+		return it->second;
+
+	int id = typeIds.size();
+	typeIds[name] = id;
+	return id;
+}
+
+unsigned long long SBScanner::bondKey(int atom1, int atom2) {
+	return ((unsigned long long) atom1 << 32) | (unsigned int) atom2;
+}
+
+unsigned long long SBScanner::angleKey(int endpoint1, int middleAtom,
+                                       int endpoint2) {
+	return ((unsigned long long) endpoint1 << 42) |
+	       ((unsigned long long) middleAtom << 21) | (unsigned int) endpoint2;
+}
+
 void SBScanner::processBond(string line) {
 	string atom1, atom2;
 	if (line.substr(1, 1) == " ") {
@@ -26,10 +48,10 @@ void SBScanner::processBond(string line) {
 	string rest_of_line = line.substr(6, line.size()-6);
 	stringstream ss(rest_of_line);
 	ss >> forceK >> bondDist;
-	bondDataMap[atom1][atom2].kBond = forceK;
-	bondDataMap[atom2][atom1].kBond = forceK;
-	bondDataMap[atom1][atom2].eqBondDist = bondDist;
-	bondDataMap[atom2][atom1].eqBondDist = bondDist;
+
+	int id1 = internType(atom1), id2 = internType(atom2);
+	bondEntries[bondKey(id1, id2)] = BondData(forceK, bondDist);
+	bondEntries[bondKey(id2, id1)] = BondData(forceK, bondDist);
 }
 
 void SBScanner::processAngle(string line) {
@@ -45,7 +67,7 @@ void SBScanner::processAngle(string line) {
     midAtom = midAtom.substr(0, 1);
   }
 
-  if (end2.substr(7, 1) == " ") {
+  if (line.substr(7, 1) == " ") {
     end2 = end2.substr(0, 1);
   }
 
@@ -54,10 +76,9 @@ void SBScanner::processAngle(string line) {
 	stringstream ss(rest_of_line);
 	ss >> angleK >> angle;
 
-  angleDataMap[end1][midAtom][end2].kAngle = angleK;
-	angleDataMap[end2][midAtom][end1].kAngle = angleK;
-	angleDataMap[end1][midAtom][end2].eqAngle = angle;
-	angleDataMap[end2][midAtom][end1].eqAngle = angle;
+	int id1 = internType(end1), mid = internType(midAtom), id2 = internType(end2);
+	angleTable[angleKey(id1, mid, id2)] = AngleData(angleK, angle);
+	angleTable[angleKey(id2, mid, id1)] = AngleData(angleK, angle);
 }
 
 void SBScanner::processLine(string line) {
@@ -67,13 +88,26 @@ void SBScanner::processLine(string line) {
 		processBond(line);
 }
 
+void SBScanner::buildBondTable() {
+	int numTypes = typeIds.size();
+	bondTable.assign(numTypes * numTypes, BondData(-1, -1));
+
+	unordered_map<unsigned long long, BondData>::iterator it;
+	for (it = bondEntries.begin(); it != bondEntries.end(); it++) {
+		int id1 = it->first >> 32, id2 = it->first & 0xFFFFFFFF;
+		bondTable[id1 * numTypes + id2] = it->second;
+	}
+	bondEntries.clear();
+}
+
 SBScanner::SBScanner() {
 
 }
 
 SBScanner::~SBScanner() {
-	bondDataMap.clear();
-	angleDataMap.clear();
+	typeIds.clear();
+	bondTable.clear();
+	angleTable.clear();
 }
 
 bool SBScanner::readInSB(string filename) {
@@ -84,6 +118,12 @@ bool SBScanner::readInSB(string filename) {
 		return false;
 	}
 
+	uint64_t sourceHash;
+	bool hashed = ParameterCache::hashFile(filename, sourceHash);
+	string cachePath = filename + PARAMETER_CACHE_EXT;
+	if (hashed && loadCache(cachePath, sourceHash))
+		return true;
+
 	int numOfLines=0;
 
   ifstream sbScanner(filename.c_str());
@@ -109,41 +149,120 @@ bool SBScanner::readInSB(string filename) {
     }
     sbScanner.close();
   }
+	buildBondTable();
+	if (hashed)
+		saveCache(cachePath, sourceHash);
+	return true;
+}
+
+bool SBScanner::loadCache(const string& cachePath, uint64_t sourceHash) {
+	ParameterCache::Reader cache(cachePath, PARAMETER_CACHE_SB, sourceHash);
+	if (!cache.isValid())
+		return false;
+
+	int numTypes = cache.getInt();
+	for (int i = 0; i < numTypes && cache.isValid(); i++)
+		typeIds[cache.getString()] = i;
+
+	// The bond table is stored as-is, so it is copied straight out of the map
+	size_t tableBytes = (size_t) numTypes * numTypes * sizeof(BondData);
+	const char* table = cache.getBytes(tableBytes);
+	if (table != NULL) {
+		bondTable.resize(numTypes * numTypes, BondData(-1, -1));
+		memcpy(&bondTable[0], table, tableBytes);
+	}
+
+	int numAngles = cache.getInt();
+	for (int i = 0; i < numAngles && cache.isValid(); i++) {
+		unsigned long long key;
+		const char* keyBytes = cache.getBytes(sizeof(key));
+		Real kAngle = cache.getReal(), eqAngle = cache.getReal();
+		if (keyBytes != NULL) {
+			memcpy(&key, keyBytes, sizeof(key));
+			angleTable[key] = AngleData(kAngle, eqAngle);
+		}
+	}
+
+	if (!cache.isValid() || typeIds.size() != numTypes) {
+		typeIds.clear();
+		bondTable.clear();
+		angleTable.clear();
+		return false;
+	}
 	return true;
 }
 
+void SBScanner::saveCache(const string& cachePath, uint64_t sourceHash) {
+	ParameterCache::Writer cache;
+	int numTypes = typeIds.size();
+
+	// Write the names in ID order so loading reassigns the same IDs
+	vector<const string*> names(numTypes);
+	for (unordered_map<string, int>::iterator it = typeIds.begin();
+	     it != typeIds.end(); it++)
+		names[it->second] = &it->first;
+
+	cache.putInt(numTypes);
+	for (int i = 0; i < numTypes; i++)
+		cache.putString(*names[i]);
+
+	if (!bondTable.empty())
+		cache.putBytes(&bondTable[0], bondTable.size() * sizeof(BondData));
+
+	cache.putInt(angleTable.size());
+	unordered_map<unsigned long long, AngleData>::iterator it;
+	for (it = angleTable.begin(); it != angleTable.end(); it++) {
+		cache.putBytes(&it->first, sizeof(it->first));
+		cache.putReal(it->second.kAngle);
+		cache.putReal(it->second.eqAngle);
+	}
+
+	// A read-only parameter directory just means the next run parses again
+	cache.save(cachePath, PARAMETER_CACHE_SB, sourceHash);
+}
+
+int SBScanner::getTypeId(const string& name) {
+	unordered_map<string, int>::iterator it = typeIds.find(name);
+	return it == typeIds.end() ? -1 : it->second;
+}
+
+BondData SBScanner::getBondData(int atom1, int atom2) {
+	int numTypes = typeIds.size();
+	if (atom1 < 0 || atom2 < 0 || bondTable.size() != numTypes * numTypes)
+		return BondData(-1, -1);
+	return bondTable[atom1 * numTypes + atom2];
+}
+
+AngleData SBScanner::getAngleData(int endpoint1, int middleAtom, int endpoint2) {
+	if (endpoint1 < 0 || middleAtom < 0 || endpoint2 < 0)
+		return AngleData(-1, -1);
+
+	unordered_map<unsigned long long, AngleData>::iterator it;
+	it = angleTable.find(angleKey(endpoint1, middleAtom, endpoint2));
+	if (it == angleTable.end())
+		return AngleData(-1, -1);
+	return it->second;
+}
+
+size_t SBScanner::getTableBytes() {
+	return mapBytes(typeIds) + bondTable.capacity() * sizeof(BondData) +
+	       mapBytes(bondEntries) + mapBytes(angleTable);
+}
+
 Real SBScanner::getKBond(string atom1, string atom2) {
-	if(bondDataMap.count(atom1) == 0)
-		return -1;
-	if(bondDataMap[atom1].count(atom2) == 0)
-		return -1;
-	return bondDataMap[atom1][atom2].kBond;
+	return getBondData(getTypeId(atom1), getTypeId(atom2)).kBond;
 }
 
 Real SBScanner::getEqBondDist(string atom1, string atom2) {
-	if(bondDataMap.count(atom1) == 0)
-		return -1;
-	if(bondDataMap[atom1].count(atom2) == 0)
-		return -1;
-	return bondDataMap[atom1][atom2].eqBondDist;
+	return getBondData(getTypeId(atom1), getTypeId(atom2)).eqBondDist;
 }
 
 Real SBScanner::getKAngle(string endpoint1, string middleAtom, string endpoint2) {
-	if(angleDataMap.count(endpoint1) == 0)
-		return -1;
-	if(angleDataMap[endpoint1].count(middleAtom) == 0)
-		return -1;
-	if(angleDataMap[endpoint1][middleAtom].count(endpoint2) == 0)
-		return -1;
-	return angleDataMap[endpoint1][middleAtom][endpoint2].kAngle;
+	return getAngleData(getTypeId(endpoint1), getTypeId(middleAtom),
+	                    getTypeId(endpoint2)).kAngle;
 }
 
 Real SBScanner::getEqAngle(string endpoint1, string middleAtom, string endpoint2) {
-	if(angleDataMap.count(endpoint1) == 0)
-		return -1;
-	if(angleDataMap[endpoint1].count(middleAtom) == 0)
-		return -1;
-	if(angleDataMap[endpoint1][middleAtom].count(endpoint2) == 0)
-		return -1;
-	return angleDataMap[endpoint1][middleAtom][endpoint2].eqAngle;
+	return getAngleData(getTypeId(endpoint1), getTypeId(middleAtom),
+	                    getTypeId(endpoint2)).eqAngle;
 }
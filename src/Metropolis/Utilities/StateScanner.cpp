@@ -492,7 +492,8 @@ void StateScanner::parsePrimaryIndexDefinitions(Environment* enviro, string defi
 
 
 
-void StateScanner::outputState(Environment *environment, Molecule *molecules, int numOfMolecules, int step, string filename, Real** atomCoords) {
+void StateScanner::outputState(Box* box, int step, string filename, Real** atomCoords) {
+  Environment* environment = box->getEnvironment();
   ofstream outFile;
   outFile.open(filename.c_str());
   outFile << environment->x << " " << environment->y << " "
@@ -506,9 +507,13 @@ void StateScanner::outputState(Environment *environment, Molecule *molecules, in
 
 	int aIdx = 0;
 
-  for (int i = 0; i < numOfMolecules; i++) {
-    Molecule currentMol = molecules[i];
-    outFile << currentMol.id << std::endl;
+  for (int i = 0; i < environment->numOfMolecules; i++) {
+    Molecule& currentMol = box->getTemplate(i);
+
+    // Template atom IDs are local to the molecule
+    int idOffset = aIdx;
+
+    outFile << box->moleculeIds[i] << std::endl;
 
     outFile << "= Type" << std::endl;
     outFile << currentMol.type << std::endl;
@@ -517,9 +522,9 @@ void StateScanner::outputState(Environment *environment, Molecule *molecules, in
     outFile << "= Atoms" << std::endl;
 
     for (int j = 0; j < currentMol.numOfAtoms; j++) {
-      Atom currentAtom = currentMol.atoms[j];
+      Atom& currentAtom = currentMol.atoms[j];
 
-      outFile << currentAtom.id << " "
+      outFile << currentAtom.id + idOffset << " "
               << atomCoords[0][aIdx] << " " << atomCoords[1][aIdx]
               << " " << atomCoords[2][aIdx] << " "
               << currentAtom.sigma << " "
@@ -534,9 +539,9 @@ void StateScanner::outputState(Environment *environment, Molecule *molecules, in
     outFile << "= Bonds" << std::endl;
 
     for (int j = 0; j < currentMol.numOfBonds; j++) {
-      Bond currentBond = currentMol.bonds[j];
-      outFile << currentBond.atom1 << " "
-              << currentBond.atom2 << " "
+      Bond& currentBond = currentMol.bonds[j];
+      outFile << currentBond.atom1 + idOffset << " "
+              << currentBond.atom2 + idOffset << " "
               << currentBond.distance << " ";
 
       if (currentBond.variable) {
@@ -550,9 +555,9 @@ void StateScanner::outputState(Environment *environment, Molecule *molecules, in
     outFile << "= Dihedrals" << std::endl;
 
     for (int j = 0; j < currentMol.numOfDihedrals; j++) {
-      Dihedral currentDi = currentMol.dihedrals[j];
-      outFile << currentDi.atom1 << " "
-              << currentDi.atom2 << " "
+      Dihedral& currentDi = currentMol.dihedrals[j];
+      outFile << currentDi.atom1 + idOffset << " "
+              << currentDi.atom2 + idOffset << " "
               << currentDi.value << " ";
 
       if (currentDi.variable) {
@@ -566,10 +571,10 @@ void StateScanner::outputState(Environment *environment, Molecule *molecules, in
     outFile << "= Hops" << std::endl;
 
     for (int j = 0; j < currentMol.numOfHops; j++) {
-      Hop currentHop = currentMol.hops[j];
+      Hop& currentHop = currentMol.hops[j];
 
-      outFile << currentHop.atom1 << " "
-              << currentHop.atom2 << " "
+      outFile << currentHop.atom1 + idOffset << " "
+              << currentHop.atom2 + idOffset << " "
               << currentHop.hop << std::endl;
     }
 
@@ -577,10 +582,10 @@ void StateScanner::outputState(Environment *environment, Molecule *molecules, in
     outFile << "= Angles" << std::endl;
 
     for (int j = 0; j < currentMol.numOfAngles; j++) {
-      Angle currentAngle = currentMol.angles[j];
+      Angle& currentAngle = currentMol.angles[j];
 
-      outFile << currentAngle.atom1 << " "
-              << currentAngle.atom2 << " "
+      outFile << currentAngle.atom1 + idOffset << " "
+              << currentAngle.atom2 + idOffset << " "
               << currentAngle.value << " ";
 
       if(currentAngle.variable) {
@@ -19,13 +19,6 @@
 
 
 
-struct NLC_Node {
-	int index; // The molecule index that this node holds.
-	struct NLC_Node* next; // The next node in this NLC chain.
-
-	NLC_Node() {};
-};
-
 /**
  * This struct contains data about the bond between two atoms.
  */
@@ -0,0 +1,139 @@
+/**
+ * Timer.cpp
+ *
+ * Wall-clock timing for the phases of a run
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "Timer.h"
+#include "Tracer.h"
+
+#define PHASE_NUM_BUCKETS (PHASE_OCTAVES * PHASE_BUCKETS_PER_OCTAVE)
+
+double wallClockSeconds() {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec + now.tv_nsec * 1e-9;
+}
+
+/** @return the histogram bucket of a duration */
+static int bucketOf(double seconds) {
+  if (seconds <= PHASE_MIN_SECONDS) {
+    return 0;
+  }
+  // frexp splits the ratio into mantissa in [0.5, 1) and a power of two
+  int exponent;
+  double mantissa = frexp(seconds / PHASE_MIN_SECONDS, &exponent);
+  int bucket = (exponent - 1) * PHASE_BUCKETS_PER_OCTAVE +
+               (int) ((2 * mantissa - 1) * PHASE_BUCKETS_PER_OCTAVE);
+  return bucket < PHASE_NUM_BUCKETS ? bucket : PHASE_NUM_BUCKETS - 1;
+}
+
+/** @return the duration in the middle of a histogram bucket */
+static double bucketMiddle(int bucket) {
+  int octave = bucket / PHASE_BUCKETS_PER_OCTAVE;
+  double step = (bucket % PHASE_BUCKETS_PER_OCTAVE + 0.5) /
+                PHASE_BUCKETS_PER_OCTAVE;
+  return ldexp(PHASE_MIN_SECONDS * (1 + step), octave);
+}
+
+/** Appends a duration with units suited to its size */
+static void appendDuration(std::string& out, double seconds) {
+  char buffer[32];
+  if (seconds >= 1) {
+    snprintf(buffer, sizeof(buffer), "%.3f s", seconds);
+  } else if (seconds >= 1e-3) {
+    snprintf(buffer, sizeof(buffer), "%.3f ms", seconds * 1e3);
+  } else {
+    snprintf(buffer, sizeof(buffer), "%.2f us", seconds * 1e6);
+  }
+  out.append(buffer);
+}
+
+PhaseTimer::PhaseTimer(const std::string& name_in) {
+  name = name_in;
+  startTime = 0;
+  count = 0;
+  total = min = max = 0;
+  memset(buckets, 0, sizeof(buckets));
+}
+
+void PhaseTimer::stop() {
+  double end = wallClockSeconds();
+  add(end - startTime);
+  if (Tracer::isMoveSampled()) {
+    Tracer::record(name.c_str(), startTime, end);
+  }
+}
+
+void PhaseTimer::add(double seconds) {
+  if (count == 0 || seconds < min) {
+    min = seconds;
+  }
+  if (count == 0 || seconds > max) {
+    max = seconds;
+  }
+  count++;
+  total += seconds;
+  buckets[bucketOf(seconds)]++;
+}
+
+double PhaseTimer::getPercentile(double fraction) const {
+  if (count == 0) {
+    return 0;
+  }
+  long rank = (long) ceil(fraction * count);
+  if (rank < 1) {
+    rank = 1;
+  }
+
+  long seen = 0;
+  int bucket = 0;
+  while (bucket < PHASE_NUM_BUCKETS - 1 &&
+         (seen += buckets[bucket]) < rank) {
+    bucket++;
+  }
+
+  // The exact extremes are better than the middle of their bucket, and the
+  // last bucket also holds everything too long for the histogram
+  if (rank >= count || bucket == PHASE_NUM_BUCKETS - 1) {
+    return max;
+  }
+  double seconds = bucketMiddle(bucket);
+  return seconds < min ? min : seconds > max ? max : seconds;
+}
+
+JsonObject PhaseTimer::toJson() const {
+  JsonObject out;
+  out.add("count", count).add("total", total).add("mean", getMean());
+  out.add("p50", getPercentile(0.5)).add("p90", getPercentile(0.9));
+  out.add("p99", getPercentile(0.99)).add("max", max);
+  return out;
+}
+
+std::string PhaseTimer::summary() const {
+  std::string out = "total ";
+  appendDuration(out, total);
+  char buffer[32];
+  snprintf(buffer, sizeof(buffer), " over %ld", count);
+  out.append(buffer);
+  if (count == 0) {
+    return out;
+  }
+
+  out.append(", mean ");
+  appendDuration(out, getMean());
+  const double fractions[] = {0.5, 0.9, 0.99};
+  const char* labels[] = {"p50", "p90", "p99"};
+  for (int i = 0; i < 3; i++) {
+    out.append(", ").append(labels[i]).append(" ");
+    appendDuration(out, getPercentile(fractions[i]));
+  }
+  out.append(", max ");
+  appendDuration(out, max);
+  return out;
+}
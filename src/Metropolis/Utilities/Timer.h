@@ -0,0 +1,118 @@
+/**
+ * Timer.h
+ *
+ * Wall-clock timing for the phases of a run. clock() reports the CPU time of
+ * every thread added together, so it overstates phases that run in parallel.
+ */
+
+#ifndef TIMER_H
+#define TIMER_H
+
+#include <stddef.h>
+#include <string>
+
+#include "Json.h"
+
+/** The number of histogram buckets each doubling of a duration spans */
+#define PHASE_BUCKETS_PER_OCTAVE 8
+
+/** The number of doublings of PHASE_MIN_SECONDS the histogram covers */
+#define PHASE_OCTAVES 40
+
+/** The shortest duration told apart by a PhaseTimer's histogram */
+#define PHASE_MIN_SECONDS 1e-9
+
+/**
+ * Returns the seconds elapsed on a monotonic clock since an arbitrary point.
+ *     Only differences between two calls are meaningful.
+ */
+double wallClockSeconds();
+
+/**
+ * Collects the wall-clock durations of one phase of a run, such as computing
+ * the old energy of each step. The total, mean and extremes are exact; the
+ * percentiles come from a logarithmic histogram, so they are good to within
+ * one bucket (about 9%) and the memory used does not grow with the run.
+ */
+class PhaseTimer {
+ public:
+  /** Constructs an empty timer for the named phase */
+  explicit PhaseTimer(const std::string& name);
+
+  /** Starts timing one occurrence of the phase */
+  void start() {startTime = wallClockSeconds();}
+
+  /**
+   * Stops timing the occurrence started last and records its duration. On
+   * moves sampled by the Tracer, the occurrence is also added to the trace.
+   */
+  void stop();
+
+  /** Records one occurrence of the phase that took the given seconds */
+  void add(double seconds);
+
+  /** @return the name of the phase */
+  const std::string& getName() const {return name;}
+
+  /** @return the number of occurrences recorded */
+  long getCount() const {return count;}
+
+  /** @return the seconds taken by every occurrence together */
+  double getTotal() const {return total;}
+
+  /** @return the mean seconds per occurrence, or 0 if there were none */
+  double getMean() const {return count > 0 ? total / count : 0;}
+
+  /** @return the longest occurrence in seconds */
+  double getMax() const {return max;}
+
+  /**
+   * @param fraction The fraction of occurrences at or below the result,
+   *     from 0 to 1; 0.5 gives the median.
+   * @return the approximate duration of that percentile in seconds
+   */
+  double getPercentile(double fraction) const;
+
+  /**
+   * @return the statistics on one line, for the results file, such as
+   *     "total 1.234 s, mean 2.10 us, p50 2.00 us, p90 ..."
+   */
+  std::string summary() const;
+
+  /**
+   * @return the count and, in seconds, the total, mean, percentiles and
+   *     longest occurrence
+   */
+  JsonObject toJson() const;
+
+ private:
+  std::string name;
+  double startTime;
+  long count;
+  double total, min, max;
+  long buckets[PHASE_OCTAVES * PHASE_BUCKETS_PER_OCTAVE];
+};
+
+/**
+ * Times the enclosing scope as one occurrence of a phase. A NULL timer makes
+ * it do nothing.
+ */
+class ScopedPhase {
+ public:
+  explicit ScopedPhase(PhaseTimer* timer_in) : timer(timer_in) {
+    if (timer != NULL) {
+      timer->start();
+    }
+  }
+
+  ~ScopedPhase() {
+    if (timer != NULL) {
+      timer->stop();
+    }
+  }
+
+ private:
+  PhaseTimer* timer;
+};
+
+#endif
@@ -0,0 +1,150 @@
+/**
+ * Tracer.cpp
+ *
+ * Records a timeline of the run as a Chrome trace
+ */
+
+#include "Tracer.h"
+
+#include <stdio.h>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <vector>
+
+#include "Json.h"
+#include "Timer.h"
+
+/** One completed event */
+struct TraceEvent {
+  const char* name;
+  double start;
+  double end;
+};
+
+/** The events of one thread, oldest overwritten first */
+struct TraceBuffer {
+  int thread;
+  const char* name;
+  long long recorded;
+  TraceEvent events[TRACE_BUFFER_EVENTS];
+};
+
+static double origin = 0;
+static int sampleInterval = 1;
+
+/** Every thread's buffer, in the order the threads first recorded */
+static std::vector<TraceBuffer*> buffers;
+static std::mutex buffersLock;
+
+static thread_local TraceBuffer* threadBuffer = NULL;
+
+/** @return the calling thread's buffer, creating it the first time */
+static TraceBuffer* getBuffer() {
+  if (threadBuffer == NULL) {
+    threadBuffer = new TraceBuffer();
+    threadBuffer->name = NULL;
+    threadBuffer->recorded = 0;
+    std::lock_guard<std::mutex> guard(buffersLock);
+    threadBuffer->thread = buffers.size();
+    buffers.push_back(threadBuffer);
+  }
+  return threadBuffer;
+}
+
+std::atomic<bool> Tracer::enabled(false);
+std::atomic<bool> Tracer::moveSampled(false);
+
+void Tracer::start(int sampleInterval_in) {
+  sampleInterval = sampleInterval_in > 0 ? sampleInterval_in : 1;
+  origin = wallClockSeconds();
+  enabled.store(true, std::memory_order_relaxed);
+}
+
+void Tracer::sampleMove(long move) {
+  moveSampled.store(isEnabled() && move % sampleInterval == 0,
+                    std::memory_order_relaxed);
+}
+
+void Tracer::nameThread(const char* name) {
+  if (isEnabled()) {
+    getBuffer()->name = name;
+  }
+}
+
+void Tracer::record(const char* name, double start, double end) {
+  if (!isEnabled()) {
+    return;
+  }
+  TraceBuffer* buffer = getBuffer();
+  TraceEvent& event = buffer->events[buffer->recorded % TRACE_BUFFER_EVENTS];
+  event.name = name;
+  event.start = start;
+  event.end = end;
+  buffer->recorded++;
+}
+
+bool Tracer::write(const std::string& path) {
+  enabled.store(false, std::memory_order_relaxed);
+  moveSampled.store(false, std::memory_order_relaxed);
+
+  std::ofstream out(path.c_str());
+  out << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [";
+  bool first = true;
+  long long dropped = 0;
+
+  std::lock_guard<std::mutex> guard(buffersLock);
+  for (int b = 0; b < buffers.size(); b++) {
+    TraceBuffer* buffer = buffers[b];
+    char defaultName[32];
+    snprintf(defaultName, sizeof(defaultName), "Thread %d", buffer->thread);
+    out << (first ? "\n" : ",\n")
+        << "{\"ph\": \"M\", \"name\": \"thread_name\", \"pid\": 1, \"tid\": "
+        << buffer->thread << ", \"args\": {\"name\": ";
+    out << JsonObject::quote(buffer->name != NULL ? buffer->name :
+                             defaultName);
+    out << "}}";
+    first = false;
+
+    long long oldest = 0;
+    if (buffer->recorded > TRACE_BUFFER_EVENTS) {
+      oldest = buffer->recorded - TRACE_BUFFER_EVENTS;
+      dropped += oldest;
+    }
+    for (long long i = oldest; i < buffer->recorded; i++) {
+      const TraceEvent& event = buffer->events[i % TRACE_BUFFER_EVENTS];
+      char times[96];
+      snprintf(times, sizeof(times), "\"ts\": %.3f, \"dur\": %.3f",
+               (event.start - origin) * 1e6,
+               (event.end - event.start) * 1e6);
+      out << ",\n{\"ph\": \"X\", \"name\": ";
+      out << JsonObject::quote(event.name);
+      out << ", \"pid\": 1, \"tid\": " << buffer->thread << ", " << times
+          << "}";
+    }
+  }
+  out << "\n]}\n";
+  out.close();
+
+  if (!out) {
+    std::cerr << "Error: Tracer::write(): Unable to write " << path
+              << std::endl;
+    return false;
+  }
+  if (dropped > 0) {
+    fprintf(stdout, "Trace: the oldest %lld events did not fit in the "
+            "buffers\n", dropped);
+  }
+  return true;
+}
+
+TraceScope::TraceScope(const char* name_in, bool record) {
+  name = record ? name_in : NULL;
+  start = name != NULL ? wallClockSeconds() : 0;
+}
+
+TraceScope::~TraceScope() {
+  if (name != NULL) {
+    Tracer::record(name, start, wallClockSeconds());
+  }
+}
@@ -0,0 +1,97 @@
+/**
+ * Tracer.h
+ *
+ * Records a timeline of the run for --trace, written at the end as a Chrome
+ * trace (JSON), which chrome://tracing and the Perfetto UI display with one
+ * row per thread. Startup phases, status updates, state saves, output writes
+ * and rebuilds of the neighbor structures are always recorded; the phases of
+ * each step and the tasks of the parallel energy kernels only on every Nth
+ * move, which keeps the cost of tracing long runs small.
+ *
+ * Each thread records into its own ring buffer, so recording takes no locks.
+ * A full buffer overwrites its oldest events. The buffers are only read by
+ * Tracer::write(), once the other threads have finished their work.
+ */
+
+#ifndef TRACER_H
+#define TRACER_H
+
+#include <atomic>
+#include <string>
+
+/** The number of events each thread's ring buffer holds */
+#define TRACE_BUFFER_EVENTS 65536
+
+namespace Tracer {
+  /**
+   * True while events are being recorded. Other threads read the flags while
+   * the main thread sets them, so they are atomic; relaxed loads suffice, as
+   * nothing else is published through them.
+   */
+  extern std::atomic<bool> enabled;
+
+  /** True if the phases of the current move are being recorded */
+  extern std::atomic<bool> moveSampled;
+
+  /** @return Tracer::enabled, read with a relaxed load */
+  inline bool isEnabled() {
+    return enabled.load(std::memory_order_relaxed);
+  }
+
+  /** @return Tracer::moveSampled, read with a relaxed load */
+  inline bool isMoveSampled() {
+    return moveSampled.load(std::memory_order_relaxed);
+  }
+
+  /**
+   * Starts recording. Event times are measured from this call.
+   *
+   * @param sampleInterval Record the phases of every sampleInterval-th move.
+   */
+  void start(int sampleInterval);
+
+  /** Decides whether the phases of a move are recorded. */
+  void sampleMove(long move);
+
+  /**
+   * Names the calling thread's row in the trace. Threads not named are shown
+   * as "Thread <n>".
+   *
+   * @param name The name, which must outlive the call to write().
+   */
+  void nameThread(const char* name);
+
+  /**
+   * Records an event on the calling thread, if recording.
+   *
+   * @param name The event name, which must outlive the call to write().
+   * @param start The wallClockSeconds() at which the event began.
+   * @param end The wallClockSeconds() at which the event ended.
+   */
+  void record(const char* name, double start, double end);
+
+  /**
+   * Writes every recorded event to a Chrome trace file and stops recording.
+   *
+   * @param path The file to write.
+   * @return false if the file could not be written.
+   */
+  bool write(const std::string& path);
+}
+
+/**
+ * Records the enclosing scope as a trace event. Does nothing unless record is
+ * true, so per-move events pass Tracer::isMoveSampled() and the rest
+ * Tracer::isEnabled().
+ */
+class TraceScope {
+ public:
+  TraceScope(const char* name_in, bool record);
+  ~TraceScope();
+
+ private:
+  const char* name;
+  double start;
+};
+
+#endif
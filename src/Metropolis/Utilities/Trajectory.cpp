@@ -0,0 +1,283 @@
+/**
+ * Trajectory.cpp
+ *
+ * Binary trajectory writer and memory-mapped reader
+ */
+
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <iostream>
+
+#include "Trajectory.h"
+
+// Size of the fixed part of the header, before the per-molecule table.
+#define TRAJECTORY_HEADER_SIZE (TRAJECTORY_MAGIC_LEN + 3 * sizeof(int32_t) + \
+                                3 * sizeof(float))
+
+std::string getTrajectoryIndexPath(const std::string& trajPath) {
+  std::string ext = TRAJECTORY_EXT;
+  if (trajPath.size() >= ext.size() &&
+      trajPath.compare(trajPath.size() - ext.size(), ext.size(), ext) == 0) {
+    return trajPath.substr(0, trajPath.size() - ext.size()) +
+           TRAJECTORY_INDEX_EXT;
+  }
+  return trajPath + TRAJECTORY_INDEX_EXT;
+}
+
+TrajectoryWriter::TrajectoryWriter(const std::string& path, int numAtoms,
+                                   int numMolecules, const int* molStart,
+                                   const int* molLen, const int* molType,
+                                   const Real* size) {
+  this->numAtoms = numAtoms;
+  offset = 0;
+  frameCount = 0;
+  frameBuffer = new float[numAtoms];
+
+  trajFile = fopen(path.c_str(), "wb");
+  indexFile = fopen(getTrajectoryIndexPath(path).c_str(), "wb");
+  if (trajFile == NULL || indexFile == NULL) {
+    std::cerr << "Error: TrajectoryWriter(): could not open trajectory ("
+              << path << ")" << std::endl;
+    return;
+  }
+
+  int32_t counts[3] = {TRAJECTORY_VERSION, numAtoms, numMolecules};
+  float box[3] = {(float) size[0], (float) size[1], (float) size[2]};
+  fwrite(TRAJECTORY_MAGIC, 1, TRAJECTORY_MAGIC_LEN, trajFile);
+  fwrite(counts, sizeof(int32_t), 3, trajFile);
+  fwrite(box, sizeof(float), 3, trajFile);
+
+  for (int i = 0; i < numMolecules; i++) {
+    int32_t mol[3] = {molStart[i], molLen[i], molType[i]};
+    fwrite(mol, sizeof(int32_t), 3, trajFile);
+  }
+
+  offset = TRAJECTORY_HEADER_SIZE + 3 * sizeof(int32_t) * numMolecules;
+}
+
+TrajectoryWriter::~TrajectoryWriter() {
+  if (trajFile != NULL)
+    fclose(trajFile);
+  if (indexFile != NULL)
+    fclose(indexFile);
+  delete[] frameBuffer;
+}
+
+bool TrajectoryWriter::isOpen() {
+  return trajFile != NULL && indexFile != NULL;
+}
+
+void TrajectoryWriter::appendFrame(long step, Real** atomCoords) {
+  if (!isOpen())
+    return;
+
+  int64_t frameStep = step;
+  fwrite(&frameStep, sizeof(int64_t), 1, trajFile);
+  for (int dim = 0; dim < 3; dim++) {
+    for (int i = 0; i < numAtoms; i++) {
+      frameBuffer[i] = (float) atomCoords[dim][i];
+    }
+    fwrite(frameBuffer, sizeof(float), numAtoms, trajFile);
+  }
+
+  fwrite(&offset, sizeof(uint64_t), 1, indexFile);
+  offset += sizeof(int64_t) + 3 * sizeof(float) * numAtoms;
+  frameCount++;
+}
+
+long TrajectoryWriter::getFrameCount() {
+  return frameCount;
+}
+
+/**
+ * Maps a whole file read-only. Returns NULL (and a size of 0) if the file
+ * can't be opened or is empty.
+ */
+static const void* mapFile(const std::string& path, size_t& size) {
+  size = 0;
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0)
+    return NULL;
+
+  struct stat info;
+  if (fstat(fd, &info) != 0 || info.st_size == 0) {
+    close(fd);
+    return NULL;
+  }
+
+  void* data = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (data == MAP_FAILED)
+    return NULL;
+
+  size = info.st_size;
+  return data;
+}
+
+TrajectoryReader::TrajectoryReader(const std::string& path) {
+  numAtoms = 0;
+  numMolecules = 0;
+  numFrames = 0;
+  frameSize = 0;
+  molecules = NULL;
+  boxSize = NULL;
+  index = NULL;
+  indexSize = 0;
+
+  trajData = (const char*) mapFile(path, trajSize);
+  if (trajData == NULL || trajSize < TRAJECTORY_HEADER_SIZE ||
+      memcmp(trajData, TRAJECTORY_MAGIC, TRAJECTORY_MAGIC_LEN) != 0) {
+    std::cerr << "Error: TrajectoryReader(): not a valid trajectory ("
+              << path << ")" << std::endl;
+    return;
+  }
+
+  const int32_t* counts = (const int32_t*) (trajData + TRAJECTORY_MAGIC_LEN);
+  if (counts[0] != TRAJECTORY_VERSION) {
+    std::cerr << "Error: TrajectoryReader(): unsupported trajectory version "
+              << counts[0] << std::endl;
+    return;
+  }
+  if (counts[1] < 0 || counts[2] < 0) {
+    std::cerr << "Error: TrajectoryReader(): corrupt header, " << counts[1]
+              << " atoms and " << counts[2] << " molecules (" << path << ")"
+              << std::endl;
+    return;
+  }
+
+  // The molecule table has to fit in the file, and every molecule in it has
+  // to lie within the atoms of a frame
+  uint64_t tableEnd = TRAJECTORY_HEADER_SIZE +
+                      3 * sizeof(int32_t) * (uint64_t) counts[2];
+  if (tableEnd > trajSize) {
+    std::cerr << "Error: TrajectoryReader(): the table of " << counts[2]
+              << " molecules runs past the end of the file (" << path << ")"
+              << std::endl;
+    return;
+  }
+  const int32_t* table = (const int32_t*) (trajData + TRAJECTORY_HEADER_SIZE);
+  for (int i = 0; i < counts[2]; i++) {
+    int32_t start = table[3 * i], len = table[3 * i + 1];
+    if (start < 0 || len < 0 || (int64_t) start + len > counts[1]) {
+      std::cerr << "Error: TrajectoryReader(): molecule " << i << " has atoms "
+                << start << " to " << (int64_t) start + len << " of only "
+                << counts[1] << " (" << path << ")" << std::endl;
+      return;
+    }
+  }
+
+  // Every frame the index lists has to lie within the file, after the header
+  uint64_t size = sizeof(int64_t) + 3 * sizeof(float) * (uint64_t) counts[1];
+  size_t mappedIndexSize;
+  const uint64_t* offsets = (const uint64_t*)
+      mapFile(getTrajectoryIndexPath(path), mappedIndexSize);
+  long frames = mappedIndexSize / sizeof(uint64_t);
+  for (long k = 0; k < frames; k++) {
+    if (offsets[k] < tableEnd || offsets[k] > trajSize ||
+        size > trajSize - offsets[k]) {
+      std::cerr << "Error: TrajectoryReader(): frame " << k << " of " << frames
+                << " at byte " << offsets[k] << " runs past the end of the "
+                << trajSize << "-byte trajectory, or into its header ("
+                << path << ")" << std::endl;
+      munmap((void*) offsets, mappedIndexSize);
+      return;
+    }
+  }
+
+  numAtoms = counts[1];
+  numMolecules = counts[2];
+  boxSize = (const float*) (counts + 3);
+  molecules = table;
+  index = offsets;
+  indexSize = mappedIndexSize;
+  numFrames = frames;
+  frameSize = size;
+}
+
+TrajectoryReader::~TrajectoryReader() {
+  if (trajData != NULL)
+    munmap((void*) trajData, trajSize);
+  if (index != NULL)
+    munmap((void*) index, indexSize);
+}
+
+bool TrajectoryReader::isOpen() {
+  return trajData != NULL && molecules != NULL;
+}
+
+int TrajectoryReader::getAtomCount() {
+  return numAtoms;
+}
+
+int TrajectoryReader::getMoleculeCount() {
+  return numMolecules;
+}
+
+long TrajectoryReader::getFrameCount() {
+  return numFrames;
+}
+
+const float* TrajectoryReader::getBoxSize() {
+  return boxSize;
+}
+
+bool TrajectoryReader::checkMolecule(int molIdx) {
+  if (molIdx < 0 || molIdx >= numMolecules) {
+    std::cerr << "Error: TrajectoryReader: molecule " << molIdx
+              << " is out of range; the trajectory has " << numMolecules
+              << std::endl;
+    return false;
+  }
+  return true;
+}
+
+bool TrajectoryReader::checkFrame(long k) {
+  if (k < 0 || k >= numFrames) {
+    std::cerr << "Error: TrajectoryReader: frame " << k
+              << " is out of range; the trajectory has " << numFrames
+              << std::endl;
+    return false;
+  }
+  if (index[k] > trajSize || frameSize > trajSize - index[k]) {
+    std::cerr << "Error: TrajectoryReader: frame " << k
+              << " runs past the end of the trajectory" << std::endl;
+    return false;
+  }
+  return true;
+}
+
+int TrajectoryReader::getMoleculeStart(int molIdx) {
+  return checkMolecule(molIdx) ? molecules[3 * molIdx] : -1;
+}
+
+int TrajectoryReader::getMoleculeLength(int molIdx) {
+  return checkMolecule(molIdx) ? molecules[3 * molIdx + 1] : -1;
+}
+
+int TrajectoryReader::getMoleculeType(int molIdx) {
+  return checkMolecule(molIdx) ? molecules[3 * molIdx + 2] : -1;
+}
+
+long TrajectoryReader::getFrameStep(long k) {
+  if (!checkFrame(k))
+    return -1;
+
+  // The step isn't necessarily 8-byte aligned within the file.
+  int64_t step;
+  memcpy(&step, trajData + index[k], sizeof(int64_t));
+  return step;
+}
+
+const float* TrajectoryReader::getFrameCoords(long k, int dim) {
+  if (!checkFrame(k))
+    return NULL;
+  if (dim < 0 || dim >= 3) {
+    std::cerr << "Error: TrajectoryReader: no axis " << dim << std::endl;
+    return NULL;
+  }
+  const char* frame = trajData + index[k] + sizeof(int64_t);
+  return ((const float*) frame) + (size_t) dim * numAtoms;
+}
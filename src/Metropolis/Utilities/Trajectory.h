@@ -0,0 +1,154 @@
+/**
+ * Trajectory.h
+ *
+ * Reading and writing of binary trajectory files.
+ *
+ * A trajectory file (*.traj) starts with a header describing the system,
+ * followed by a sequence of fixed-size frames:
+ *
+ *   header:  char[8]   magic ("MCGPUTRJ")
+ *            int32     format version
+ *            int32     number of atoms
+ *            int32     number of molecules
+ *            float32   box dimensions [x, y, z]
+ *            int32     per molecule: first atom, atom count, molecule type
+ *   frame:   int64     simulation step
+ *            float32   x coordinates [numAtoms]
+ *            float32   y coordinates [numAtoms]
+ *            float32   z coordinates [numAtoms]
+ *
+ * Every frame appended to the trajectory also appends its byte offset, as a
+ * uint64, to a sidecar index file (*.trajidx). Analysis tools can map both
+ * files and seek straight to frame k without scanning the trajectory.
+ */
+
+#ifndef TRAJECTORY_H
+#define TRAJECTORY_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+
+#include "Metropolis/DataTypes.h"
+
+#define TRAJECTORY_MAGIC "MCGPUTRJ"
+#define TRAJECTORY_MAGIC_LEN 8
+#define TRAJECTORY_VERSION 1
+#define TRAJECTORY_EXT ".traj"
+#define TRAJECTORY_INDEX_EXT ".trajidx"
+
+class TrajectoryWriter {
+  public:
+    /**
+     * Creates the trajectory and its index, and writes the header.
+     *
+     * @param path The path of the trajectory file. The index is written to
+     *     the same path with TRAJECTORY_INDEX_EXT appended in place of
+     *     TRAJECTORY_EXT.
+     * @param numAtoms The number of atoms in each frame.
+     * @param numMolecules The number of molecules in the system.
+     * @param molStart The index of the first atom of each molecule.
+     * @param molLen The number of atoms in each molecule.
+     * @param molType The type of each molecule.
+     * @param size Real[3]. The dimensions of the box.
+     */
+    TrajectoryWriter(const std::string& path, int numAtoms, int numMolecules,
+                     const int* molStart, const int* molLen,
+                     const int* molType, const Real* size);
+
+    /** Closes the trajectory and index files. */
+    ~TrajectoryWriter();
+
+    /** True if both files were created successfully. */
+    bool isOpen();
+
+    /**
+     * Appends a frame to the trajectory and its offset to the index.
+     *
+     * @param step The simulation step of the frame.
+     * @param atomCoords Real[3][numAtoms]. The atom coordinates.
+     */
+    void appendFrame(long step, Real** atomCoords);
+
+    /** The number of frames written so far. */
+    long getFrameCount();
+
+  private:
+    FILE* trajFile;
+    FILE* indexFile;
+    int numAtoms;
+    uint64_t offset;
+    long frameCount;
+    float* frameBuffer;
+};
+
+class TrajectoryReader {
+  public:
+    /**
+     * Maps a trajectory and its index into memory.
+     *
+     * @param path The path of the trajectory file.
+     */
+    TrajectoryReader(const std::string& path);
+
+    /** Unmaps the trajectory and index. */
+    ~TrajectoryReader();
+
+    /**
+     * True if the trajectory and index were mapped, the header is valid and
+     * every frame the index lists lies within the trajectory.
+     */
+    bool isOpen();
+
+    int getAtomCount();
+    int getMoleculeCount();
+    long getFrameCount();
+
+    /** The box dimensions stored in the header, as float[3]. */
+    const float* getBoxSize();
+
+    /**
+     * The first atom, atom count and type of the given molecule, or -1 if
+     * there is no such molecule.
+     */
+    int getMoleculeStart(int molIdx);
+    int getMoleculeLength(int molIdx);
+    int getMoleculeType(int molIdx);
+
+    /** The simulation step of frame k, or -1 if there is no frame k. */
+    long getFrameStep(long k);
+
+    /**
+     * The coordinates of frame k along one axis, pointing directly into the
+     * mapped file, or NULL if there is no frame k.
+     *
+     * @param k The frame number, starting at zero.
+     * @param dim X_COORD, Y_COORD or Z_COORD.
+     */
+    const float* getFrameCoords(long k, int dim);
+
+  private:
+    const char* trajData;
+    size_t trajSize;
+    const uint64_t* index;
+    size_t indexSize;
+    int numAtoms;
+    int numMolecules;
+    long numFrames;
+    uint64_t frameSize;
+    const int32_t* molecules;
+    const float* boxSize;
+
+    /** Reports an error and returns false if there is no molecule molIdx. */
+    bool checkMolecule(int molIdx);
+
+    /** Reports an error and returns false if there is no frame k. */
+    bool checkFrame(long k);
+};
+
+/**
+ * Returns the path of the index file belonging to a trajectory.
+ */
+std::string getTrajectoryIndexPath(const std::string& trajPath);
+
+#endif
@@ -282,20 +282,21 @@ void ZmatrixScanner::handleZAdditions(string line, int cmdFormat) {
 vector<Hop> ZmatrixScanner::calculateHops(Molecule molec)
 {
     vector<Hop> newHops;
-    int **graph;
+    vector< vector<int> > adjacency;
+    vector<int> distance;
     int size = molec.numOfAtoms;
 	int startId = molec.atoms[0].id;
 
-    buildAdjacencyMatrix(graph,molec);
+    buildAdjacencyList(adjacency, molec);
 
     for(int atom1=0; atom1<size; atom1++)
     {
+        findHopDistances(atom1, adjacency, distance);
         for(int atom2=atom1+1; atom2<size; atom2++)
         {
-            int distance = findHopDistance(atom1,atom2,size,graph);
-            if(distance >=3)
+            if(distance[atom2] >=3)
             {
-				Hop tempHop = Hop(atom1+startId,atom2+startId,distance); //+startId because atoms may not start at 1
+				Hop tempHop = Hop(atom1+startId,atom2+startId,distance[atom2]); //+startId because atoms may not start at 1
                 newHops.push_back(tempHop);
             }
         }
@@ -304,90 +305,47 @@ vector<Hop> ZmatrixScanner::calculateHops(Molecule molec)
     return newHops;
 }
 
-bool ZmatrixScanner::contains(vector<int> &vect, int item)
-{
-    for(int i=0; i<vect.size(); i++)
-    {
-        if(vect[i]==item)
-        {
-            return true;
-        }
-    }
-
-    return false;
-}
-
-
-int ZmatrixScanner::findHopDistance(int atom1, int atom2, int size, int **graph) {
-  map<int, int> distance;
-  queue<int> Queue;
-  vector<int> checked;
-  vector<int> bonds;
-
-  Queue.push(atom1);
-  checked.push_back(atom1);
-  distance.insert(pair<int, int>(atom1, 0));
+void ZmatrixScanner::findHopDistances(int source, vector< vector<int> > &adjacency,
+                                      vector<int> &distance) {
+  int size = adjacency.size();
+  vector<int> frontier(size);
+  int head = 0, tail = 0;
 
-  while (!Queue.empty()) {
-    int target = Queue.front();
-    Queue.pop();
+  distance.assign(size, -1);
+  distance[source] = 0;
+  frontier[tail++] = source;
 
-    if(target == atom2) {
-      return distance[target];
-    }
-
-    bonds.clear();
-
-    for (int col = 0; col < size; col++) {
-      if (graph[target][col] == 1) {
-        bonds.push_back(col);
-      }
-    }
+  while (head < tail) {
+    int target = frontier[head++];
 
-    for (int x = 0; x < bonds.size(); x++) {
-      int currentBond = bonds[x];
+    for (int x = 0; x < adjacency[target].size(); x++) {
+      int neighbor = adjacency[target][x];
 
-      if (!contains(checked, currentBond)) {
-        checked.push_back(currentBond);
-        int newDistance = distance[target] + 1;
-        distance.insert(pair<int, int>(currentBond, newDistance));
-        Queue.push(currentBond);
+      if (distance[neighbor] < 0) {
+        distance[neighbor] = distance[target] + 1;
+        frontier[tail++] = neighbor;
       }
     }
   }
-
-  //Needs a return value
-  return -1; //Temp fill
 }
 
-void ZmatrixScanner::buildAdjacencyMatrix(int **&graph, Molecule molec) {
+void ZmatrixScanner::buildAdjacencyList(vector< vector<int> > &adjacency, Molecule molec) {
 
   int size = molec.numOfAtoms;
 	int startId = molec.atoms[0].id;
 	int lastId = startId + molec.numOfAtoms -1;
 
-  graph =  new int*[size]; //create colums
-
-  for (int i = 0; i < size; i++) { //create rows
-    graph[i] = new int[size];
-  }
-
-  //fill with zero
-  for (int c = 0; c < size; c++) {
-    for (int r = 0; r < size; r++) {
-            graph[c][r]=0;
-    }
-  }
+  adjacency.assign(size, vector<int>());
 
-  //fill with adjacent array with bonds
+  //fill the adjacency list with bonds
   for(int x=0; x<molec.numOfBonds; x++) {
     Bond bond = molec.bonds[x];
 		//make sure the bond is intermolecular
 		if ( (bond.atom1 >= startId && bond.atom1 <= lastId) &&
 		      (bond.atom2 >= startId && bond.atom2 <= lastId) ) {
 
-      graph[bond.atom1-startId][bond.atom2-startId] = 1;
-      graph[bond.atom2-startId][bond.atom1-startId] = 1;
+      adjacency[bond.atom1-startId].push_back(bond.atom2-startId);
+      adjacency[bond.atom2-startId].push_back(bond.atom1-startId);
 		}
   }
 }
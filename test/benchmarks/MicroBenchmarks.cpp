@@ -0,0 +1,555 @@
+/**
+ * MicroBenchmarks.cpp
+ *
+ * metrobench times the energy kernels and move primitives of a Monte Carlo
+ * step one at a time, on synthetic systems built in memory (see
+ * SyntheticSystem.h), and writes the results as a JSON document. End-to-end
+ * timings mix every kernel together; these isolate each one, so a change to a
+ * kernel can be measured on its own.
+ *
+ * Each benchmark runs an operation in batches. The batch is grown until it
+ * takes at least --min-time seconds, which also warms up the caches, then
+ * --warmup batches are run untimed and --repetitions batches are timed. The
+ * results give the minimum, median, mean, maximum and standard deviation of
+ * the time per operation over the timed batches.
+ *
+ * Molecules and pairs are drawn from a fixed random sequence, so that every
+ * build times the same operations.
+ *
+ * Usage: metrobench [options] > results.json
+ */
+
+#include <algorithm>
+#include <getopt.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "SyntheticSystem.h"
+#include "Metropolis/BruteForceStep.h"
+#include "Metropolis/ProximityMatrixStep.h"
+#include "Metropolis/Utilities/Json.h"
+#include "Metropolis/Utilities/MathLibrary.h"
+#include "Metropolis/Utilities/Timer.h"
+
+/** The length of the random sequences of molecules and pairs; a power of 2 */
+#define BENCH_SEQUENCE 4096
+
+/** The most operations in one batch */
+#define BENCH_MAX_BATCH (1L << 30)
+
+/** How the benchmarks are run */
+struct BenchOptions {
+	std::vector<SyntheticSpec> systems;
+	int repetitions;
+	int warmup;
+	double minTime;
+	std::string filter;
+	std::string outputPath;
+};
+
+/** The state the benchmarks of one system share */
+struct BenchContext {
+	SimBox* sb;
+	BruteForceStep* bruteForce;
+	ProximityMatrixStep* proximity;
+
+	/** A matrix for the update benchmark, built on first use */
+	char* matrix;
+
+	/** A random sequence of molecules */
+	std::vector<int> molecules;
+
+	/** A random sequence of molecule pairs, and of pairs in range */
+	std::vector<int> pairs, pairsInRange;
+
+	/** The first primary index atom of each molecule moved between cells */
+	std::vector<Real> savedX;
+	std::vector<char> moved;
+
+	/** Accumulates results so the operations are not optimized away */
+	Real sink;
+};
+
+/**
+ * Sets up a benchmark before it is timed.
+ *
+ * @return false if the benchmark cannot run on the system, and is skipped
+ */
+typedef bool (*BenchSetUp)(BenchContext& ctx);
+
+/** Runs a batch of operations, starting at the given position */
+typedef void (*BenchRun)(BenchContext& ctx, long start, long count);
+
+/** Undoes what a benchmark changed in the system */
+typedef void (*BenchTearDown)(BenchContext& ctx);
+
+struct Benchmark {
+	const char* name;
+	const char* description;
+	BenchSetUp setUp;
+	BenchRun run;
+	BenchTearDown tearDown;
+};
+
+// ----- Operations -----
+
+static bool alwaysRuns(BenchContext&) {
+	return true;
+}
+
+static void nothingToUndo(BenchContext&) {
+}
+
+static void runInRange(BenchContext& ctx, long start, long count) {
+	int** molData = ctx.sb->moleculeData;
+	for (long k = start; k < start + count; k++) {
+		int i = 2 * (k & (BENCH_SEQUENCE - 1));
+		int m1 = ctx.pairs[i], m2 = ctx.pairs[i + 1];
+		int p1Start = molData[MOL_PIDX_START][m1];
+		int p2Start = molData[MOL_PIDX_START][m2];
+		ctx.sink += SimCalcs::moleculesInRange(p1Start,
+		    p1Start + molData[MOL_PIDX_COUNT][m1], p2Start,
+		    p2Start + molData[MOL_PIDX_COUNT][m2], ctx.sb->atomCoordinates,
+		    ctx.sb->size, ctx.sb->primaryIndexes, ctx.sb->cutoff);
+	}
+}
+
+static bool hasPairsInRange(BenchContext& ctx) {
+	return !ctx.pairsInRange.empty();
+}
+
+static void runInteraction(BenchContext& ctx, long start, long count) {
+	int numPairs = ctx.pairsInRange.size() / 2;
+	for (long k = start; k < start + count; k++) {
+		int i = 2 * (k % numPairs);
+		ctx.sink += BruteForceCalcs::calcMoleculeInteractionEnergy(
+		    ctx.pairsInRange[i], ctx.pairsInRange[i + 1], ctx.sb->moleculeData,
+		    ctx.sb->atomData, ctx.sb->atomCoordinates, ctx.sb->size);
+	}
+}
+
+static void runBruteForce(BenchContext& ctx, long start, long count) {
+	for (long k = start; k < start + count; k++) {
+		int mol = ctx.molecules[k & (BENCH_SEQUENCE - 1)];
+		ctx.sink += ctx.bruteForce->calcMolecularEnergyContribution(mol, 0);
+	}
+}
+
+static bool buildMatrix(BenchContext& ctx) {
+	ctx.proximity->buildProximityMatrix();
+	return true;
+}
+
+static void runProximity(BenchContext& ctx, long start, long count) {
+	for (long k = start; k < start + count; k++) {
+		int mol = ctx.molecules[k & (BENCH_SEQUENCE - 1)];
+		ctx.sink += ctx.proximity->calcMolecularEnergyContribution(mol, 0);
+	}
+}
+
+static void runMoveRollback(BenchContext& ctx, long start, long count) {
+	for (long k = start; k < start + count; k++) {
+		int mol = ctx.molecules[k & (BENCH_SEQUENCE - 1)];
+		ctx.bruteForce->changeMolecule(mol, ctx.sb);
+		ctx.bruteForce->rollback(mol, ctx.sb);
+	}
+}
+
+static void runMatrixCreate(BenchContext& ctx, long start, long count) {
+	for (long k = start; k < start + count; k++) {
+		char* matrix = ProximityMatrixCalcs::createProximityMatrix();
+		ctx.sink += matrix[k % ctx.sb->numMolecules];
+		ProximityMatrixCalcs::freeProximityMatrix(matrix);
+	}
+}
+
+static bool createMatrix(BenchContext& ctx) {
+	if (ctx.matrix == NULL) {
+		ctx.matrix = ProximityMatrixCalcs::createProximityMatrix();
+	}
+	return true;
+}
+
+static void runMatrixUpdate(BenchContext& ctx, long start, long count) {
+	for (long k = start; k < start + count; k++) {
+		int mol = ctx.molecules[k & (BENCH_SEQUENCE - 1)];
+		ProximityMatrixCalcs::updateProximityMatrix(ctx.matrix, mol);
+	}
+}
+
+static void runBuildNLC(BenchContext& ctx, long start, long count) {
+	for (long k = start; k < start + count; k++) {
+		ctx.sb->buildNLC();
+	}
+}
+
+/** @return the first primary index atom of a molecule */
+static int primaryAtom(SimBox* sb, int mol) {
+	return sb->primaryIndexes[sb->moleculeData[MOL_PIDX_START][mol]];
+}
+
+static bool saveCells(BenchContext& ctx) {
+	int numMolecules = ctx.sb->numMolecules;
+	ctx.savedX.resize(numMolecules);
+	ctx.moved.assign(numMolecules, 0);
+	for (int mol = 0; mol < numMolecules; mol++) {
+		ctx.savedX[mol] = ctx.sb->atomCoordinates[X_COORD][primaryAtom(ctx.sb,
+		                                                               mol)];
+	}
+	return ctx.sb->useNLC;
+}
+
+/**
+ * Moves the cell of a molecule's first primary index atom one cell along x,
+ * or back again, so every update moves the molecule between cells.
+ */
+static void runUpdateNLC(BenchContext& ctx, long start, long count) {
+	Real* x = ctx.sb->atomCoordinates[X_COORD];
+	Real width = ctx.sb->cellWidth[X_COORD], size = ctx.sb->size[X_COORD];
+	for (long k = start; k < start + count; k++) {
+		int mol = ctx.molecules[k & (BENCH_SEQUENCE - 1)];
+		Real original = ctx.savedX[mol];
+		x[primaryAtom(ctx.sb, mol)] = ctx.moved[mol] ? original :
+		    fmod(original + width, size);
+		ctx.moved[mol] = !ctx.moved[mol];
+		ctx.sb->updateNLC(mol);
+	}
+}
+
+static void restoreCells(BenchContext& ctx) {
+	for (int mol = 0; mol < ctx.sb->numMolecules; mol++) {
+		if (ctx.moved[mol]) {
+			ctx.sb->atomCoordinates[X_COORD][primaryAtom(ctx.sb, mol)] =
+			    ctx.savedX[mol];
+			ctx.sb->updateNLC(mol);
+		}
+	}
+}
+
+/** The benchmarks, in the order they run */
+static const Benchmark BENCHMARKS[] = {
+	{"moleculesInRange", "range check of a random pair of molecules",
+	 alwaysRuns, runInRange, nothingToUndo},
+	{"calcMoleculeInteractionEnergy",
+	 "LJ and Coulomb energy of a pair of molecules in range",
+	 hasPairsInRange, runInteraction, nothingToUndo},
+	{"calcMolecularEnergyContribution/brute-force",
+	 "energy of a random molecule with every other molecule",
+	 alwaysRuns, runBruteForce, nothingToUndo},
+	{"calcMolecularEnergyContribution/proximity-matrix",
+	 "energy of a random molecule with the molecules in its matrix row",
+	 buildMatrix, runProximity, nothingToUndo},
+	{"changeMolecule+rollback", "random move of a molecule and its rollback",
+	 alwaysRuns, runMoveRollback, nothingToUndo},
+	{"createProximityMatrix", "build of the whole proximity matrix",
+	 alwaysRuns, runMatrixCreate, nothingToUndo},
+	{"updateProximityMatrix", "update of a random molecule's matrix row",
+	 createMatrix, runMatrixUpdate, nothingToUndo},
+	{"buildNLC", "sort of every molecule into the neighbor cells",
+	 alwaysRuns, runBuildNLC, nothingToUndo},
+	{"updateNLC", "move of a random molecule to the next cell",
+	 saveCells, runUpdateNLC, restoreCells},
+};
+
+// ----- Timing -----
+
+/** @return the seconds taken by a batch of operations */
+static double timeBatch(const Benchmark& bench, BenchContext& ctx,
+                        long& position, long count) {
+	double start = wallClockSeconds();
+	bench.run(ctx, position, count);
+	double elapsed = wallClockSeconds() - start;
+	position += count;
+	return elapsed;
+}
+
+/**
+ * Times a benchmark and returns its result.
+ *
+ * @param median Set to the median nanoseconds per operation.
+ */
+static JsonObject measure(const Benchmark& bench, BenchContext& ctx,
+                          const BenchOptions& options, double& median) {
+	// Grow the batch until it takes minTime, which also warms up the caches
+	long position = 0, batch = 1;
+	double elapsed = timeBatch(bench, ctx, position, batch);
+	while (elapsed < options.minTime && batch < BENCH_MAX_BATCH) {
+		double scale = elapsed > 0 ? 1.2 * options.minTime / elapsed : 10;
+		batch = std::min(BENCH_MAX_BATCH, (long) (batch * std::min(scale, 10.0))
+		                                  + 1);
+		elapsed = timeBatch(bench, ctx, position, batch);
+	}
+
+	for (int i = 0; i < options.warmup; i++) {
+		timeBatch(bench, ctx, position, batch);
+	}
+	std::vector<double> perOp;
+	for (int i = 0; i < options.repetitions; i++) {
+		perOp.push_back(timeBatch(bench, ctx, position, batch) / batch * 1e9);
+	}
+
+	std::sort(perOp.begin(), perOp.end());
+	int n = perOp.size();
+	median = n % 2 == 1 ? perOp[n / 2] :
+	                (perOp[n / 2 - 1] + perOp[n / 2]) / 2;
+	double mean = 0, variance = 0;
+	for (int i = 0; i < n; i++) {
+		mean += perOp[i] / n;
+	}
+	for (int i = 0; i < n; i++) {
+		variance += (perOp[i] - mean) * (perOp[i] - mean) / std::max(n - 1, 1);
+	}
+
+	JsonObject ns;
+	ns.add("min", perOp[0]).add("median", median).add("mean", mean)
+	  .add("max", perOp[n - 1]).add("stddev", sqrt(variance));
+	JsonObject result;
+	result.add("name", bench.name).add("description", bench.description)
+	      .add("batch", batch).add("repetitions", options.repetitions)
+	      .add("ns_per_op", ns).add("ops_per_second", 1e9 / median);
+	return result;
+}
+
+/** @return the system as JSON, with the sizes it was built at */
+static JsonObject describeSystem(SyntheticSystem& system) {
+	const SyntheticSpec& spec = system.getSpec();
+	SimBox* sb = system.getSimBox();
+	JsonObject out;
+	out.add("molecule", spec.molecule).add("molecules", sb->numMolecules)
+	   .add("atoms_per_molecule", spec.getAtomsPerMolecule())
+	   .add("atoms", sb->numAtoms).add("density", spec.getDensity())
+	   .add("box", spec.getBoxLength()).add("cutoff", spec.cutoff)
+	   .add("sparse_nlc", sb->useNLC && sb->sparseNLC)
+	   .add("build_seconds", system.getBuildTime());
+	return out;
+}
+
+/** Fills in the random sequences of molecules and pairs */
+static void drawSequences(BenchContext& ctx) {
+	SimBox* sb = ctx.sb;
+	int** molData = sb->moleculeData;
+	for (int i = 0; i < BENCH_SEQUENCE; i++) {
+		ctx.molecules.push_back(ctx.bruteForce->chooseMolecule(sb));
+		int m1 = ctx.bruteForce->chooseMolecule(sb), m2 = ctx.bruteForce->chooseMolecule(sb);
+		if (m1 == m2) {
+			m2 = (m2 + 1) % sb->numMolecules;
+		}
+		ctx.pairs.push_back(m1);
+		ctx.pairs.push_back(m2);
+	}
+
+	// Pairs in range are rare in big boxes, so they are searched for directly
+	for (int m1 = 0; m1 < sb->numMolecules &&
+	     ctx.pairsInRange.size() < 2 * BENCH_SEQUENCE; m1++) {
+		int p1Start = molData[MOL_PIDX_START][m1];
+		int m2 = ctx.molecules[m1 & (BENCH_SEQUENCE - 1)];
+		for (int tries = 0; tries < sb->numMolecules; tries++) {
+			m2 = (m2 + 1) % sb->numMolecules;
+			int p2Start = molData[MOL_PIDX_START][m2];
+			if (m2 != m1 && SimCalcs::moleculesInRange(p1Start,
+			    p1Start + molData[MOL_PIDX_COUNT][m1], p2Start,
+			    p2Start + molData[MOL_PIDX_COUNT][m2], sb->atomCoordinates,
+			    sb->size, sb->primaryIndexes, sb->cutoff)) {
+				ctx.pairsInRange.push_back(m1);
+				ctx.pairsInRange.push_back(m2);
+				break;
+			}
+		}
+	}
+}
+
+/** Runs every selected benchmark on one system */
+static JsonObject benchSystem(const SyntheticSpec& spec,
+                              const BenchOptions& options) {
+	SyntheticSystem system(spec);
+	BenchContext ctx;
+	ctx.sb = system.getSimBox();
+	ctx.bruteForce = new BruteForceStep(ctx.sb);
+	ctx.proximity = new ProximityMatrixStep(ctx.sb);
+	ctx.matrix = NULL;
+	ctx.sink = 0;
+	drawSequences(ctx);
+
+	fprintf(stderr, "%s, box %.2f A, cutoff %.2f A\n", spec.describe().c_str(),
+	        spec.getBoxLength(), spec.cutoff);
+	if (spec.cutoff > spec.getBoxLength() / 2) {
+		fprintf(stderr, "  The cutoff is over half the box length\n");
+	}
+
+	std::vector<JsonObject> results;
+	int numBenchmarks = sizeof(BENCHMARKS) / sizeof(BENCHMARKS[0]);
+	for (int i = 0; i < numBenchmarks; i++) {
+		const Benchmark& bench = BENCHMARKS[i];
+		if (strstr(bench.name, options.filter.c_str()) == NULL) {
+			continue;
+		}
+		if (!bench.setUp(ctx)) {
+			fprintf(stderr, "  %-50s skipped\n", bench.name);
+			continue;
+		}
+		double median;
+		results.push_back(measure(bench, ctx, options, median));
+		bench.tearDown(ctx);
+		fprintf(stderr, "  %-50s %14.1f ns/op\n", bench.name, median);
+	}
+
+	if (ctx.matrix != NULL) {
+		ProximityMatrixCalcs::freeProximityMatrix(ctx.matrix);
+	}
+	delete ctx.proximity;
+	delete ctx.bruteForce;
+
+	JsonObject out;
+	out.add("system", describeSystem(system)).add("benchmarks", results)
+	   .add("checksum", (double) ctx.sink);
+	return out;
+}
+
+// ----- Command line -----
+
+static void printUsage() {
+	std::cout << "Usage: metrobench [options] > results.json\n\n"
+	    "Times the energy kernels and move primitives on synthetic systems.\n"
+	    "Every combination of the listed molecules, counts and densities is\n"
+	    "benchmarked.\n\n"
+	    "--molecule <list>\tMolecules: water, methanol, chain (default\n"
+	    "\t\t\twater,methanol)\n"
+	    "--molecules <list>\tMolecule counts (default 500,4000)\n"
+	    "--chain-atoms <list>\tAtoms per chain molecule (default 12)\n"
+	    "--density <list>\tMolecules per cubic nanometer, 0 for the liquid\n"
+	    "\t\t\t(default 0)\n"
+	    "--cutoff <angstroms>\tCutoff distance (default 11)\n"
+	    "--repetitions <count>\tTimed batches per benchmark (default 10)\n"
+	    "--warmup <count>\tUntimed batches per benchmark (default 2)\n"
+	    "--min-time <seconds>\tShortest batch (default 0.02)\n"
+	    "--filter <text>\t\tOnly benchmarks whose name contains <text>\n"
+	    "--output <path>\t\tWrite the JSON to <path> instead of stdout\n";
+}
+
+static bool parseOptions(int argc, char** argv, BenchOptions& options) {
+	std::vector<std::string> molecules, counts, chainAtoms, densities;
+	molecules = splitList("water,methanol");
+	counts = splitList("500,4000");
+	chainAtoms.push_back("12");
+	densities.push_back("0");
+	double cutoff = 11.0;
+	options.repetitions = 10;
+	options.warmup = 2;
+	options.minTime = 0.02;
+
+	static struct option long_options[] = {
+		{"molecule", required_argument, 0, 'm'},
+		{"molecules", required_argument, 0, 'n'},
+		{"chain-atoms", required_argument, 0, 'a'},
+		{"density", required_argument, 0, 'd'},
+		{"cutoff", required_argument, 0, 'c'},
+		{"repetitions", required_argument, 0, 'r'},
+		{"warmup", required_argument, 0, 'w'},
+		{"min-time", required_argument, 0, 't'},
+		{"filter", required_argument, 0, 'f'},
+		{"output", required_argument, 0, 'o'},
+		{"help", no_argument, 0, 'h'},
+		{0, 0, 0, 0}
+	};
+
+	int c;
+	while ((c = getopt_long(argc, argv, "h", long_options, NULL)) != -1) {
+		switch (c) {
+			case 'm': molecules = splitList(optarg); break;
+			case 'n': counts = splitList(optarg); break;
+			case 'a': chainAtoms = splitList(optarg); break;
+			case 'd': densities = splitList(optarg); break;
+			case 'c': cutoff = atof(optarg); break;
+			case 'r': options.repetitions = atoi(optarg); break;
+			case 'w': options.warmup = atoi(optarg); break;
+			case 't': options.minTime = atof(optarg); break;
+			case 'f': options.filter = optarg; break;
+			case 'o': options.outputPath = optarg; break;
+			case 'h': printUsage(); exit(EXIT_SUCCESS);
+			default: return false;
+		}
+	}
+	if (optind < argc || options.repetitions < 1 || options.warmup < 0 ||
+	    options.minTime < 0) {
+		return false;
+	}
+
+	for (int m = 0; m < molecules.size(); m++) {
+		// Only chains come in more than one size
+		int numSizes = molecules[m] == "chain" ? chainAtoms.size() : 1;
+		for (int a = 0; a < numSizes; a++) {
+			for (int d = 0; d < densities.size(); d++) {
+				for (int n = 0; n < counts.size(); n++) {
+					SyntheticSpec spec;
+					spec.molecule = molecules[m];
+					spec.numMolecules = atoi(counts[n].c_str());
+					spec.chainAtoms = atoi(chainAtoms[a].c_str());
+					spec.density = atof(densities[d].c_str());
+					spec.cutoff = cutoff;
+					if (!spec.isValid()) {
+						std::cerr << "Error: metrobench: Invalid system "
+						          << spec.describe() << std::endl;
+						return false;
+					}
+					options.systems.push_back(spec);
+				}
+			}
+		}
+	}
+	return true;
+}
+
+int main(int argc, char** argv) {
+	BenchOptions options;
+	if (!parseOptions(argc, argv, options)) {
+		printUsage();
+		return EXIT_FAILURE;
+	}
+
+	std::vector<JsonObject> systems;
+	for (int i = 0; i < options.systems.size(); i++) {
+		systems.push_back(benchSystem(options.systems[i], options));
+	}
+
+	char host[256];
+	if (gethostname(host, sizeof(host)) != 0) {
+		snprintf(host, sizeof(host), "unknown");
+	}
+	host[sizeof(host) - 1] = '\0';
+	int threads = 1;
+#ifdef _OPENMP
+	threads = omp_get_max_threads();
+#endif
+
+	JsonObject document;
+	document.add("benchmark", "metrobench").add("host", host)
+	        .add("precision", sizeof(Real) == sizeof(float) ? "single" :
+	                                                         "double")
+	        .add("threads", threads).add("warmup", options.warmup)
+	        .add("min_time", options.minTime).add("systems", systems);
+
+	if (options.outputPath.empty()) {
+		std::cout << document.str() << std::endl;
+	} else {
+		std::ofstream out(options.outputPath.c_str());
+		out << document.str() << std::endl;
+		out.close();
+		if (!out) {
+			std::cerr << "Error: metrobench: Unable to write "
+			          << options.outputPath << std::endl;
+			return EXIT_FAILURE;
+		}
+	}
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,475 @@
+/**
+ * ScalingBenchmark.cpp
+ *
+ * metroscale runs the Monte Carlo steps of the energy kernels on synthetic
+ * systems built in memory (see SyntheticSystem.h) and writes one CSV row per
+ * run, for tracking strong and weak scaling from release to release. It sweeps
+ * every combination of the listed molecules, molecule counts, densities,
+ * cutoffs, strategies and thread counts, running the same number of steps at
+ * each point.
+ *
+ * Each point is a Simulation built around the synthetic Box and timed through
+ * Simulation::run, so the steps are the same steps a metrosim run takes. The
+ * run has no status output or state saves, and writes its results and PDB
+ * files to a temporary directory that is removed afterwards.
+ *
+ * With --neighbor the brute-force energies are summed over the neighbor cells
+ * on one thread, so the brute-force points with more threads are skipped.
+ *
+ * For strong scaling the system stays the same as the threads are added; with
+ * --weak the molecule counts are per thread, so the system grows with them.
+ *
+ * Each run takes place in a child process of its own, so the peak resident set
+ * size of the row is that of the run alone. The startup time covers building
+ * the Box and the Simulation's startup up to the first full energy; the steps
+ * per second cover the main loop of the run only. Every row of a system starts
+ * from the same seed, so the final energies of a system agree across thread
+ * counts.
+ *
+ * Usage: metroscale [options] > scaling.csv
+ */
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "SyntheticSystem.h"
+#include "Metropolis/Simulation.h"
+#include "Metropolis/SimulationStep.h"
+#include "Metropolis/Utilities/Timer.h"
+
+/** The columns of the CSV, in order */
+#define SCALE_CSV_HEADER "label,molecule,molecules,atoms,density,box,cutoff," \
+	"strategy,threads,repetition,steps,startup_seconds,run_seconds," \
+	"steps_per_second,acceptance,final_energy,peak_rss_kb"
+
+/** One run of the sweep */
+struct ScalePoint {
+	SyntheticSpec spec;
+	SimulationStrategy strategy;
+	int threads;
+	int repetition;
+};
+
+/** How the sweep is run */
+struct ScaleOptions {
+	std::vector<ScalePoint> points;
+	long steps;
+	int tileSize;
+	std::string label;
+	std::string outputPath;
+};
+
+/** What a child process measures for one point */
+struct ScaleResult {
+	double startup;
+	double run;
+	long accepted;
+	Real energy;
+};
+
+// ----- Running a point -----
+
+/**
+ * Builds the Box of a point and times a Simulation of it. The final energy
+ * includes the long-range correction, so it is comparable with a metrosim run
+ * of the same system.
+ */
+static ScaleResult runPoint(const ScalePoint& point,
+                            const ScaleOptions& options) {
+	ScaleResult result;
+	double start = wallClockSeconds();
+	Box* box = SyntheticSystem::buildBox(point.spec);
+	double buildTime = wallClockSeconds() - start;
+
+	KernelConfig config = {true, point.threads, options.tileSize, 64};
+	SimCalcs::kernel = config;
+
+	SimulationArgs args = SimulationArgs();
+	args.simulationMode = SimulationMode::Serial;
+	args.strategy = point.strategy;
+	args.useNeighborList = point.spec.useNLC;
+	args.spatialIndex = point.spec.spatialIndex;
+	args.stepCount = options.steps;
+	args.stateInterval = -1;
+
+	Simulation simulation(args, box);
+	simulation.run();
+	result.startup = buildTime + simulation.getStartupTime();
+	result.run = simulation.getLoopTime();
+	result.accepted = simulation.getAcceptedMoves();
+	result.energy = simulation.getFinalEnergy();
+	return result;
+}
+
+/** Removes a directory and the files in it */
+static void removeDirectory(const std::string& path) {
+	DIR* dir = opendir(path.c_str());
+	if (dir != NULL) {
+		struct dirent* entry;
+		while ((entry = readdir(dir)) != NULL) {
+			std::string name = entry->d_name;
+			if (name != "." && name != "..") {
+				unlink((path + "/" + name).c_str());
+			}
+		}
+		closedir(dir);
+	}
+	rmdir(path.c_str());
+}
+
+/**
+ * Runs a point in the child process, with its output files in a temporary
+ * directory and its console output discarded, since stdout may be the CSV.
+ *
+ * @return false if the temporary directory could not be made.
+ */
+static bool runChild(const ScalePoint& point, const ScaleOptions& options,
+                     ScaleResult& result) {
+	const char* tmp = getenv("TMPDIR");
+	std::string pattern = std::string(tmp != NULL ? tmp : "/tmp") +
+	                      "/metroscale.XXXXXX";
+	std::vector<char> path(pattern.begin(), pattern.end());
+	path.push_back('\0');
+	if (mkdtemp(&path[0]) == NULL || chdir(&path[0]) != 0) {
+		std::cerr << "Error: metroscale: Unable to create a directory in "
+		          << pattern << ": " << strerror(errno) << std::endl;
+		return false;
+	}
+
+	int devNull = open("/dev/null", O_WRONLY);
+	if (devNull >= 0) {
+		dup2(devNull, STDOUT_FILENO);
+		close(devNull);
+	}
+
+	result = runPoint(point, options);
+	fflush(stdout);
+	removeDirectory(&path[0]);
+	return true;
+}
+
+/**
+ * Runs a point in a child process.
+ *
+ * @param peakKb Set to the peak resident set size of the child, in kilobytes.
+ * @return false if the child did not report back.
+ */
+static bool measurePoint(const ScalePoint& point, const ScaleOptions& options,
+                         ScaleResult& result, long& peakKb) {
+	int fds[2];
+	if (pipe(fds) != 0) {
+		std::cerr << "Error: metroscale: Unable to create a pipe: "
+		          << strerror(errno) << std::endl;
+		return false;
+	}
+
+	fflush(stdout);
+	fflush(stderr);
+	pid_t pid = fork();
+	if (pid < 0) {
+		std::cerr << "Error: metroscale: Unable to fork: " << strerror(errno)
+		          << std::endl;
+		close(fds[0]);
+		close(fds[1]);
+		return false;
+	}
+	if (pid == 0) {
+		close(fds[0]);
+		ScaleResult measured;
+		if (!runChild(point, options, measured)) {
+			_exit(EXIT_FAILURE);
+		}
+		ssize_t written = write(fds[1], &measured, sizeof(measured));
+		_exit(written == sizeof(measured) ? EXIT_SUCCESS : EXIT_FAILURE);
+	}
+
+	close(fds[1]);
+	size_t received = 0;
+	char* bytes = (char*) &result;
+	while (received < sizeof(result)) {
+		ssize_t got = read(fds[0], bytes + received, sizeof(result) - received);
+		if (got < 0 && errno == EINTR) {
+			continue;
+		} else if (got <= 0) {
+			break;
+		}
+		received += got;
+	}
+	close(fds[0]);
+
+	int status;
+	struct rusage usage;
+	if (wait4(pid, &status, 0, &usage) != pid || !WIFEXITED(status) ||
+	    WEXITSTATUS(status) != EXIT_SUCCESS || received != sizeof(result)) {
+		return false;
+	}
+	// Linux reports ru_maxrss in kilobytes
+	peakKb = usage.ru_maxrss;
+	return true;
+}
+
+/** @return a CSV row for a point */
+static std::string formatRow(const ScalePoint& point,
+                             const ScaleOptions& options,
+                             const ScaleResult& result, long peakKb) {
+	const SyntheticSpec& spec = point.spec;
+	char row[512];
+	snprintf(row, sizeof(row),
+	         "%s,%s,%d,%d,%.4f,%.4f,%.4f,%s,%d,%d,%ld,%.6f,%.6f,%.2f,%.4f,"
+	         "%.6f,%ld", options.label.c_str(), spec.molecule.c_str(),
+	         spec.numMolecules,
+	         spec.numMolecules * spec.getAtomsPerMolecule(), spec.getDensity(),
+	         spec.getBoxLength(), spec.cutoff,
+	         Strategy::toString(point.strategy).c_str(), point.threads,
+	         point.repetition, options.steps, result.startup, result.run,
+	         result.run > 0 ? options.steps / result.run : 0,
+	         options.steps > 0 ? (double) result.accepted / options.steps : 0,
+	         (double) result.energy, peakKb);
+	return row;
+}
+
+// ----- Command line -----
+
+/** @return the thread counts 1, 2, 4, ... up to the most OpenMP allows */
+static std::vector<std::string> defaultThreads() {
+	int maxThreads = 1;
+#ifdef _OPENMP
+	maxThreads = omp_get_max_threads();
+#endif
+	std::vector<std::string> threads;
+	for (int t = 1; ; t *= 2) {
+		char count[16];
+		snprintf(count, sizeof(count), "%d", t < maxThreads ? t : maxThreads);
+		threads.push_back(count);
+		if (t >= maxThreads) {
+			break;
+		}
+	}
+	return threads;
+}
+
+static void printUsage() {
+	std::cout << "Usage: metroscale [options] > scaling.csv\n\n"
+	    "Runs simulations of synthetic systems over every combination of the\n"
+	    "listed molecules, counts, densities, cutoffs, strategies and thread\n"
+	    "counts, and writes the steps per second, startup time and peak\n"
+	    "memory of each as CSV.\n\n"
+	    "--molecule <list>\tMolecules: water, methanol, chain (default\n"
+	    "\t\t\twater,methanol)\n"
+	    "--molecules <list>\tMolecule counts (default 500,1000,2000,4000)\n"
+	    "--chain-atoms <count>\tAtoms per chain molecule (default 12)\n"
+	    "--density <list>\tMolecules per cubic nanometer, 0 for the liquid\n"
+	    "\t\t\t(default 0)\n"
+	    "--cutoff <list>\t\tCutoff distances in angstroms (default 11)\n"
+	    "--strategy <list>\tbrute-force, proximity-matrix (default both)\n"
+	    "--threads <list>\tThreads computing each energy (default 1, 2,\n"
+	    "\t\t\t4, ... up to OMP_NUM_THREADS)\n"
+	    "--tile <blocks>\t\tBlocks of molecules handed to each thread\n"
+	    "\t\t\t(default 4)\n"
+	    "--weak\t\t\tMolecule counts are per thread (weak scaling)\n"
+	    "--neighbor\t\tUse the neighbor cells, as -n does. Brute force\n"
+	    "\t\t\tthen runs on one thread only\n"
+	    "--steps <count>\t\tSteps run at each point (default 2000)\n"
+	    "--repetitions <count>\tRuns of each point (default 1)\n"
+	    "--seed <seed>\t\tSeed of every run (default 12345)\n"
+	    "--label <text>\t\tFirst column of every row, such as a version\n"
+	    "--output <path>\t\tWrite the CSV to <path> instead of stdout\n";
+}
+
+static bool parseOptions(int argc, char** argv, ScaleOptions& options) {
+	std::vector<std::string> molecules, counts, densities, cutoffs, strategies;
+	std::vector<std::string> threads;
+	molecules = splitList("water,methanol");
+	counts = splitList("500,1000,2000,4000");
+	densities.push_back("0");
+	cutoffs.push_back("11");
+	strategies = splitList("brute-force,proximity-matrix");
+	threads = defaultThreads();
+	int chainAtoms = SYNTHETIC_CHAIN_ATOMS, repetitions = 1, seed = 12345;
+	bool weak = false, neighbor = false;
+	options.steps = 2000;
+	options.tileSize = 4;
+
+	static struct option long_options[] = {
+		{"molecule", required_argument, 0, 'm'},
+		{"molecules", required_argument, 0, 'n'},
+		{"chain-atoms", required_argument, 0, 'a'},
+		{"density", required_argument, 0, 'd'},
+		{"cutoff", required_argument, 0, 'c'},
+		{"strategy", required_argument, 0, 'S'},
+		{"threads", required_argument, 0, 'T'},
+		{"tile", required_argument, 0, 'k'},
+		{"weak", no_argument, 0, 'W'},
+		{"neighbor", no_argument, 0, 'N'},
+		{"steps", required_argument, 0, 'i'},
+		{"repetitions", required_argument, 0, 'r'},
+		{"seed", required_argument, 0, 'e'},
+		{"label", required_argument, 0, 'l'},
+		{"output", required_argument, 0, 'o'},
+		{"help", no_argument, 0, 'h'},
+		{0, 0, 0, 0}
+	};
+
+	int c;
+	while ((c = getopt_long(argc, argv, "h", long_options, NULL)) != -1) {
+		switch (c) {
+			case 'm': molecules = splitList(optarg); break;
+			case 'n': counts = splitList(optarg); break;
+			case 'a': chainAtoms = atoi(optarg); break;
+			case 'd': densities = splitList(optarg); break;
+			case 'c': cutoffs = splitList(optarg); break;
+			case 'S': strategies = splitList(optarg); break;
+			case 'T': threads = splitList(optarg); break;
+			case 'k': options.tileSize = atoi(optarg); break;
+			case 'W': weak = true; break;
+			case 'N': neighbor = true; break;
+			case 'i': options.steps = atol(optarg); break;
+			case 'r': repetitions = atoi(optarg); break;
+			case 'e': seed = atoi(optarg); break;
+			case 'l': options.label = optarg; break;
+			case 'o': options.outputPath = optarg; break;
+			case 'h': printUsage(); exit(EXIT_SUCCESS);
+			default: return false;
+		}
+	}
+	if (optind < argc || options.steps < 0 || options.tileSize < 1 ||
+	    repetitions < 1 || options.label.find(',') != std::string::npos) {
+		return false;
+	}
+
+	std::vector<SyntheticSpec> systems;
+	int skipped = 0;
+	for (size_t m = 0; m < molecules.size(); m++) {
+		for (size_t d = 0; d < densities.size(); d++) {
+			for (size_t cut = 0; cut < cutoffs.size(); cut++) {
+				for (size_t n = 0; n < counts.size(); n++) {
+					SyntheticSpec spec;
+					spec.molecule = molecules[m];
+					spec.numMolecules = atoi(counts[n].c_str());
+					spec.chainAtoms = chainAtoms;
+					spec.density = atof(densities[d].c_str());
+					spec.cutoff = atof(cutoffs[cut].c_str());
+					spec.useNLC = neighbor;
+					spec.seed = seed;
+					if (!spec.isValid()) {
+						std::cerr << "Error: metroscale: Invalid system "
+						          << spec.describe() << std::endl;
+						return false;
+					}
+					systems.push_back(spec);
+				}
+			}
+		}
+	}
+
+	for (size_t i = 0; i < systems.size(); i++) {
+		for (size_t s = 0; s < strategies.size(); s++) {
+			ScalePoint point;
+			point.strategy = Strategy::fromString(strategies[s]);
+			if (point.strategy != Strategy::BruteForce &&
+			    point.strategy != Strategy::ProximityMatrix) {
+				std::cerr << "Error: metroscale: Unknown strategy "
+				          << strategies[s] << std::endl;
+				return false;
+			}
+			for (size_t t = 0; t < threads.size(); t++) {
+				point.threads = atoi(threads[t].c_str());
+				if (point.threads < 1) {
+					std::cerr << "Error: metroscale: Invalid thread count "
+					          << threads[t] << std::endl;
+					return false;
+				}
+				// The brute-force energies of the neighbor cells are summed on
+				// one thread, so more threads would only repeat the point
+				if (neighbor && point.strategy == Strategy::BruteForce &&
+				    point.threads != 1) {
+					skipped++;
+					continue;
+				}
+				point.spec = systems[i];
+				if (weak) {
+					point.spec.numMolecules *= point.threads;
+				}
+				for (point.repetition = 0; point.repetition < repetitions;
+				     point.repetition++) {
+					options.points.push_back(point);
+				}
+			}
+		}
+	}
+	if (skipped > 0) {
+		std::cerr << "Warning: metroscale: Skipped " << skipped << " brute-force "
+		          << "point" << (skipped == 1 ? "" : "s") << " with more than one "
+		          << "thread, since --neighbor sums the energies on one thread"
+		          << std::endl;
+	}
+	return true;
+}
+
+int main(int argc, char** argv) {
+	ScaleOptions options;
+	if (!parseOptions(argc, argv, options)) {
+		printUsage();
+		return EXIT_FAILURE;
+	}
+
+	std::ofstream file;
+	if (!options.outputPath.empty()) {
+		file.open(options.outputPath.c_str());
+		if (!file.is_open()) {
+			std::cerr << "Error: metroscale: Unable to write "
+			          << options.outputPath << std::endl;
+			return EXIT_FAILURE;
+		}
+	}
+	std::ostream& out = options.outputPath.empty() ? std::cout : file;
+	out << SCALE_CSV_HEADER << std::endl;
+
+	int failures = 0;
+	for (size_t i = 0; i < options.points.size(); i++) {
+		const ScalePoint& point = options.points[i];
+		ScaleResult result;
+		long peakKb;
+		fprintf(stderr, "%s, %s, %d thread%s: ", point.spec.describe().c_str(),
+		        Strategy::toString(point.strategy).c_str(), point.threads,
+		        point.threads == 1 ? "" : "s");
+		if (!measurePoint(point, options, result, peakKb)) {
+			fprintf(stderr, "failed\n");
+			failures++;
+			continue;
+		}
+		fprintf(stderr, "%.1f steps/s, startup %.3f s, peak %.1f MB\n",
+		        result.run > 0 ? options.steps / result.run : 0,
+		        result.startup, peakKb / 1024.0);
+		if (point.spec.cutoff > point.spec.getBoxLength() / 2) {
+			fprintf(stderr, "  The cutoff is over half the box length\n");
+		}
+		out << formatRow(point, options, result, peakKb) << std::endl;
+	}
+
+	out.flush();
+	if (!out) {
+		std::cerr << "Error: metroscale: Unable to write "
+		          << options.outputPath << std::endl;
+		return EXIT_FAILURE;
+	}
+	return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
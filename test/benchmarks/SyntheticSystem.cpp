@@ -0,0 +1,236 @@
+#include "SyntheticSystem.h"
+
+#include <math.h>
+#include <sstream>
+#include <vector>
+
+#include "Metropolis/GPUCopy.h"
+#include "Metropolis/SimBoxBuilder.h"
+#include "Metropolis/SimulationStep.h"
+#include "Metropolis/Utilities/FileUtilities.h"
+#include "Metropolis/Utilities/MathLibrary.h"
+#include "Metropolis/Utilities/Timer.h"
+
+/** The atoms, bonds, angles and hops of a template being put together */
+struct TemplateParts {
+	std::vector<Atom> atoms;
+	std::vector<Bond> bonds;
+	std::vector<Angle> angles;
+	std::vector<Hop> hops;
+	int primaryIndex;
+};
+
+static void addAtom(TemplateParts& parts, const char* name, Real x, Real y,
+                    Real z, Real sigma, Real epsilon, Real charge) {
+	parts.atoms.push_back(Atom(parts.atoms.size(), x, y, z, sigma, epsilon,
+	                           charge, name));
+}
+
+static Real distance(const Atom& a1, const Atom& a2) {
+	return sqrt(pow(a1.x - a2.x, 2) + pow(a1.y - a2.y, 2) +
+	            pow(a1.z - a2.z, 2));
+}
+
+static void addBond(TemplateParts& parts, int a1, int a2) {
+	parts.bonds.push_back(Bond(a1, a2, distance(parts.atoms[a1],
+	                                            parts.atoms[a2]), false));
+}
+
+/** Adds the angle between two atoms bonded to the atom mid */
+static void addAngle(TemplateParts& parts, int a1, int mid, int a2) {
+	Real b1 = distance(parts.atoms[a1], parts.atoms[mid]);
+	Real b2 = distance(parts.atoms[a2], parts.atoms[mid]);
+	Real c = distance(parts.atoms[a1], parts.atoms[a2]);
+	Real degrees = acos((b1 * b1 + b2 * b2 - c * c) / (2 * b1 * b2)) * 180 /
+	               M_PI;
+	parts.angles.push_back(Angle(a1, a2, degrees, false));
+}
+
+static void addHop(TemplateParts& parts, int a1, int a2, int hop) {
+	Hop h;
+	h.atom1 = a1;
+	h.atom2 = a2;
+	h.hop = hop;
+	parts.hops.push_back(h);
+}
+
+/** TIP3P water, with the parameters of oplsaa.par types 111 and 112 */
+static void buildWater(TemplateParts& parts) {
+	Real angle = 104.52 * M_PI / 180;
+	addAtom(parts, "OW", 0, 0, 0, 3.15061, 0.1521, -0.834);
+	addAtom(parts, "HW", 0.9572, 0, 0, 0, 0, 0.417);
+	addAtom(parts, "HW", 0.9572 * cos(angle), 0.9572 * sin(angle), 0, 0, 0,
+	        0.417);
+	addBond(parts, 0, 1);
+	addBond(parts, 0, 2);
+	addAngle(parts, 1, 0, 2);
+	parts.primaryIndex = 0;
+}
+
+/**
+ * OPLS-AA methanol, with the geometry of resources/exampleFiles/meoh.z and the
+ * parameters of oplsaa.par types 154 to 157.
+ */
+static void buildMethanol(TemplateParts& parts) {
+	Real hoh = 108.99 * M_PI / 180;
+	addAtom(parts, "OH", 0, 0, 0, 3.12, 0.17, -0.683);
+	addAtom(parts, "HO", 0.9457 * cos(hoh), 0.9457 * sin(hoh), 0, 0, 0, 0.418);
+	addAtom(parts, "CT", 1.41187, 0, 0, 3.5, 0.066, 0.145);
+
+	// The methyl hydrogens are staggered about the C-O bond
+	Real och = 110.4 * M_PI / 180;
+	for (int i = 0; i < 3; i++) {
+		Real twist = (180 + 120 * i) * M_PI / 180;
+		addAtom(parts, "HC", 1.41187 - 1.0904 * cos(och),
+		        1.0904 * sin(och) * cos(twist), 1.0904 * sin(och) * sin(twist),
+		        2.5, 0.03, 0.04);
+	}
+
+	addBond(parts, 0, 1);
+	addBond(parts, 0, 2);
+	addAngle(parts, 1, 0, 2);
+	for (int h = 3; h < 6; h++) {
+		addBond(parts, 2, h);
+		addAngle(parts, 0, 2, h);
+		addHop(parts, 1, h, 3);
+		for (int other = h + 1; other < 6; other++) {
+			addAngle(parts, h, 2, other);
+		}
+	}
+	parts.primaryIndex = 0;
+}
+
+/**
+ * A zigzag chain of united CH2 atoms (OPLS-UA Lennard-Jones parameters) with
+ * alternating charges, so the Coulomb terms are exercised too.
+ */
+static void buildChain(TemplateParts& parts, int numAtoms) {
+	Real half = 56 * M_PI / 180;
+	for (int i = 0; i < numAtoms; i++) {
+		Real charge = (i % 2 == 0 ? 0.25 : -0.25);
+		if (numAtoms % 2 == 1 && i == numAtoms - 1) {
+			charge = 0;
+		}
+		addAtom(parts, "CH2", i * 1.53 * sin(half), (i % 2) * 1.53 * cos(half), 0,
+		        3.905, 0.118, charge);
+	}
+	for (int i = 0; i + 1 < numAtoms; i++) {
+		addBond(parts, i, i + 1);
+		if (i + 2 < numAtoms) {
+			addAngle(parts, i, i + 1, i + 2);
+		}
+		if (i + 3 < numAtoms) {
+			addHop(parts, i, i + 3, 3);
+		}
+	}
+	parts.primaryIndex = numAtoms / 2;
+}
+
+std::vector<std::string> splitList(const char* text) {
+	std::vector<std::string> items;
+	std::stringstream in(text);
+	std::string item;
+	while (std::getline(in, item, ',')) {
+		if (!item.empty()) {
+			items.push_back(item);
+		}
+	}
+	return items;
+}
+
+double SyntheticSpec::getDensity() const {
+	if (density > 0) {
+		return density;
+	} else if (molecule == "methanol") {
+		return SYNTHETIC_METHANOL_DENSITY;
+	} else if (molecule == "chain") {
+		return SYNTHETIC_CHAIN_ATOM_DENSITY / chainAtoms;
+	}
+	return SYNTHETIC_WATER_DENSITY;
+}
+
+double SyntheticSpec::getBoxLength() const {
+	// One cubic nanometer is 1000 cubic angstroms
+	return cbrt(numMolecules / getDensity() * 1000);
+}
+
+int SyntheticSpec::getAtomsPerMolecule() const {
+	if (molecule == "methanol") {
+		return 6;
+	} else if (molecule == "chain") {
+		return chainAtoms;
+	}
+	return 3;
+}
+
+std::string SyntheticSpec::describe() const {
+	std::stringstream out;
+	out << numMolecules << " ";
+	if (molecule == "chain") {
+		out << chainAtoms << "-atom chain";
+	} else {
+		out << molecule;
+	}
+	return out.str();
+}
+
+bool SyntheticSpec::isValid() const {
+	return (molecule == "water" || molecule == "methanol" ||
+	        (molecule == "chain" && chainAtoms > 0)) && numMolecules > 0 &&
+	       cutoff > 0 && density >= 0;
+}
+
+SyntheticSystem::SyntheticSystem(const SyntheticSpec& spec_in) {
+	spec = spec_in;
+	box = buildBox(spec);
+
+	seed(spec.seed);
+	SimBoxBuilder builder(spec.useNLC, new SBScanner(), Packing::Default,
+	                      spec.spatialIndex);
+	double start = wallClockSeconds();
+	sb = builder.build(box);
+	buildTime = wallClockSeconds() - start;
+
+	GPUCopy::setParallel(false);
+	GPUCopy::copyIn(sb);
+	SimCalcs::setSB(sb);
+}
+
+Box* SyntheticSystem::buildBox(const SyntheticSpec& spec) {
+	TemplateParts parts;
+	if (spec.molecule == "methanol") {
+		buildMethanol(parts);
+	} else if (spec.molecule == "chain") {
+		buildChain(parts, spec.chainAtoms);
+	} else {
+		buildWater(parts);
+	}
+
+	Environment enviro;
+	enviro.x = enviro.y = enviro.z = spec.getBoxLength();
+	enviro.cutoff = spec.cutoff;
+	enviro.temp = 298.15;
+	enviro.maxTranslation = 0.15;
+	enviro.maxRotation = 15.0;
+	enviro.numOfMolecules = spec.numMolecules;
+	enviro.primaryAtomIndexDefinitions = 1;
+	enviro.primaryAtomIndexArray->push_back(
+	    new std::vector<int>(1, parts.primaryIndex));
+	enviro.randomseed = spec.seed;
+
+	std::vector<Molecule> templates;
+	templates.push_back(Molecule(0, 0, &parts.atoms[0],
+	                             parts.angles.empty() ? NULL : &parts.angles[0],
+	                             parts.bonds.empty() ? NULL : &parts.bonds[0],
+	                             NULL, parts.hops.empty() ? NULL : &parts.hops[0],
+	                             parts.atoms.size(), parts.angles.size(),
+	                             parts.bonds.size(), 0, parts.hops.size()));
+
+	Box* box = new Box();
+	box->environment = new Environment(&enviro);
+	SBScanner sbScanner;
+	buildBoxData(&enviro, templates, box, sbScanner);
+	box->environment->numOfMolecules = box->moleculeCount;
+	box->environment->numOfAtoms = box->atomCount;
+	return box;
+}
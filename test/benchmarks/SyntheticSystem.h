@@ -0,0 +1,136 @@
+/**
+ * SyntheticSystem.h
+ *
+ * Builds simulation boxes for the benchmarks in memory, so that the number of
+ * molecules, the density, the cutoff and the size of the molecules can be
+ * varied without writing config files. A system is some number of copies of
+ * one molecule in a cubic box, placed on the FCC lattice just as a run from a
+ * config file places them.
+ *
+ * The molecules are TIP3P water, OPLS-AA methanol, or a chain of any number
+ * of united atoms with generic Lennard-Jones parameters and alternating
+ * charges. Like the simulation itself, the molecules are rigid, so no bond or
+ * angle parameters are looked up.
+ */
+
+#ifndef SYNTHETIC_SYSTEM_H
+#define SYNTHETIC_SYSTEM_H
+
+#include <string>
+#include <vector>
+
+#include "Metropolis/Box.h"
+#include "Metropolis/SimBox.h"
+#include "Metropolis/SimulationArgs.h"
+
+/** The number of atoms in a chain molecule when none is given */
+#define SYNTHETIC_CHAIN_ATOMS 12
+
+/** The united atoms per cubic nanometer of a liquid of chain molecules */
+#define SYNTHETIC_CHAIN_ATOM_DENSITY 27.5
+
+/** The molecules per cubic nanometer of liquid water at 298 K */
+#define SYNTHETIC_WATER_DENSITY 33.4
+
+/** The molecules per cubic nanometer of liquid methanol at 298 K */
+#define SYNTHETIC_METHANOL_DENSITY 14.9
+
+/**
+ * Describes a synthetic system. The defaults give 500 water molecules at the
+ * density of the liquid, with an 11 angstrom cutoff.
+ */
+struct SyntheticSpec {
+	/** The molecule: "water", "methanol" or "chain" */
+	std::string molecule;
+
+	/** The number of molecules in the box */
+	int numMolecules;
+
+	/** The number of atoms in each molecule, for chains only */
+	int chainAtoms;
+
+	/**
+	 * The number of molecules per cubic nanometer, or 0 for the density of the
+	 * liquid
+	 */
+	double density;
+
+	/** The cutoff distance in angstroms */
+	double cutoff;
+
+	/** Builds the NLC, which every benchmark of the cells needs */
+	bool useNLC;
+
+	/** How the NLC indexes the molecules */
+	SpatialIndexType spatialIndex;
+
+	/** The seed of the random number generator */
+	int seed;
+
+	SyntheticSpec() : molecule("water"), numMolecules(500),
+	                  chainAtoms(SYNTHETIC_CHAIN_ATOMS), density(0),
+	                  cutoff(11.0), useNLC(true),
+	                  spatialIndex(SpatialIndex::Default), seed(12345) {}
+
+	/** @return the density, filling in the liquid density if it is 0 */
+	double getDensity() const;
+
+	/** @return the length of a side of the box in angstroms */
+	double getBoxLength() const;
+
+	/** @return the number of atoms in one molecule */
+	int getAtomsPerMolecule() const;
+
+	/** @return the system in a few words, such as "500 water" */
+	std::string describe() const;
+
+	/** @return true if the molecule is one SyntheticSystem can build */
+	bool isValid() const;
+};
+
+/**
+ * Splits a comma-separated list, as given to the benchmark options that sweep
+ * over several systems.
+ */
+std::vector<std::string> splitList(const char* text);
+
+/**
+ * A Box and the SimBox built from it, for a synthetic system. Building the
+ * system seeds the random number generator and points SimCalcs and GPUCopy at
+ * the new SimBox, so it is ready for the energy kernels and moves.
+ */
+class SyntheticSystem {
+ public:
+	/**
+	 * Builds a system.
+	 *
+	 * @param spec The system to build.
+	 */
+	explicit SyntheticSystem(const SyntheticSpec& spec);
+
+	/**
+	 * Builds only the Box of a system, for a Simulation to build its own
+	 * SimBox from. The caller owns the box.
+	 */
+	static Box* buildBox(const SyntheticSpec& spec);
+
+	/** @return the loaded box, holding the molecule template */
+	Box* getBox() {return box;}
+
+	/** @return the simulation box */
+	SimBox* getSimBox() {return sb;}
+
+	/** @return the description the system was built from */
+	const SyntheticSpec& getSpec() {return spec;}
+
+	/** @return the seconds taken to build the SimBox */
+	double getBuildTime() {return buildTime;}
+
+ private:
+	SyntheticSpec spec;
+	Box* box;
+	SimBox* sb;
+	double buildTime;
+};
+
+#endif
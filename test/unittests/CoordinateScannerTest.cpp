@@ -0,0 +1,62 @@
+#include "Metropolis/Utilities/FileUtilities.h"
+#include "TestUtil.h"
+#include "gtest/gtest.h"
+
+#include <stdio.h>
+
+#define TEST_PDB "coordinateScannerTest.pdb"
+#define TEST_XYZ "coordinateScannerTest.xyz"
+
+static void writeFile(const std::string& path, const std::string& contents) {
+	std::ofstream out(path.c_str());
+	out << contents;
+}
+
+// Descr: Standard PDB records and records pushed out of their columns by
+//        six-digit serial numbers both load, in order
+TEST(CoordinateScannerTest, ReadsPDB)
+{
+	writeFile(TEST_PDB,
+		"REMARK Created by MCGPU\n"
+		"ATOM      1  O   UNK     1      29.373  29.774  29.928\n"
+		"HETATM    2  H   UNK     1     -30.229 -29.374   1.959  1.00  0.00\n"
+		"TER\n"
+		"ATOM  100000  H   UNK 16667      34.651  54.015  65.820\r\n"
+		"END\n");
+
+	Real x[3], y[3], z[3];
+	Real* coords[3] = {x, y, z};
+	CoordinateScanner scanner;
+	ASSERT_TRUE(scanner.readInCoordinates(TEST_PDB, 3, coords));
+	EXPECT_DOUBLE_EQ(29.373, x[0]);
+	EXPECT_DOUBLE_EQ(-29.374, y[1]);
+	EXPECT_DOUBLE_EQ(1.959, z[1]);
+	EXPECT_DOUBLE_EQ(34.651, x[2]);
+	EXPECT_DOUBLE_EQ(65.820, z[2]);
+
+	// The atom count must match the box
+	EXPECT_FALSE(scanner.readInCoordinates(TEST_PDB, 2, coords));
+	EXPECT_FALSE(scanner.readInCoordinates(TEST_PDB, 4, coords));
+
+	remove(TEST_PDB);
+}
+
+// Descr: XYZ files load, and a count that disagrees with the box is rejected
+TEST(CoordinateScannerTest, ReadsXYZ)
+{
+	writeFile(TEST_XYZ, "2\nequilibrated box\nO 1.5 -2.25 3\nH\t4 5 6e-1\n");
+
+	Real x[2], y[2], z[2];
+	Real* coords[3] = {x, y, z};
+	CoordinateScanner scanner;
+	ASSERT_TRUE(scanner.readInCoordinates(TEST_XYZ, 2, coords));
+	EXPECT_DOUBLE_EQ(1.5, x[0]);
+	EXPECT_DOUBLE_EQ(-2.25, y[0]);
+	EXPECT_DOUBLE_EQ(0.6, z[1]);
+	EXPECT_FALSE(scanner.readInCoordinates(TEST_XYZ, 3, coords));
+
+	writeFile(TEST_XYZ, "2\n\nO 1.5 -2.25 3\nH 4 5\n");
+	EXPECT_FALSE(scanner.readInCoordinates(TEST_XYZ, 2, coords));
+
+	remove(TEST_XYZ);
+}
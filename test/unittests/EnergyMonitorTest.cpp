@@ -0,0 +1,110 @@
+#include "Metropolis/EnergyMonitor.h"
+#include "Metropolis/PairCounters.h"
+#include "Metropolis/SimulationStep.h"
+#include "gtest/gtest.h"
+
+#include <math.h>
+#include <vector>
+
+/**
+ * Sets up a SimBox of single-atom molecules on the x axis, each atom with
+ * the same Lennard-Jones parameters and a charge of alternating sign.
+ */
+class EnergyMonitorTest : public ::testing::Test {
+	protected:
+		void build(Real boxSize, Real cutoff, std::vector<Real> x) {
+			int n = x.size();
+			coords[0] = x;
+			coords[1].assign(n, 0.5);
+			coords[2].assign(n, 0.5);
+			atoms[ATOM_SIGMA].assign(n, 3.0);
+			atoms[ATOM_EPSILON].assign(n, 0.2);
+			atoms[ATOM_CHARGE].resize(n);
+			indexes.resize(n);
+			ones.assign(n, 1);
+			for (int i = 0; i < n; i++) {
+				atoms[ATOM_CHARGE][i] = i % 2 == 0 ? 0.5 : -0.5;
+				indexes[i] = i;
+			}
+			for (int i = 0; i < NUM_DIMENSIONS; i++) {
+				atomCoords[i] = &coords[i][0];
+				size[i] = boxSize;
+			}
+			for (int i = 0; i < ATOM_DATA_SIZE; i++) {
+				atomData[i] = &atoms[i][0];
+			}
+			moleculeData[MOL_START] = &indexes[0];
+			moleculeData[MOL_LEN] = &ones[0];
+			moleculeData[MOL_PIDX_START] = &indexes[0];
+			moleculeData[MOL_PIDX_COUNT] = &ones[0];
+
+			sb.numMolecules = sb.numAtoms = n;
+			sb.atomCoordinates = atomCoords;
+			sb.atomData = atomData;
+			sb.moleculeData = moleculeData;
+			sb.primaryIndexes = &indexes[0];
+			sb.size = size;
+			sb.cutoff = cutoff;
+		}
+
+		/** @return the energy of two of the atoms, as the kernels find it */
+		Real pairEnergy(int a1, int a2) {
+			Real r2 = SimCalcs::calcAtomDistSquared(a1, a2, atomCoords, size);
+			return SimCalcs::calcLJEnergy(a1, a2, r2, atomData) +
+			       SimCalcs::calcChargeEnergy(a1, a2, sqrt(r2), atomData);
+		}
+
+		SimBox sb;
+		std::vector<Real> coords[NUM_DIMENSIONS];
+		std::vector<Real> atoms[ATOM_DATA_SIZE];
+		std::vector<int> indexes, ones;
+		Real* atomCoords[NUM_DIMENSIONS];
+		Real* atomData[ATOM_DATA_SIZE];
+		int* moleculeData[MOL_DATA_SIZE];
+		Real size[NUM_DIMENSIONS];
+};
+
+TEST_F(EnergyMonitorTest, SumsPairsInRange)
+{
+	// The last atom is in range of the first only across the boundary
+	build(40.0, 8.0, {1.0, 8.0, 14.0, 38.0});
+	Real expected = pairEnergy(0, 1) + pairEnergy(1, 2) + pairEnergy(0, 3);
+	EXPECT_NEAR(expected, EnergyMonitor::calcSystemEnergy(&sb, atomCoords),
+	            1e-12);
+}
+
+TEST_F(EnergyMonitorTest, ReportsDriftFromCopiedCoordinates)
+{
+	build(40.0, 8.0, {1.0, 8.0, 14.0, 38.0});
+	Real energy = EnergyMonitor::calcSystemEnergy(&sb, atomCoords);
+	EnergyMonitor monitor(&sb, 2.0);
+
+	DriftCheck check;
+	EXPECT_FALSE(monitor.collect(check));
+	EXPECT_TRUE(monitor.submit(10, energy + 2.5));
+
+	// Moving an atom after the copy doesn't change the check
+	coords[0][1] = 9.0;
+	EXPECT_FALSE(monitor.submit(20, energy));
+	EXPECT_EQ(1, monitor.getSkipped());
+
+	ASSERT_TRUE(monitor.wait(check));
+	EXPECT_EQ(10, check.step);
+	EXPECT_NEAR(energy + 2.0, check.recomputed, 1e-12);
+	EXPECT_NEAR(0.5, check.drift, 1e-12);
+	EXPECT_NEAR(0.5 / fabs(energy + 2.0), check.relativeDrift, 1e-12);
+	EXPECT_EQ(1, monitor.getChecks());
+	EXPECT_FALSE(monitor.wait(check));
+}
+
+#ifdef PAIR_COUNTERS_ENABLED
+TEST_F(EnergyMonitorTest, LeavesPairCountersAlone)
+{
+	build(40.0, 8.0, {1.0, 8.0, 14.0, 38.0});
+	PairCounters before = pairCounters;
+	EnergyMonitor::calcSystemEnergy(&sb, atomCoords);
+	PairCounters counted = pairCounters.since(before);
+	EXPECT_EQ(0, counted.atomPairs);
+	EXPECT_EQ(0, counted.moleculePairs);
+}
+#endif
@@ -0,0 +1,161 @@
+#include "Metropolis/Utilities/Journal.h"
+#include "Metropolis/SimBoxConstants.h"
+#include "gtest/gtest.h"
+
+#include <stdio.h>
+#include <unistd.h>
+
+#define TEST_JOURNAL "journalTest.journal"
+
+// Descr: Replays a journal to steps before, on and between keyframes
+TEST(JournalTest, ReconstructFromKeyframe)
+{
+	// Two molecules: atoms 0-1 and atom 2
+	int molStart[2] = {0, 2};
+	int molLen[2] = {2, 1};
+
+	Real x[3] = {0.0, 1.0, 2.0}, y[3] = {0.0, 0.0, 0.0}, z[3] = {0.0, 0.0, 0.0};
+	Real* coords[3] = {x, y, z};
+
+	{
+		JournalWriter writer(TEST_JOURNAL, 3, 2, molStart, molLen);
+		ASSERT_TRUE(writer.isOpen());
+		std::vector<char> moves;
+
+		writer.writeKeyframe(0, coords);
+
+		x[2] = 5.0;   // step 2 moves molecule 1
+		writer.encodeMove(moves, 2, 1, coords);
+		x[0] = 7.0;   // step 4 moves molecule 0
+		y[1] = 3.0;
+		writer.encodeMove(moves, 4, 0, coords);
+		writer.writeRecords(moves);
+		writer.writeKeyframe(4, coords);
+
+		moves.clear();
+		z[2] = 9.0;   // step 6 moves molecule 1
+		writer.encodeMove(moves, 6, 1, coords);
+		writer.writeRecords(moves);
+	}
+
+	JournalReader reader(TEST_JOURNAL);
+	ASSERT_TRUE(reader.isOpen());
+	EXPECT_EQ(3, reader.getAtomCount());
+	EXPECT_EQ(2, reader.getMoleculeCount());
+	EXPECT_EQ(0, reader.getFirstStep());
+	EXPECT_EQ(6, reader.getLastStep());
+
+	Real rx[3], ry[3], rz[3];
+	Real* replay[3] = {rx, ry, rz};
+
+	ASSERT_TRUE(reader.reconstruct(1, replay));
+	EXPECT_EQ(2.0, rx[2]);
+	EXPECT_EQ(0.0, rx[0]);
+
+	ASSERT_TRUE(reader.reconstruct(3, replay));
+	EXPECT_EQ(5.0, rx[2]);
+	EXPECT_EQ(0.0, rx[0]);
+
+	ASSERT_TRUE(reader.reconstruct(5, replay));
+	EXPECT_EQ(7.0, rx[0]);
+	EXPECT_EQ(3.0, ry[1]);
+	EXPECT_EQ(0.0, rz[2]);
+
+	ASSERT_TRUE(reader.reconstruct(6, replay));
+	EXPECT_EQ(9.0, rz[2]);
+	EXPECT_EQ(5.0, rx[2]);
+
+	EXPECT_FALSE(reader.reconstruct(7, replay));
+
+	remove(TEST_JOURNAL);
+}
+
+// Descr: A header whose molecules lie outside of the atoms is rejected
+TEST(JournalTest, RejectsBadHeader)
+{
+	int molStart[2] = {0, 2};
+	int molLen[2] = {2, 1};
+	Real x[3] = {0.0, 1.0, 2.0}, y[3] = {0.0, 0.0, 0.0}, z[3] = {0.0, 0.0, 0.0};
+	Real* coords[3] = {x, y, z};
+
+	int badStart[2] = {2, -1};
+	int badLen[2] = {2, 2};
+	for (int i = 0; i < 2; i++) {
+		{
+			molStart[1] = badStart[i];
+			molLen[1] = badLen[i];
+			JournalWriter writer(TEST_JOURNAL, 3, 2, molStart, molLen);
+			ASSERT_TRUE(writer.isOpen());
+			writer.writeKeyframe(0, coords);
+		}
+		JournalReader reader(TEST_JOURNAL);
+		EXPECT_FALSE(reader.isOpen());
+	}
+
+	{
+		JournalWriter writer(TEST_JOURNAL, 0, 0, molStart, molLen);
+		ASSERT_TRUE(writer.isOpen());
+		writer.writeKeyframe(0, coords);
+	}
+	JournalReader reader(TEST_JOURNAL);
+	EXPECT_FALSE(reader.isOpen());
+
+	remove(TEST_JOURNAL);
+}
+
+// Descr: A record cut short at the end of the journal is not replayed
+TEST(JournalTest, IgnoresTruncatedRecord)
+{
+	int molStart[2] = {0, 2};
+	int molLen[2] = {2, 1};
+	Real x[3] = {0.0, 1.0, 2.0}, y[3] = {0.0, 0.0, 0.0}, z[3] = {0.0, 0.0, 0.0};
+	Real* coords[3] = {x, y, z};
+
+	long moveEnd;
+	{
+		JournalWriter writer(TEST_JOURNAL, 3, 2, molStart, molLen);
+		ASSERT_TRUE(writer.isOpen());
+		std::vector<char> moves;
+		writer.writeKeyframe(0, coords);
+		x[2] = 5.0;
+		writer.encodeMove(moves, 2, 1, coords);
+		writer.writeRecords(moves);
+	}
+	FILE* journal = fopen(TEST_JOURNAL, "rb");
+	ASSERT_TRUE(journal != NULL);
+	fseek(journal, 0, SEEK_END);
+	moveEnd = ftell(journal);
+	fclose(journal);
+
+	// A keyframe at step 2 whose coordinates were cut short, as a crash part
+	// way through writing would leave it
+	journal = fopen(TEST_JOURNAL, "ab");
+	ASSERT_TRUE(journal != NULL);
+	int32_t kind = JOURNAL_KEYFRAME;
+	int64_t step = 2;
+	Real partial[2] = {99.0, 99.0};
+	fwrite(&kind, sizeof(int32_t), 1, journal);
+	fwrite(&step, sizeof(int64_t), 1, journal);
+	fwrite(partial, sizeof(Real), 2, journal);
+	fclose(journal);
+
+	JournalReader reader(TEST_JOURNAL);
+	ASSERT_TRUE(reader.isOpen());
+	EXPECT_EQ(2, reader.getLastStep());
+
+	Real rx[3], ry[3], rz[3];
+	Real* replay[3] = {rx, ry, rz};
+	ASSERT_TRUE(reader.reconstruct(2, replay));
+	EXPECT_EQ(5.0, rx[2]);
+	EXPECT_EQ(0.0, rx[0]);
+	EXPECT_EQ(1.0, rx[1]);
+
+	// A move cut short leaves the last step at the record before it
+	ASSERT_EQ(0, truncate(TEST_JOURNAL, moveEnd - sizeof(Real)));
+	JournalReader cut(TEST_JOURNAL);
+	ASSERT_TRUE(cut.isOpen());
+	EXPECT_EQ(0, cut.getLastStep());
+	EXPECT_FALSE(cut.reconstruct(2, replay));
+
+	remove(TEST_JOURNAL);
+}
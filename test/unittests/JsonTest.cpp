@@ -0,0 +1,37 @@
+#include "Metropolis/Utilities/Json.h"
+#include "gtest/gtest.h"
+
+#include <math.h>
+
+TEST(JsonTest, WritesMembersInOrder) {
+	JsonObject inner;
+	inner.add("count", 3).add("ok", true);
+
+	JsonObject object;
+	object.add("name", "meoh500").add("energy", -1315.5).add("inner", inner);
+	EXPECT_EQ("{\"name\": \"meoh500\", \"energy\": -1315.5, "
+	          "\"inner\": {\"count\": 3, \"ok\": true}}", object.str());
+	EXPECT_EQ("{}", JsonObject().str());
+}
+
+TEST(JsonTest, WritesArraysOfObjects) {
+	std::vector<JsonObject> items(2);
+	items[0].add("n", 1);
+	items[1].add("n", 2);
+
+	JsonObject object;
+	object.add("items", items).add("none", std::vector<JsonObject>());
+	EXPECT_EQ("{\"items\": [{\"n\": 1}, {\"n\": 2}], \"none\": []}",
+	          object.str());
+}
+
+TEST(JsonTest, EscapesStrings) {
+	EXPECT_EQ("\"a\\\"b\\\\c\\nd\\u0001\"",
+	          JsonObject::quote("a\"b\\c\nd\x01"));
+}
+
+TEST(JsonTest, WritesNonFiniteNumbersAsNull) {
+	JsonObject object;
+	object.add("x", (double) NAN).add("y", (double) INFINITY);
+	EXPECT_EQ("{\"x\": null, \"y\": null}", object.str());
+}
@@ -0,0 +1,70 @@
+#include "Metropolis/MetricsServer.h"
+#include "gtest/gtest.h"
+
+#include <string>
+#include <vector>
+
+/** @return the line of a metric in the Prometheus text, or "" */
+static std::string line(const std::string& text, const std::string& metric) {
+	size_t start = text.find("\n" + metric + " ");
+	if (start == std::string::npos) {
+		return "";
+	}
+	start++;
+	return text.substr(start, text.find('\n', start) - start);
+}
+
+TEST(MetricsServerTest, ReportsOnlyInfoBeforeFirstSnapshot) {
+	MetricsServer server("meoh500", "brute-force",
+	                     std::vector<std::string>(1, "Move"));
+	std::string text = server.format();
+	EXPECT_NE(std::string::npos, text.find(
+	    "mcgpu_info{name=\"meoh500\",strategy=\"brute-force\"} 1\n"));
+	EXPECT_EQ(std::string::npos, text.find("mcgpu_step"));
+}
+
+TEST(MetricsServerTest, FormatsPublishedSnapshot) {
+	std::vector<std::string> phases;
+	phases.push_back("Choose");
+	phases.push_back("Old-Energy");
+	MetricsServer server("", "proximity-matrix", phases);
+
+	MetricsSnapshot snapshot = MetricsSnapshot();
+	snapshot.step = 4000;
+	snapshot.lastStep = 10000;
+	snapshot.energy = -1315.5;
+	snapshot.accepted = 3000;
+	snapshot.rejected = 1000;
+	snapshot.stepsPerSecond = 2500;
+	snapshot.phaseCount[1] = 4000;
+	snapshot.phaseTotal[1] = 0.5;
+	snapshot.phaseP99[1] = 0.00025;
+	server.publish(snapshot);
+
+	std::string text = server.format();
+	EXPECT_EQ("mcgpu_step 4000", line(text, "mcgpu_step"));
+	EXPECT_EQ("mcgpu_last_step 10000", line(text, "mcgpu_last_step"));
+	EXPECT_EQ("mcgpu_energy -1315.5", line(text, "mcgpu_energy"));
+	EXPECT_EQ("mcgpu_acceptance_ratio 0.75",
+	          line(text, "mcgpu_acceptance_ratio"));
+	EXPECT_EQ("mcgpu_steps_per_second 2500",
+	          line(text, "mcgpu_steps_per_second"));
+	EXPECT_NE(std::string::npos, text.find(
+	    "mcgpu_phase_seconds{phase=\"Old-Energy\",quantile=\"0.99\"} "
+	    "0.00025\n"));
+	EXPECT_NE(std::string::npos, text.find(
+	    "mcgpu_phase_seconds_count{phase=\"Old-Energy\"} 4000\n"));
+	EXPECT_NE(std::string::npos, text.find(
+	    "mcgpu_phase_seconds_sum{phase=\"Choose\"} 0\n"));
+}
+
+TEST(MetricsServerTest, EscapesLabelsForPrometheus) {
+	// Only backslashes, quotes and line feeds are escaped; a tab or a
+	// non-ASCII byte passes through as is
+	MetricsServer server("a\\b\"c\nd\te\xc3\xa9", "brute-force",
+	                     std::vector<std::string>(1, "Move"));
+	std::string text = server.format();
+	EXPECT_NE(std::string::npos, text.find(
+	    "mcgpu_info{name=\"a\\\\b\\\"c\\nd\te\xc3\xa9\","
+	    "strategy=\"brute-force\"} 1\n"));
+}